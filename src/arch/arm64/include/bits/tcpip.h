@@ -13,4 +13,21 @@ FILE_SECBOOT ( PERMITTED );
 extern uint16_t tcpip_continue_chksum ( uint16_t sum, const void *data,
 					size_t len );
 
+/**
+ * Copy data and calculate continued TCP/IP checksum
+ *
+ * @v partial		Checksum of already-summed data, in network byte order
+ * @v dest		Destination buffer
+ * @v src		Source buffer
+ * @v len		Length of data
+ * @ret cksum		Updated checksum, in network byte order
+ */
+static inline __attribute__ (( always_inline )) uint16_t
+tcpip_copy_chksum ( uint16_t partial, void *dest, const void *src,
+		    size_t len ) {
+
+	/* Use generic word-at-a-time implementation */
+	return generic_tcpip_copy_chksum ( partial, dest, src, len );
+}
+
 #endif /* _BITS_TCPIP_H */
@@ -31,6 +31,7 @@ FILE_SECBOOT ( PERMITTED );
  */
 
 #include <limits.h>
+#include <string.h>
 #include <ipxe/tcpip.h>
 
 extern char x86_tcpip_loop_end[];
@@ -172,3 +173,73 @@ uint16_t tcpip_continue_chksum ( uint16_t partial, const void *data,
 
 	return ( ~sum & 0xffff );
 }
+
+/**
+ * Copy data and calculate continued TCP/IP checksum
+ *
+ * @v partial		Checksum of already-summed data, in network byte order
+ * @v dest		Destination buffer
+ * @v src		Source buffer
+ * @v len		Length of data
+ * @ret cksum		Updated checksum, in network byte order
+ *
+ * The bulk of the data is copied and summed in a single pass, four
+ * native machine words at a time.  Any remaining data is copied and
+ * then summed using tcpip_continue_chksum().
+ */
+uint16_t tcpip_copy_chksum ( uint16_t partial, void *dest, const void *src,
+			     size_t len ) {
+	unsigned long sum = ( ( ~partial ) & 0xffff );
+	unsigned long loop_count;
+	unsigned long discard_S;
+	unsigned long discard_D;
+	unsigned long discard_a;
+	size_t done;
+
+	/* Calculate number of iterations of the main loop */
+	loop_count = ( len / ( sizeof ( sum ) * 4 ) );
+	done = ( loop_count * sizeof ( sum ) * 4 );
+
+	/* Copy and checksum the bulk of the data.  Pointers are
+	 * advanced using "lea" and the loop counter using "dec",
+	 * neither of which modifies the carry flag.
+	 */
+	if ( loop_count ) {
+		__asm__ ( /* Clear carry flag before starting checksumming */
+			  "clc\n\t"
+			  /* Main "mov;mov;adc" loop, unrolled x4 */
+			  "\n1:\n\t"
+			  "mov (%1), %3\n\t"
+			  "mov %3, (%2)\n\t"
+			  "adc %3, %0\n\t"
+			  "mov (1*%c5)(%1), %3\n\t"
+			  "mov %3, (1*%c5)(%2)\n\t"
+			  "adc %3, %0\n\t"
+			  "mov (2*%c5)(%1), %3\n\t"
+			  "mov %3, (2*%c5)(%2)\n\t"
+			  "adc %3, %0\n\t"
+			  "mov (3*%c5)(%1), %3\n\t"
+			  "mov %3, (3*%c5)(%2)\n\t"
+			  "adc %3, %0\n\t"
+			  "lea (4*%c5)(%1), %1\n\t"
+			  "lea (4*%c5)(%2), %2\n\t"
+			  "dec %4\n\t"
+			  "jnz 1b\n\t"
+			  /* Consume CF */
+			  "adc $0, %0\n\t"
+			  "adc $0, %0\n\t"
+			  : "+r" ( sum ), "=&r" ( discard_S ),
+			    "=&r" ( discard_D ), "=&r" ( discard_a ),
+			    "+r" ( loop_count )
+			  : "i" ( sizeof ( sum ) ), "1" ( src ), "2" ( dest )
+			  : "cc", "memory" );
+	}
+
+	/* Fold down to a uint16_t */
+	while ( sum >> 16 )
+		sum = ( ( sum & 0xffff ) + ( sum >> 16 ) );
+
+	/* Copy and checksum any remaining data */
+	memcpy ( ( dest + done ), ( src + done ), ( len - done ) );
+	return tcpip_continue_chksum ( ~sum, ( dest + done ), ( len - done ) );
+}
@@ -12,5 +12,7 @@ FILE_SECBOOT ( PERMITTED );
 
 extern uint16_t tcpip_continue_chksum ( uint16_t partial, const void *data,
 					size_t len );
+extern uint16_t tcpip_copy_chksum ( uint16_t partial, void *dest,
+				    const void *src, size_t len );
 
 #endif /* _BITS_TCPIP_H */
@@ -95,6 +95,7 @@ FILE_SECBOOT ( PERMITTED );
 #define DHCP_CMD		/* DHCP management commands */
 #define FCMGMT_CMD		/* Fibre Channel management commands */
 #define FORM_CMD		/* Form commands */
+//#define HEAPSTAT_CMD		/* Heap statistics commands */
 #define IBMGMT_CMD		/* Infiniband management commands */
 #define IFMGMT_CMD		/* Interface management commands */
 #define IMAGE_CMD		/* Image management commands */
@@ -307,6 +308,7 @@ FILE_SECBOOT ( PERMITTED );
 				 * registers when iPXE traps to it due to
 				 * privileged instructions */
 //#define ERRMSG_80211		/* All 802.11 error descriptions (~3.3kb) */
+//#define HEAP_SITES		/* Attribute heap allocations to call sites */
 
 #include <config/named.h>
 #include NAMED_CONFIG(general.h)
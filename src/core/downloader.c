@@ -81,6 +81,10 @@ static void downloader_free ( struct refcnt *refcnt ) {
 static void downloader_finished ( struct downloader *downloader, int rc ) {
 	struct image *image = downloader->image;
 
+	/* Release any excess buffer space */
+	if ( rc == 0 )
+		rc = xferbuf_shrink ( &downloader->buffer );
+
 	/* Log download status */
 	if ( rc == 0 ) {
 		syslog ( LOG_NOTICE, "Downloaded \"%s\"\n", image->name );
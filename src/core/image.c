@@ -240,25 +240,33 @@ int image_set_cmdline ( struct image *image, const char *cmdline ) {
 }
 
 /**
- * Set image length
+ * Set image length and allocated size
  *
  * @v image		Image
  * @v len		Length of image data
+ * @v size		Allocated size of image data (must be at least len)
  * @ret rc		Return status code
+ *
+ * An image that is being filled incrementally (e.g. by a download of
+ * unknown length) may be allocated more storage than it currently
+ * uses.  The image length always reflects only the valid data.
  */
-int image_set_len ( struct image *image, size_t len ) {
+int image_set_size ( struct image *image, size_t len, size_t size ) {
 	size_t alloc_len;
 	void *data;
 	void *new;
 	char *nul;
 
+	/* Sanity check */
+	assert ( len <= size );
+
 	/* Refuse to reallocate static images */
 	if ( image->flags & IMAGE_STATIC )
 		return -ENOTTY;
 
 	/* Calculate allocation length (including a terminating NUL) */
-	alloc_len = ( len ? ( len + 1 ) : 0 );
-	if ( alloc_len < len )
+	alloc_len = ( size ? ( size + 1 ) : 0 );
+	if ( alloc_len < size )
 		return -ERANGE;
 
 	/* (Re)allocate image data */
@@ -268,11 +276,11 @@ int image_set_len ( struct image *image, size_t len ) {
 	new = urealloc ( data, alloc_len );
 	if ( ! new )
 		return -ENOMEM;
-	image->data = ( len ? new : empty_image_data );
+	image->data = ( size ? new : empty_image_data );
 	image->len = len;
 
 	/* Add terminating NUL (if not the empty image) */
-	if ( len ) {
+	if ( size ) {
 		nul = ( image->rwdata + len );
 		*nul = '\0';
 	}
@@ -280,6 +288,18 @@ int image_set_len ( struct image *image, size_t len ) {
 	return 0;
 }
 
+/**
+ * Set image length
+ *
+ * @v image		Image
+ * @v len		Length of image data
+ * @ret rc		Return status code
+ */
+int image_set_len ( struct image *image, size_t len ) {
+
+	return image_set_size ( image, len, len );
+}
+
 /**
  * Set image data
  *
@@ -28,13 +28,182 @@ FILE_SECBOOT ( PERMITTED );
 #include <strings.h>
 #include <errno.h>
 #include <ipxe/malloc.h>
+#include <ipxe/io.h>
 #include <ipxe/iobuf.h>
 
 /** @file
  *
  * I/O buffers
  *
+ * Freed I/O buffers of commonly used sizes are retained in per-size
+ * caches, so that the allocations made for every received and
+ * transmitted packet do not need to search the heap.  Cached buffers
+ * are released via a cache discarder whenever the heap comes under
+ * memory pressure.
+ *
+ * The same cache discarder empties the caches on shutdown, since the
+ * heap's shutdown function discards all cached data.  This runs only
+ * after all devices have been removed (and have therefore freed
+ * their I/O buffers), and so no cached buffers survive into the
+ * booted operating system.
+ */
+
+/** An I/O buffer size class cache */
+struct io_buffer_cache {
+	/** Buffer length */
+	size_t len;
+	/** Physical alignment */
+	size_t align;
+	/** Maximum number of cached buffers */
+	unsigned int max;
+	/** Number of cached buffers */
+	unsigned int count;
+	/** List of cached buffers */
+	struct list_head list;
+};
+
+/** Define an I/O buffer size class cache */
+#define IOB_CACHE( index, _len, _align, _max ) {			\
+	.len = (_len),							\
+	.align = (_align),						\
+	.max = (_max),							\
+	.list = LIST_HEAD_INIT ( iob_caches[index].list ),		\
+	}
+
+/** I/O buffer size class caches (in order of increasing size)
+ *
+ * Each buffer is aligned on its own size (rounded up to the nearest
+ * power of two), up to a maximum of page-size alignment, exactly as
+ * would be done by alloc_iob().
+ */
+static struct io_buffer_cache iob_caches[] = {
+	IOB_CACHE ( 0, 128, 128, 64 ),
+	IOB_CACHE ( 1, 512, 512, 64 ),
+	IOB_CACHE ( 2, 2048, 2048, 128 ),
+	IOB_CACHE ( 3, 4096, PAGE_SIZE, 32 ),
+	IOB_CACHE ( 4, 9216, PAGE_SIZE, 16 ),
+};
+
+/**
+ * Identify I/O buffer cache for a new allocation
+ *
+ * @v len	Required length of buffer
+ * @v align	Physical alignment
+ * @ret cache	I/O buffer cache, or NULL
+ */
+static struct io_buffer_cache * iob_cache_alloc ( size_t len, size_t align ) {
+	struct io_buffer_cache *cache;
+	unsigned int i;
+
+	/* Use the smallest size class that can hold the buffer,
+	 * provided that its alignment is sufficient.
+	 */
+	for ( i = 0 ; i < ( sizeof ( iob_caches ) /
+			    sizeof ( iob_caches[0] ) ) ; i++ ) {
+		cache = &iob_caches[i];
+		if ( len <= cache->len )
+			return ( ( align <= cache->align ) ? cache : NULL );
+	}
+	return NULL;
+}
+
+/**
+ * Identify I/O buffer cache for a freed buffer
+ *
+ * @v iobuf	I/O buffer
+ * @ret cache	I/O buffer cache, or NULL
  */
+static struct io_buffer_cache * iob_cache_free ( struct io_buffer *iobuf ) {
+	struct io_buffer_cache *cache;
+	size_t len = ( iobuf->end - iobuf->head );
+	unsigned int i;
+
+	/* Only detached buffers exactly matching a size class may be
+	 * cached.  There is no need to distinguish between buffers
+	 * allocated via the cache and other buffers that happen to
+	 * match a size class: both are freed in the same way.
+	 */
+	if ( iobuf->end == iobuf )
+		return NULL;
+	for ( i = 0 ; i < ( sizeof ( iob_caches ) /
+			    sizeof ( iob_caches[0] ) ) ; i++ ) {
+		cache = &iob_caches[i];
+		if ( ( len == cache->len ) &&
+		     ( ( virt_to_phys ( iobuf->head ) &
+			 ( cache->align - 1 ) ) == 0 ) ) {
+			return ( ( cache->count < cache->max ) ? cache : NULL );
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Allocate I/O buffer from size class cache
+ *
+ * @v cache	I/O buffer cache
+ * @ret iobuf	I/O buffer, or NULL if none available
+ */
+static struct io_buffer * iob_cache_get ( struct io_buffer_cache *cache ) {
+	struct io_buffer *iobuf;
+	void *data;
+
+	/* Reuse a cached buffer, if available */
+	iobuf = list_first_entry ( &cache->list, struct io_buffer, list );
+	if ( iobuf ) {
+		list_del ( &iobuf->list );
+		cache->count--;
+		VALGRIND_MAKE_MEM_UNDEFINED ( iobuf->head, cache->len );
+		return iobuf;
+	}
+
+	/* Otherwise, allocate a new buffer and detached descriptor */
+	data = malloc_phys ( cache->len, cache->align );
+	if ( ! data )
+		return NULL;
+	iobuf = malloc ( sizeof ( *iobuf ) );
+	if ( ! iobuf ) {
+		free_phys ( data, cache->len );
+		return NULL;
+	}
+	iobuf->head = data;
+	iobuf->end = ( data + cache->len );
+
+	return iobuf;
+}
+
+/**
+ * Discard a cached I/O buffer
+ *
+ * @ret discarded	Number of cached items discarded
+ */
+static unsigned int iob_cache_discard ( void ) {
+	struct io_buffer_cache *cache;
+	struct io_buffer *iobuf;
+	unsigned int i = ( sizeof ( iob_caches ) / sizeof ( iob_caches[0] ) );
+
+	/* Discard a buffer from the largest non-empty size class */
+	while ( i-- ) {
+		cache = &iob_caches[i];
+		iobuf = list_first_entry ( &cache->list, struct io_buffer,
+					   list );
+		if ( ! iobuf )
+			continue;
+		list_del ( &iobuf->list );
+		cache->count--;
+		free_phys ( iobuf->head, cache->len );
+		free ( iobuf );
+		return 1;
+	}
+	return 0;
+}
+
+/** I/O buffer cache discarder
+ *
+ * This is also used to empty the caches on shutdown.
+ */
+struct cache_discarder iob_cache_discarder __cache_discarder ( CACHE_CHEAP ) = {
+	.discard = iob_cache_discard,
+};
 
 /**
  * Allocate I/O buffer with specified alignment and offset
@@ -45,8 +214,13 @@ FILE_SECBOOT ( PERMITTED );
  * @ret iobuf	I/O buffer, or NULL if none available
  *
  * @c align will be rounded up to the nearest power of two.
+ *
+ * Buffers with no offset that fit within a size class will be
+ * allocated from the size class cache, and so may have more tailroom
+ * than was requested.
  */
 struct io_buffer * alloc_iob_raw ( size_t len, size_t align, size_t offset ) {
+	struct io_buffer_cache *cache;
 	struct io_buffer *iobuf;
 	size_t headroom;
 	size_t tailroom;
@@ -55,6 +229,18 @@ struct io_buffer * alloc_iob_raw ( size_t len, size_t align, size_t offset ) {
 	unsigned int align_log2;
 	void *data;
 
+	/* Use size class cache, if applicable */
+	if ( ( offset == 0 ) && ( cache = iob_cache_alloc ( len, align ) ) ) {
+		iobuf = iob_cache_get ( cache );
+		if ( iobuf ) {
+			memset ( &iobuf->map, 0, sizeof ( iobuf->map ) );
+			iobuf->data = iobuf->tail = iobuf->head;
+			iobuf->flags = 0;
+			iobuf->mss = 0;
+		}
+		return iobuf;
+	}
+
 	/* Round up requested alignment and calculate initial headroom
 	 * and tailroom to ensure that no cachelines are shared
 	 * between I/O buffer data and other data structures.
@@ -114,6 +300,8 @@ struct io_buffer * alloc_iob_raw ( size_t len, size_t align, size_t offset ) {
 	iobuf->head = data;
 	iobuf->data = iobuf->tail = ( data + headroom );
 	iobuf->end = ( data + len );
+	iobuf->flags = 0;
+	iobuf->mss = 0;
 
 	return iobuf;
 }
@@ -151,6 +339,7 @@ struct io_buffer * alloc_iob ( size_t len ) {
  * @v iobuf	I/O buffer
  */
 void free_iob ( struct io_buffer *iobuf ) {
+	struct io_buffer_cache *cache;
 	size_t len;
 
 	/* Allow free_iob(NULL) to be valid */
@@ -163,8 +352,16 @@ void free_iob ( struct io_buffer *iobuf ) {
 	assert ( iobuf->tail <= iobuf->end );
 	assert ( ! dma_mapped ( &iobuf->map ) );
 
-	/* Free buffer */
+	/* Return buffer to size class cache, if applicable */
 	len = ( iobuf->end - iobuf->head );
+	if ( ( cache = iob_cache_free ( iobuf ) ) ) {
+		VALGRIND_MAKE_MEM_NOACCESS ( iobuf->head, len );
+		list_add ( &iobuf->list, &cache->list );
+		cache->count++;
+		return;
+	}
+
+	/* Free buffer */
 	if ( iobuf->end == iobuf ) {
 
 		/* Descriptor is inline */
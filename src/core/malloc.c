@@ -27,12 +27,15 @@ FILE_SECBOOT ( PERMITTED );
 #include <stddef.h>
 #include <stdint.h>
 #include <string.h>
+#include <strings.h>
 #include <ipxe/io.h>
 #include <ipxe/list.h>
 #include <ipxe/init.h>
 #include <ipxe/refcnt.h>
 #include <ipxe/malloc.h>
+#include <ipxe/umalloc.h>
 #include <valgrind/memcheck.h>
+#include <config/general.h>
 
 /** @file
  *
@@ -40,8 +43,8 @@ FILE_SECBOOT ( PERMITTED );
  *
  * @anchor malloc
  *
- * Memory allocation via malloc() is provided using a simple
- * free-block list in a fixed-size heap.
+ * Memory allocation via malloc() is provided using segregated
+ * free-block lists in an internal heap.
  *
  * The standard C semantics are supported.  Calling realloc() with a
  * size of zero is a valid way to free a block.  Calling malloc() or
@@ -63,7 +66,11 @@ FILE_SECBOOT ( PERMITTED );
  * In contrast, memory deallocation assumes that the caller is always
  * passing in a valid pointer value.
  *
- * The internal heap is relatively small.  Allocation is expected to
+ * The internal heap starts from a relatively small fixed-size area.
+ * When this area is exhausted, the heap will be extended (up to a
+ * fixed limit) using additional regions obtained from the external
+ * heap via umalloc(), and each such region will be returned to the
+ * external heap once it has drained.  Allocation is still expected to
  * sometimes fail in normal operation, and all callers must be
  * prepared to handle it cleanly.  Device drivers attempting to
  * allocate receive buffers to refill a receive ring can simply exit
@@ -86,10 +93,28 @@ FILE_SECBOOT ( PERMITTED );
  * A cache discard mechanism exists to attempt to alleviate memory
  * pressure by discarding cached information (such as packets held in
  * a TCP out-of-order receive queue) when an allocation attempt would
- * otherwise fail.  Code that holds pointers to discardable objects
- * must be careful not to call any allocation functions.
+ * otherwise fail, and the heap cannot be extended.  Code that holds
+ * pointers to discardable objects must be careful not to call any
+ * allocation functions.
  *
+ * Usage statistics (including a histogram of allocation sizes) are
+ * maintained for each heap at negligible cost.  Allocations from the
+ * internal heap may optionally also be attributed to their calling
+ * addresses, by enabling HEAP_SITES in config/general.h.
+ *
+ */
+
+/** A free memory block linkage
+ *
+ * Free blocks are linked into singly-rooted lists (size bins and
+ * address hash chains) that support constant-time removal.
  */
+struct memory_link {
+	/** Next link in list */
+	struct memory_link *next;
+	/** Pointer to the previous link's (or list head's) next pointer */
+	struct memory_link **pprev;
+};
 
 /** A free block of memory */
 struct memory_block {
@@ -106,16 +131,31 @@ struct memory_block {
 	 */
 	char pad[ offsetof ( struct refcnt, count ) +
 		  sizeof ( ( ( struct refcnt * ) NULL )->count ) ];
-	/** List of free blocks */
-	struct list_head list;
+	/** Size bin list */
+	struct memory_link bin;
+	/** Start address hash chain */
+	struct memory_link start;
+	/** End address hash chain */
+	struct memory_link end;
 };
 
 /** Physical address alignment maintained for free blocks of memory
  *
  * We keep memory blocks aligned on a power of two that is at least
- * large enough to hold a @c struct @c memory_block.
+ * large enough to hold a @c struct @c memory_block.  A free block
+ * holds its size, the reference counter padding, and three
+ * two-pointer links (size bin, start address hash chain, and end
+ * address hash chain), i.e. eight pointer-sized words.  This is
+ * required to allow free blocks to be found and coalesced in constant
+ * time.
+ *
+ * This is twice the alignment required by a single free list.  On
+ * 64-bit builds, it costs between 16 and 26 bytes per allocation on
+ * average in the self-tests.  Peak heap usage grows by under 2% for
+ * network-heavy workloads, and by around 9% (under 200 bytes) for
+ * the settings tests, which make the smallest allocations.
  */
-#define MIN_MEMBLOCK_ALIGN ( 4 * sizeof ( void * ) )
+#define MIN_MEMBLOCK_ALIGN ( 8 * sizeof ( void * ) )
 
 /** A block of allocated memory complete with size information */
 struct autosized_block {
@@ -128,7 +168,8 @@ struct autosized_block {
 /**
  * Heap area size
  *
- * Currently fixed at 4MB.
+ * Currently fixed at 4MB.  The heap may be extended beyond this size
+ * using additional regions.
  */
 #define HEAP_SIZE ( 4096 * 1024 )
 
@@ -138,136 +179,371 @@ struct autosized_block {
 /** The heap area */
 static char __attribute__ (( aligned ( HEAP_ALIGN ) )) heap_area[HEAP_SIZE];
 
+/** Minimum size of an additional heap region */
+#define HEAP_REGION_SIZE ( 1024 * 1024 )
+
+/** Maximum total size of additional heap regions */
+#define HEAP_REGION_MAX ( 64 * 1024 * 1024 )
+
+/** An additional heap region obtained from the external heap */
+struct heap_region {
+	/** List of additional heap regions */
+	struct list_head list;
+	/** Start of usable memory */
+	void *start;
+	/** Length of usable memory */
+	size_t len;
+	/** Total length of external allocation */
+	size_t total;
+};
+
+#ifdef HEAP_SITES
+
+/** Number of tracked allocation sites (must be a power of two) */
+#define HEAP_SITES_MAX 64
+
+/** Tracked allocation sites */
+struct heap_site heap_sites[HEAP_SITES_MAX];
+
+/** Number of tracked allocation sites */
+const unsigned int heap_num_sites = HEAP_SITES_MAX;
+
+#endif /* HEAP_SITES */
+
+/** Number of bits in a size bin bitmap word */
+#define HEAP_BINMAP_BITS ( 8 * sizeof ( unsigned long ) )
+
+/**
+ * Get memory block from size bin link
+ *
+ * @v link		Size bin link, or NULL
+ * @ret block		Memory block, or NULL
+ */
+#define bin_block( link ) \
+	( (link) ? container_of ( (link), struct memory_block, bin ) : NULL )
+
 /**
- * Mark all blocks in free list as defined
+ * Iterate over all free memory blocks
  *
+ * @v block		Memory block
  * @v heap		Heap
+ * @v index		Size bin index
  */
-static inline void valgrind_make_blocks_defined ( struct heap *heap ) {
-	struct memory_block *block;
+#define for_each_free_block( block, heap, index )			\
+	for ( (index) = 0 ; (index) < HEAP_BINS ; (index)++ )		\
+		for ( (block) = bin_block ( (heap)->bins[index] ) ;	\
+		      (block) ;						\
+		      (block) = bin_block ( (block)->bin.next ) )
 
-	/* Do nothing unless running under Valgrind */
-	if ( RUNNING_ON_VALGRIND <= 0 )
-		return;
+/**
+ * Add link to list
+ *
+ * @v head		List head
+ * @v link		Link
+ */
+static inline void heap_link ( struct memory_link **head,
+			       struct memory_link *link ) {
+
+	link->next = *head;
+	if ( link->next )
+		link->next->pprev = &link->next;
+	link->pprev = head;
+	*head = link;
+}
 
-	/* Traverse free block list, marking each block structure as
-	 * defined.  Some contortions are necessary to avoid errors
-	 * from list_check().
-	 */
+/**
+ * Remove link from list
+ *
+ * @v link		Link
+ */
+static inline void heap_unlink ( struct memory_link *link ) {
 
-	/* Mark block list itself as defined */
-	VALGRIND_MAKE_MEM_DEFINED ( &heap->blocks, sizeof ( heap->blocks ) );
+	*(link->pprev) = link->next;
+	if ( link->next )
+		link->next->pprev = link->pprev;
+}
 
-	/* Mark areas accessed by list_check() as defined */
-	VALGRIND_MAKE_MEM_DEFINED ( &heap->blocks.prev->next,
-				    sizeof ( heap->blocks.prev->next ) );
-	VALGRIND_MAKE_MEM_DEFINED ( heap->blocks.next,
-				    sizeof ( *heap->blocks.next ) );
-	VALGRIND_MAKE_MEM_DEFINED ( &heap->blocks.next->next->prev,
-				    sizeof ( heap->blocks.next->next->prev ) );
+/**
+ * Calculate size bin index
+ *
+ * @v size		Block size
+ * @ret index		Size bin index
+ *
+ * Each power of two is subdivided into @c HEAP_BIN_SUBDIVISIONS bins
+ * of equal width.
+ */
+static inline unsigned int heap_bin ( size_t size ) {
+	unsigned int msb = ( flsl ( size ) - 1 );
+	unsigned int shift;
+
+	if ( msb < HEAP_BIN_SUBDIVISIONS_LOG2 )
+		return ( msb << HEAP_BIN_SUBDIVISIONS_LOG2 );
+	shift = ( msb - HEAP_BIN_SUBDIVISIONS_LOG2 );
+	return ( ( msb << HEAP_BIN_SUBDIVISIONS_LOG2 ) |
+		 ( ( size >> shift ) & ( HEAP_BIN_SUBDIVISIONS - 1 ) ) );
+}
 
-	/* Mark each block in list as defined */
-	list_for_each_entry ( block, &heap->blocks, list ) {
+/**
+ * Calculate size class
+ *
+ * @v size		Block size
+ * @ret index		Size class index
+ */
+static inline unsigned int heap_class ( size_t size ) {
 
-		/* Mark block as defined */
-		VALGRIND_MAKE_MEM_DEFINED ( block, sizeof ( *block ) );
+	return ( flsl ( size ) - 1 );
+}
 
-		/* Mark areas accessed by list_check() as defined */
-		VALGRIND_MAKE_MEM_DEFINED ( block->list.next,
-					    sizeof ( *block->list.next ) );
-		VALGRIND_MAKE_MEM_DEFINED ( &block->list.next->next->prev,
-				      sizeof ( block->list.next->next->prev ) );
+/**
+ * Calculate index of first size bin containing only sufficiently large blocks
+ *
+ * @v size		Minimum block size
+ * @ret index		Size bin index
+ */
+static inline unsigned int heap_bin_above ( size_t size ) {
+	unsigned int msb = ( flsl ( size ) - 1 );
+	unsigned int index = heap_bin ( size );
+	size_t granularity;
+
+	/* Move to next bin unless size is at the bottom of this bin */
+	granularity = ( ( msb > HEAP_BIN_SUBDIVISIONS_LOG2 ) ?
+			( 1UL << ( msb - HEAP_BIN_SUBDIVISIONS_LOG2 ) ) : 1 );
+	if ( size & ( granularity - 1 ) )
+		index++;
+	return index;
+}
+
+/**
+ * Find first non-empty size bin
+ *
+ * @v heap		Heap
+ * @v index		Lowest acceptable size bin index
+ * @ret index		Size bin index, or HEAP_BINS if none found
+ */
+static unsigned int heap_first_bin ( struct heap *heap, unsigned int index ) {
+	unsigned long word;
+	unsigned int i;
+
+	for ( i = ( index / HEAP_BINMAP_BITS ) ;
+	      i < ( HEAP_BINS / HEAP_BINMAP_BITS ) ; i++ ) {
+		word = heap->binmap[i];
+		if ( index > ( i * HEAP_BINMAP_BITS ) )
+			word &= ( ~0UL << ( index % HEAP_BINMAP_BITS ) );
+		if ( word )
+			return ( ( i * HEAP_BINMAP_BITS ) + ffsl ( word ) - 1 );
 	}
+	return HEAP_BINS;
 }
 
 /**
- * Mark all blocks in free list as inaccessible
+ * Calculate address hash bucket
  *
  * @v heap		Heap
+ * @v addr		Address
+ * @ret bucket		Hash bucket index
  */
-static inline void valgrind_make_blocks_noaccess ( struct heap *heap ) {
+static inline unsigned int heap_hash ( struct heap *heap, void *addr ) {
+	uint32_t index = ( virt_to_phys ( addr ) / heap->align );
+
+	return ( ( ( uint32_t ) ( index * 0x9e3779b9UL ) ) >>
+		 ( 32 - HEAP_HASH_LOG2 ) );
+}
+
+/**
+ * Find free block starting at a given address
+ *
+ * @v heap		Heap
+ * @v addr		Start address
+ * @ret block		Free block, or NULL
+ */
+static struct memory_block * heap_find_start ( struct heap *heap,
+					       void *addr ) {
 	struct memory_block *block;
-	struct memory_block *prev = NULL;
+	struct memory_link *link;
+
+	for ( link = heap->starts[ heap_hash ( heap, addr ) ] ; link ;
+	      link = link->next ) {
+		block = container_of ( link, struct memory_block, start );
+		if ( ( ( void * ) block ) == addr )
+			return block;
+	}
+	return NULL;
+}
+
+/**
+ * Find free block ending at a given address
+ *
+ * @v heap		Heap
+ * @v addr		End address
+ * @ret block		Free block, or NULL
+ */
+static struct memory_block * heap_find_end ( struct heap *heap, void *addr ) {
+	struct memory_block *block;
+	struct memory_link *link;
+
+	for ( link = heap->ends[ heap_hash ( heap, addr ) ] ; link ;
+	      link = link->next ) {
+		block = container_of ( link, struct memory_block, end );
+		if ( ( ( ( void * ) block ) + block->size ) == addr )
+			return block;
+	}
+	return NULL;
+}
+
+/**
+ * Add block to free block lists
+ *
+ * @v heap		Heap
+ * @v block		Free block (with size already populated)
+ */
+static void heap_insert ( struct heap *heap, struct memory_block *block ) {
+	unsigned int index = heap_bin ( block->size );
+
+	heap_link ( &heap->bins[index], &block->bin );
+	heap->binmap[ index / HEAP_BINMAP_BITS ] |=
+		( 1UL << ( index % HEAP_BINMAP_BITS ) );
+	heap_link ( &heap->starts[ heap_hash ( heap, block ) ],
+		    &block->start );
+	heap_link ( &heap->ends[ heap_hash ( heap, ( ( ( void * ) block ) +
+						     block->size ) ) ],
+		    &block->end );
+	heap->freeblocks++;
+}
+
+/**
+ * Remove block from free block lists
+ *
+ * @v heap		Heap
+ * @v block		Free block
+ */
+static void heap_remove ( struct heap *heap, struct memory_block *block ) {
+	unsigned int index = heap_bin ( block->size );
+
+	heap_unlink ( &block->bin );
+	if ( ! heap->bins[index] ) {
+		heap->binmap[ index / HEAP_BINMAP_BITS ] &=
+			~( 1UL << ( index % HEAP_BINMAP_BITS ) );
+	}
+	heap_unlink ( &block->start );
+	heap_unlink ( &block->end );
+	heap->freeblocks--;
+}
+
+/**
+ * Mark all blocks in free lists as defined
+ *
+ * @v heap		Heap
+ */
+static inline void valgrind_make_blocks_defined ( struct heap *heap ) {
+	struct memory_link *link;
+	unsigned int index;
 
 	/* Do nothing unless running under Valgrind */
 	if ( RUNNING_ON_VALGRIND <= 0 )
 		return;
 
-	/* Traverse free block list, marking each block structure as
-	 * inaccessible.  Some contortions are necessary to avoid
-	 * errors from list_check().
+	/* Traverse size bins, marking each block structure as defined
+	 * before following its link to the next block.
 	 */
+	for ( index = 0 ; index < HEAP_BINS ; index++ ) {
+		for ( link = heap->bins[index] ; link ; link = link->next ) {
+			VALGRIND_MAKE_MEM_DEFINED ( bin_block ( link ),
+						    sizeof ( struct
+							     memory_block ) );
+		}
+	}
+}
 
-	/* Mark each block in list as inaccessible */
-	list_for_each_entry ( block, &heap->blocks, list ) {
-
-		/* Mark previous block (if any) as inaccessible. (Current
-		 * block will be accessed by list_check().)
-		 */
-		if ( prev )
-			VALGRIND_MAKE_MEM_NOACCESS ( prev, sizeof ( *prev ) );
-		prev = block;
+/**
+ * Mark all blocks in free lists as inaccessible
+ *
+ * @v heap		Heap
+ */
+static inline void valgrind_make_blocks_noaccess ( struct heap *heap ) {
+	struct memory_link *link;
+	struct memory_link *next;
+	unsigned int index;
 
-		/* At the end of the list, list_check() will end up
-		 * accessing the first list item.  Temporarily mark
-		 * this area as defined.
-		 */
-		VALGRIND_MAKE_MEM_DEFINED ( &heap->blocks.next->prev,
-					    sizeof ( heap->blocks.next->prev ));
-	}
-	/* Mark last block (if any) as inaccessible */
-	if ( prev )
-		VALGRIND_MAKE_MEM_NOACCESS ( prev, sizeof ( *prev ) );
+	/* Do nothing unless running under Valgrind */
+	if ( RUNNING_ON_VALGRIND <= 0 )
+		return;
 
-	/* Mark as inaccessible the area that was temporarily marked
-	 * as defined to avoid errors from list_check().
+	/* Traverse size bins, marking each block structure as
+	 * inaccessible after following its link to the next block.
 	 */
-	VALGRIND_MAKE_MEM_NOACCESS ( &heap->blocks.next->prev,
-				     sizeof ( heap->blocks.next->prev ) );
-
-	/* Mark block list itself as inaccessible */
-	VALGRIND_MAKE_MEM_NOACCESS ( &heap->blocks, sizeof ( heap->blocks ) );
+	for ( index = 0 ; index < HEAP_BINS ; index++ ) {
+		for ( link = heap->bins[index] ; link ; link = next ) {
+			next = link->next;
+			VALGRIND_MAKE_MEM_NOACCESS ( bin_block ( link ),
+						     sizeof ( struct
+							      memory_block ) );
+		}
+	}
 }
 
 /**
- * Check integrity of the blocks in the free list
+ * Check integrity of the blocks in the free lists
  *
  * @v heap		Heap
  */
 static inline void check_blocks ( struct heap *heap ) {
 	struct memory_block *block;
-	struct memory_block *prev = NULL;
+	unsigned int count = 0;
+	unsigned int index;
+	int present;
 
 	if ( ! ASSERTING )
 		return;
 
-	list_for_each_entry ( block, &heap->blocks, list ) {
+	for ( index = 0 ; index < HEAP_BINS ; index++ ) {
 
-		/* Check alignment */
-		assert ( ( virt_to_phys ( block ) &
-			   ( heap->align - 1 ) ) == 0 );
+		/* Check that bitmap matches bin occupancy */
+		present = ( ( heap->binmap[ index / HEAP_BINMAP_BITS ] >>
+			      ( index % HEAP_BINMAP_BITS ) ) & 1 );
+		assert ( present == ( heap->bins[index] != NULL ) );
 
-		/* Check that list structure is intact */
-		list_check ( &block->list );
+		for ( block = bin_block ( heap->bins[index] ) ; block ;
+		      block = bin_block ( block->bin.next ) ) {
 
-		/* Check that block size is not too small */
-		assert ( block->size >= sizeof ( *block ) );
-		assert ( block->size >= heap->align );
+			/* Check alignment */
+			assert ( ( virt_to_phys ( block ) &
+				   ( heap->align - 1 ) ) == 0 );
 
-		/* Check that block does not wrap beyond end of address space */
-		assert ( ( ( void * ) block + block->size ) >
-			 ( ( void * ) block ) );
+			/* Check that list structures are intact */
+			assert ( *(block->bin.pprev) == &block->bin );
+			assert ( *(block->start.pprev) == &block->start );
+			assert ( *(block->end.pprev) == &block->end );
 
-		/* Check that blocks remain in ascending order, and
-		 * that adjacent blocks have been merged.
-		 */
-		if ( prev ) {
-			assert ( ( ( void * ) block ) > ( ( void * ) prev ) );
-			assert ( ( ( void * ) block ) >
-				 ( ( ( void * ) prev ) + prev->size ) );
+			/* Check that block size is not too small */
+			assert ( block->size >= sizeof ( *block ) );
+			assert ( block->size >= heap->align );
+
+			/* Check that block does not wrap beyond end
+			 * of address space.
+			 */
+			assert ( ( ( void * ) block + block->size ) >
+				 ( ( void * ) block ) );
+
+			/* Check that block is in the correct size bin */
+			assert ( heap_bin ( block->size ) == index );
+
+			/* Check that block can be found by address */
+			assert ( heap_find_start ( heap, block ) == block );
+			assert ( heap_find_end ( heap, ( ( ( void * ) block ) +
+							 block->size ) ) ==
+				 block );
+
+			/* Check that adjacent blocks have been merged */
+			assert ( heap_find_start ( heap, ( ( ( void * ) block )
+							   + block->size ) ) ==
+				 NULL );
+
+			count++;
 		}
-		prev = block;
 	}
+
+	/* Check free block count */
+	assert ( count == heap->freeblocks );
 }
 
 /**
@@ -300,6 +576,50 @@ static void discard_all_cache ( void ) {
 	} while ( discarded );
 }
 
+/**
+ * Find a free block capable of satisfying an allocation
+ *
+ * @v heap		Heap
+ * @v actual_size	Size of memory block
+ * @v fit_size		Size of block guaranteed to satisfy any alignment
+ * @v actual_offset	Offset of memory block
+ * @v align_mask	Alignment mask
+ * @ret block		Free block, or NULL
+ */
+static struct memory_block * heap_find ( struct heap *heap, size_t actual_size,
+					 size_t fit_size, size_t actual_offset,
+					 size_t align_mask ) {
+	struct memory_block *block;
+	unsigned int index;
+	unsigned int last;
+	size_t pre_size;
+
+	/* Use the first block from the first non-empty size bin in
+	 * which all blocks are guaranteed to be large enough.
+	 */
+	index = heap_first_bin ( heap, heap_bin_above ( fit_size ) );
+	if ( index < HEAP_BINS )
+		return bin_block ( heap->bins[index] );
+
+	/* Otherwise, search through any remaining bins that may
+	 * contain a suitable block.
+	 */
+	last = heap_bin ( fit_size );
+	for ( index = heap_first_bin ( heap, heap_bin ( actual_size ) ) ;
+	      index <= last ; index = heap_first_bin ( heap, ( index + 1 ) ) ){
+		for ( block = bin_block ( heap->bins[index] ) ; block ;
+		      block = bin_block ( block->bin.next ) ) {
+			pre_size = ( ( actual_offset - virt_to_phys ( block ) )
+				     & align_mask );
+			if ( ( block->size >= pre_size ) &&
+			     ( ( block->size - pre_size ) >= actual_size ) )
+				return block;
+		}
+	}
+
+	return NULL;
+}
+
 /**
  * Allocate a memory block
  *
@@ -309,7 +629,7 @@ static void discard_all_cache ( void ) {
  * @v offset		Offset from physical alignment
  * @ret ptr		Memory block, or NULL
  *
- * Allocates a memory block @b physically aligned as requested.  No
+ * Allocates a memory block @ physically aligned as requested.  No
  * guarantees are provided for the alignment of the virtual address.
  *
  * @c align must be a power of two.  @c size may not be zero.
@@ -320,6 +640,7 @@ static void * heap_alloc_block ( struct heap *heap, size_t size, size_t align,
 	size_t actual_offset;
 	size_t align_mask;
 	size_t actual_size;
+	size_t fit_size;
 	size_t pre_size;
 	size_t post_size;
 	struct memory_block *pre;
@@ -362,22 +683,31 @@ static void * heap_alloc_block ( struct heap *heap, size_t size, size_t align,
 	/* Calculate alignment mask */
 	align_mask = ( ( align - 1 ) | ( heap->align - 1 ) );
 
+	/* Calculate size of a free block that is guaranteed to be
+	 * able to satisfy the allocation regardless of its alignment,
+	 * and check for overflow.
+	 */
+	fit_size = ( actual_size + ( align_mask & ~( heap->align - 1 ) ) );
+	if ( fit_size < actual_size ) {
+		ptr = NULL;
+		goto done;
+	}
+
 	DBGC2 ( heap, "HEAP allocating %#zx (aligned %#zx+%#zx)\n",
 		size, align, offset );
 	while ( 1 ) {
-		/* Search through blocks for the first one with enough space */
-		list_for_each_entry ( block, &heap->blocks, list ) {
+		/* Find a suitable free block */
+		block = heap_find ( heap, actual_size, fit_size,
+				    actual_offset, align_mask );
+		if ( block ) {
 			pre_size = ( ( actual_offset - virt_to_phys ( block ) )
 				     & align_mask );
-			if ( ( block->size < pre_size ) ||
-			     ( ( block->size - pre_size ) < actual_size ) )
-				continue;
 			post_size = ( block->size - pre_size - actual_size );
 			/* Split block into pre-block, block, and
-			 * post-block.  After this split, the "pre"
-			 * block is the one currently linked into the
-			 * free list.
+			 * post-block, and return the pre-block and
+			 * post-block (if any) to the free lists.
 			 */
+			heap_remove ( heap, block );
 			pre   = block;
 			block = ( ( ( void * ) pre   ) + pre_size );
 			post  = ( ( ( void * ) block ) + actual_size );
@@ -385,9 +715,6 @@ static void * heap_alloc_block ( struct heap *heap, size_t size, size_t align,
 				"+ [%p,%p)\n", pre,
 				( ( ( void * ) pre ) + pre->size ), pre, block,
 				post, ( ( ( void * ) pre ) + pre->size ) );
-			/* If there is a "post" block, add it in to
-			 * the free list.
-			 */
 			if ( post_size ) {
 				assert ( post_size >= sizeof ( *block ) );
 				assert ( ( post_size &
@@ -395,30 +722,25 @@ static void * heap_alloc_block ( struct heap *heap, size_t size, size_t align,
 				VALGRIND_MAKE_MEM_UNDEFINED ( post,
 							      sizeof ( *post ));
 				post->size = post_size;
-				list_add ( &post->list, &pre->list );
+				heap_insert ( heap, post );
 			}
-			/* Shrink "pre" block, leaving the main block
-			 * isolated and no longer part of the free
-			 * list.
-			 */
-			pre->size = pre_size;
-			/* If there is no "pre" block, remove it from
-			 * the list.
-			 */
-			if ( ! pre_size ) {
-				list_del ( &pre->list );
-				VALGRIND_MAKE_MEM_NOACCESS ( pre,
-							     sizeof ( *pre ) );
-			} else {
+			if ( pre_size ) {
 				assert ( pre_size >= sizeof ( *block ) );
 				assert ( ( pre_size &
 					   ( heap->align - 1 ) ) == 0 );
+				pre->size = pre_size;
+				heap_insert ( heap, pre );
+			} else {
+				VALGRIND_MAKE_MEM_NOACCESS ( pre,
+							     sizeof ( *pre ) );
 			}
 			/* Update memory usage statistics */
 			heap->freemem -= actual_size;
 			heap->usedmem += actual_size;
 			if ( heap->usedmem > heap->maxusedmem )
 				heap->maxusedmem = heap->usedmem;
+			heap->allocs[ heap_class ( actual_size ) ]++;
+			heap->inuse[ heap_class ( actual_size ) ]++;
 			/* Return allocated block */
 			ptr = ( ( ( void * ) block ) + offset - actual_offset );
 			DBGC2 ( heap, "HEAP allocated [%p,%p) within "
@@ -446,6 +768,8 @@ static void * heap_alloc_block ( struct heap *heap, size_t size, size_t align,
 	}
 
  done:
+	if ( ! ptr )
+		heap->failures++;
 	check_blocks ( heap );
 	valgrind_make_blocks_noaccess ( heap );
 	return ptr;
@@ -463,11 +787,10 @@ static void * heap_alloc_block ( struct heap *heap, size_t size, size_t align,
 static void heap_free_block ( struct heap *heap, void *ptr, size_t size ) {
 	struct memory_block *freeing;
 	struct memory_block *block;
-	struct memory_block *tmp;
 	size_t sub_offset;
 	size_t actual_size;
-	ssize_t gap_before;
-	ssize_t gap_after = -1;
+	size_t freed_size;
+	unsigned int index;
 
 	/* Allow for ptr==NULL */
 	if ( ! ptr )
@@ -491,9 +814,9 @@ static void heap_free_block ( struct heap *heap, void *ptr, size_t size ) {
 		( ( ( void * ) freeing ) + actual_size ) );
 	VALGRIND_MAKE_MEM_UNDEFINED ( freeing, sizeof ( *freeing ) );
 
-	/* Check that this block does not overlap the free list */
+	/* Check that this block does not overlap the free lists */
 	if ( ASSERTING ) {
-		list_for_each_entry ( block, &heap->blocks, list ) {
+		for_each_free_block ( block, heap, index ) {
 			if ( ( ( ( void * ) block ) <
 			       ( ( void * ) freeing + actual_size ) ) &&
 			     ( ( void * ) freeing <
@@ -509,59 +832,46 @@ static void heap_free_block ( struct heap *heap, void *ptr, size_t size ) {
 		}
 	}
 
-	/* Insert/merge into free list */
+	/* Merge with immediately preceding block, if possible */
 	freeing->size = actual_size;
-	list_for_each_entry_safe ( block, tmp, &heap->blocks, list ) {
-		/* Calculate gaps before and after the "freeing" block */
-		gap_before = ( ( ( void * ) freeing ) - 
-			       ( ( ( void * ) block ) + block->size ) );
-		gap_after = ( ( ( void * ) block ) - 
-			      ( ( ( void * ) freeing ) + freeing->size ) );
-		/* Merge with immediately preceding block, if possible */
-		if ( gap_before == 0 ) {
-			DBGC2 ( heap, "HEAP merging [%p,%p) + [%p,%p) -> "
-				"[%p,%p)\n", block,
-				( ( ( void * ) block ) + block->size ), freeing,
-				( ( ( void * ) freeing ) + freeing->size ),
-				block,
-				( ( ( void * ) freeing ) + freeing->size ) );
-			block->size += actual_size;
-			list_del ( &block->list );
-			VALGRIND_MAKE_MEM_NOACCESS ( freeing,
-						     sizeof ( *freeing ) );
-			freeing = block;
-		}
-		/* Stop processing as soon as we reach a following block */
-		if ( gap_after >= 0 )
-			break;
+	block = heap_find_end ( heap, freeing );
+	if ( block ) {
+		DBGC2 ( heap, "HEAP merging [%p,%p) + [%p,%p) -> [%p,%p)\n",
+			block, ( ( ( void * ) block ) + block->size ), freeing,
+			( ( ( void * ) freeing ) + freeing->size ), block,
+			( ( ( void * ) freeing ) + freeing->size ) );
+		heap_remove ( heap, block );
+		block->size += freeing->size;
+		VALGRIND_MAKE_MEM_NOACCESS ( freeing, sizeof ( *freeing ) );
+		freeing = block;
 	}
 
-	/* Insert before the immediately following block.  If
-	 * possible, merge the following block into the "freeing"
-	 * block.
-	 */
-	DBGC2 ( heap, "HEAP freed [%p,%p)\n",
-		freeing, ( ( ( void * ) freeing ) + freeing->size ) );
-	list_add_tail ( &freeing->list, &block->list );
-	if ( gap_after == 0 ) {
+	/* Merge with immediately following block, if possible */
+	block = heap_find_start ( heap, ( ( ( void * ) freeing ) +
+					  freeing->size ) );
+	if ( block ) {
 		DBGC2 ( heap, "HEAP merging [%p,%p) + [%p,%p) -> [%p,%p)\n",
 			freeing, ( ( ( void * ) freeing ) + freeing->size ),
 			block, ( ( ( void * ) block ) + block->size ), freeing,
 			( ( ( void * ) block ) + block->size ) );
+		heap_remove ( heap, block );
 		freeing->size += block->size;
-		list_del ( &block->list );
 		VALGRIND_MAKE_MEM_NOACCESS ( block, sizeof ( *block ) );
 	}
 
 	/* Update memory usage statistics */
 	heap->freemem += actual_size;
 	heap->usedmem -= actual_size;
+	heap->inuse[ heap_class ( actual_size ) ]--;
 
-	/* Allow heap to shrink */
-	if ( heap->shrink && heap->shrink ( freeing, freeing->size ) ) {
-		list_del ( &freeing->list );
-		heap->freemem -= freeing->size;
-		VALGRIND_MAKE_MEM_UNDEFINED ( freeing, freeing->size );
+	/* Allow heap to shrink, otherwise add to free lists */
+	DBGC2 ( heap, "HEAP freed [%p,%p)\n",
+		freeing, ( ( ( void * ) freeing ) + freeing->size ) );
+	freed_size = freeing->size;
+	if ( heap->shrink && heap->shrink ( freeing, freed_size ) ) {
+		heap->freemem -= freed_size;
+	} else {
+		heap_insert ( heap, freeing );
 	}
 
 	/* Sanity checks */
@@ -604,8 +914,10 @@ void * heap_realloc ( struct heap *heap, void *old_ptr, size_t new_size ) {
 	 */
 	if ( new_size ) {
 		new_total_size = ( new_size + offset );
-		if ( new_total_size < new_size )
+		if ( new_total_size < new_size ) {
+			heap->failures++;
 			return NULL;
+		}
 		new_block = heap_alloc_block ( heap, new_total_size,
 					       heap->ptr_align, -offset );
 		if ( ! new_block )
@@ -645,14 +957,188 @@ void * heap_realloc ( struct heap *heap, void *old_ptr, size_t new_size ) {
 	return new_ptr;
 }
 
+/** The global heap (defined below) */
+static struct heap heap;
+
+/** List of additional heap regions */
+static LIST_HEAD ( heap_regions );
+
+/** Total size of additional heap regions */
+static size_t heap_regions_len;
+
+/**
+ * Extend heap with an additional region
+ *
+ * @v size		Failed allocation size
+ * @ret extended	Heap has been extended
+ */
+static int heap_extend ( size_t size ) {
+	struct heap_region *region;
+	size_t total;
+	size_t pad;
+	void *start;
+
+	/* Calculate region size, allowing for the region descriptor
+	 * and for worst-case alignment padding.
+	 */
+	if ( size < HEAP_REGION_SIZE )
+		size = HEAP_REGION_SIZE;
+	total = ( size + PAGE_SIZE + sizeof ( *region ) + MIN_MEMBLOCK_ALIGN );
+	if ( total < size )
+		return 0;
+
+	/* Limit total size of additional regions */
+	if ( total > ( HEAP_REGION_MAX - heap_regions_len ) ) {
+		DBGC ( &heap, "HEAP cannot extend by %#zx (already extended "
+		       "by %zdkB)\n", total, ( heap_regions_len >> 10 ) );
+		return 0;
+	}
+
+	/* Allocate region from external heap */
+	region = umalloc ( total );
+	if ( ! region ) {
+		DBGC ( &heap, "HEAP could not allocate %#zx for extension\n",
+		       total );
+		return 0;
+	}
+
+	/* Populate region descriptor */
+	start = ( ( ( void * ) region ) + sizeof ( *region ) );
+	pad = ( ( -virt_to_phys ( start ) ) & ( MIN_MEMBLOCK_ALIGN - 1 ) );
+	region->start = ( start + pad );
+	region->len = ( ( total - sizeof ( *region ) - pad ) &
+			~( MIN_MEMBLOCK_ALIGN - 1 ) );
+	region->total = total;
+	DBGC ( &heap, "HEAP extended by [%p,%p)\n",
+	       region->start, ( region->start + region->len ) );
+
+	/* Add to allocation pool.  The region is not yet on the list
+	 * of regions, and so cannot be immediately released by
+	 * heap_shrink().
+	 */
+	VALGRIND_MAKE_MEM_NOACCESS ( region->start, region->len );
+	heap_populate ( &heap, region->start, region->len );
+	list_add_tail ( &region->list, &heap_regions );
+	heap_regions_len += total;
+
+	return 1;
+}
+
+/**
+ * Attempt to grow heap
+ *
+ * @v size		Failed allocation size
+ * @ret grown		Heap has grown: retry allocations
+ */
+static unsigned int heap_grow ( size_t size ) {
+
+	/* Extend heap with an additional region, if possible.  This
+	 * is preferable to discarding cached data such as packets
+	 * held in a TCP out-of-order receive queue, since those would
+	 * subsequently need to be retransmitted.
+	 */
+	if ( heap_extend ( size ) )
+		return 1;
+
+	/* Otherwise, discard some cached data */
+	return discard_cache ( size );
+}
+
+/**
+ * Allow heap to shrink
+ *
+ * @v ptr		Start of free block
+ * @v size		Size of free block
+ * @ret shrunk		Heap has shrunk: discard block
+ *
+ * An additional region is returned to the external heap when it has
+ * completely drained, unless the rest of the heap is itself short of
+ * free memory (in which case the region is likely to be needed again
+ * almost immediately).
+ */
+static unsigned int heap_shrink ( void *ptr, size_t size ) {
+	struct heap_region *region;
+
+	list_for_each_entry ( region, &heap_regions, list ) {
+
+		/* Skip regions that have not completely drained */
+		if ( ( ptr != region->start ) || ( size != region->len ) )
+			continue;
+
+		/* Retain region if remaining free memory is low */
+		if ( ( heap.freemem - size ) < HEAP_REGION_SIZE )
+			return 0;
+
+		/* Return region to external heap */
+		DBGC ( &heap, "HEAP releasing [%p,%p)\n",
+		       region->start, ( region->start + region->len ) );
+		list_del ( &region->list );
+		heap_regions_len -= region->total;
+		ufree ( region );
+		return 1;
+	}
+
+	return 0;
+}
+
 /** The global heap */
 static struct heap heap = {
-	.blocks = LIST_HEAD_INIT ( heap.blocks ),
 	.align = MIN_MEMBLOCK_ALIGN,
 	.ptr_align = sizeof ( void * ),
-	.grow = discard_cache,
+	.grow = heap_grow,
+	.shrink = heap_shrink,
 };
 
+/** The internal heap (exposed for statistics reporting) */
+struct heap * const malloc_heap = &heap;
+
+#ifdef HEAP_SITES
+
+/**
+ * Record allocation site
+ *
+ * @v caller		Calling address
+ * @v size		Requested size
+ * @v ptr		Allocated memory, or NULL
+ */
+static inline void heap_record ( void *caller, size_t size, void *ptr ) {
+	struct heap_site *site;
+	uint32_t hash;
+	unsigned int i;
+
+	/* Do nothing for zero-length allocations */
+	if ( ! size )
+		return;
+
+	/* Find (or create) entry for this site.  If the table is
+	 * full, then the allocation is not attributed.
+	 */
+	hash = ( ( ( uint32_t ) ( ( intptr_t ) caller ) ) * 0x9e3779b9UL );
+	for ( i = 0 ; i < heap_num_sites ; i++ ) {
+		site = &heap_sites[ ( hash + i ) & ( heap_num_sites - 1 ) ];
+		if ( ! site->caller )
+			site->caller = caller;
+		if ( site->caller != caller )
+			continue;
+		if ( ptr ) {
+			site->allocs++;
+			site->size += size;
+		} else {
+			site->failures++;
+		}
+		return;
+	}
+}
+
+#else /* HEAP_SITES */
+
+static inline void heap_record ( void *caller __unused, size_t size __unused,
+				 void *ptr __unused ) {
+	/* Allocation site tracking is not enabled */
+}
+
+#endif /* HEAP_SITES */
+
 /**
  * Reallocate memory
  *
@@ -661,8 +1147,11 @@ static struct heap heap = {
  * @ret new_ptr		Allocated memory, or NULL
  */
 void * realloc ( void *old_ptr, size_t new_size ) {
+	void *new_ptr;
 
-	return heap_realloc ( &heap, old_ptr, new_size );
+	new_ptr = heap_realloc ( &heap, old_ptr, new_size );
+	heap_record ( __builtin_return_address ( 0 ), new_size, new_ptr );
+	return new_ptr;
 }
 
 /**
@@ -677,7 +1166,8 @@ void * realloc ( void *old_ptr, size_t new_size ) {
 void * malloc ( size_t size ) {
 	void *ptr;
 
-	ptr = realloc ( NULL, size );
+	ptr = heap_realloc ( &heap, NULL, size );
+	heap_record ( __builtin_return_address ( 0 ), size, ptr );
 	if ( ASSERTED ) {
 		DBGC ( &heap, "HEAP detected possible memory corruption "
 		       "from %p\n", __builtin_return_address ( 0 ) );
@@ -718,7 +1208,8 @@ void free ( void *ptr ) {
 void * zalloc ( size_t size ) {
 	void *data;
 
-	data = malloc ( size );
+	data = heap_realloc ( &heap, NULL, size );
+	heap_record ( __builtin_return_address ( 0 ), size, data );
 	if ( data )
 		memset ( data, 0, size );
 	if ( ASSERTED ) {
@@ -760,11 +1251,11 @@ void zfree ( void *ptr ) {
  * @v size		Requested size
  * @v align		Physical alignment
  * @v offset		Offset from physical alignment
+ * @v caller		Calling address
  * @ret ptr		Memory, or NULL
- *
- * @c align must be a power of two.  @c size may not be zero.
  */
-void * malloc_phys_offset ( size_t size, size_t phys_align, size_t offset ) {
+static void * heap_malloc_phys ( size_t size, size_t phys_align,
+				 size_t offset, void *caller ) {
 	void * ptr;
 
 	assert ( phys_align != 0 );
@@ -774,9 +1265,26 @@ void * malloc_phys_offset ( size_t size, size_t phys_align, size_t offset ) {
 			   ( phys_align - 1 ) ) == 0 );
 		VALGRIND_MALLOCLIKE_BLOCK ( ptr, size, 0, 0 );
 	}
+	heap_record ( caller, size, ptr );
 	return ptr;
 }
 
+/**
+ * Allocate memory with specified physical alignment and offset
+ *
+ * @v size		Requested size
+ * @v align		Physical alignment
+ * @v offset		Offset from physical alignment
+ * @ret ptr		Memory, or NULL
+ *
+ * @c align must be a power of two.  @c size may not be zero.
+ */
+void * malloc_phys_offset ( size_t size, size_t phys_align, size_t offset ) {
+
+	return heap_malloc_phys ( size, phys_align, offset,
+				  __builtin_return_address ( 0 ) );
+}
+
 /**
  * Allocate memory with specified physical alignment
  *
@@ -788,7 +1296,8 @@ void * malloc_phys_offset ( size_t size, size_t phys_align, size_t offset ) {
  */
 void * malloc_phys ( size_t size, size_t phys_align ) {
 
-	return malloc_phys_offset ( size, phys_align, 0 );
+	return heap_malloc_phys ( size, phys_align, 0,
+				  __builtin_return_address ( 0 ) );
 }
 
 /**
@@ -829,6 +1338,7 @@ void heap_populate ( struct heap *heap, void *start, size_t len ) {
 
 	/* Fix up memory usage statistics */
 	heap->usedmem += len;
+	heap->inuse[ heap_class ( len ) ]++;
 }
 
 /**
@@ -842,7 +1352,6 @@ static void init_heap ( void ) {
 
 	/* Populate heap */
 	VALGRIND_MAKE_MEM_NOACCESS ( heap_area, sizeof ( heap_area ) );
-	VALGRIND_MAKE_MEM_NOACCESS ( &heap.blocks, sizeof ( heap.blocks ) );
 	heap_populate ( &heap, heap_area, sizeof ( heap_area ) );
 }
 
@@ -858,8 +1367,8 @@ struct init_fn heap_init_fn __init_fn ( INIT_EARLY ) = {
  */
 static void shutdown_cache ( int booting __unused ) {
 	discard_all_cache();
-	DBGC ( &heap, "HEAP maximum usage %zdkB\n",
-	       ( heap.maxusedmem >> 10 ) );
+	DBGC ( &heap, "HEAP maximum usage %zdkB (extended by %zdkB)\n",
+	       ( heap.maxusedmem >> 10 ), ( heap_regions_len >> 10 ) );
 }
 
 /** Memory allocator shutdown function */
@@ -868,15 +1377,48 @@ struct startup_fn heap_startup_fn __startup_fn ( STARTUP_EARLY ) = {
 	.shutdown = shutdown_cache,
 };
 
+/**
+ * Find size of largest free block
+ *
+ * @v heap		Heap
+ * @ret size		Size of largest free block (or zero if none)
+ */
+size_t heap_largest ( struct heap *heap ) {
+	struct memory_block *block;
+	unsigned long word;
+	unsigned int index;
+	unsigned int i;
+	size_t largest = 0;
+
+	/* Scan the highest non-empty size bin */
+	valgrind_make_blocks_defined ( heap );
+	for ( i = ( HEAP_BINS / HEAP_BINMAP_BITS ) ; i-- ; ) {
+		word = heap->binmap[i];
+		if ( ! word )
+			continue;
+		index = ( ( i * HEAP_BINMAP_BITS ) + flsl ( word ) - 1 );
+		for ( block = bin_block ( heap->bins[index] ) ; block ;
+		      block = bin_block ( block->bin.next ) ) {
+			if ( block->size > largest )
+				largest = block->size;
+		}
+		break;
+	}
+	valgrind_make_blocks_noaccess ( heap );
+
+	return largest;
+}
+
 /**
  * Dump free block list (for debugging)
  *
  */
 void heap_dump ( struct heap *heap ) {
 	struct memory_block *block;
+	unsigned int index;
 
 	dbg_printf ( "HEAP free block list:\n" );
-	list_for_each_entry ( block, &heap->blocks, list ) {
+	for_each_free_block ( block, heap, index ) {
 		dbg_printf ( "...[%p,%p] (size %#zx)\n", block,
 			     ( ( ( void * ) block ) + block->size ),
 			     block->size );
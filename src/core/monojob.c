@@ -32,6 +32,7 @@ FILE_SECBOOT ( PERMITTED );
 #include <ipxe/keys.h>
 #include <ipxe/job.h>
 #include <ipxe/monojob.h>
+#include <ipxe/nap.h>
 #include <ipxe/timer.h>
 
 /** @file
@@ -101,8 +102,12 @@ int monojob_wait ( const char *string, unsigned long timeout ) {
 	last_check = last_progress = last_display = currticks();
 	while ( monojob_rc == -EINPROGRESS ) {
 
-		/* Allow job to progress */
+		/* Allow job to progress, sleeping the CPU until the
+		 * next interrupt if the system is idle.
+		 */
 		step();
+		if ( ! process_pending() )
+			cpu_nap();
 		now = currticks();
 
 		/* Continue until a timer tick occurs (to minimise
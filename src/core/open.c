@@ -193,6 +193,15 @@ int xfer_vopen ( struct interface *intf, int type, va_list args ) {
 		struct sockaddr *local = va_arg ( args, struct sockaddr * );
 
 		return xfer_open_socket ( intf, semantics, peer, local ); }
+	case LOCATION_CONNECTED: {
+		struct interface *socket;
+
+		( void ) va_arg ( args, int ); /* Discard "semantics" */
+		( void ) va_arg ( args, struct sockaddr * ); /* "peer" */
+		( void ) va_arg ( args, struct sockaddr * ); /* "local" */
+		socket = va_arg ( args, struct interface * );
+		intf_plug_plug ( intf, socket );
+		return 0; }
 	default:
 		DBGC ( INTF_COL ( intf ), "INTF " INTF_FMT " attempted to "
 		       "open unsupported location type %d\n",
@@ -34,11 +34,20 @@ FILE_SECBOOT ( PERMITTED );
  *
  * We implement a trivial form of cooperative multitasking, in which
  * all processes share a single stack and address space.
+ *
+ * A running process that has no pending work may put itself to sleep
+ * using process_sleep(), in which case it will not be stepped again
+ * until it is woken (by an event such as a timer being started or a
+ * network device being opened) using process_wake().  The system is
+ * idle when no running process has pending work.
  */
 
 /** Process run queue */
 static LIST_HEAD ( run_queue );
 
+/** Sleeping process queue */
+static LIST_HEAD ( sleep_queue );
+
 /**
  * Get pointer to object containing process
  *
@@ -55,14 +64,17 @@ void * process_object ( struct process *process ) {
  * @v process		Process
  *
  * It is safe to call process_add() multiple times; further calls will
- * have no effect.
+ * have no effect (other than to wake the process if it is sleeping).
  */
 void process_add ( struct process *process ) {
 	if ( ! process_running ( process ) ) {
 		DBGC ( PROC_COL ( process ), "PROCESS " PROC_FMT
 		       " starting\n", PROC_DBG ( process ) );
 		ref_get ( process->refcnt );
+		process->sleeping = 0;
 		list_add_tail ( &process->list, &run_queue );
+	} else if ( process->sleeping ) {
+		process_wake ( process );
 	} else {
 		DBGC ( PROC_COL ( process ), "PROCESS " PROC_FMT
 		       " already started\n", PROC_DBG ( process ) );
@@ -83,6 +95,7 @@ void process_del ( struct process *process ) {
 		       " stopping\n", PROC_DBG ( process ) );
 		list_del ( &process->list );
 		INIT_LIST_HEAD ( &process->list );
+		process->sleeping = 0;
 		ref_put ( process->refcnt );
 	} else {
 		DBGC ( PROC_COL ( process ), "PROCESS " PROC_FMT
@@ -90,6 +103,56 @@ void process_del ( struct process *process ) {
 	}
 }
 
+/**
+ * Put process to sleep
+ *
+ * @v process		Process
+ *
+ * A sleeping process remains running (and retains its reference to
+ * the containing object), but will not be stepped until it is woken
+ * using process_wake().  It is safe to call process_sleep() on a
+ * process that is not running; this will have no effect.
+ */
+void process_sleep ( struct process *process ) {
+	if ( process_running ( process ) && ( ! process->sleeping ) ) {
+		DBGC2 ( PROC_COL ( process ), "PROCESS " PROC_FMT
+			" sleeping\n", PROC_DBG ( process ) );
+		list_del ( &process->list );
+		list_add_tail ( &process->list, &sleep_queue );
+		process->sleeping = 1;
+	}
+}
+
+/**
+ * Wake sleeping process
+ *
+ * @v process		Process
+ *
+ * It is safe to call process_wake() on a process that is not
+ * sleeping; this will have no effect.
+ */
+void process_wake ( struct process *process ) {
+	if ( process->sleeping ) {
+		DBGC2 ( PROC_COL ( process ), "PROCESS " PROC_FMT
+			" waking\n", PROC_DBG ( process ) );
+		list_del ( &process->list );
+		list_add_tail ( &process->list, &run_queue );
+		process->sleeping = 0;
+	}
+}
+
+/**
+ * Check for processes with pending work
+ *
+ * @ret pending		Some process has pending work
+ *
+ * If no process has pending work, then the system is idle and the
+ * caller may choose to sleep the CPU until the next interrupt.
+ */
+int process_pending ( void ) {
+	return ( ! list_empty ( &run_queue ) );
+}
+
 /**
  * Single-step a single process
  *
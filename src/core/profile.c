@@ -44,6 +44,12 @@ FILE_SECBOOT ( PERMITTED );
  * The algorithm for updating the mean and variance estimators is from
  * The Art of Computer Programming (via Wikipedia), with adjustments
  * to avoid the use of floating-point instructions.
+ *
+ * Since the mean and standard deviation hide any tail latency, a
+ * profiler may also maintain a histogram of sample values with
+ * logarithmically-sized buckets.  In addition, each profiling
+ * interval that is completed via profile_stop() is recorded in a
+ * fixed-size trace ring (see profile_trace.c).
  */
 
 /** Accumulated time excluded from profiling */
@@ -110,6 +116,7 @@ static inline unsigned int profile_accvar_shift ( struct profiler *profiler ) {
  */
 void profile_update ( struct profiler *profiler, unsigned long sample ) {
 	unsigned int sample_msb;
+	unsigned int bucket;
 	unsigned int mean_shift;
 	unsigned int delta_shift;
 	signed long pre_delta;
@@ -128,6 +135,15 @@ void profile_update ( struct profiler *profiler, unsigned long sample ) {
 	if ( profiler->count < INT_MAX )
 		profiler->count++;
 
+	/* Update histogram, if applicable */
+	if ( profiler->hist ) {
+		bucket = flsl ( sample );
+		if ( bucket >= PROFILE_BUCKETS )
+			bucket = ( PROFILE_BUCKETS - 1 );
+		if ( profiler->hist[bucket] < UINT_MAX )
+			profiler->hist[bucket]++;
+	}
+
 	/* Adjust mean sample value scale if necessary.  Skip if
 	 * sample is zero (in which case flsl(sample)-1 would
 	 * underflow): in the case of a zero sample we have no need to
@@ -277,3 +293,42 @@ unsigned long profile_stddev ( struct profiler *profiler ) {
 
 	return isqrt ( profile_variance ( profiler ) );
 }
+
+/**
+ * Get approximate sample quantile
+ *
+ * @v profiler		Profiler
+ * @v percent		Percentage of samples
+ * @ret limit		Upper bound on the given percentage of sample values
+ *
+ * The returned value is the upper bound of the histogram bucket
+ * containing the requested quantile, and so may overestimate the
+ * true quantile by up to a factor of two.  Zero is returned if the
+ * profiler does not maintain a histogram.
+ */
+unsigned long profile_quantile ( struct profiler *profiler,
+				 unsigned int percent ) {
+	unsigned long long threshold;
+	unsigned long long total = 0;
+	unsigned int bucket;
+
+	/* Do nothing unless a histogram is maintained */
+	if ( ! profiler->hist )
+		return 0;
+
+	/* Calculate number of samples required */
+	for ( bucket = 0 ; bucket < PROFILE_BUCKETS ; bucket++ )
+		total += profiler->hist[bucket];
+	threshold = ( ( total * percent ) + 99 ) / 100;
+
+	/* Find first bucket at which threshold is reached */
+	total = 0;
+	for ( bucket = 0 ; bucket < ( PROFILE_BUCKETS - 1 ) ; bucket++ ) {
+		total += profiler->hist[bucket];
+		if ( total >= threshold )
+			break;
+	}
+
+	/* Return upper bound of bucket */
+	return ( bucket ? ( ( 1UL << bucket ) - 1 ) : 0 );
+}
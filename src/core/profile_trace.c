@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2026 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+FILE_SECBOOT ( PERMITTED );
+
+#include <stdint.h>
+#include <ipxe/profile.h>
+
+/** @file
+ *
+ * Profiling trace ring
+ *
+ * Each profiling interval that is completed via profile_stop() is
+ * recorded in a fixed-size trace ring, which retains the most recent
+ * events in the order in which they occurred.
+ *
+ * The trace ring is referenced only by objects built with profiling
+ * enabled (and by code that dumps the trace), and so is not linked
+ * in to a build without profiling.
+ */
+
+/** Profiling trace ring */
+struct profile_event profile_trace_ring[PROFILE_TRACE_SIZE];
+
+/** Profiling trace ring producer counter */
+unsigned long profile_trace_prod;
+
+/**
+ * Record profiling interval in trace ring
+ *
+ * @v profiler		Profiler
+ *
+ * The trace ring may be written from within an interrupt handler.
+ * Since we have no portable atomic increment (and since there is
+ * only ever a single CPU), a slot is claimed before it is filled in
+ * so that an interrupting writer will almost always use a different
+ * slot.  In the worst case, an event will be overwritten.  This is
+ * an acceptable price for avoiding the need to disable interrupts.
+ *
+ * Note that this file may be built with profiling disabled, and so
+ * we must not use the inline profile_stopped() or profile_elapsed().
+ */
+void profile_trace ( struct profiler *profiler ) {
+	struct profile_event *event;
+
+	/* Claim slot */
+	event = &profile_trace_ring[ ( profile_trace_prod++ ) %
+				     PROFILE_TRACE_SIZE ];
+
+	/* Record event */
+	event->profiler = profiler;
+	event->stopped = ( profiler->stopped + profile_excluded );
+	event->elapsed = ( profiler->stopped - profiler->started );
+}
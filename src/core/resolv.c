@@ -29,10 +29,13 @@ FILE_SECBOOT ( PERMITTED );
 #include <string.h>
 #include <errno.h>
 #include <ipxe/xfer.h>
+#include <ipxe/job.h>
 #include <ipxe/open.h>
 #include <ipxe/process.h>
 #include <ipxe/socket.h>
 #include <ipxe/resolv.h>
+#include <ipxe/retry.h>
+#include <ipxe/timer.h>
 
 /** @file
  *
@@ -299,6 +302,37 @@ int resolv ( struct interface *resolv, const char *name,
  ***************************************************************************
  */
 
+/** Number of connection attempts raced for a named stream socket */
+#define NAMED_ATTEMPTS 2
+
+/** Named socket connection attempt states */
+enum named_attempt_state {
+	/** Name resolution in progress */
+	NAMED_RESOLVING = 0,
+	/** Name resolved, connection not yet started */
+	NAMED_RESOLVED,
+	/** Connection in progress */
+	NAMED_CONNECTING,
+	/** Attempt failed or abandoned */
+	NAMED_FAILED,
+};
+
+/** A named socket connection attempt */
+struct named_attempt {
+	/** Named socket */
+	struct named_socket *named;
+	/** Name resolution interface */
+	struct interface resolv;
+	/** Data transfer interface */
+	struct interface xfer;
+	/** Peer socket address */
+	struct sockaddr peer;
+	/** State */
+	enum named_attempt_state state;
+	/** Time at which name resolution completed */
+	unsigned long resolved;
+};
+
 /** A named socket */
 struct named_socket {
 	/** Reference counter */
@@ -313,6 +347,31 @@ struct named_socket {
 	struct sockaddr local;
 	/** Stored local socket address exists */
 	int have_local;
+
+	/** Connection attempts, in order of preference
+	 *
+	 * Connection attempts are used only when racing connections
+	 * to different address families.  When not racing, the name
+	 * is resolved via the name resolution interface and the
+	 * parent interface is redirected to the resolved address.
+	 */
+	struct named_attempt attempts[NAMED_ATTEMPTS];
+	/** Number of connection attempts */
+	unsigned int count;
+	/** Connection attempt timer */
+	struct retry_timer timer;
+	/** Time at which most recent connection attempt started */
+	unsigned long started;
+	/** Status code of most recently failed connection attempt */
+	int rc;
+};
+
+/** Address families for named socket connection attempts
+ *
+ * Address families are listed in order of preference.
+ */
+static const sa_family_t named_families[NAMED_ATTEMPTS] = {
+	AF_INET6, AF_INET,
 };
 
 /**
@@ -322,7 +381,18 @@ struct named_socket {
  * @v rc		Reason for termination
  */
 static void named_close ( struct named_socket *named, int rc ) {
+	struct named_attempt *attempt;
+	unsigned int i;
+
+	/* Stop timer */
+	stop_timer ( &named->timer );
+
 	/* Shut down interfaces */
+	for ( i = 0 ; i < named->count ; i++ ) {
+		attempt = &named->attempts[i];
+		intf_shutdown ( &attempt->resolv, rc );
+		intf_shutdown ( &attempt->xfer, rc );
+	}
 	intf_shutdown ( &named->resolv, rc );
 	intf_shutdown ( &named->xfer, rc );
 }
@@ -338,9 +408,36 @@ static size_t named_window ( struct named_socket *named __unused ) {
 	return 0;
 }
 
+/**
+ * Report job progress
+ *
+ * @v named		Named socket
+ * @v progress		Progress report to fill in
+ * @ret ongoing_rc	Ongoing job status code (if known)
+ */
+static int named_progress ( struct named_socket *named,
+			    struct job_progress *progress ) {
+	struct named_attempt *attempt;
+	unsigned int i;
+
+	/* Report progress of single name resolution, if applicable */
+	if ( ! named->count )
+		return job_progress ( &named->resolv, progress );
+
+	/* Otherwise, report progress of first unresolved attempt */
+	for ( i = 0 ; i < named->count ; i++ ) {
+		attempt = &named->attempts[i];
+		if ( attempt->state == NAMED_RESOLVING )
+			return job_progress ( &attempt->resolv, progress );
+	}
+
+	return 0;
+}
+
 /** Named socket opener data transfer interface operations */
 static struct interface_operation named_xfer_ops[] = {
 	INTF_OP ( xfer_window, struct named_socket *, named_window ),
+	INTF_OP ( job_progress, struct named_socket *, named_progress ),
 	INTF_OP ( intf_close, struct named_socket *, named_close ),
 };
 
@@ -391,6 +488,300 @@ static struct interface_descriptor named_resolv_desc =
 	INTF_DESC_PASSTHRU ( struct named_socket, resolv, named_resolv_op,
 			     xfer );
 
+/**
+ * Abandon connection attempt
+ *
+ * @v attempt		Connection attempt
+ * @v rc		Reason for abandonment
+ */
+static void named_abandon ( struct named_attempt *attempt, int rc ) {
+
+	/* Mark as failed and shut down interfaces */
+	attempt->state = NAMED_FAILED;
+	intf_shutdown ( &attempt->resolv, rc );
+	intf_shutdown ( &attempt->xfer, rc );
+}
+
+/**
+ * Start connection attempt
+ *
+ * @v attempt		Connection attempt
+ */
+static void named_connect ( struct named_attempt *attempt ) {
+	struct named_socket *named = attempt->named;
+	int rc;
+
+	DBGC ( named, "NAMED %p attempt %d connecting to %s\n",
+	       named, ( ( int ) ( attempt - named->attempts ) ),
+	       sock_ntoa ( &attempt->peer ) );
+
+	/* Record start time, even if the attempt fails immediately */
+	named->started = currticks();
+
+	/* Open socket */
+	if ( ( rc = xfer_open_socket ( &attempt->xfer, named->semantics,
+				       &attempt->peer,
+				       ( named->have_local ?
+					 &named->local : NULL ) ) ) != 0 ) {
+		DBGC ( named, "NAMED %p attempt %d could not connect: %s\n",
+		       named, ( ( int ) ( attempt - named->attempts ) ),
+		       strerror ( rc ) );
+		named->rc = rc;
+		named_abandon ( attempt, rc );
+		return;
+	}
+	attempt->state = NAMED_CONNECTING;
+}
+
+/**
+ * Start any connection attempts that are due
+ *
+ * @v named		Named socket
+ *
+ * Connection attempts are started in order of preference.  An
+ * attempt whose address has been resolved will wait for up to the
+ * resolution delay for any more preferred address to be resolved,
+ * and for up to the connection attempt delay for any in-progress
+ * connection attempt to complete.
+ */
+static void named_step ( struct named_socket *named ) {
+	struct named_attempt *attempt;
+	unsigned long elapsed;
+	unsigned long delay;
+	unsigned int failed = 0;
+	int resolving = 0;
+	int connecting = 0;
+	unsigned int i;
+
+	/* Start or schedule connection attempts */
+	for ( i = 0 ; i < named->count ; i++ ) {
+		attempt = &named->attempts[i];
+		switch ( attempt->state ) {
+		case NAMED_RESOLVING:
+			resolving = 1;
+			break;
+		case NAMED_CONNECTING:
+			connecting = 1;
+			break;
+		case NAMED_FAILED:
+			failed++;
+			break;
+		case NAMED_RESOLVED:
+			/* Wait for more preferred attempts, if applicable */
+			if ( connecting ) {
+				elapsed = ( currticks() - named->started );
+				delay = NAMED_CONNECTION_DELAY;
+			} else if ( resolving ) {
+				elapsed = ( currticks() - attempt->resolved );
+				delay = NAMED_RESOLUTION_DELAY;
+			} else {
+				elapsed = delay = 0;
+			}
+			if ( elapsed < delay ) {
+				start_timer_fixed ( &named->timer,
+						    ( delay - elapsed ) );
+				return;
+			}
+
+			/* Start connection attempt */
+			named_connect ( attempt );
+			if ( attempt->state == NAMED_CONNECTING ) {
+				connecting = 1;
+			} else {
+				failed++;
+			}
+			break;
+		}
+	}
+
+	/* Fail if all attempts have failed */
+	if ( failed == named->count ) {
+		DBGC ( named, "NAMED %p all attempts failed: %s\n",
+		       named, strerror ( named->rc ) );
+		named_close ( named, named->rc );
+	}
+}
+
+/**
+ * Handle connection attempt timer expiry
+ *
+ * @v timer		Connection attempt timer
+ * @v fail		Failure indicator
+ */
+static void named_expired ( struct retry_timer *timer, int fail __unused ) {
+	struct named_socket *named =
+		container_of ( timer, struct named_socket, timer );
+
+	/* Start any connection attempts that are now due */
+	named_step ( named );
+}
+
+/**
+ * Handle connection attempt failure
+ *
+ * @v attempt		Connection attempt
+ * @v rc		Reason for failure
+ */
+static void named_attempt_close ( struct named_attempt *attempt, int rc ) {
+	struct named_socket *named = attempt->named;
+
+	/* Treat a close without a result as a failure */
+	if ( rc == 0 )
+		rc = -ECONNABORTED;
+	DBGC ( named, "NAMED %p attempt %d failed: %s\n",
+	       named, ( ( int ) ( attempt - named->attempts ) ),
+	       strerror ( rc ) );
+
+	/* Abandon this attempt and move on to any others */
+	named->rc = rc;
+	named_abandon ( attempt, rc );
+	named_step ( named );
+}
+
+/**
+ * Handle connection attempt name resolution
+ *
+ * @v attempt		Connection attempt
+ * @v sa		Completed socket address
+ */
+static void named_attempt_resolved ( struct named_attempt *attempt,
+				     struct sockaddr *sa ) {
+	struct named_socket *named = attempt->named;
+
+	/* Ignore any duplicate resolutions */
+	if ( attempt->state != NAMED_RESOLVING )
+		return;
+
+	/* Record resolved address */
+	memcpy ( &attempt->peer, sa, sizeof ( attempt->peer ) );
+	attempt->state = NAMED_RESOLVED;
+	attempt->resolved = currticks();
+	DBGC ( named, "NAMED %p attempt %d resolved to %s\n",
+	       named, ( ( int ) ( attempt - named->attempts ) ),
+	       sock_ntoa ( sa ) );
+
+	/* Name resolution is complete */
+	intf_shutdown ( &attempt->resolv, 0 );
+
+	/* Start any connection attempts that are now due */
+	named_step ( named );
+}
+
+/**
+ * Handle connection attempt flow control window change
+ *
+ * @v attempt		Connection attempt
+ *
+ * The first connection attempt to open its flow control window
+ * (i.e. to complete its handshake) wins.  All other attempts are
+ * abandoned, and the established connection is handed over to the
+ * parent interface without reconnecting.
+ */
+static void named_attempt_window_changed ( struct named_attempt *attempt ) {
+	struct named_socket *named = attempt->named;
+	struct sockaddr *local =
+		( named->have_local ? &named->local : NULL );
+	struct named_attempt *other;
+	struct interface *socket;
+	unsigned int i;
+	int rc;
+
+	/* Ignore until connection is established */
+	if ( ( attempt->state != NAMED_CONNECTING ) ||
+	     ( xfer_window ( &attempt->xfer ) == 0 ) )
+		return;
+	DBGC ( named, "NAMED %p attempt %d connected to %s\n",
+	       named, ( ( int ) ( attempt - named->attempts ) ),
+	       sock_ntoa ( &attempt->peer ) );
+
+	/* Abandon all other attempts */
+	for ( i = 0 ; i < named->count ; i++ ) {
+		other = &named->attempts[i];
+		if ( ( other != attempt ) && ( other->state != NAMED_FAILED ) )
+			named_abandon ( other, -ECANCELED );
+	}
+
+	/* Hand over established connection to parent.  The parent is
+	 * redirected to the established connection (rather than
+	 * simply being spliced to it), so that a parent which
+	 * intercepts redirection (e.g. to record the peer address)
+	 * will still see the peer address.
+	 */
+	socket = intf_get ( attempt->xfer.dest );
+	intf_unplug ( &attempt->xfer );
+	intf_nullify ( &named->xfer );
+	if ( ( rc = xfer_redirect ( &named->xfer, LOCATION_CONNECTED,
+				    named->semantics, &attempt->peer, local,
+				    socket ) ) != 0 ) {
+		/* Redirection failed - do not unplug data-xfer
+		 * interface, and reattach the established connection
+		 * so that it will be closed.
+		 */
+		DBGC ( named, "NAMED %p could not redirect: %s\n",
+		       named, strerror ( rc ) );
+		if ( socket->dest == &null_intf )
+			intf_plug_plug ( &attempt->xfer, socket );
+	} else {
+		/* Redirection succeeded - unplug data-xfer interface
+		 * and notify parent that the connection is ready.
+		 */
+		intf_unplug ( &named->xfer );
+		xfer_window_changed ( socket );
+	}
+	intf_put ( socket );
+
+	/* Terminate named socket opener */
+	named_close ( named, rc );
+}
+
+/** Named socket connection attempt resolver interface operations */
+static struct interface_operation named_attempt_resolv_op[] = {
+	INTF_OP ( intf_close, struct named_attempt *, named_attempt_close ),
+	INTF_OP ( resolv_done, struct named_attempt *,
+		  named_attempt_resolved ),
+};
+
+/** Named socket connection attempt resolver interface descriptor */
+static struct interface_descriptor named_attempt_resolv_desc =
+	INTF_DESC ( struct named_attempt, resolv, named_attempt_resolv_op );
+
+/** Named socket connection attempt data transfer interface operations */
+static struct interface_operation named_attempt_xfer_op[] = {
+	INTF_OP ( intf_close, struct named_attempt *, named_attempt_close ),
+	INTF_OP ( xfer_window_changed, struct named_attempt *,
+		  named_attempt_window_changed ),
+};
+
+/** Named socket connection attempt data transfer interface descriptor */
+static struct interface_descriptor named_attempt_xfer_desc =
+	INTF_DESC ( struct named_attempt, xfer, named_attempt_xfer_op );
+
+/**
+ * Check whether or not to race connections to different address families
+ *
+ * @v semantics		Communication semantics (e.g. SOCK_STREAM)
+ * @v peer		Peer socket address to complete
+ * @v name		Name to resolve
+ * @ret race		Race connections to different address families
+ */
+static int named_race ( int semantics, struct sockaddr *peer,
+			const char *name ) {
+	struct sockaddr sa;
+
+	/* Race only stream connections with an unspecified address
+	 * family, to a name that is not a numeric address.
+	 */
+	if ( semantics != SOCK_STREAM )
+		return 0;
+	if ( ( ! peer ) || peer->sa_family )
+		return 0;
+	memset ( &sa, 0, sizeof ( sa ) );
+	if ( sock_aton ( name, &sa ) == 0 )
+		return 0;
+
+	return 1;
+}
+
 /**
  * Open named socket
  *
@@ -399,11 +790,18 @@ static struct interface_descriptor named_resolv_desc =
  * @v name		Name to resolve
  * @v local		Local socket address, or NULL
  * @ret rc		Return status code
+ *
+ * For stream sockets, connection attempts to each address family are
+ * raced against each other as described in RFC 8305 ("Happy
+ * Eyeballs"), and the first connection to be established is used.
  */
 int xfer_open_named_socket ( struct interface *xfer, int semantics,
 			     struct sockaddr *peer, const char *name,
 			     struct sockaddr *local ) {
 	struct named_socket *named;
+	struct named_attempt *attempt;
+	unsigned int started = 0;
+	unsigned int i;
 	int rc;
 
 	/* Allocate and initialise structure */
@@ -413,6 +811,7 @@ int xfer_open_named_socket ( struct interface *xfer, int semantics,
 	ref_init ( &named->refcnt, NULL );
 	intf_init ( &named->xfer, &named_xfer_desc, &named->refcnt );
 	intf_init ( &named->resolv, &named_resolv_desc, &named->refcnt );
+	timer_init ( &named->timer, named_expired, &named->refcnt );
 	named->semantics = semantics;
 	if ( local ) {
 		memcpy ( &named->local, local, sizeof ( named->local ) );
@@ -423,8 +822,41 @@ int xfer_open_named_socket ( struct interface *xfer, int semantics,
 	       named, name );
 
 	/* Start name resolution */
-	if ( ( rc = resolv ( &named->resolv, name, peer ) ) != 0 )
-		goto err;
+	if ( named_race ( semantics, peer, name ) ) {
+
+		/* Start name resolution for each address family */
+		named->count = NAMED_ATTEMPTS;
+		named->rc = -ENOENT;
+		for ( i = 0 ; i < named->count ; i++ ) {
+			attempt = &named->attempts[i];
+			attempt->named = named;
+			intf_init ( &attempt->resolv,
+				    &named_attempt_resolv_desc,
+				    &named->refcnt );
+			intf_init ( &attempt->xfer, &named_attempt_xfer_desc,
+				    &named->refcnt );
+			memcpy ( &attempt->peer, peer,
+				 sizeof ( attempt->peer ) );
+			attempt->peer.sa_family = named_families[i];
+			if ( ( rc = resolv ( &attempt->resolv, name,
+					     &attempt->peer ) ) != 0 ) {
+				named->rc = rc;
+				attempt->state = NAMED_FAILED;
+				continue;
+			}
+			started++;
+		}
+		if ( ! started ) {
+			rc = named->rc;
+			goto err;
+		}
+
+	} else {
+
+		/* Start single name resolution */
+		if ( ( rc = resolv ( &named->resolv, name, peer ) ) != 0 )
+			goto err;
+	}
 
 	/* Attach parent interface, mortalise self, and return */
 	intf_plug_plug ( &named->xfer, xfer );
@@ -432,6 +864,7 @@ int xfer_open_named_socket ( struct interface *xfer, int semantics,
 	return 0;
 
  err:
+	named_close ( named, rc );
 	ref_put ( &named->refcnt );
 	return rc;
 }
@@ -172,7 +172,6 @@ static unsigned int uheap_shrink ( void *ptr, size_t size ) {
 
 /** The external heap */
 static struct heap uheap = {
-	.blocks = LIST_HEAD_INIT ( uheap.blocks ),
 	.align = UHEAP_ALIGN,
 	.ptr_align = UHEAP_ALIGN,
 	.grow = uheap_grow,
@@ -27,6 +27,7 @@ FILE_SECBOOT ( PERMITTED );
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <assert.h>
 #include <ipxe/xfer.h>
 #include <ipxe/iobuf.h>
 #include <ipxe/umalloc.h>
@@ -60,6 +61,19 @@ FILE_SECBOOT ( PERMITTED );
  * attempt to resize the buffer to accommodate the write (and will
  * fail if this cannot be done).
  *
+ * Since the final length of the data is often not known in advance
+ * (e.g. for a chunked HTTP response, or a TFTP transfer without a
+ * "tsize" option), automatic resizing grows the underlying storage
+ * geometrically rather than to the exact length required, to avoid
+ * reallocating (and potentially copying) the whole buffer for every
+ * received packet.  The consumer may call xferbuf_shrink() once the
+ * transfer is complete to release any excess storage.  There is no
+ * common completion path within the data transfer buffer itself, and
+ * so this is done by each consumer whose buffer outlives the transfer
+ * (i.e. the downloader and the PeerDist download multiplexer).  Other
+ * consumers free their buffers as soon as the contents have been
+ * processed, and so gain nothing from shrinking them.
+ *
  * An object interface may choose to implement the xfer_buffer()
  * interface method to provide another object with direct access to
  * its own data buffer.  This is something of a layering violation,
@@ -74,7 +88,7 @@ static struct profiler xferbuf_deliver_profiler __profiler =
 
 /** Data write profiler */
 static struct profiler xferbuf_write_profiler __profiler =
-	{ .name = "xferbuf.write" };
+	{ .name = "xferbuf.write", .hist = PROFILE_HISTOGRAM };
 
 /** Data read profiler */
 static struct profiler xferbuf_read_profiler __profiler =
@@ -89,6 +103,7 @@ void xferbuf_free ( struct xfer_buffer *xferbuf ) {
 
 	xferbuf->op->realloc ( xferbuf, 0 );
 	xferbuf->len = 0;
+	xferbuf->size = 0;
 	xferbuf->max = 0;
 	xferbuf->pos = 0;
 }
@@ -101,6 +116,7 @@ void xferbuf_free ( struct xfer_buffer *xferbuf ) {
  * @ret rc		Return status code
  */
 static int xferbuf_ensure_size ( struct xfer_buffer *xferbuf, size_t len ) {
+	size_t size;
 	int rc;
 
 	/* Record maximum required size */
@@ -111,14 +127,66 @@ static int xferbuf_ensure_size ( struct xfer_buffer *xferbuf, size_t len ) {
 	if ( len <= xferbuf->len )
 		return 0;
 
-	/* Extend buffer */
-	if ( ( rc = xferbuf->op->realloc ( xferbuf, len ) ) != 0 ) {
-		DBGC ( xferbuf, "XFERBUF %p could not extend buffer to "
-		       "%zd bytes: %s\n", xferbuf, len, strerror ( rc ) );
-		return rc;
+	/* Extend allocated storage, if necessary */
+	if ( len > xferbuf->size ) {
+
+		/* Grow geometrically, to avoid quadratic behaviour when
+		 * the final length is not known in advance.  An empty
+		 * buffer is allocated at exactly the required length,
+		 * so that a buffer presized via xfer_seek() will not
+		 * be overallocated.
+		 */
+		size = ( xferbuf->size + ( xferbuf->size / 2 ) );
+		if ( size < len )
+			size = len;
+
+		/* Fall back to the exact required length if the
+		 * geometric allocation fails.
+		 */
+		if ( ( size == len ) ||
+		     ( xferbuf->op->realloc ( xferbuf, size ) != 0 ) ) {
+			size = len;
+			if ( ( rc = xferbuf->op->realloc ( xferbuf,
+							   size ) ) != 0 ) {
+				DBGC ( xferbuf, "XFERBUF %p could not extend "
+				       "buffer to %zd bytes: %s\n", xferbuf,
+				       len, strerror ( rc ) );
+				return rc;
+			}
+		}
+		xferbuf->size = size;
 	}
 	xferbuf->len = len;
 
+	/* Notify buffer of new length, if applicable */
+	if ( xferbuf->op->resize )
+		xferbuf->op->resize ( xferbuf );
+
+	return 0;
+}
+
+/**
+ * Shrink data transfer buffer to fit its contents
+ *
+ * @v xferbuf		Data transfer buffer
+ * @ret rc		Return status code
+ */
+int xferbuf_shrink ( struct xfer_buffer *xferbuf ) {
+	int rc;
+
+	/* If buffer has no excess storage, do nothing */
+	if ( xferbuf->size <= xferbuf->len )
+		return 0;
+
+	/* Shrink buffer */
+	if ( ( rc = xferbuf->op->realloc ( xferbuf, xferbuf->len ) ) != 0 ) {
+		DBGC ( xferbuf, "XFERBUF %p could not shrink buffer to "
+		       "%zd bytes: %s\n", xferbuf, xferbuf->len,
+		       strerror ( rc ) );
+		return rc;
+	}
+	xferbuf->size = xferbuf->len;
+
 	return 0;
 }
 
@@ -290,7 +358,7 @@ struct xfer_buffer_operations xferbuf_umalloc_operations = {
 static int xferbuf_fixed_realloc ( struct xfer_buffer *xferbuf, size_t len ) {
 
 	/* Refuse to allocate extra space */
-	if ( len > xferbuf->len ) {
+	if ( len > xferbuf->size ) {
 		/* Note that EFI relies upon this error mapping to
 		 * EFI_BUFFER_TOO_SMALL.
 		 */
@@ -331,20 +399,41 @@ struct xfer_buffer_operations xferbuf_void_operations = {
  * Reallocate image-based data transfer buffer
  *
  * @v xferbuf		Data transfer buffer
- * @v len		New length (or zero to free buffer)
+ * @v len		New allocated size (or zero to free buffer)
  * @ret rc		Return status code
+ *
+ * The image length is not extended beyond the data written so far.
  */
 static int xferbuf_image_realloc ( struct xfer_buffer *xferbuf, size_t len ) {
 	struct image *image = xferbuf->data;
+	size_t used = xferbuf->len;
 	int rc;
 
 	/* Resize image */
-	if ( ( rc = image_set_len ( image, len ) ) != 0 )
+	if ( used > len )
+		used = len;
+	if ( ( rc = image_set_size ( image, used, len ) ) != 0 )
 		return rc;
 
 	return 0;
 }
 
+/**
+ * Update length of image-based data transfer buffer
+ *
+ * @v xferbuf		Data transfer buffer
+ */
+static void xferbuf_image_resize ( struct xfer_buffer *xferbuf ) {
+	struct image *image = xferbuf->data;
+	char *nul;
+
+	/* Update image length within existing allocation */
+	assert ( xferbuf->len <= xferbuf->size );
+	image->len = xferbuf->len;
+	nul = ( image->rwdata + image->len );
+	*nul = '\0';
+}
+
 /**
  * Access image-based data transfer buffer
  *
@@ -360,6 +449,7 @@ static void * xferbuf_image_access ( struct xfer_buffer *xferbuf ) {
 /** Image-based data buffer operations */
 struct xfer_buffer_operations xferbuf_image_operations = {
 	.realloc = xferbuf_image_realloc,
+	.resize = xferbuf_image_resize,
 	.access = xferbuf_image_access,
 };
 
@@ -29,6 +29,7 @@
 #include <ipxe/ethernet.h>
 #include <ipxe/settings.h>
 #include <ipxe/socket.h>
+#include <ipxe/tcpip.h>
 
 /* This hack prevents pre-2.6.32 headers from redefining struct sockaddr */
 #define _SYS_SOCKET_H
@@ -38,8 +39,12 @@
 #include <linux/if.h>
 #include <linux/if_ether.h>
 #include <linux/if_tun.h>
+#include <linux/virtio_net.h>
 
-#define RX_BUF_SIZE 1536
+/** Receive buffer space beyond the MTU (link-layer header and VLAN tag) */
+#define RX_BUF_PAD 36
+/** Maximum supported MTU (jumbo frames) */
+#define TAP_MAX_MTU 9000
 #define RX_QUOTA 4
 
 /** @file
@@ -74,8 +79,10 @@ static int tap_open(struct net_device * netdev)
 	}
 
 	memset(&ifr, 0, sizeof(ifr));
-	/* IFF_NO_PI for no extra packet information */
-	ifr.ifr_flags = IFF_TAP | IFF_NO_PI;
+	/* IFF_NO_PI for no extra packet information, IFF_VNET_HDR
+	 * for per-packet checksum status
+	 */
+	ifr.ifr_flags = IFF_TAP | IFF_NO_PI | IFF_VNET_HDR;
 	strncpy(ifr.ifr_name, nic->interface, IFNAMSIZ);
 	DBGC(nic, "tap %p interface = '%s'\n", nic, nic->interface);
 
@@ -96,6 +103,16 @@ static int tap_open(struct net_device * netdev)
 		return ret;
 	}
 
+	/* Accept packets with partial checksums, if supported */
+	ret = linux_ioctl(nic->fd, TUNSETOFFLOAD, TUN_F_CSUM);
+	if (ret == 0) {
+		netdev->state |= NETDEV_RX_CSUM;
+	} else {
+		DBGC(nic, "tap %p has no checksum offload (%s)\n",
+		     nic, linux_strerror(linux_errno));
+		netdev->state &= ~NETDEV_RX_CSUM;
+	}
+
 	return 0;
 }
 
@@ -114,11 +131,21 @@ static void tap_close(struct net_device *netdev)
 static int tap_transmit(struct net_device *netdev, struct io_buffer *iobuf)
 {
 	struct tap_nic * nic = netdev->priv;
+	struct virtio_net_hdr *hdr;
 	int rc;
 
 	/* Pad and align packet */
 	iob_pad(iobuf, ETH_ZLEN);
 
+	/* Prepend an empty virtio network header */
+	if (iob_headroom(iobuf) < sizeof(*hdr)) {
+		DBGC(nic, "tap %p insufficient headroom for header\n", nic);
+		netdev_tx_complete_err(netdev, iobuf, -ENOBUFS);
+		return 0;
+	}
+	hdr = iob_push(iobuf, sizeof(*hdr));
+	memset(hdr, 0, sizeof(*hdr));
+
 	rc = linux_write(nic->fd, iobuf->data, iobuf->tail - iobuf->data);
 	DBGC2(nic, "tap %p wrote %d bytes\n", nic, rc);
 	netdev_tx_complete(netdev, iobuf);
@@ -132,7 +159,9 @@ static void tap_poll(struct net_device *netdev)
 	struct tap_nic * nic = netdev->priv;
 	struct pollfd pfd;
 	struct io_buffer * iobuf;
+	struct virtio_net_hdr *hdr;
 	unsigned int quota = RX_QUOTA;
+	size_t len = ( sizeof(*hdr) + netdev->mtu + RX_BUF_PAD );
 	int r;
 
 	pfd.fd = nic->fd;
@@ -146,18 +175,38 @@ static void tap_poll(struct net_device *netdev)
 
 	/* At this point we know there is at least one new packet to be read */
 
-	iobuf = alloc_iob(RX_BUF_SIZE);
+	iobuf = alloc_iob(len);
 	if (! iobuf)
 		goto allocfail;
 
 	while (quota-- &&
-	       ((r = linux_read(nic->fd, iobuf->data, RX_BUF_SIZE)) > 0)) {
+	       ((r = linux_read(nic->fd, iobuf->data, len)) > 0)) {
 		DBGC2(nic, "tap %p read %d bytes\n", nic, r);
 
 		iob_put(iobuf, r);
-		netdev_rx(netdev, iobuf);
 
-		iobuf = alloc_iob(RX_BUF_SIZE);
+		/* Strip header, recording checksum status */
+		if (iob_len(iobuf) < sizeof(*hdr)) {
+			netdev_rx_err(netdev, iobuf, -EINVAL);
+		} else {
+			hdr = iobuf->data;
+			iob_pull(iobuf, sizeof(*hdr));
+			if (! (netdev->state & NETDEV_RX_CSUM)) {
+				/* Checksum offload not enabled */
+			} else if (hdr->flags & VIRTIO_NET_HDR_F_NEEDS_CSUM) {
+				/* Complete partial checksum, since the
+				 * packet may be passed on intact
+				 */
+				if (tcpip_complete_chksum(iobuf, hdr->csum_start,
+							  hdr->csum_offset) == 0)
+					iobuf->flags |= IOB_CSUM_VERIFIED;
+			} else if (hdr->flags & VIRTIO_NET_HDR_F_DATA_VALID) {
+				iobuf->flags |= IOB_CSUM_VERIFIED;
+			}
+			netdev_rx(netdev, iobuf);
+		}
+
+		iobuf = alloc_iob(len);
 		if (! iobuf)
 			goto allocfail;
 	}
@@ -209,6 +258,9 @@ static int tap_probe(struct linux_device *device, struct linux_device_request *r
 	memcpy ( netdev->hw_addr, tap_default_mac, ETH_ALEN );
 	memset(nic, 0, sizeof(*nic));
 
+	/* Allow jumbo frames, leaving the default MTU unchanged */
+	netdev->max_pkt_len = ( ETH_HLEN + TAP_MAX_MTU );
+
 	/* Look for the mandatory if setting */
 	if_setting = linux_find_setting("if", &request->settings);
 
@@ -33,6 +33,9 @@ FILE_SECBOOT ( PERMITTED );
 #include <ipxe/ethernet.h>
 #include <ipxe/if_ether.h>
 #include <ipxe/iobuf.h>
+#include <ipxe/ip.h>
+#include <ipxe/ipv6.h>
+#include <ipxe/tcp.h>
 #include <ipxe/malloc.h>
 #include <ipxe/pci.h>
 #include "virtio-net.h"
@@ -47,8 +50,12 @@ FILE_SECBOOT ( PERMITTED );
 const struct virtio_features virtio_net_features = {
 	.word = {
 		( VIRTIO_FEAT0_ANY_LAYOUT |
+		  VIRTIO_FEAT0_NET_CSUM |
+		  VIRTIO_FEAT0_NET_GUEST_CSUM |
 		  VIRTIO_FEAT0_NET_MTU |
-		  VIRTIO_FEAT0_NET_MAC ),
+		  VIRTIO_FEAT0_NET_MAC |
+		  VIRTIO_FEAT0_NET_HOST_TSO4 |
+		  VIRTIO_FEAT0_NET_HOST_TSO6 ),
 		( VIRTIO_FEAT1_MODERN ),
 	},
 };
@@ -113,6 +120,19 @@ static void virtio_net_mtu ( struct net_device *netdev ) {
  ******************************************************************************
  */
 
+/**
+ * Free packet headers
+ *
+ * @v queue		Virtio network queue
+ */
+static void virtio_net_free_hdrs ( struct virtio_net_queue *queue ) {
+
+	/* Free packet headers */
+	dma_free ( &queue->map, queue->hdrs,
+		   ( queue->max * sizeof ( queue->hdrs[0] ) ) );
+	queue->hdrs = NULL;
+}
+
 /**
  * Enable queue
  *
@@ -124,6 +144,7 @@ static int virtio_net_enable ( struct virtio_net *vnet,
 			       struct virtio_net_queue *queue ) {
 	struct virtio_device *virtio = &vnet->virtio;
 	struct virtio_desc *desc;
+	size_t hdrs_len = ( queue->max * sizeof ( queue->hdrs[0] ) );
 	unsigned int count;
 	unsigned int max;
 	unsigned int fill;
@@ -132,13 +153,16 @@ static int virtio_net_enable ( struct virtio_net *vnet,
 	unsigned int write;
 	int rc;
 
-	/* Map packet header */
-	if ( ( rc = dma_map ( virtio->dma, &queue->map, &queue->hdr,
-			      sizeof ( queue->hdr ), queue->dma ) ) != 0 ) {
-		DBGC ( vnet, "VNET %s Q%d could not map header: %s\n",
-		       virtio->name, queue->queue.index, strerror ( rc ) );
-		goto err_map;
+	/* Allocate packet headers */
+	queue->hdrs = dma_alloc ( virtio->dma, &queue->map, hdrs_len,
+				  VIRTIO_NET_HDRS_ALIGN );
+	if ( ! queue->hdrs ) {
+		DBGC ( vnet, "VNET %s Q%d could not allocate headers\n",
+		       virtio->name, queue->queue.index );
+		rc = -ENOMEM;
+		goto err_alloc;
 	}
+	memset ( queue->hdrs, 0, hdrs_len );
 
 	/* Enable queue */
 	count = ( queue->count * VIRTIO_NET_DESCS );
@@ -163,7 +187,8 @@ static int virtio_net_enable ( struct virtio_net *vnet,
 		queue->iobufs[slot] = NULL;
 		index = ( slot * VIRTIO_NET_DESCS );
 		desc = &queue->queue.desc[index];
-		desc[0].addr = cpu_to_le64 ( dma ( &queue->map, &queue->hdr ));
+		desc[0].addr = cpu_to_le64 ( dma ( &queue->map,
+						   &queue->hdrs[slot] ) );
 		desc[0].len = cpu_to_le32 ( vnet->hlen );
 		desc[0].flags = cpu_to_le16 ( VIRTIO_DESC_FL_NEXT | write );
 		desc[0].next = cpu_to_le16 ( index + 1 );
@@ -179,11 +204,25 @@ static int virtio_net_enable ( struct virtio_net *vnet,
 	 * failure.
 	 */
  err_enable:
-	dma_unmap ( &queue->map, sizeof ( queue->hdr ) );
- err_map:
+	virtio_net_free_hdrs ( queue );
+ err_alloc:
 	return rc;
 }
 
+/**
+ * Get next packet header
+ *
+ * @v queue		Virtio network queue
+ * @ret hdr		Packet header to be used by next submitted I/O buffer
+ */
+static inline union virtio_net_header *
+virtio_net_next_header ( struct virtio_net_queue *queue ) {
+	unsigned int slot;
+
+	slot = queue->slots[ queue->queue.prod & queue->mask ];
+	return &queue->hdrs[slot];
+}
+
 /**
  * Submit I/O buffer to queue
  *
@@ -207,7 +246,7 @@ static void virtio_net_submit ( struct virtio_net *vnet,
 	index = ( slot * VIRTIO_NET_DESCS );
 	desc = &queue->queue.desc[index];
 
-	/* Populate descriptors */
+	/* Populate descriptor */
 	desc[1].addr = cpu_to_le64 ( iob_dma ( iobuf ) );
 	desc[1].len = cpu_to_le32 ( len );
 	DBGC2 ( vnet, "VNET %s Q%d [%02x-%02x] is [%lx,%lx)\n",
@@ -229,11 +268,12 @@ static void virtio_net_submit ( struct virtio_net *vnet,
  * @v vnet		Virtio network device
  * @v queue		Virtio network queue
  * @v len		Length to fill in (or NULL to ignore)
+ * @v hdr		Packet header to fill in (or NULL to ignore)
  * @ret iobuf		I/O buffer
  */
-static struct io_buffer * virtio_net_complete ( struct virtio_net *vnet,
-						struct virtio_net_queue *queue,
-						size_t *len ) {
+static struct io_buffer *
+virtio_net_complete ( struct virtio_net *vnet, struct virtio_net_queue *queue,
+		      size_t *len, union virtio_net_header **hdr ) {
 	struct virtio_device *virtio = &vnet->virtio;
 	struct io_buffer *iobuf;
 	unsigned int cons;
@@ -250,6 +290,8 @@ static struct io_buffer * virtio_net_complete ( struct virtio_net *vnet,
 	iobuf = queue->iobufs[slot];
 	assert ( iobuf != NULL );
 	queue->iobufs[slot] = NULL;
+	if ( hdr )
+		*hdr = &queue->hdrs[slot];
 	DBGC2 ( vnet, "VNET %s Q%d [%02x-%02x] complete",
 		virtio->name, queue->queue.index, index, ( index + 1 ) );
 	if ( len )
@@ -308,6 +350,7 @@ static int virtio_net_open ( struct net_device *netdev ) {
 	struct virtio_net *vnet = netdev->priv;
 	struct virtio_device *virtio = &vnet->virtio;
 	union virtio_net_header hdr;
+	uint32_t tso;
 	int rc;
 
 	/* (Re)initialise device */
@@ -324,6 +367,22 @@ static int virtio_net_open ( struct net_device *netdev ) {
 	/* Calculate maximum frame size */
 	vnet->mfs = ( ETH_HLEN + 4 /* possible VLAN */ + netdev->mtu );
 
+	/* Record receive checksum offload capability */
+	if ( virtio->features.word[0] & VIRTIO_FEAT0_NET_GUEST_CSUM ) {
+		netdev->state |= NETDEV_RX_CSUM;
+	} else {
+		netdev->state &= ~NETDEV_RX_CSUM;
+	}
+
+	/* Record segmentation offload capability */
+	tso = ( VIRTIO_FEAT0_NET_CSUM | VIRTIO_FEAT0_NET_HOST_TSO4 |
+		VIRTIO_FEAT0_NET_HOST_TSO6 );
+	if ( ( virtio->features.word[0] & tso ) == tso ) {
+		netdev->state |= NETDEV_TX_TSO;
+	} else {
+		netdev->state &= ~NETDEV_TX_TSO;
+	}
+
 	/* Enable receive queue */
 	if ( ( rc = virtio_net_enable ( vnet, &vnet->rx ) ) != 0 ) {
 		DBGC ( vnet, "VNET %s could not enable RX: %s\n",
@@ -346,9 +405,9 @@ static int virtio_net_open ( struct net_device *netdev ) {
 
 	return 0;
 
-	dma_unmap ( &vnet->tx.map, sizeof ( vnet->tx.hdr ) );
+	virtio_net_free_hdrs ( &vnet->tx );
  err_tx:
-	dma_unmap ( &vnet->rx.map, sizeof ( vnet->rx.hdr ) );
+	virtio_net_free_hdrs ( &vnet->rx );
  err_rx:
 	/* There may be no way to disable individual queues: we must
 	 * reset the whole device instead and then free the queues.
@@ -373,9 +432,9 @@ static void virtio_net_close ( struct net_device *netdev ) {
 	/* Reset device */
 	virtio_reset ( virtio );
 
-	/* Unmap headers (now that device is guaranteed idle) */
-	dma_unmap ( &vnet->rx.map, sizeof ( vnet->rx.hdr ) );
-	dma_unmap ( &vnet->tx.map, sizeof ( vnet->tx.hdr ) );
+	/* Free headers (now that device is guaranteed idle) */
+	virtio_net_free_hdrs ( &vnet->rx );
+	virtio_net_free_hdrs ( &vnet->tx );
 
 	/* Free queues */
 	virtio_free ( virtio, &vnet->rx.queue );
@@ -386,6 +445,66 @@ static void virtio_net_close ( struct net_device *netdev ) {
 		free_rx_iob ( vnet->rx_iobufs[i] );
 }
 
+/**
+ * Construct segmentation offload packet header
+ *
+ * @v vnet		Virtio network device
+ * @v iobuf		I/O buffer
+ * @v hdr		Packet header to fill in
+ * @ret rc		Return status code
+ */
+static int virtio_net_tso ( struct virtio_net *vnet, struct io_buffer *iobuf,
+			    union virtio_net_header *hdr ) {
+	struct virtio_device *virtio = &vnet->virtio;
+	struct virtio_net_common_header *common = &hdr->common;
+	struct ethhdr *ethhdr = iobuf->data;
+	struct iphdr *iphdr;
+	struct tcp_header *tcphdr;
+	size_t len = iob_len ( iobuf );
+	size_t offset;
+	size_t thlen;
+	unsigned int gso_type;
+
+	/* Locate TCP header */
+	offset = sizeof ( *ethhdr );
+	if ( len < ( offset + sizeof ( *iphdr ) ) )
+		goto err_len;
+	iphdr = ( iobuf->data + offset );
+	if ( ethhdr->h_protocol == htons ( ETH_P_IP ) ) {
+		gso_type = VIRTIO_NET_HDR_GSO_TCPV4;
+		offset += ( ( iphdr->verhdrlen & IP_MASK_HLEN ) * 4 );
+	} else if ( ethhdr->h_protocol == htons ( ETH_P_IPV6 ) ) {
+		gso_type = VIRTIO_NET_HDR_GSO_TCPV6;
+		offset += sizeof ( struct ipv6_header );
+	} else {
+		DBGC ( vnet, "VNET %s cannot segment protocol %04x\n",
+		       virtio->name, ntohs ( ethhdr->h_protocol ) );
+		return -ENOTSUP;
+	}
+	if ( len < ( offset + sizeof ( *tcphdr ) ) )
+		goto err_len;
+	tcphdr = ( iobuf->data + offset );
+	thlen = ( ( ( tcphdr->hlen & TCP_MASK_HLEN ) / 16 ) * 4 );
+
+	/* Construct header.  The TCP checksum field already holds
+	 * the pseudo-header checksum.
+	 */
+	common->flags = VIRTIO_NET_HDR_NEEDS_CSUM;
+	common->gso_type = gso_type;
+	common->hdr_len = cpu_to_le16 ( offset + thlen );
+	common->gso_size = cpu_to_le16 ( iobuf->mss );
+	common->csum_start = cpu_to_le16 ( offset );
+	common->csum_offset =
+		cpu_to_le16 ( offsetof ( typeof ( *tcphdr ), csum ) );
+
+	return 0;
+
+ err_len:
+	DBGC ( vnet, "VNET %s cannot segment truncated packet\n",
+	       virtio->name );
+	return -EINVAL;
+}
+
 /**
  * Transmit packet
  *
@@ -397,6 +516,8 @@ static int virtio_net_transmit ( struct net_device *netdev,
 				 struct io_buffer *iobuf ) {
 	struct virtio_net *vnet = netdev->priv;
 	struct virtio_net_queue *queue = &vnet->tx;
+	union virtio_net_header *hdr;
+	int rc;
 
 	/* Defer packet if there are no available transmit descriptors */
 	if ( ( queue->queue.prod - queue->queue.cons ) >= queue->fill ) {
@@ -404,6 +525,14 @@ static int virtio_net_transmit ( struct net_device *netdev,
 		return 0;
 	}
 
+	/* Construct packet header */
+	hdr = virtio_net_next_header ( queue );
+	memset ( hdr, 0, sizeof ( *hdr ) );
+	if ( iobuf->mss ) {
+		if ( ( rc = virtio_net_tso ( vnet, iobuf, hdr ) ) != 0 )
+			return rc;
+	}
+
 	/* Submit I/O buffer */
 	virtio_net_submit ( vnet, queue, iobuf, iob_len ( iobuf ) );
 
@@ -427,7 +556,7 @@ static void virtio_net_poll_tx ( struct net_device *netdev ) {
 	while ( virtio_completions ( &queue->queue ) ) {
 
 		/* Complete I/O buffer */
-		iobuf = virtio_net_complete ( vnet, queue, NULL );
+		iobuf = virtio_net_complete ( vnet, queue, NULL, NULL );
 		netdev_tx_complete ( netdev, iobuf );
 	}
 }
@@ -440,6 +569,7 @@ static void virtio_net_poll_tx ( struct net_device *netdev ) {
 static void virtio_net_poll_rx ( struct net_device *netdev ) {
 	struct virtio_net *vnet = netdev->priv;
 	struct virtio_net_queue *queue = &vnet->rx;
+	union virtio_net_header *hdr;
 	struct io_buffer *iobuf;
 	size_t len;
 
@@ -447,8 +577,35 @@ static void virtio_net_poll_rx ( struct net_device *netdev ) {
 	while ( virtio_completions ( &queue->queue ) > 0 ) {
 
 		/* Complete I/O buffer */
-		iobuf = virtio_net_complete ( vnet, queue, &len );
+		iobuf = virtio_net_complete ( vnet, queue, &len, &hdr );
+
+		/* Strip packet header length (held separately) */
+		if ( len < vnet->hlen ) {
+			DBGC ( vnet, "VNET %s received truncated packet "
+			       "(len %#zx)\n", vnet->virtio.name, len );
+			netdev_rx_err ( netdev, iobuf, -EINVAL );
+			continue;
+		}
 		iob_put ( iobuf, ( len - vnet->hlen ) );
+
+		/* Complete any partial checksum and record checksum
+		 * status.  A packet originating within the host may
+		 * carry only a partial checksum, which must be
+		 * completed since the packet may be passed on intact
+		 * to another network stack.
+		 */
+		if ( hdr->common.flags & VIRTIO_NET_HDR_NEEDS_CSUM ) {
+			if ( tcpip_complete_chksum ( iobuf,
+				le16_to_cpu ( hdr->common.csum_start ),
+				le16_to_cpu ( hdr->common.csum_offset ) ) == 0){
+				iobuf->flags |= IOB_CSUM_VERIFIED;
+			} else {
+				DBGC ( vnet, "VNET %s received invalid partial "
+				       "checksum\n", vnet->virtio.name );
+			}
+		} else if ( hdr->common.flags & VIRTIO_NET_HDR_DATA_VALID ) {
+			iobuf->flags |= IOB_CSUM_VERIFIED;
+		}
 		netdev_rx ( netdev, iobuf );
 	}
 }
@@ -513,11 +670,10 @@ static int virtio_net_probe ( struct pci_device *pci ) {
 	virtio = &vnet->virtio;
 	virtio_net_queue_init ( &vnet->rx, vnet->rx_iobufs, vnet->rx_slots,
 				VIRTIO_NET_RX_INDEX, VIRTIO_NET_RX_COUNT,
-				VIRTIO_NET_RX_MAX, DMA_RX,
-				VIRTIO_DESC_FL_WRITE );
+				VIRTIO_NET_RX_MAX, VIRTIO_DESC_FL_WRITE );
 	virtio_net_queue_init ( &vnet->tx, vnet->tx_iobufs, vnet->tx_slots,
 				VIRTIO_NET_TX_INDEX, VIRTIO_NET_TX_COUNT,
-				VIRTIO_NET_TX_MAX, DMA_TX, 0 );
+				VIRTIO_NET_TX_MAX, 0 );
 
 	/* Map PCI device */
 	if ( ( rc = virtio_pci_map ( virtio, pci ) ) != 0 ) {
@@ -12,26 +12,74 @@ FILE_SECBOOT ( PERMITTED );
 
 #include <ipxe/virtio.h>
 
+/** Device handles packets with partial checksums */
+#define VIRTIO_FEAT0_NET_CSUM 0x00000001
+
+/** Driver handles packets with partial checksums */
+#define VIRTIO_FEAT0_NET_GUEST_CSUM 0x00000002
+
 /** Device has a reported MTU */
 #define VIRTIO_FEAT0_NET_MTU 0x00000008
 
 /** Device has a MAC address */
 #define VIRTIO_FEAT0_NET_MAC 0x00000020
 
+/** Device can segment TCPv4 packets */
+#define VIRTIO_FEAT0_NET_HOST_TSO4 0x00000800
+
+/** Device can segment TCPv6 packets */
+#define VIRTIO_FEAT0_NET_HOST_TSO6 0x00001000
+
 /** MAC address register offset */
 #define VIRTIO_NET_MAC 0x00
 
 /** MTU register offset */
 #define VIRTIO_NET_MTU 0x0a
 
+/** Fields common to all virtio network packet headers */
+struct virtio_net_common_header {
+	/** Flags */
+	uint8_t flags;
+	/** Segmentation offload type */
+	uint8_t gso_type;
+	/** Length of headers to be replicated in each segment */
+	uint16_t hdr_len;
+	/** Segment size */
+	uint16_t gso_size;
+	/** Offset from which to calculate checksum */
+	uint16_t csum_start;
+	/** Offset (from csum_start) at which to place checksum */
+	uint16_t csum_offset;
+} __attribute__ (( packed ));
+
 /** A virtio network packet header */
 union virtio_net_header {
+	/** Fields common to all interfaces */
+	struct virtio_net_common_header common;
 	/** Legacy interface */
 	uint8_t legacy[10];
 	/** Modern (version 1.0) interface */
 	uint8_t modern[12];
 } __attribute__ (( packed ));
 
+/** Packet has a partial checksum (and so originated within the host) */
+#define VIRTIO_NET_HDR_NEEDS_CSUM 0x01
+
+/** Packet checksum has been validated */
+#define VIRTIO_NET_HDR_DATA_VALID 0x02
+
+/** Packet does not require segmentation */
+#define VIRTIO_NET_HDR_GSO_NONE 0
+
+/** Packet requires TCPv4 segmentation */
+#define VIRTIO_NET_HDR_GSO_TCPV4 1
+
+/** Packet requires TCPv6 segmentation */
+#define VIRTIO_NET_HDR_GSO_TCPV6 4
+
+/** Packet header array alignment */
+#define VIRTIO_NET_HDRS_ALIGN 16
+
 /** Receive queue index */
 #define VIRTIO_NET_RX_INDEX 0
 
@@ -61,18 +109,15 @@ struct virtio_net_queue {
 	struct io_buffer **iobufs;
 	/** Descriptor slot ring */
 	uint8_t *slots;
+	/** Packet headers (one per descriptor slot) */
+	union virtio_net_header *hdrs;
+	/** DMA mapping for packet headers */
+	struct dma_mapping map;
 	/** Effective fill level */
 	unsigned int fill;
 	/** Descriptor index ring mask */
 	unsigned int mask;
 
-	/** Shared packet header */
-	union virtio_net_header hdr;
-	/** DMA mapping for packet header */
-	struct dma_mapping map;
-
-	/** DMA direction for packet header */
-	uint8_t dma;
 	/** Buffer writability flag for packet header */
 	uint8_t write;
 	/** Requested queue size */
@@ -88,7 +133,6 @@ struct virtio_net_queue {
  * @v index		Queue index
  * @v iobufs		I/O buffer list
  * @v slots		Descriptor slot ring
- * @v dma		DMA direction for packet header
  * @v write		Writability flag for packet header
  * @v count		Requested queue size
  * @v max		Maximum fill level
@@ -97,13 +141,11 @@ static inline __attribute__ (( always_inline )) void
 virtio_net_queue_init ( struct virtio_net_queue *queue,
 			struct io_buffer **iobufs, uint8_t *slots,
 			unsigned int index, unsigned int count,
-			unsigned int max, unsigned int dma,
-			unsigned int write ) {
+			unsigned int max, unsigned int write ) {
 
 	queue->queue.index = index;
 	queue->iobufs = iobufs;
 	queue->slots = slots;
-	queue->dma = dma;
 	queue->write = write;
 	queue->count = count;
 	queue->max = max;
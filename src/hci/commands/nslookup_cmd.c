@@ -24,11 +24,12 @@ FILE_SECBOOT ( PERMITTED );
 #include <getopt.h>
 #include <ipxe/command.h>
 #include <ipxe/parseopt.h>
+#include <ipxe/dns.h>
 #include <usr/nslookup.h>
 
 /** @file
  *
- * nslookup command
+ * nslookup and dnscache commands
  *
  */
 
@@ -73,5 +74,47 @@ static int nslookup_exec ( int argc, char **argv ) {
 	return 0;
 }
 
-/** The "nslookup" command */
+/** "dnscache" options */
+struct dnscache_options {
+	/** Flush cache */
+	int flush;
+};
+
+/** "dnscache" option list */
+static struct option_descriptor dnscache_opts[] = {
+	OPTION_DESC ( "flush", 'f', no_argument,
+		      struct dnscache_options, flush, parse_flag ),
+};
+
+/** "dnscache" command descriptor */
+static struct command_descriptor dnscache_cmd =
+	COMMAND_DESC ( struct dnscache_options, dnscache_opts, 0, 0, NULL );
+
+/**
+ * The "dnscache" command
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret rc		Return status code
+ */
+static int dnscache_exec ( int argc, char **argv ) {
+	struct dnscache_options opts;
+	int rc;
+
+	/* Parse options */
+	if ( ( rc = parse_options ( argc, argv, &dnscache_cmd, &opts ) ) != 0 )
+		return rc;
+
+	/* Flush or show cache */
+	if ( opts.flush ) {
+		dns_cache_flush();
+	} else {
+		dnscache();
+	}
+
+	return 0;
+}
+
+/** Name resolution commands */
 COMMAND ( nslookup, nslookup_exec );
+COMMAND ( dnscache, dnscache_exec );
@@ -66,5 +66,36 @@ static int profstat_exec ( int argc, char **argv ) {
 	return 0;
 }
 
+/** "profdump" options */
+struct profdump_options {};
+
+/** "profdump" option list */
+static struct option_descriptor profdump_opts[] = {};
+
+/** "profdump" command descriptor */
+static struct command_descriptor profdump_cmd =
+	COMMAND_DESC ( struct profdump_options, profdump_opts, 0, 0, NULL );
+
+/**
+ * The "profdump" command
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret rc		Return status code
+ */
+static int profdump_exec ( int argc, char **argv ) {
+	struct profdump_options opts;
+	int rc;
+
+	/* Parse options */
+	if ( ( rc = parse_options ( argc, argv, &profdump_cmd, &opts ) ) != 0 )
+		return rc;
+
+	profdump();
+
+	return 0;
+}
+
 /** Profiling commands */
 COMMAND ( profstat, profstat_exec );
+COMMAND ( profdump, profdump_exec );
@@ -25,14 +25,24 @@ FILE_LICENCE(GPL2_OR_LATER);
 #include <ipxe/linux.h>
 #include <ipxe/malloc.h>
 #include <ipxe/init.h>
+#include <usr/heapstat.h>
+#include <usr/profstat.h>
 
 int linux_argc;
 char **linux_argv;
 
+/** Dump heap statistics on exit */
+static int heapstat_on_exit;
+
+/** Dump profiling histograms and trace on exit */
+static int profdump_on_exit;
+
 /** Supported command-line options */
 static struct option options[] = {
 	{"net", 1, NULL, 'n'},
 	{"settings", 1, NULL, 's'},
+	{"heapstat", 0, NULL, 'h'},
+	{"profdump", 0, NULL, 'p'},
 	{NULL, 0, NULL, 0}
 };
 
@@ -137,6 +147,12 @@ void linux_args_parse()
 			if ((rc = parse_settings_args(optarg)) != 0)
 				return;
 			break;
+		case 'h':
+			heapstat_on_exit = 1;
+			break;
+		case 'p':
+			profdump_on_exit = 1;
+			break;
 		default:
 			return;
 		}
@@ -145,7 +161,7 @@ void linux_args_parse()
 	return;
 }
 
-/** Clean up requests and settings */
+/** Clean up requests and settings, and dump statistics if requested */
 void linux_args_cleanup(int flags __unused)
 {
 	struct linux_device_request *request;
@@ -168,6 +184,14 @@ void linux_args_cleanup(int flags __unused)
 		list_del(&setting->list);
 		free(setting);
 	}
+
+	/* Dump heap statistics, if requested */
+	if (heapstat_on_exit)
+		heapstat();
+
+	/* Dump profiling histograms and trace, if requested */
+	if (profdump_on_exit)
+		profdump();
 }
 
 struct startup_fn startup_linux_args __startup_fn(STARTUP_EARLY) = {
@@ -0,0 +1,36 @@
+#ifndef _IPXE_BENCH_H
+#define _IPXE_BENCH_H
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * Benchmark infrastructure
+ *
+ */
+
+#include <stddef.h>
+#include <ipxe/tables.h>
+#include <ipxe/profile.h>
+
+/** A benchmark set */
+struct benchmark {
+	/** Benchmark set name */
+	const char *name;
+	/** Run benchmarks */
+	void ( * exec ) ( void );
+};
+
+/** Benchmark table */
+#define BENCHMARKS __table ( struct benchmark, "benchmarks" )
+
+/** Declare a benchmark */
+#define __benchmark __table_entry ( BENCHMARKS, 01 )
+
+/** Number of iterations for each benchmark */
+#define BENCH_COUNT 256
+
+extern void bench_report ( const char *name, struct profiler *profiler,
+			   size_t len );
+
+#endif /* _IPXE_BENCH_H */
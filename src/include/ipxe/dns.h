@@ -78,9 +78,32 @@ struct dns_header {
 	uint16_t arcount;
 } __attribute__ (( packed ));
 
+/** Response flag */
+#define DNS_FLAG_QR 0x8000
+
 /** Recursion desired flag */
 #define DNS_FLAG_RD 0x0100
 
+/** Recursion available flag */
+#define DNS_FLAG_RA 0x0080
+
+/** Response code mask */
+#define DNS_FLAG_RCODE_MASK 0x000f
+
+/**
+ * Extract response code
+ *
+ * @v flags		Flags (in host byte order)
+ * @ret rcode		Response code
+ */
+#define DNS_FLAG_RCODE( flags ) ( (flags) & DNS_FLAG_RCODE_MASK )
+
+/** Response code "no error" */
+#define DNS_RCODE_NOERROR 0
+
+/** Response code "name error" (i.e. nonexistent domain) */
+#define DNS_RCODE_NXDOMAIN 3
+
 /** A DNS question */
 struct dns_question {
 	/** Query type */
@@ -135,6 +158,26 @@ struct dns_rr_cname {
 	struct dns_rr_common common;
 } __attribute__ (( packed ));
 
+/** Type of a DNS "SOA" record */
+#define DNS_TYPE_SOA 6
+
+/** Fixed-length portion of a DNS "SOA" record
+ *
+ * This follows the variable-length MNAME and RNAME fields.
+ */
+struct dns_soa {
+	/** Serial number */
+	uint32_t serial;
+	/** Refresh interval */
+	uint32_t refresh;
+	/** Retry interval */
+	uint32_t retry;
+	/** Expiry limit */
+	uint32_t expire;
+	/** Minimum time to live (used for negative caching) */
+	uint32_t minimum;
+} __attribute__ (( packed ));
+
 /** A DNS resource record */
 union dns_rr {
 	/** Common fields */
@@ -147,10 +190,37 @@ union dns_rr {
 	struct dns_rr_cname cname;
 };
 
+/** Maximum number of entries in the DNS cache
+ *
+ * This is a policy decision.
+ */
+#define DNS_CACHE_MAX 32
+
+/** Maximum time to live for a DNS cache entry (in seconds)
+ *
+ * This is a policy decision.
+ */
+#define DNS_CACHE_MAX_TTL 86400
+
+/** DNS cache entry information */
+struct dns_cache_info {
+	/** Name */
+	char name[ DNS_MAX_NAME_LEN + 1 /* NUL */ ];
+	/** Record type */
+	const char *type;
+	/** Record value */
+	char value[ DNS_MAX_NAME_LEN + 1 /* NUL */ ];
+	/** Remaining time to live (in seconds) */
+	unsigned long ttl;
+};
+
 extern int dns_encode ( const char *string, struct dns_name *name );
 extern int dns_decode ( struct dns_name *name, char *data, size_t len );
 extern int dns_compare ( struct dns_name *first, struct dns_name *second );
 extern int dns_copy ( struct dns_name *src, struct dns_name *dst );
 extern int dns_skip ( struct dns_name *name );
+extern int dns_cache_info ( unsigned int index, struct dns_cache_info *info );
+extern void dns_cache_flush ( void );
+extern void dns_cache_age ( unsigned long ticks );
 
 #endif /* _IPXE_DNS_H */
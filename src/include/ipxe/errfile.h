@@ -94,6 +94,7 @@ FILE_SECBOOT ( PERMITTED );
 #define ERRFILE_efi_disklog	       ( ERRFILE_CORE | 0x00350000 )
 #define ERRFILE_datauri		       ( ERRFILE_CORE | 0x00360000 )
 #define ERRFILE_dmesg		       ( ERRFILE_CORE | 0x00370000 )
+#define ERRFILE_benchmark	       ( ERRFILE_CORE | 0x00380000 )
 
 #define ERRFILE_eisa		     ( ERRFILE_DRIVER | 0x00000000 )
 #define ERRFILE_isa		     ( ERRFILE_DRIVER | 0x00010000 )
@@ -327,6 +328,7 @@ FILE_SECBOOT ( PERMITTED );
 #define ERRFILE_eap_md5			( ERRFILE_NET | 0x004d0000 )
 #define ERRFILE_eap_mschapv2		( ERRFILE_NET | 0x004e0000 )
 #define ERRFILE_syslogs			( ERRFILE_NET | 0x004f0000 )
+#define ERRFILE_fragment		( ERRFILE_NET | 0x00500000 )
 
 #define ERRFILE_image		      ( ERRFILE_IMAGE | 0x00000000 )
 #define ERRFILE_elf		      ( ERRFILE_IMAGE | 0x00010000 )
@@ -455,6 +457,7 @@ FILE_SECBOOT ( PERMITTED );
 #define ERRFILE_crypto_null	      ( ERRFILE_OTHER | 0x006a0000 )
 #define ERRFILE_ffdhe		      ( ERRFILE_OTHER | 0x006b0000 )
 #define ERRFILE_cbc		      ( ERRFILE_OTHER | 0x006c0000 )
+#define ERRFILE_netem		      ( ERRFILE_OTHER | 0x006d0000 )
 
 /** @} */
 
@@ -18,14 +18,52 @@ FILE_SECBOOT ( PERMITTED );
 /** Fragment reassembly timeout */
 #define FRAGMENT_TIMEOUT ( TICKS_PER_SEC / 2 )
 
+/** Maximum length of reassembled payload */
+#define FRAGMENT_MAX_LEN 65535
+
+/** Maximum number of discontiguous received ranges
+ *
+ * A fragment that would create an additional hole in a reassembly
+ * buffer already holding this many ranges is dropped.
+ */
+#define FRAGMENT_MAX_RANGES 8
+
+/** Maximum number of concurrent reassembly buffers per reassembler
+ *
+ * The oldest reassembly buffer is discarded when this limit is
+ * reached, in order to bound memory usage.
+ */
+#define FRAGMENT_MAX_BUFFERS 4
+
+/** A received range of a fragmented packet */
+struct fragment_range {
+	/** Start offset */
+	size_t start;
+	/** End offset */
+	size_t end;
+};
+
 /** A fragment reassembly buffer */
 struct fragment {
 	/* List of fragment reassembly buffers */
 	struct list_head list;
-	/** Reassembled packet */
+	/** Reassembled packet
+	 *
+	 * This comprises the non-fragmentable portion followed by the
+	 * payload, extending as far as the end of the highest
+	 * received fragment.  Payload within any holes is undefined.
+	 */
 	struct io_buffer *iobuf;
 	/** Length of non-fragmentable portion of reassembled packet */
 	size_t hdrlen;
+	/** Received payload ranges (in ascending order) */
+	struct fragment_range ranges[FRAGMENT_MAX_RANGES];
+	/** Number of received payload ranges */
+	unsigned int count;
+	/** Final fragment has been received */
+	int final;
+	/** Total payload length (valid only once final fragment received) */
+	size_t len;
 	/** Reassembly timer */
 	struct retry_timer timer;
 	/** Fragment reassembler */
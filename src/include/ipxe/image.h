@@ -218,6 +218,7 @@ extern int image_set_uri ( struct image *image, struct uri *uri );
 extern int image_set_name ( struct image *image, const char *name );
 extern char * image_strip_suffix ( struct image *image );
 extern int image_set_cmdline ( struct image *image, const char *cmdline );
+extern int image_set_size ( struct image *image, size_t len, size_t size );
 extern int image_set_len ( struct image *image, size_t len );
 extern int image_set_data ( struct image *image, const void *data,
 			    size_t len );
@@ -115,8 +115,30 @@ struct io_buffer {
 	void *tail;
 	/** End of the buffer */
         void *end;
+
+	/** Flags */
+	unsigned int flags;
+	/** Segment size for TCP segmentation offload, or zero
+	 *
+	 * A transmitted TCP packet with a non-zero segment size may
+	 * carry more payload than fits within a single segment.  It
+	 * will be split into segments of this size (excluding
+	 * headers) by the network device, or in software if the
+	 * network device does not support segmentation offload.
+	 */
+	size_t mss;
 };
 
+/** Transport-layer checksum has been verified by hardware
+ *
+ * This may be set by a network device driver on a received packet
+ * to indicate that the TCP or UDP checksum has already been verified
+ * (or that the packet originated within the host and so carries no
+ * valid checksum), allowing the transport layer to omit its own
+ * verification.
+ */
+#define IOB_CSUM_VERIFIED 0x0001
+
 /**
  * Reserve space at start of I/O buffer
  *
@@ -257,6 +279,8 @@ static inline void iob_populate ( struct io_buffer *iobuf,
 	iobuf->head = iobuf->data = data;
 	iobuf->tail = ( data + len );
 	iobuf->end = ( data + max_len );
+	iobuf->flags = 0;
+	iobuf->mss = 0;
 }
 
 /**
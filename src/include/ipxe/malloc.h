@@ -41,10 +41,49 @@ FILE_SECBOOT ( PERMITTED );
  */
 #define NOWHERE ( ( void * ) ~( ( intptr_t ) 0 ) )
 
-/** A heap */
+struct memory_link;
+
+/** Number of size bins per power of two (log2) */
+#define HEAP_BIN_SUBDIVISIONS_LOG2 2
+
+/** Number of size bins per power of two */
+#define HEAP_BIN_SUBDIVISIONS ( 1 << HEAP_BIN_SUBDIVISIONS_LOG2 )
+
+/** Number of size bins */
+#define HEAP_BINS ( ( 8 * sizeof ( size_t ) ) << HEAP_BIN_SUBDIVISIONS_LOG2 )
+
+/** Number of free block address hash buckets (log2) */
+#define HEAP_HASH_LOG2 8
+
+/** Number of free block address hash buckets */
+#define HEAP_HASH_SIZE ( 1 << HEAP_HASH_LOG2 )
+
+/** Number of allocation size classes
+ *
+ * Allocations are classified for statistical purposes by the
+ * power-of-two size range within which the underlying block falls.
+ */
+#define HEAP_CLASSES ( 8 * sizeof ( size_t ) )
+
+/** A heap
+ *
+ * Free memory blocks are held in segregated lists indexed by size
+ * bin, with a bitmap of non-empty bins, so that a suitable block can
+ * be found in constant time.  Free blocks are additionally hashed by
+ * their start and end addresses, so that a freed block can be merged
+ * with its neighbours in constant time.
+ */
 struct heap {
-	/** List of free memory blocks */
-	struct list_head blocks;
+	/** Free memory blocks, indexed by size bin */
+	struct memory_link *bins[HEAP_BINS];
+	/** Bitmap of non-empty size bins */
+	unsigned long binmap[ HEAP_BINS / ( 8 * sizeof ( unsigned long ) ) ];
+	/** Free memory blocks, hashed by start address */
+	struct memory_link *starts[HEAP_HASH_SIZE];
+	/** Free memory blocks, hashed by end address */
+	struct memory_link *ends[HEAP_HASH_SIZE];
+	/** Number of free memory blocks */
+	unsigned int freeblocks;
 
 	/** Alignment for free memory blocks */
 	size_t align;
@@ -57,6 +96,12 @@ struct heap {
 	size_t usedmem;
 	/** Maximum amount of used memory */
 	size_t maxusedmem;
+	/** Number of failed allocations */
+	unsigned long failures;
+	/** Number of allocations made, indexed by size class */
+	unsigned long allocs[HEAP_CLASSES];
+	/** Number of allocations in use, indexed by size class */
+	unsigned long inuse[HEAP_CLASSES];
 
 	/**
 	 * Attempt to grow heap (optional)
@@ -72,15 +117,31 @@ struct heap {
 	 * @v size		Size of free block
 	 * @ret shrunk		Heap has shrunk: discard block
 	 *
-	 * Note that the discarded block will be accessed once after
-	 * this method returns, in order to clear the free block
-	 * metadata.
+	 * The discarded block will not be accessed by the heap after
+	 * this method returns, and so may be released immediately.
 	 */
 	unsigned int ( * shrink ) ( void *ptr, size_t size );
 };
 
+/** A heap allocation site */
+struct heap_site {
+	/** Calling address, or NULL if unused */
+	void *caller;
+	/** Number of allocations made */
+	unsigned long allocs;
+	/** Total size of allocations made */
+	unsigned long size;
+	/** Number of failed allocations */
+	unsigned long failures;
+};
+
+extern struct heap * const malloc_heap;
+extern struct heap_site heap_sites[];
+extern const unsigned int heap_num_sites;
+
 extern void * heap_realloc ( struct heap *heap, void *old_ptr,
 			     size_t new_size );
+extern size_t heap_largest ( struct heap *heap );
 extern void heap_dump ( struct heap *heap );
 extern void heap_populate ( struct heap *heap, void *start, size_t len );
 
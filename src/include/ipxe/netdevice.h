@@ -93,6 +93,22 @@ struct net_protocol {
 	 * allocated.
 	 */
 	const char * ( *ntoa ) ( const void * net_addr );
+	/**
+	 * Segment packet for transmission
+	 *
+	 * @v iobuf		I/O buffer (starting at network-layer header)
+	 * @v segments		List of segments to fill in
+	 * @ret rc		Return status code
+	 *
+	 * This method is required only by network-layer protocols
+	 * which may transmit packets using TCP segmentation offload.
+	 * It must split the packet into segments of at most @c
+	 * iobuf->mss bytes of payload, each with complete headers and
+	 * checksums.  The original I/O buffer is left unmodified and
+	 * remains owned by the caller.
+	 */
+	int ( * segment ) ( struct io_buffer *iobuf,
+			    struct list_head *segments );
 	/** Network-layer protocol
 	 *
 	 * This is an ETH_P_XXX constant, in network-byte order
@@ -464,6 +480,21 @@ struct net_device {
 /** Network device should be opened automatically */
 #define NETDEV_AUTO_OPEN 0x0080
 
+/** Network device verifies received transport-layer checksums
+ *
+ * This flag can be used by a network device to indicate that it may
+ * mark received packets with @c IOB_CSUM_VERIFIED.
+ */
+#define NETDEV_RX_CSUM 0x0100
+
+/** Network device supports TCP segmentation offload
+ *
+ * This flag can be used by a network device to indicate that it can
+ * accept transmitted packets with a non-zero @c mss.  Such packets
+ * carry a partial TCP checksum covering only the pseudo-header.
+ */
+#define NETDEV_TX_TSO 0x0200
+
 /** Link-layer protocol table */
 #define LL_PROTOCOLS __table ( struct ll_protocol, "ll_protocols" )
 
@@ -744,6 +775,9 @@ extern struct net_device * find_netdev_by_scope_id ( unsigned int scope_id );
 extern struct net_device * find_netdev_by_location ( unsigned int bus_type,
 						     unsigned int location );
 extern struct net_device * last_opened_netdev ( void );
+extern int net_segment ( struct io_buffer *iobuf,
+			 struct net_protocol *net_protocol,
+			 struct list_head *segments );
 extern int net_tx ( struct io_buffer *iobuf, struct net_device *netdev,
 		    struct net_protocol *net_protocol, const void *ll_dest,
 		    const void *ll_source );
@@ -42,6 +42,21 @@ enum {
 	 * struct sockaddr *local;
 	 */
 	LOCATION_SOCKET,
+	/** Location is an established socket connection
+	 *
+	 * Parameter list for open() is:
+	 *
+	 * int semantics;
+	 * struct sockaddr *peer;
+	 * struct sockaddr *local;
+	 * struct interface *socket;
+	 *
+	 * The leading parameters are as for LOCATION_SOCKET, and
+	 * describe the connection already open on the (unplugged)
+	 * socket interface.  Opening this location attaches to the
+	 * existing connection rather than opening a new connection.
+	 */
+	LOCATION_CONNECTED,
 };
 
 /** A URI opener */
@@ -26,6 +26,8 @@ struct process {
 	 * this field may be NULL.
 	 */
 	struct refcnt *refcnt;
+	/** Process is sleeping (i.e. has no pending work) */
+	int sleeping;
 };
 
 /** A process descriptor */
@@ -121,6 +123,9 @@ extern void * __attribute__ (( pure ))
 process_object ( struct process *process );
 extern void process_add ( struct process *process );
 extern void process_del ( struct process *process );
+extern void process_sleep ( struct process *process );
+extern void process_wake ( struct process *process );
+extern int process_pending ( void );
 extern void step ( void );
 
 /**
@@ -149,6 +154,7 @@ process_init_stopped ( struct process *process,
 	INIT_LIST_HEAD ( &process->list );
 	process->desc = desc;
 	process->refcnt = refcnt;
+	process->sleeping = 0;
 }
 
 /**
@@ -21,6 +21,9 @@ FILE_SECBOOT ( PERMITTED );
 #endif
 #endif
 
+/** Number of profiler histogram buckets */
+#define PROFILE_BUCKETS 32
+
 /**
  * A data structure for storing profiling information
  */
@@ -49,8 +52,55 @@ struct profiler {
 	 * (i.e. one less than would be returned by flsll(raw_accvar)).
 	 */
 	unsigned int accvar_msb;
+	/** Histogram of sample values, or NULL
+	 *
+	 * Bucket N counts the samples for which flsl(sample)==N
+	 * (i.e. samples in the range [2^(N-1),2^N), with bucket zero
+	 * counting zero-valued samples).  The final bucket also
+	 * counts all larger samples.
+	 *
+	 * Histograms are optional, and are maintained only for
+	 * profilers defined with PROFILE_HISTOGRAM.
+	 */
+	unsigned int *hist;
 };
 
+/**
+ * Define histogram storage for a profiler
+ *
+ * Use as e.g.
+ *
+ * @code
+ *
+ *   static struct profiler my_profiler __profiler =
+ *	{ .name = "my", .hist = PROFILE_HISTOGRAM };
+ *
+ * @endcode
+ */
+#if PROFILING
+#define PROFILE_HISTOGRAM ( ( unsigned int [PROFILE_BUCKETS] ) { 0 } )
+#else
+#define PROFILE_HISTOGRAM NULL
+#endif
+
+/** A profiling trace event */
+struct profile_event {
+	/** Profiler */
+	struct profiler *profiler;
+	/** Stop timestamp */
+	unsigned long stopped;
+	/** Elapsed time */
+	unsigned long elapsed;
+};
+
+/** Number of events held in profiling trace ring
+ *
+ * Must be a power of two.  The trace ring is linked in only if at
+ * least one object is built with profiling enabled (or if the trace
+ * is dumped).
+ */
+#define PROFILE_TRACE_SIZE 256
+
 /** Profiler table */
 #define PROFILERS __table ( struct profiler, "profilers" )
 
@@ -64,11 +114,16 @@ struct profiler {
 unsigned long profile_timestamp ( void );
 
 extern unsigned long profile_excluded;
+extern struct profile_event profile_trace_ring[PROFILE_TRACE_SIZE];
+extern unsigned long profile_trace_prod;
 
 extern void profile_update ( struct profiler *profiler, unsigned long sample );
 extern unsigned long profile_mean ( struct profiler *profiler );
 extern unsigned long profile_variance ( struct profiler *profiler );
 extern unsigned long profile_stddev ( struct profiler *profiler );
+extern unsigned long profile_quantile ( struct profiler *profiler,
+					unsigned int percent );
+extern void profile_trace ( struct profiler *profiler );
 
 /**
  * Get start time
@@ -149,6 +204,7 @@ profile_stop_at ( struct profiler *profiler, unsigned long stopped ) {
 	if ( PROFILING ) {
 		profiler->stopped = ( stopped - profile_excluded );
 		profile_update ( profiler, profile_elapsed ( profiler ) );
+		profile_trace ( profiler );
 	}
 }
 
@@ -42,6 +42,22 @@ struct resolver {
 /** Register as a name resolver */
 #define __resolver( resolv_order ) __table_entry ( RESOLVERS, resolv_order )
 
+/** Resolution delay
+ *
+ * This is the time for which to wait for resolution of a more
+ * preferred address family before connecting to an already resolved
+ * address of a less preferred family, as recommended by RFC 8305.
+ */
+#define NAMED_RESOLUTION_DELAY ( 50 * TICKS_PER_SEC / 1000 )
+
+/** Connection attempt delay
+ *
+ * This is the time for which to wait for an in-progress connection
+ * attempt to complete before starting the next connection attempt,
+ * as recommended by RFC 8305.
+ */
+#define NAMED_CONNECTION_DELAY ( 250 * TICKS_PER_SEC / 1000 )
+
 extern void resolv_done ( struct interface *intf, struct sockaddr *sa );
 #define resolv_done_TYPE( object_type ) \
 	typeof ( void ( object_type, struct sockaddr *sa ) )
@@ -18,9 +18,12 @@ FILE_SECBOOT ( PERMITTED );
 /** Default maximum timeout value (in ticks) */
 #define DEFAULT_MAX_TIMEOUT ( 10 * TICKS_PER_SEC )
 
+/** Time remaining until next expiry when no timers are running */
+#define RETRY_NEVER ( ~0UL )
+
 /** A retry timer */
 struct retry_timer {
-	/** List of active timers */
+	/** Timer wheel slot list */
 	struct list_head list;
 	/** Timer is currently running */
 	unsigned int running;
@@ -89,6 +92,7 @@ extern void start_timer_fixed ( struct retry_timer *timer,
 				unsigned long timeout );
 extern void stop_timer ( struct retry_timer *timer );
 extern void retry_poll ( void );
+extern unsigned long retry_remaining ( void );
 
 /**
  * Start timer with no delay
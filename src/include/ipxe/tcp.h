@@ -141,12 +141,16 @@ struct tcp_timestamp_padded_option {
 
 /** Parsed TCP options */
 struct tcp_options {
+	/** MSS option, if present */
+	const struct tcp_mss_option *mssopt;
 	/** Window scale option, if present */
 	const struct tcp_window_scale_option *wsopt;
 	/** SACK permitted option, if present */
 	const struct tcp_sack_permitted_option *spopt;
 	/** Timestamp option, if present */
 	const struct tcp_timestamp_option *tsopt;
+	/** Selective acknowledgement option, if present */
+	const struct tcp_sack_option *sackopt;
 };
 
 /** @} */
@@ -352,32 +356,175 @@ struct tcp_options {
  *    e) Intercontinental WAN: expected bandwidth 5MB/s, typical RTT
  *       250ms, minimum required window 1280kB.
  *
+ *    f) 100-Gigabit LAN: expected bandwidth 12500MB/s, typical RTT
+ *       2ms, minimum required window 25MB
+ *
  * The maximum possible value for the TCP window size is 1GB (using
  * the maximum window scale of 2**14).  However, it is advisable to
  * keep the window size as small as possible (without limiting
  * bandwidth), since in the event of a lost packet the window size
  * represents the maximum amount that will need to be retransmitted.
  *
- * We therefore choose a (rounded up) maximum window size of 2048kB.
+ * The advertised window for each connection is therefore tuned
+ * according to the measured bandwidth-delay product, starting from
+ * TCP_INITIAL_WINDOW_SIZE and growing up to a maximum of 32MB (the
+ * largest window representable using our advertised window scale).
+ */
+#define TCP_MAX_WINDOW_SIZE	( 32 * 1024 * 1024 )
+
+/**
+ * Initial advertised TCP window size
+ *
+ * This is sufficient for a Gigabit LAN without requiring any window
+ * tuning.
+ */
+#define TCP_INITIAL_WINDOW_SIZE	( 256 * 1024 )
+
+/**
+ * Minimum advertised TCP window size
+ *
+ * The advertised window will be reduced in response to memory
+ * pressure, but never below this size.
  */
-#define TCP_MAX_WINDOW_SIZE	( 2048 * 1024 )
+#define TCP_MIN_WINDOW_SIZE	( 64 * 1024 )
 
 /**
- * Path MTU
+ * TCP window recovery time
+ *
+ * Once memory pressure has eased, the maximum receive window limit
+ * is allowed to double at most once in each interval of this length,
+ * and only while the limit is constraining the sender.
+ */
+#define TCP_WINDOW_RECOVERY_TIME ( 1 * TICKS_PER_SEC )
+
+/**
+ * Base maximum segment size
  *
  * IPv6 requires all data link layers to support a datagram size of
- * 1280 bytes.  We choose to use this as our maximum transmitted
- * datagram size, on the assumption that any practical link layer we
- * encounter will allow this size.  This is a very conservative
- * assumption in practice, but the impact of making such a
- * conservative assumption is insignificant since the amount of data
- * that we transmit (rather than receive) is negligible.
+ * 1280 bytes.  We use this as our initial path MTU, on the assumption
+ * that any practical path will allow this size, and use
+ * packetization layer path MTU discovery (RFC 4821) to probe for
+ * larger sizes up to the MTU of the local link.
+ *
+ * We allow space within this 1280 bytes for an IPv6 header and a TCP
+ * header.  Space for any TCP options is deducted from the maximum
+ * segment size when each segment is constructed.
+ */
+#define TCP_BASE_MSS ( 1280 - 40 /* IPv6 */ - 20 /* TCP */ )
+
+/**
+ * Default maximum segment size
+ *
+ * This is the maximum segment size assumed for a peer that does not
+ * advertise an MSS, as per RFC 1122.
+ */
+#define TCP_DEFAULT_MSS 536
+
+/**
+ * Minimum path MTU probe increment
+ *
+ * Path MTU discovery stops once the range of maximum segment sizes
+ * remaining to be searched is smaller than this.
+ */
+#define TCP_PROBE_MIN 64
+
+/**
+ * Maximum amount of data held in the transmit queue
+ *
+ * Data remains in the transmit queue until it has been acknowledged,
+ * and so this limits the amount of data that may be in flight.
+ * 256kB allows for a 100Mbps upload with a 20ms RTT, while remaining
+ * a small fraction of the heap.
+ */
+#define TCP_MAX_TX_QUEUE ( 256 * 1024 )
+
+/**
+ * Maximum data payload for TCP segmentation offload
+ *
+ * This allows for IPv6 and TCP headers (including options) within
+ * the 64kB maximum length of an IP packet.
+ */
+#define TCP_TSO_MAX_LEN ( 65535 - 40 /* IPv6 */ - 60 /* TCP */ )
+
+/**
+ * Maximum number of out-of-order received sequence ranges
+ *
+ * Each range is a run of contiguous data received beyond RCV.NXT.
+ * Out-of-order segments that would create further ranges are
+ * discarded, which bounds the cost of maintaining the receive queue.
+ */
+#define TCP_RX_RANGES_MAX 16
+
+/**
+ * Maximum number of received segments per acknowledgement
  *
- * We allow space within this 1280 bytes for an IPv6 header, a TCP
- * header, and a (padded) TCP timestamp option.
+ * An acknowledgement will be sent at the end of each poll of the
+ * network stack, or sooner if this many data segments have been
+ * received without being acknowledged.
  */
-#define TCP_PATH_MTU							\
-	( 1280 - 40 /* IPv6 */ - 20 /* TCP */ - 12 /* TCP timestamp */ )
+#define TCP_ACK_SEGMENTS_MAX 8
+
+/**
+ * Delayed acknowledgement timeout
+ *
+ * A lone data segment that does not request an immediate push will
+ * be acknowledged after this delay, unless a further segment arrives
+ * first.  RFC 1122 requires this to be less than 0.5 seconds.
+ */
+#define TCP_DELAYED_ACK_TIMEOUT ( TICKS_PER_SEC / 25 )
+
+/**
+ * Duplicate acknowledgement threshold
+ *
+ * This is the number of duplicate acknowledgements that will trigger
+ * a fast retransmission, as per RFC 5681.
+ */
+#define TCP_DUPACK_THRESHOLD 3
+
+/**
+ * Calculate initial congestion window
+ *
+ * @v mss		Sender maximum segment size
+ * @ret cwnd		Initial congestion window
+ *
+ * This is the initial window as defined in RFC 3390.
+ */
+static inline __attribute__ (( always_inline )) size_t
+tcp_initial_cwnd ( size_t mss ) {
+	size_t cwnd = ( 2 * mss );
+
+	if ( cwnd < 4380 )
+		cwnd = 4380;
+	if ( cwnd > ( 4 * mss ) )
+		cwnd = ( 4 * mss );
+	return cwnd;
+}
+
+/**
+ * Initial TCP retransmission timeout
+ *
+ * This is the value used before any round-trip time has been
+ * measured, as per RFC 6298.
+ */
+#define TCP_INITIAL_RTO ( 1 * TICKS_PER_SEC )
+
+/**
+ * Minimum TCP retransmission timeout
+ *
+ * RFC 6298 recommends a minimum of one second, but permits a lower
+ * value.  We use the 200ms minimum that is widely deployed in
+ * practice, so that losses on low-latency links are recovered
+ * promptly.
+ */
+#define TCP_MIN_RTO ( TICKS_PER_SEC / 5 )
+
+/**
+ * Maximum TCP retransmission timeout
+ *
+ * This leaves room for at least one backoff before the retry timer
+ * deems the failure to be permanent.
+ */
+#define TCP_MAX_RTO ( 4 * TICKS_PER_SEC )
 
 /** TCP maximum segment lifetime
  *
@@ -455,8 +602,54 @@ struct tcp_statistics {
 	unsigned long in_octets_good;
 };
 
+/** TCP connection information */
+struct tcp_info {
+	/** Remote socket address */
+	struct sockaddr_tcpip peer;
+	/** Local port */
+	unsigned int local_port;
+	/** Name of current TCP state */
+	const char *state;
+	/** Send window */
+	uint32_t snd_win;
+	/** Send window scale */
+	unsigned int snd_win_scale;
+	/** Congestion window */
+	uint32_t cwnd;
+	/** Receive window */
+	uint32_t rcv_win;
+	/** Receive window scale */
+	unsigned int rcv_win_scale;
+	/** Receive window limit */
+	uint32_t rcv_space;
+	/** Maximum receive window limit */
+	uint32_t rcv_space_max;
+	/** Selective acknowledgements are enabled */
+	int sack;
+	/** Timestamps are enabled */
+	int ts;
+	/** Transmit maximum segment size */
+	size_t snd_mss;
+	/** Smoothed round-trip time (in ms) */
+	unsigned long srtt;
+	/** Retransmission timeout (in ms) */
+	unsigned long rto;
+	/** Number of retransmissions */
+	unsigned long retransmits;
+	/** Number of octets received and passed to upper layer */
+	unsigned long in_octets;
+	/** Number of octets sent and acknowledged by peer */
+	unsigned long out_octets;
+	/** Number of out-of-order packets held in receive queue */
+	unsigned int rx_queued;
+	/** Time since connection was opened (in ticks) */
+	unsigned long age;
+};
+
 extern struct tcpip_protocol tcp_protocol __tcpip_protocol;
 
 extern struct tcp_statistics tcp_stats;
 
+extern int tcp_info ( unsigned int index, struct tcp_info *info );
+
 #endif /* _IPXE_TCP_H */
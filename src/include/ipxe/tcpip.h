@@ -17,12 +17,15 @@ FILE_SECBOOT ( PERMITTED );
 
 extern uint16_t generic_tcpip_continue_chksum ( uint16_t partial,
 						const void *data, size_t len );
+extern uint16_t generic_tcpip_copy_chksum ( uint16_t partial, void *dest,
+					    const void *src, size_t len );
 
 #include <bits/tcpip.h>
 
 struct io_buffer;
 struct net_device;
 struct ip_statistics;
+struct list_head;
 
 /** Positive zero checksum value */
 #define TCPIP_POSITIVE_ZERO_CSUM 0x0000
@@ -127,6 +130,8 @@ struct tcpip_protocol {
 	 * zero (0xffff).
 	 */
 	uint16_t zero_csum;
+	/** Transmitted datagrams must not be fragmented in transit */
+	int dontfrag;
         /** 
 	 * Transport-layer protocol number
 	 *
@@ -188,6 +193,29 @@ struct tcpip_net_protocol {
 /** Declare a TCP/IP network-layer protocol */
 #define __tcpip_net_protocol __table_entry ( TCPIP_NET_PROTOCOLS, 01 )
 
+/** Number of hash buckets for connections indexed by local port
+ *
+ * Must be a power of two.
+ */
+#define TCPIP_PORT_HASH_SIZE 64
+
+/**
+ * Calculate hash bucket for local port
+ *
+ * @v port		Local port (in host-endian order)
+ * @ret bucket		Hash bucket index
+ */
+static inline __attribute__ (( always_inline )) unsigned int
+tcpip_port_hash ( unsigned int port ) {
+
+	/* Fold high-order bits, since explicitly bound ports tend to
+	 * differ only in their low-order bits and randomly allocated
+	 * ports may differ in any bits.
+	 */
+	return ( ( port ^ ( port >> 6 ) ^ ( port >> 12 ) ) &
+		 ( TCPIP_PORT_HASH_SIZE - 1 ) );
+}
+
 extern int tcpip_rx ( struct io_buffer *iobuf, struct net_device *netdev,
 		      uint8_t tcpip_proto, struct sockaddr_tcpip *st_src,
 		      struct sockaddr_tcpip *st_dest, uint16_t pshdr_csum,
@@ -200,7 +228,11 @@ extern int tcpip_tx ( struct io_buffer *iobuf, struct tcpip_protocol *tcpip,
 extern struct tcpip_net_protocol * tcpip_net_protocol ( sa_family_t sa_family );
 extern struct net_device * tcpip_netdev ( struct sockaddr_tcpip *st_dest );
 extern size_t tcpip_mtu ( struct sockaddr_tcpip *st_dest );
+extern int tcpip_segment ( struct io_buffer *iobuf, size_t hdrlen,
+			   struct list_head *segments );
 extern uint16_t tcpip_chksum ( const void *data, size_t len );
+extern int tcpip_complete_chksum ( struct io_buffer *iobuf, size_t start,
+				   size_t offset );
 extern int tcpip_bind ( struct sockaddr_tcpip *st_local,
 			int ( * available ) ( int port ) );
 
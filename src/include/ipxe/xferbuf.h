@@ -23,6 +23,12 @@ struct xfer_buffer {
 	void *data;
 	/** Size of data */
 	size_t len;
+	/** Allocated size of data
+	 *
+	 * Automatically resized buffers are grown geometrically, and
+	 * so may have an allocated size exceeding the size of data.
+	 */
+	size_t size;
 	/** Maximum required size of data */
 	size_t max;
 	/** Current offset within data */
@@ -36,10 +42,18 @@ struct xfer_buffer_operations {
 	/** Reallocate data buffer
 	 *
 	 * @v xferbuf		Data transfer buffer
-	 * @v len		New length (or zero to free buffer)
+	 * @v len		New allocated size (or zero to free buffer)
 	 * @ret rc		Return status code
 	 */
 	int ( * realloc ) ( struct xfer_buffer *xferbuf, size_t len );
+	/** Update length of data (optional)
+	 *
+	 * @v xferbuf		Data transfer buffer
+	 *
+	 * This is called whenever the length of data increases
+	 * within the existing allocated size.
+	 */
+	void ( * resize ) ( struct xfer_buffer *xferbuf );
 	/**
 	 * Access data buffer
 	 *
@@ -93,6 +107,7 @@ static inline __attribute__ (( always_inline )) void
 xferbuf_fixed_init ( struct xfer_buffer *xferbuf, void *data, size_t len ) {
 	xferbuf->data = data;
 	xferbuf->len = len;
+	xferbuf->size = len;
 	xferbuf->op = &xferbuf_fixed_operations;
 }
 
@@ -126,6 +141,7 @@ xferbuf_image_init ( struct xfer_buffer *xferbuf, struct image *image ) {
 }
 
 extern void xferbuf_free ( struct xfer_buffer *xferbuf );
+extern int xferbuf_shrink ( struct xfer_buffer *xferbuf );
 extern int xferbuf_write ( struct xfer_buffer *xferbuf, size_t offset,
 			   const void *data, size_t len );
 extern int xferbuf_read ( struct xfer_buffer *xferbuf, size_t offset,
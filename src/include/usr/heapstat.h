@@ -0,0 +1,15 @@
+#ifndef _USR_HEAPSTAT_H
+#define _USR_HEAPSTAT_H
+
+/** @file
+ *
+ * Heap statistics
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+FILE_SECBOOT ( PERMITTED );
+
+extern void heapstat ( void );
+
+#endif /* _USR_HEAPSTAT_H */
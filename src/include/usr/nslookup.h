@@ -11,5 +11,6 @@ FILE_LICENCE ( GPL2_OR_LATER );
 FILE_SECBOOT ( PERMITTED );
 
 extern int nslookup ( const char *name, const char *setting_name );
+extern void dnscache ( void );
 
 #endif /* _USR_NSLOOKUP_H */
@@ -11,5 +11,6 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 FILE_SECBOOT ( PERMITTED );
 
 extern void profstat ( void );
+extern void profdump ( void );
 
 #endif /* _USR_PROFSTAT_H */
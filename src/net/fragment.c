@@ -27,6 +27,8 @@ FILE_SECBOOT ( PERMITTED );
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <assert.h>
 #include <ipxe/retry.h>
 #include <ipxe/timer.h>
 #include <ipxe/ipstat.h>
@@ -38,6 +40,20 @@ FILE_SECBOOT ( PERMITTED );
  *
  */
 
+/**
+ * Free fragment reassembly buffer
+ *
+ * @v fragment		Fragment reassembly buffer
+ */
+static void fragment_free ( struct fragment *fragment ) {
+
+	stop_timer ( &fragment->timer );
+	free_iob ( fragment->iobuf );
+	list_del ( &fragment->list );
+	fragment->fragments->stats->reasm_fails++;
+	free ( fragment );
+}
+
 /**
  * Expire fragment reassembly buffer
  *
@@ -49,10 +65,7 @@ static void fragment_expired ( struct retry_timer *timer, int fail __unused ) {
 		container_of ( timer, struct fragment, timer );
 
 	DBGC ( fragment, "FRAG %p expired\n", fragment );
-	free_iob ( fragment->iobuf );
-	list_del ( &fragment->list );
-	fragment->fragments->stats->reasm_fails++;
-	free ( fragment );
+	fragment_free ( fragment );
 }
 
 /**
@@ -75,6 +88,215 @@ static struct fragment * fragment_find ( struct fragment_reassembler *fragments,
 	return NULL;
 }
 
+/**
+ * Create fragment reassembly buffer
+ *
+ * @v fragments		Fragment reassembler
+ * @ret fragment	Fragment reassembly buffer, or NULL on error
+ */
+static struct fragment *
+fragment_create ( struct fragment_reassembler *fragments ) {
+	struct fragment *fragment;
+	unsigned int count = 0;
+
+	/* Discard oldest reassembly buffer if limit has been reached */
+	list_for_each_entry ( fragment, &fragments->list, list )
+		count++;
+	if ( count >= FRAGMENT_MAX_BUFFERS ) {
+		fragment = list_last_entry ( &fragments->list, struct fragment,
+					     list );
+		DBGC ( fragment, "FRAG %p discarded to make space\n",
+		       fragment );
+		fragment_free ( fragment );
+	}
+
+	/* Create new fragment reassembly buffer */
+	fragment = zalloc ( sizeof ( *fragment ) );
+	if ( ! fragment )
+		return NULL;
+	list_add ( &fragment->list, &fragments->list );
+	timer_init ( &fragment->timer, fragment_expired, NULL );
+	fragment->fragments = fragments;
+
+	return fragment;
+}
+
+/**
+ * Reallocate fragment reassembly buffer
+ *
+ * @v fragment		Fragment reassembly buffer
+ * @v hdr		Non-fragmentable portion
+ * @v hdrlen		Length of non-fragmentable portion
+ * @v max_len		Maximum payload length
+ * @ret rc		Return status code
+ *
+ * Any payload already received is preserved.  I/O buffer headroom is
+ * also preserved, to allow for code which modifies and resends the
+ * reassembled packet (e.g. ICMP echo responses).
+ */
+static int fragment_realloc ( struct fragment *fragment, const void *hdr,
+			      size_t hdrlen, size_t max_len ) {
+	struct io_buffer *iobuf = fragment->iobuf;
+	struct io_buffer *new_iobuf;
+	size_t headroom = iob_headroom ( iobuf );
+	size_t len = ( iob_len ( iobuf ) - fragment->hdrlen );
+
+	/* Allocate new I/O buffer */
+	assert ( len <= max_len );
+	new_iobuf = alloc_iob ( headroom + hdrlen + max_len );
+	if ( ! new_iobuf ) {
+		DBGC ( fragment, "FRAG %p could not extend reassembly buffer "
+		       "to %zd bytes\n", fragment, ( hdrlen + max_len ) );
+		return -ENOMEM;
+	}
+	iob_reserve ( new_iobuf, headroom );
+
+	/* Copy non-fragmentable portion and payload */
+	memcpy ( iob_put ( new_iobuf, hdrlen ), hdr, hdrlen );
+	memcpy ( iob_put ( new_iobuf, len ),
+		 ( iobuf->data + fragment->hdrlen ), len );
+
+	/* Replace I/O buffer */
+	free_iob ( iobuf );
+	fragment->iobuf = new_iobuf;
+	fragment->hdrlen = hdrlen;
+
+	return 0;
+}
+
+/**
+ * Record received payload range
+ *
+ * @v fragment		Fragment reassembly buffer
+ * @v start		Start offset
+ * @v end		End offset
+ * @ret rc		Return status code
+ */
+static int fragment_mark ( struct fragment *fragment, size_t start,
+			   size_t end ) {
+	struct fragment_range *ranges = fragment->ranges;
+	unsigned int count = fragment->count;
+	unsigned int i;
+	unsigned int j;
+
+	/* Find first range not ending before the new range, and
+	 * first range starting after the new range.  Adjacent ranges
+	 * are merged.
+	 */
+	for ( i = 0 ; ( i < count ) && ( ranges[i].end < start ) ; i++ ) {}
+	for ( j = i ; ( j < count ) && ( ranges[j].start <= end ) ; j++ ) {}
+
+	/* Insert new range or merge with overlapping ranges */
+	if ( i == j ) {
+		if ( count >= FRAGMENT_MAX_RANGES ) {
+			DBGC ( fragment, "FRAG %p has too many holes\n",
+			       fragment );
+			return -ENOBUFS;
+		}
+		memmove ( &ranges[ i + 1 ], &ranges[i],
+			  ( ( count - i ) * sizeof ( ranges[0] ) ) );
+		fragment->count++;
+	} else {
+		if ( start > ranges[i].start )
+			start = ranges[i].start;
+		if ( end < ranges[ j - 1 ].end )
+			end = ranges[ j - 1 ].end;
+		memmove ( &ranges[ i + 1 ], &ranges[j],
+			  ( ( count - j ) * sizeof ( ranges[0] ) ) );
+		fragment->count -= ( j - i - 1 );
+	}
+	ranges[i].start = start;
+	ranges[i].end = end;
+
+	return 0;
+}
+
+/**
+ * Add fragment to reassembly buffer
+ *
+ * @v fragment		Fragment reassembly buffer
+ * @v iobuf		I/O buffer
+ * @v hdrlen		Length of non-fragmentable portion of I/O buffer
+ * @v offset		Fragment offset
+ * @v more_frags	More fragments exist
+ * @ret rc		Return status code
+ *
+ * The I/O buffer is left owned by the caller.  Fragments may arrive
+ * in any order, and may overlap.
+ */
+static int fragment_add ( struct fragment *fragment, struct io_buffer *iobuf,
+			  size_t hdrlen, size_t offset, int more_frags ) {
+	size_t len = ( iob_len ( iobuf ) - hdrlen );
+	size_t end = ( offset + len );
+	size_t extent;
+	size_t max_len;
+	int rc;
+
+	/* Check consistency with final fragment */
+	extent = ( fragment->count ?
+		   fragment->ranges[ fragment->count - 1 ].end : 0 );
+	if ( ( fragment->final && ( end > fragment->len ) ) ||
+	     ( ( ! more_frags ) &&
+	       ( ( fragment->final && ( end != fragment->len ) ) ||
+		 ( end < extent ) ) ) ) {
+		DBGC ( fragment, "FRAG %p inconsistent fragment [%zd,%zd)%s\n",
+		       fragment, offset, end, ( more_frags ? "" : " final" ) );
+		return -EINVAL;
+	}
+
+	/* Take non-fragmentable portion from the first fragment, if
+	 * its length differs from that already present.
+	 */
+	max_len = ( iob_len ( fragment->iobuf ) - fragment->hdrlen +
+		    iob_tailroom ( fragment->iobuf ) );
+	if ( ( offset == 0 ) && ( hdrlen != fragment->hdrlen ) ) {
+		if ( ( rc = fragment_realloc ( fragment, iobuf->data, hdrlen,
+					       max_len ) ) != 0 )
+			return rc;
+	}
+
+	/* Extend reassembly buffer, if necessary.  Allow space for
+	 * further fragments until the total length is known.
+	 */
+	if ( end > max_len ) {
+		if ( ! more_frags ) {
+			max_len = end;
+		} else if ( fragment->final ) {
+			max_len = fragment->len;
+		} else {
+			max_len *= 2;
+			if ( max_len > FRAGMENT_MAX_LEN )
+				max_len = FRAGMENT_MAX_LEN;
+			if ( max_len < end )
+				max_len = end;
+		}
+		if ( ( rc = fragment_realloc ( fragment, fragment->iobuf->data,
+					       fragment->hdrlen,
+					       max_len ) ) != 0 )
+			return rc;
+	}
+
+	/* Record received range */
+	if ( ( rc = fragment_mark ( fragment, offset, end ) ) != 0 )
+		return rc;
+	if ( ! more_frags ) {
+		fragment->final = 1;
+		fragment->len = end;
+	}
+
+	/* Copy payload and (for the first fragment) non-fragmentable
+	 * portion into reassembly buffer.
+	 */
+	if ( end > extent )
+		iob_put ( fragment->iobuf, ( end - extent ) );
+	memcpy ( ( fragment->iobuf->data + fragment->hdrlen + offset ),
+		 ( iobuf->data + hdrlen ), len );
+	if ( offset == 0 )
+		memcpy ( fragment->iobuf->data, iobuf->data, hdrlen );
+
+	return 0;
+}
+
 /**
  * Reassemble packet
  *
@@ -90,89 +312,106 @@ struct io_buffer * fragment_reassemble ( struct fragment_reassembler *fragments,
 					 struct io_buffer *iobuf,
 					 size_t *hdrlen ) {
 	struct fragment *fragment;
-	struct io_buffer *new_iobuf;
-	size_t new_len;
 	size_t offset;
-	size_t expected_offset;
+	size_t end;
 	int more_frags;
+	int rc;
 
 	/* Update statistics */
 	fragments->stats->reasm_reqds++;
 
-	/* Find matching fragment reassembly buffer, if any */
-	fragment = fragment_find ( fragments, iobuf, *hdrlen );
-
-	/* Drop out-of-order fragments */
+	/* Parse fragment */
 	offset = fragments->fragment_offset ( iobuf, *hdrlen );
-	expected_offset = ( fragment ? ( iob_len ( fragment->iobuf ) -
-					 fragment->hdrlen ) : 0 );
-	if ( offset != expected_offset ) {
-		DBGC ( fragment, "FRAG %p dropping out-of-sequence fragment "
-		       "[%zd,%zd), expected [%zd,...)\n", fragment, offset,
-		       ( offset + iob_len ( iobuf ) - *hdrlen ),
-		       expected_offset );
+	end = ( offset + iob_len ( iobuf ) - *hdrlen );
+	more_frags = fragments->more_fragments ( iobuf, *hdrlen );
+	if ( end > FRAGMENT_MAX_LEN ) {
+		DBGC ( fragments, "FRAG dropping oversized fragment "
+		       "[%zd,%zd)\n", offset, end );
 		goto drop;
 	}
 
-	/* Create or extend fragment reassembly buffer as applicable */
-	if ( ! fragment ) {
+	/* Find matching fragment reassembly buffer, if any */
+	fragment = fragment_find ( fragments, iobuf, *hdrlen );
+	if ( fragment ) {
 
-		/* Create new fragment reassembly buffer */
-		fragment = zalloc ( sizeof ( *fragment ) );
-		if ( ! fragment )
+		/* Add to existing reassembly buffer */
+		DBGC ( fragment, "FRAG %p [%zd,%zd)%s\n", fragment, offset,
+		       end, ( more_frags ? "" : " final" ) );
+		rc = fragment_add ( fragment, iobuf, *hdrlen, offset,
+				    more_frags );
+		if ( rc == -EINVAL ) {
+			fragment_free ( fragment );
+			goto discard;
+		}
+		if ( rc != 0 )
 			goto drop;
-		list_add ( &fragment->list, &fragments->list );
-		fragment->iobuf = iobuf;
-		fragment->hdrlen = *hdrlen;
-		timer_init ( &fragment->timer, fragment_expired, NULL );
-		fragment->fragments = fragments;
-		DBGC ( fragment, "FRAG %p [0,%zd)\n", fragment,
-		       ( iob_len ( iobuf ) - *hdrlen ) );
+		free_iob ( iobuf );
 
 	} else {
 
-		/* Check if this is the final fragment */
-		more_frags = fragments->more_fragments ( iobuf, *hdrlen );
-		DBGC ( fragment, "FRAG %p [%zd,%zd)%s\n", fragment,
-		       offset, ( offset + iob_len ( iobuf ) - *hdrlen ),
-		       ( more_frags ? "" : " complete" ) );
-
-		/* Extend fragment reassembly buffer.  Preserve I/O
-		 * buffer headroom to allow for code which modifies
-		 * and resends the buffer (e.g. ICMP echo responses).
-		 */
-		iob_pull ( iobuf, *hdrlen );
-		new_len = ( iob_headroom ( fragment->iobuf ) +
-			    iob_len ( fragment->iobuf ) + iob_len ( iobuf ) );
-		new_iobuf = alloc_iob ( new_len );
-		if ( ! new_iobuf ) {
-			DBGC ( fragment, "FRAG %p could not extend reassembly "
-			       "buffer to %zd bytes\n", fragment, new_len );
+		/* Create new reassembly buffer */
+		fragment = fragment_create ( fragments );
+		if ( ! fragment )
 			goto drop;
-		}
-		iob_reserve ( new_iobuf, iob_headroom ( fragment->iobuf ) );
-		memcpy ( iob_put ( new_iobuf, iob_len ( fragment->iobuf ) ),
-			 fragment->iobuf->data, iob_len ( fragment->iobuf ) );
-		memcpy ( iob_put ( new_iobuf, iob_len ( iobuf ) ),
-			 iobuf->data, iob_len ( iobuf ) );
-		free_iob ( fragment->iobuf );
-		fragment->iobuf = new_iobuf;
-		free_iob ( iobuf );
+		DBGC ( fragment, "FRAG %p [%zd,%zd)%s\n", fragment, offset,
+		       end, ( more_frags ? "" : " final" ) );
 
-		/* Stop fragment reassembly timer */
-		stop_timer ( &fragment->timer );
+		if ( offset == 0 ) {
 
-		/* If this is the final fragment, return it */
-		if ( ! more_frags ) {
-			iobuf = fragment->iobuf;
-			*hdrlen = fragment->hdrlen;
-			list_del ( &fragment->list );
-			free ( fragment );
-			fragments->stats->reasm_oks++;
-			return iobuf;
+			/* Use I/O buffer as reassembly buffer */
+			fragment->iobuf = iobuf;
+			fragment->hdrlen = *hdrlen;
+			fragment_mark ( fragment, 0, end );
+			fragment->final = ( ! more_frags );
+			fragment->len = end;
+
+		} else {
+
+			/* Allocate reassembly buffer.  Preserve I/O
+			 * buffer headroom as for fragment_realloc().
+			 */
+			fragment->iobuf = alloc_iob ( iob_headroom ( iobuf ) +
+						      *hdrlen + end );
+			if ( ! fragment->iobuf ) {
+				fragment_free ( fragment );
+				free_iob ( iobuf );
+				return NULL;
+			}
+			iob_reserve ( fragment->iobuf, iob_headroom ( iobuf ) );
+			memcpy ( iob_put ( fragment->iobuf, *hdrlen ),
+				 iobuf->data, *hdrlen );
+			fragment->hdrlen = *hdrlen;
+
+			/* Add fragment.  On failure, the reassembly
+			 * buffer would hold no received range, and so
+			 * must be discarded rather than left to await
+			 * further fragments.
+			 */
+			rc = fragment_add ( fragment, iobuf, *hdrlen, offset,
+					    more_frags );
+			if ( rc != 0 ) {
+				fragment_free ( fragment );
+				goto discard;
+			}
+			free_iob ( iobuf );
 		}
 	}
 
+	/* Return reassembled packet, if complete */
+	if ( fragment->final && ( fragment->count == 1 ) &&
+	     ( fragment->ranges[0].start == 0 ) &&
+	     ( fragment->ranges[0].end == fragment->len ) ) {
+		iobuf = fragment->iobuf;
+		iobuf->flags &= ~IOB_CSUM_VERIFIED;
+		*hdrlen = fragment->hdrlen;
+		DBGC ( fragment, "FRAG %p complete\n", fragment );
+		stop_timer ( &fragment->timer );
+		list_del ( &fragment->list );
+		free ( fragment );
+		fragments->stats->reasm_oks++;
+		return iobuf;
+	}
+
 	/* (Re)start fragment reassembly timer */
 	start_timer_fixed ( &fragment->timer, FRAGMENT_TIMEOUT );
 
@@ -180,6 +419,7 @@ struct io_buffer * fragment_reassemble ( struct fragment_reassembler *fragments,
 
  drop:
 	fragments->stats->reasm_fails++;
+ discard:
 	free_iob ( iobuf );
 	return NULL;
 }
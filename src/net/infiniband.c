@@ -54,6 +54,9 @@ struct list_head ib_devices = LIST_HEAD_INIT ( ib_devices );
 /** List of open Infiniband devices, in reverse order of opening */
 static struct list_head open_ib_devices = LIST_HEAD_INIT ( open_ib_devices );
 
+/* Forward declaration */
+struct process ib_process __permanent_process;
+
 /** Infiniband device index */
 static unsigned int ibdev_index = 0;
 
@@ -689,6 +692,9 @@ int ib_open ( struct ib_device *ibdev ) {
 	/* Add to head of open devices list */
 	list_add ( &ibdev->open_list, &open_ib_devices );
 
+	/* Ensure that the event queues are being polled */
+	process_wake ( &ib_process );
+
 	/* Notify drivers of device state change */
 	ib_notify ( ibdev );
 
@@ -891,11 +897,15 @@ void ib_poll_eq ( struct ib_device *ibdev ) {
  *
  * @v process		Infiniband event queue process
  */
-static void ib_step ( struct process *process __unused ) {
+static void ib_step ( struct process *process ) {
 	struct ib_device *ibdev;
 
 	list_for_each_entry ( ibdev, &open_ib_devices, open_list )
 		ib_poll_eq ( ibdev );
+
+	/* Sleep until a device is opened, if none are open */
+	if ( list_empty ( &open_ib_devices ) )
+		process_sleep ( process );
 }
 
 /** Infiniband event queue process */
@@ -36,6 +36,7 @@
 #include <ipxe/netdevice.h>
 #include <ipxe/ip.h>
 #include <ipxe/tcpip.h>
+#include <ipxe/tcp.h>
 #include <ipxe/dhcp.h>
 #include <ipxe/settings.h>
 #include <ipxe/fragment.h>
@@ -487,6 +488,13 @@ static int ipv4_tx ( struct io_buffer *iobuf,
 	iphdr->protocol = tcpip_protocol->tcpip_proto;
 	iphdr->dest = sin_dest->sin_addr;
 
+	/* Forbid fragmentation by routers, if applicable, so that an
+	 * oversized packet is dropped rather than silently delivered.
+	 * This is required for TCP path MTU probing.
+	 */
+	if ( tcpip_protocol->dontfrag )
+		iphdr->frags = htons ( IP_MASK_DONOTFRAG );
+
 	/* Use routing table to identify next hop and transmitting netdev */
 	next_hop = iphdr->dest;
 	if ( sin_src )
@@ -514,11 +522,17 @@ static int ipv4_tx ( struct io_buffer *iobuf,
 			       ( ( netdev->rx_stats.bad & 0xf ) << 4 ) |
 			       ( ( netdev->rx_stats.good & 0xf ) << 0 ) );
 
-	/* Fix up checksums */
+	/* Fix up checksums.  A packet requiring segmentation carries
+	 * only the (uncomplemented) pseudo-header checksum, to be
+	 * completed for each segment.
+	 */
 	if ( trans_csum ) {
 		*trans_csum = ipv4_pshdr_chksum ( iobuf, *trans_csum );
-		if ( ! *trans_csum )
+		if ( iobuf->mss ) {
+			*trans_csum = ~*trans_csum;
+		} else if ( ! *trans_csum ) {
 			*trans_csum = tcpip_protocol->zero_csum;
+		}
 	}
 	iphdr->chksum = tcpip_chksum ( iphdr, sizeof ( *iphdr ) );
 
@@ -581,6 +595,44 @@ static int ipv4_tx ( struct io_buffer *iobuf,
 	return rc;
 }
 
+/**
+ * Segment IPv4 packet
+ *
+ * @v iobuf		I/O buffer
+ * @v segments		List of segments to fill in
+ * @ret rc		Return status code
+ */
+static int ipv4_segment ( struct io_buffer *iobuf,
+			  struct list_head *segments ) {
+	struct iphdr *iphdr = iobuf->data;
+	size_t hdrlen = ( ( iphdr->verhdrlen & IP_MASK_HLEN ) * 4 );
+	uint16_t ident = ntohs ( iphdr->ident );
+	struct tcp_header *tcphdr;
+	struct io_buffer *segment;
+	int rc;
+
+	/* Only TCP packets may be segmented */
+	if ( iphdr->protocol != IP_TCP )
+		return -ENOTSUP;
+
+	/* Segment packet */
+	if ( ( rc = tcpip_segment ( iobuf, hdrlen, segments ) ) != 0 )
+		return rc;
+
+	/* Fix up IPv4 headers and complete TCP checksums */
+	list_for_each_entry ( segment, segments, list ) {
+		iphdr = segment->data;
+		iphdr->len = htons ( iob_len ( segment ) );
+		iphdr->ident = htons ( ident++ );
+		iphdr->chksum = 0;
+		iphdr->chksum = tcpip_chksum ( iphdr, hdrlen );
+		tcphdr = ( segment->data + hdrlen );
+		tcphdr->csum = ipv4_pshdr_chksum ( segment, tcphdr->csum );
+	}
+
+	return 0;
+}
+
 /**
  * Check if network device has any IPv4 address
  *
@@ -869,6 +921,7 @@ struct net_protocol ipv4_protocol __net_protocol = {
 	.net_addr_len = sizeof ( struct in_addr ),
 	.rx = ipv4_rx,
 	.ntoa = ipv4_ntoa,
+	.segment = ipv4_segment,
 };
 
 /** IPv4 TCPIP net protocol */
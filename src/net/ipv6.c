@@ -30,6 +30,7 @@ FILE_SECBOOT ( PERMITTED );
 #include <byteswap.h>
 #include <ipxe/iobuf.h>
 #include <ipxe/tcpip.h>
+#include <ipxe/tcp.h>
 #include <ipxe/if_ether.h>
 #include <ipxe/crc32.h>
 #include <ipxe/fragment.h>
@@ -577,8 +578,12 @@ static int ipv6_tx ( struct io_buffer *iobuf,
 		*trans_csum = ipv6_pshdr_chksum ( iphdr, len,
 						  tcpip_protocol->tcpip_proto,
 						  *trans_csum );
-		if ( ! *trans_csum )
+		if ( iobuf->mss ) {
+			/* Leave pseudo-header checksum for segmentation */
+			*trans_csum = ~*trans_csum;
+		} else if ( ! *trans_csum ) {
 			*trans_csum = tcpip_protocol->zero_csum;
+		}
 	}
 
 	/* Print IPv6 header for debugging */
@@ -634,6 +639,43 @@ static int ipv6_tx ( struct io_buffer *iobuf,
 	return rc;
 }
 
+/**
+ * Segment IPv6 packet
+ *
+ * @v iobuf		I/O buffer
+ * @v segments		List of segments to fill in
+ * @ret rc		Return status code
+ */
+static int ipv6_segment ( struct io_buffer *iobuf,
+			  struct list_head *segments ) {
+	struct ipv6_header *iphdr = iobuf->data;
+	struct tcp_header *tcphdr;
+	struct io_buffer *segment;
+	size_t len;
+	int rc;
+
+	/* Only TCP packets (without extension headers) may be segmented */
+	if ( iphdr->next_header != IP_TCP )
+		return -ENOTSUP;
+
+	/* Segment packet */
+	if ( ( rc = tcpip_segment ( iobuf, sizeof ( *iphdr ),
+				    segments ) ) != 0 )
+		return rc;
+
+	/* Fix up IPv6 headers and complete TCP checksums */
+	list_for_each_entry ( segment, segments, list ) {
+		iphdr = segment->data;
+		len = ( iob_len ( segment ) - sizeof ( *iphdr ) );
+		iphdr->len = htons ( len );
+		tcphdr = ( segment->data + sizeof ( *iphdr ) );
+		tcphdr->csum = ipv6_pshdr_chksum ( iphdr, len, IP_TCP,
+						   tcphdr->csum );
+	}
+
+	return 0;
+}
+
 /**
  * Process incoming IPv6 packets
  *
@@ -1052,6 +1094,7 @@ struct net_protocol ipv6_protocol __net_protocol = {
 	.net_addr_len = sizeof ( struct in6_addr ),
 	.rx = ipv6_rx,
 	.ntoa = ipv6_ntoa,
+	.segment = ipv6_segment,
 };
 
 /** IPv6 TCPIP net protocol */
@@ -56,11 +56,16 @@ struct list_head net_devices = LIST_HEAD_INIT ( net_devices );
 /** List of open network devices, in reverse order of opening */
 static struct list_head open_net_devices = LIST_HEAD_INIT ( open_net_devices );
 
+/* Forward declaration */
+struct process net_process __permanent_process;
+
 /** Network polling profiler */
-static struct profiler net_poll_profiler __profiler = { .name = "net.poll" };
+static struct profiler net_poll_profiler __profiler =
+	{ .name = "net.poll", .hist = PROFILE_HISTOGRAM };
 
 /** Network receive profiler */
-static struct profiler net_rx_profiler __profiler = { .name = "net.rx" };
+static struct profiler net_rx_profiler __profiler =
+	{ .name = "net.rx", .hist = PROFILE_HISTOGRAM };
 
 /** Network transmit profiler */
 static struct profiler net_tx_profiler __profiler = { .name = "net.tx" };
@@ -339,6 +344,9 @@ int netdev_tx ( struct net_device *netdev, struct io_buffer *iobuf ) {
 		netdev->name, iobuf, iobuf->data, iob_len ( iobuf ) );
 	profile_start ( &net_tx_profiler );
 
+	/* Only capable devices may be given packets to segment */
+	assert ( ( netdev->state & NETDEV_TX_TSO ) || ( iobuf->mss == 0 ) );
+
 	/* Enqueue packet */
 	list_add_tail ( &iobuf->list, &netdev->tx_queue );
 
@@ -552,6 +560,10 @@ void netdev_rx ( struct net_device *netdev, struct io_buffer *iobuf ) {
 	DBGC2 ( netdev, "NETDEV %s received %p (%p+%zx)\n",
 		netdev->name, iobuf, iobuf->data, iob_len ( iobuf ) );
 
+	/* Only capable devices may claim to have verified checksums */
+	assert ( ( netdev->state & NETDEV_RX_CSUM ) ||
+		 ! ( iobuf->flags & IOB_CSUM_VERIFIED ) );
+
 	/* Discard packet (for test purposes) if applicable */
 	if ( ( rc = inject_fault ( NETDEV_DISCARD_RATE ) ) != 0 ) {
 		netdev_rx_err ( netdev, iobuf, rc );
@@ -882,6 +894,9 @@ int netdev_open ( struct net_device *netdev ) {
 	/* Add to head of open devices list */
 	list_add ( &netdev->open_list, &open_net_devices );
 
+	/* Ensure that the networking stack is being polled */
+	process_wake ( &net_process );
+
 	/* Notify drivers of device state change */
 	netdev_notify ( netdev );
 
@@ -1061,6 +1076,76 @@ struct net_device * last_opened_netdev ( void ) {
 	return netdev;
 }
 
+/**
+ * Segment network-layer packet
+ *
+ * @v iobuf		I/O buffer
+ * @v net_protocol	Network-layer protocol
+ * @v segments		List of segments to fill in
+ * @ret rc		Return status code
+ *
+ * Splits a packet requiring TCP segmentation offload into individual
+ * segments.  The original I/O buffer remains owned by the caller.
+ */
+int net_segment ( struct io_buffer *iobuf, struct net_protocol *net_protocol,
+		  struct list_head *segments ) {
+
+	/* Check that protocol supports segmentation */
+	if ( ! net_protocol->segment ) {
+		DBG ( "%s cannot segment packets\n", net_protocol->name );
+		return -ENOTSUP;
+	}
+
+	/* Segment packet */
+	return net_protocol->segment ( iobuf, segments );
+}
+
+/**
+ * Transmit network-layer packet using software segmentation
+ *
+ * @v iobuf		I/O buffer
+ * @v netdev		Network device
+ * @v net_protocol	Network-layer protocol
+ * @v ll_dest		Destination link-layer address
+ * @v ll_source		Source link-layer address
+ * @ret rc		Return status code
+ */
+static int net_tx_segmented ( struct io_buffer *iobuf,
+			      struct net_device *netdev,
+			      struct net_protocol *net_protocol,
+			      const void *ll_dest, const void *ll_source ) {
+	LIST_HEAD ( segments );
+	struct io_buffer *segment;
+	struct io_buffer *tmp;
+	int rc;
+
+	/* Segment packet */
+	if ( ( rc = net_segment ( iobuf, net_protocol, &segments ) ) != 0 ) {
+		DBGC ( netdev, "NETDEV %s could not segment: %s\n",
+		       netdev->name, strerror ( rc ) );
+		netdev_tx_err ( netdev, iobuf, rc );
+		return rc;
+	}
+	free_iob ( iobuf );
+
+	/* Transmit segments */
+	rc = 0;
+	list_for_each_entry_safe ( segment, tmp, &segments, list ) {
+		list_del ( &segment->list );
+		if ( ( rc = net_tx ( segment, netdev, net_protocol, ll_dest,
+				     ll_source ) ) != 0 )
+			break;
+	}
+
+	/* Discard any untransmitted segments */
+	list_for_each_entry_safe ( segment, tmp, &segments, list ) {
+		list_del ( &segment->list );
+		free_iob ( segment );
+	}
+
+	return rc;
+}
+
 /**
  * Transmit network-layer packet
  *
@@ -1081,6 +1166,12 @@ int net_tx ( struct io_buffer *iobuf, struct net_device *netdev,
 	struct ll_protocol *ll_protocol = netdev->ll_protocol;
 	int rc;
 
+	/* Segment packet in software, if required */
+	if ( iobuf->mss && ! ( netdev->state & NETDEV_TX_TSO ) ) {
+		return net_tx_segmented ( iobuf, netdev, net_protocol,
+					  ll_dest, ll_source );
+	}
+
 	/* Add link-layer header */
 	if ( ( rc = ll_protocol->push ( netdev, iobuf, ll_dest, ll_source,
 					net_protocol->net_proto ) ) != 0 ) {
@@ -1190,8 +1281,14 @@ void net_poll ( void ) {
  *
  * @v process		Network stack process
  */
-static void net_step ( struct process *process __unused ) {
+static void net_step ( struct process *process ) {
+
+	/* Poll the network stack */
 	net_poll();
+
+	/* Sleep until a network device is opened, if none are open */
+	if ( list_empty ( &open_net_devices ) )
+		process_sleep ( process );
 }
 
 /**
@@ -147,6 +147,12 @@ static void peermux_info_close ( struct peerdist_multiplexer *peermux, int rc ){
 	/* Shut down content information interface */
 	intf_shutdown ( &peermux->info, rc );
 
+	/* Release any excess buffer space, since the content
+	 * information is retained for the duration of the download.
+	 */
+	if ( ( rc = xferbuf_shrink ( buffer ) ) != 0 )
+		goto err;
+
 	/* Parse content information */
 	if ( ( rc = peerdist_info ( buffer->data, buffer->len, info ) ) != 0 ) {
 		DBGC ( peermux, "PEERMUX %p could not parse content info: %s\n",
@@ -40,7 +40,13 @@ FILE_SECBOOT ( PERMITTED );
  *
  * This implementation of the timer is designed to satisfy RFC 2988
  * and therefore be usable as a TCP retransmission timer.
- * 
+ *
+ * Running timers are held in a hashed timer wheel indexed by expiry
+ * time, so that starting and stopping a timer take constant time and
+ * each poll need examine only the slots corresponding to the time
+ * that has elapsed since the previous poll.  A timer whose expiry
+ * lies more than one revolution of the wheel in the future will be
+ * examined (and left in place) once per revolution.
  */
 
 /* The theoretical minimum that the algorithm in stop_timer() can
@@ -49,8 +55,72 @@ FILE_SECBOOT ( PERMITTED );
  */
 #define MIN_TIMEOUT 7
 
-/** List of running timers */
-static LIST_HEAD ( timers );
+/** Number of timer wheel slots (must be a power of two) */
+#define RETRY_WHEEL_SIZE 256
+
+/** Timer wheel slots, indexed by expiry time
+ *
+ * Each slot is initialised on first use (see retry_slot()), so that
+ * timers may be started at any time, including before the
+ * initialisation functions have run.
+ */
+static struct list_head retry_wheel[RETRY_WHEEL_SIZE];
+
+/** Time (in ticks) of the next timer wheel slot to be processed
+ *
+ * Every running timer either expires at or after this time, or is
+ * held in the slot for this time.
+ */
+static unsigned long retry_cursor;
+
+/** Number of running timers */
+static unsigned int retry_count;
+
+/* Forward declaration */
+struct process retry_process __permanent_process;
+
+/**
+ * Get timer wheel slot
+ *
+ * @v time		Time (in ticks)
+ * @ret slot		Timer wheel slot
+ */
+static inline struct list_head * retry_slot ( unsigned long time ) {
+	struct list_head *slot = &retry_wheel[ time & ( RETRY_WHEEL_SIZE - 1 ) ];
+
+	/* Initialise slot on first use */
+	if ( ! slot->next )
+		INIT_LIST_HEAD ( slot );
+
+	return slot;
+}
+
+/**
+ * Calculate timer expiry time
+ *
+ * @v timer		Retry timer
+ * @ret expiry		Expiry time (in ticks)
+ */
+static inline unsigned long retry_expiry ( struct retry_timer *timer ) {
+
+	return ( timer->start + timer->timeout );
+}
+
+/**
+ * Add timer to timer wheel
+ *
+ * @v timer		Retry timer
+ */
+static void retry_insert ( struct retry_timer *timer ) {
+	unsigned long expiry = retry_expiry ( timer );
+
+	/* Add to the slot for the expiry time, or to the next slot to
+	 * be processed if the expiry time has already been passed.
+	 */
+	if ( ( ( signed long ) ( expiry - retry_cursor ) ) < 0 )
+		expiry = retry_cursor;
+	list_add_tail ( &timer->list, retry_slot ( expiry ) );
+}
 
 /**
  * Start timer with a specified timeout
@@ -64,11 +134,14 @@ static LIST_HEAD ( timers );
  */
 void start_timer_fixed ( struct retry_timer *timer, unsigned long timeout ) {
 
-	/* Add to list of running timers (if applicable) */
-	if ( ! timer->running ) {
-		list_add ( &timer->list, &timers );
+	/* Remove from timer wheel (if applicable) */
+	if ( timer->running ) {
+		list_del ( &timer->list );
+	} else {
 		ref_get ( timer->refcnt );
 		timer->running = 1;
+		retry_count++;
+		process_wake ( &retry_process );
 	}
 
 	/* Record start time */
@@ -77,6 +150,9 @@ void start_timer_fixed ( struct retry_timer *timer, unsigned long timeout ) {
 	/* Record timeout */
 	timer->timeout = timeout;
 
+	/* Add to timer wheel */
+	retry_insert ( timer );
+
 	DBGC2 ( timer, "Timer %p started at time %ld (expires at %ld)\n",
 		timer, timer->start, ( timer->start + timer->timeout ) );
 }
@@ -127,6 +203,7 @@ void stop_timer ( struct retry_timer *timer ) {
 	list_del ( &timer->list );
 	runtime = ( now - timer->start );
 	timer->running = 0;
+	retry_count--;
 	DBGC2 ( timer, "Timer %p stopped at time %ld (ran for %ld)\n",
 		timer, now, runtime );
 
@@ -175,6 +252,7 @@ static void timer_expired ( struct retry_timer *timer ) {
 	assert ( timer->running );
 	list_del ( &timer->list );
 	timer->running = 0;
+	retry_count--;
 	timer->count++;
 
 	/* Back off the timeout value */
@@ -192,26 +270,90 @@ static void timer_expired ( struct retry_timer *timer ) {
 }
 
 /**
- * Poll the retry timer list
+ * Poll the retry timers
  *
  */
 void retry_poll ( void ) {
+	LIST_HEAD ( pending );
 	struct retry_timer *timer;
 	unsigned long now = currticks();
-	unsigned long used;
+	unsigned long elapsed;
+	unsigned int count;
 
-	/* Process at most one timer expiry.  We cannot process
-	 * multiple expiries in one pass, because one timer expiring
-	 * may end up triggering another timer's deletion from the
-	 * list.
+	/* Process each slot corresponding to the elapsed time (or
+	 * every slot, if a full revolution has elapsed).
 	 */
-	list_for_each_entry ( timer, &timers, list ) {
-		used = ( now - timer->start );
-		if ( used >= timer->timeout ) {
-			timer_expired ( timer );
+	elapsed = ( now - retry_cursor );
+	count = ( ( elapsed < RETRY_WHEEL_SIZE ) ?
+		  ( elapsed + 1 ) : RETRY_WHEEL_SIZE );
+	for ( ; count-- ; retry_cursor++ ) {
+
+		/* Move the slot's timers to a pending list.  An
+		 * expiry handler may stop or restart any timer
+		 * (including those still pending), so always take
+		 * the first remaining pending timer.
+		 */
+		list_splice_init ( retry_slot ( retry_cursor ), &pending );
+		while ( ( timer = list_first_entry ( &pending,
+						     struct retry_timer,
+						     list ) ) ) {
+			if ( ( now - timer->start ) >= timer->timeout ) {
+				timer_expired ( timer );
+			} else {
+				/* Not yet expired: return to wheel */
+				list_del ( &timer->list );
+				list_add_tail ( &timer->list,
+						retry_slot ( retry_expiry ( timer ) ) );
+			}
+		}
+	}
+
+	/* Leave the current slot to be processed again by the next
+	 * poll, since an expiry handler may have started a timer that
+	 * expires at the current time.
+	 */
+	retry_cursor = now;
+}
+
+/**
+ * Find time remaining until the next retry timer expiry
+ *
+ * @ret remaining	Time remaining (in ticks), or RETRY_NEVER
+ *
+ * The returned value will be zero if any timer has already expired
+ * (but has not yet been processed by retry_poll()).
+ */
+unsigned long retry_remaining ( void ) {
+	struct retry_timer *timer;
+	struct list_head *slot;
+	unsigned long now = currticks();
+	unsigned long best = RETRY_NEVER;
+	unsigned long offset;
+	unsigned long delta;
+	unsigned int i;
+
+	/* Every timer in the slot at offset i from the cursor expires
+	 * at least i ticks after the cursor, so the scan can stop as
+	 * soon as the best expiry found so far is within i ticks.
+	 */
+	for ( i = 0 ; i < RETRY_WHEEL_SIZE ; i++ ) {
+		if ( best <= i )
 			break;
+		slot = retry_slot ( retry_cursor + i );
+		list_for_each_entry ( timer, slot, list ) {
+			offset = ( retry_expiry ( timer ) - retry_cursor );
+			if ( ( ( signed long ) offset ) < 0 )
+				offset = 0;
+			if ( offset < best )
+				best = offset;
 		}
 	}
+	if ( best == RETRY_NEVER )
+		return RETRY_NEVER;
+
+	/* Convert to time remaining from now */
+	delta = ( now - retry_cursor );
+	return ( ( best > delta ) ? ( best - delta ) : 0 );
 }
 
 /**
@@ -219,8 +361,14 @@ void retry_poll ( void ) {
  *
  * @v process		Retry timer process
  */
-static void retry_step ( struct process *process __unused ) {
+static void retry_step ( struct process *process ) {
+
+	/* Poll timers */
 	retry_poll();
+
+	/* Sleep until a timer is started, if no timers are running */
+	if ( ! retry_count )
+		process_sleep ( process );
 }
 
 /** Retry timer process */
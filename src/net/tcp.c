@@ -30,12 +30,30 @@
 FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 FILE_SECBOOT ( PERMITTED );
 
+/** A received TCP sequence range
+ *
+ * This describes a run of contiguous data held within the receive
+ * queue.
+ */
+struct tcp_rx_range {
+	/** Start of range (in host-endian order) */
+	uint32_t seq;
+	/** End of range (in host-endian order) */
+	uint32_t nxt;
+	/** First I/O buffer within range */
+	struct io_buffer *first;
+	/** Last I/O buffer within range */
+	struct io_buffer *last;
+};
+
 /** A TCP connection */
 struct tcp_connection {
 	/** Reference counter */
 	struct refcnt refcnt;
 	/** List of TCP connections */
 	struct list_head list;
+	/** List of TCP connections within local port hash bucket */
+	struct list_head hash;
 
 	/** Flags */
 	unsigned int flags;
@@ -47,8 +65,30 @@ struct tcp_connection {
 	struct sockaddr_tcpip peer;
 	/** Local port */
 	unsigned int local_port;
-	/** Maximum segment size */
+	/** Maximum segment size
+	 *
+	 * This is the MSS advertised to the peer, derived from the
+	 * MTU of the local link.
+	 */
 	size_t mss;
+	/** Transmit maximum segment size
+	 *
+	 * This is the largest segment (excluding TCP options) known
+	 * to be able to traverse the path to the peer.
+	 */
+	size_t snd_mss;
+	/** Upper bound on transmit maximum segment size
+	 *
+	 * This is the smaller of the local MSS and the MSS advertised
+	 * by the peer, reduced whenever a path MTU probe is lost.
+	 */
+	size_t snd_mss_max;
+	/** Transmit maximum segment size being probed, or zero */
+	size_t probe_mss;
+	/** Start of path MTU probe (in host-endian order) */
+	uint32_t probe_seq;
+	/** End of path MTU probe (in host-endian order) */
+	uint32_t probe_nxt;
 
 	/** Current TCP state */
 	unsigned int tcp_state;
@@ -67,11 +107,38 @@ struct tcp_connection {
 	 * Equivalent to (SND.NXT-SND.UNA) in RFC 793 terminology.
 	 */
 	uint32_t snd_sent;
+	/** Maximum unacknowledged sequence count
+	 *
+	 * Equivalent to (SND.MAX-SND.UNA), where SND.MAX is the
+	 * highest sequence number ever sent.  This may exceed the
+	 * unacknowledged sequence count following a retransmission
+	 * timeout.
+	 */
+	uint32_t snd_max;
 	/** Send window
 	 *
 	 * Equivalent to SND.WND in RFC 793 terminology
 	 */
 	uint32_t snd_win;
+	/** Congestion window
+	 *
+	 * Equivalent to cwnd in RFC 5681 terminology
+	 */
+	uint32_t cwnd;
+	/** Slow start threshold
+	 *
+	 * Equivalent to ssthresh in RFC 5681 terminology
+	 */
+	uint32_t ssthresh;
+	/** Number of consecutive duplicate acknowledgements received */
+	unsigned int dupacks;
+	/** Fast recovery point
+	 *
+	 * Equivalent to "recover" in RFC 6582 terminology
+	 */
+	uint32_t recover;
+	/** Next sequence number eligible for fast retransmission */
+	uint32_t rtx_seq;
 	/** Current acknowledgement number
 	 *
 	 * Equivalent to RCV.NXT in RFC 793 terminology.
@@ -82,6 +149,26 @@ struct tcp_connection {
 	 * Equivalent to RCV.WND in RFC 793 terminology.
 	 */
 	uint32_t rcv_win;
+	/** Number of received data segments not yet acknowledged */
+	unsigned int rcv_unacked;
+	/** Receive window limit
+	 *
+	 * This is tuned according to the measured bandwidth-delay
+	 * product, and is the largest window that will be advertised.
+	 */
+	uint32_t rcv_space;
+	/** Maximum receive window limit
+	 *
+	 * This is reduced in response to memory pressure, and
+	 * recovers gradually once the pressure has eased.
+	 */
+	uint32_t rcv_space_max;
+	/** Time at which maximum receive window limit last changed */
+	unsigned long rcv_space_changed;
+	/** Acknowledgement number at start of window measurement */
+	uint32_t rcv_space_seq;
+	/** Time at which window measurement started */
+	unsigned long rcv_space_start;
 	/** Received timestamp value
 	 *
 	 * Updated when a packet is received; copied to ts_recent when
@@ -93,6 +180,25 @@ struct tcp_connection {
 	 * Equivalent to TS.Recent in RFC 1323 terminology.
 	 */
 	uint32_t ts_recent;
+	/** Smoothed round-trip time (in units of 1/8 ticks)
+	 *
+	 * Equivalent to SRTT in RFC 6298 terminology.
+	 */
+	unsigned long srtt;
+	/** Round-trip time variation (in units of 1/4 ticks)
+	 *
+	 * Equivalent to RTTVAR in RFC 6298 terminology.
+	 */
+	unsigned long rttvar;
+	/** Retransmission timeout (in ticks)
+	 *
+	 * Equivalent to RTO in RFC 6298 terminology.
+	 */
+	unsigned long rto;
+	/** Sequence number being timed (if not using timestamps) */
+	uint32_t rtt_seq;
+	/** Time at which timed sequence number was sent */
+	unsigned long rtt_start;
 	/** Send window scale
 	 *
 	 * Equivalent to Snd.Wind.Scale in RFC 1323 terminology
@@ -106,17 +212,50 @@ struct tcp_connection {
 
 	/** Selective acknowledgement list (in host-endian order) */
 	struct tcp_sack_block sack[TCP_SACK_MAX];
+	/** Selectively acknowledged transmitted data (in host-endian order)
+	 *
+	 * This is the list of blocks reported by the peer as having
+	 * been received beyond SND.UNA.
+	 */
+	struct tcp_sack_block sacked[TCP_SACK_MAX];
 
 	/** Transmit queue */
 	struct list_head tx_queue;
-	/** Receive queue */
+	/** Length of data in transmit queue */
+	size_t tx_len;
+	/** Transmit queue cursor
+	 *
+	 * This is the I/O buffer from which data was most recently
+	 * copied for transmission (or NULL), allowing consecutive
+	 * segments to be constructed without rescanning the transmit
+	 * queue from the start.
+	 */
+	struct io_buffer *tx_cursor;
+	/** Offset of transmit queue cursor within transmit queue */
+	size_t tx_cursor_offset;
+	/** Receive queue
+	 *
+	 * Received packets are held in sequence order, with no
+	 * overlapping data.
+	 */
 	struct list_head rx_queue;
+	/** Received sequence ranges (in sequence order)
+	 *
+	 * Adjacent ranges are always separated by a gap.
+	 */
+	struct tcp_rx_range rx_range[TCP_RX_RANGES_MAX];
+	/** Number of received sequence ranges */
+	unsigned int rx_ranges;
+	/** Received in-order data awaiting delivery */
+	struct list_head rx_deliver;
 	/** Transmission process */
 	struct process process;
 	/** Retransmission timer */
 	struct retry_timer timer;
 	/** Keepalive timer */
 	struct retry_timer keepalive;
+	/** Delayed acknowledgement timer */
+	struct retry_timer delack;
 	/** Shutdown (TIME_WAIT) timer */
 	struct retry_timer wait;
 
@@ -124,6 +263,15 @@ struct tcp_connection {
 	struct pending_operation pending_flags;
 	/** Pending operations for transmit queue */
 	struct pending_operation pending_data;
+
+	/** Time at which connection was opened */
+	unsigned long start;
+	/** Number of retransmissions */
+	unsigned long retransmits;
+	/** Number of octets received and passed to upper layer */
+	unsigned long in_octets;
+	/** Number of octets sent and acknowledged by peer */
+	unsigned long out_octets;
 };
 
 /** TCP flags */
@@ -136,6 +284,18 @@ enum tcp_flags {
 	TCP_ACK_PENDING = 0x0004,
 	/** TCP selective acknowledgement is enabled */
 	TCP_SACK_ENABLED = 0x0008,
+	/** TCP fast recovery is in progress */
+	TCP_FAST_RECOVERY = 0x0010,
+	/** A round-trip time measurement has been made */
+	TCP_RTT_VALID = 0x0020,
+	/** A transmitted sequence number is being timed */
+	TCP_RTT_TIMING = 0x0040,
+	/** TCP acknowledgement may be delayed */
+	TCP_ACK_DELAYED = 0x0080,
+	/** A path MTU probe has been lost */
+	TCP_PROBE_LOST = 0x0100,
+	/** TCP segmentation offload is available */
+	TCP_TSO = 0x0200,
 };
 
 /** TCP internal header
@@ -168,6 +328,15 @@ struct tcp_rx_queued_header {
  */
 static LIST_HEAD ( tcp_conns );
 
+/**
+ * TCP connections indexed by local port
+ *
+ * Each connection has a unique local port, and so may be identified
+ * by local port alone.  Each hash bucket is initialised on first use
+ * (see tcp_bucket()).
+ */
+static struct list_head tcp_hash[TCPIP_PORT_HASH_SIZE];
+
 /** TCP statistics */
 struct tcp_statistics tcp_stats;
 
@@ -175,20 +344,25 @@ struct tcp_statistics tcp_stats;
 static struct profiler tcp_tx_profiler __profiler = { .name = "tcp.tx" };
 
 /** Receive profiler */
-static struct profiler tcp_rx_profiler __profiler = { .name = "tcp.rx" };
+static struct profiler tcp_rx_profiler __profiler =
+	{ .name = "tcp.rx", .hist = PROFILE_HISTOGRAM };
 
 /** Data transfer profiler */
-static struct profiler tcp_xfer_profiler __profiler = { .name = "tcp.xfer" };
+static struct profiler tcp_xfer_profiler __profiler =
+	{ .name = "tcp.xfer", .hist = PROFILE_HISTOGRAM };
 
 /* Forward declarations */
 static struct process_descriptor tcp_process_desc;
 static struct interface_descriptor tcp_xfer_desc;
 static void tcp_expired ( struct retry_timer *timer, int over );
 static void tcp_keepalive_expired ( struct retry_timer *timer, int over );
+static void tcp_delack_expired ( struct retry_timer *timer, int over );
 static void tcp_wait_expired ( struct retry_timer *timer, int over );
 static struct tcp_connection * tcp_demux ( unsigned int local_port );
+static void tcp_rx_deliver ( struct tcp_connection *tcp );
 static int tcp_rx_ack ( struct tcp_connection *tcp, uint32_t ack,
-			uint32_t win );
+			uint32_t win, size_t seq_len,
+			const struct tcp_options *options );
 
 /**
  * Name TCP state
@@ -248,6 +422,23 @@ tcp_dump_flags ( struct tcp_connection *tcp, unsigned int flags ) {
 		DBGC2 ( tcp, " ACK" );
 }
 
+/**
+ * Dump TCP connection statistics
+ *
+ * @v tcp		TCP connection
+ */
+static inline __attribute__ (( always_inline )) void
+tcp_dump_stats ( struct tcp_connection *tcp ) {
+
+	DBGC ( tcp, "TCP %p received %ld bytes, sent %ld bytes in %ld "
+	       "ticks with %ld retransmissions\n", tcp, tcp->in_octets,
+	       tcp->out_octets, ( currticks() - tcp->start ),
+	       tcp->retransmits );
+	DBGC ( tcp, "TCP %p SRTT %ld/8 RTTVAR %ld/4 RTO %ld ticks, cwnd %d "
+	       "ssthresh %d\n", tcp, tcp->srtt, tcp->rttvar, tcp->rto,
+	       tcp->cwnd, tcp->ssthresh );
+}
+
 /***************************************************************************
  *
  * Open and close
@@ -255,6 +446,22 @@ tcp_dump_flags ( struct tcp_connection *tcp, unsigned int flags ) {
  ***************************************************************************
  */
 
+/**
+ * Get local port hash bucket
+ *
+ * @v local_port	Local port
+ * @ret bucket		List of connections within hash bucket
+ */
+static inline struct list_head * tcp_bucket ( unsigned int local_port ) {
+	struct list_head *bucket = &tcp_hash[ tcpip_port_hash ( local_port ) ];
+
+	/* Initialise bucket on first use */
+	if ( ! bucket->next )
+		INIT_LIST_HEAD ( bucket );
+
+	return bucket;
+}
+
 /**
  * Check if local TCP port is available
  *
@@ -279,6 +486,7 @@ static int tcp_open ( struct interface *xfer, struct sockaddr *peer,
 	struct sockaddr_tcpip *st_peer = ( struct sockaddr_tcpip * ) peer;
 	struct sockaddr_tcpip *st_local = ( struct sockaddr_tcpip * ) local;
 	struct tcp_connection *tcp;
+	struct net_device *netdev;
 	size_t mtu;
 	int port;
 	int rc;
@@ -293,13 +501,16 @@ static int tcp_open ( struct interface *xfer, struct sockaddr *peer,
 	process_init_stopped ( &tcp->process, &tcp_process_desc, &tcp->refcnt );
 	timer_init ( &tcp->timer, tcp_expired, &tcp->refcnt );
 	timer_init ( &tcp->keepalive, tcp_keepalive_expired, &tcp->refcnt );
+	timer_init ( &tcp->delack, tcp_delack_expired, &tcp->refcnt );
 	timer_init ( &tcp->wait, tcp_wait_expired, &tcp->refcnt );
 	tcp->prev_tcp_state = TCP_CLOSED;
 	tcp->tcp_state = TCP_STATE_SENT ( TCP_SYN );
 	tcp_dump_state ( tcp );
 	tcp->snd_seq = random();
+	tcp->start = currticks();
 	INIT_LIST_HEAD ( &tcp->tx_queue );
 	INIT_LIST_HEAD ( &tcp->rx_queue );
+	INIT_LIST_HEAD ( &tcp->rx_deliver );
 	memcpy ( &tcp->peer, st_peer, sizeof ( tcp->peer ) );
 
 	/* Calculate MSS */
@@ -311,6 +522,23 @@ static int tcp_open ( struct interface *xfer, struct sockaddr *peer,
 		goto err;
 	}
 	tcp->mss = ( mtu - sizeof ( struct tcp_header ) );
+	tcp->snd_mss_max = tcp->mss;
+	tcp->snd_mss = ( ( tcp->mss < TCP_BASE_MSS ) ? tcp->mss : TCP_BASE_MSS );
+
+	/* Use segmentation offload, if available */
+	netdev = tcpip_netdev ( &tcp->peer );
+	if ( netdev && ( netdev->state & NETDEV_TX_TSO ) )
+		tcp->flags |= TCP_TSO;
+
+	/* Initialise congestion control */
+	tcp->cwnd = tcp_initial_cwnd ( tcp->snd_mss );
+	tcp->ssthresh = TCP_MAX_TX_QUEUE;
+	tcp->recover = tcp->snd_seq;
+	tcp->rto = TCP_INITIAL_RTO;
+
+	/* Initialise receive window limit */
+	tcp->rcv_space = TCP_INITIAL_WINDOW_SIZE;
+	tcp->rcv_space_max = TCP_MAX_WINDOW_SIZE;
 
 	/* Bind to local port */
 	port = tcpip_bind ( st_local, tcp_port_available );
@@ -334,6 +562,7 @@ static int tcp_open ( struct interface *xfer, struct sockaddr *peer,
 	 */
 	intf_plug_plug ( &tcp->xfer, xfer );
 	list_add ( &tcp->list, &tcp_conns );
+	list_add ( &tcp->hash, tcp_bucket ( tcp->local_port ) );
 	return 0;
 
  err:
@@ -358,6 +587,12 @@ static void tcp_close ( struct tcp_connection *tcp, int rc ) {
 	intf_shutdown ( &tcp->xfer, rc );
 	tcp->flags |= TCP_XFER_CLOSED;
 
+	/* Discard any undelivered received data */
+	list_for_each_entry_safe ( iobuf, tmp, &tcp->rx_deliver, list ) {
+		list_del ( &iobuf->list );
+		free_iob ( iobuf );
+	}
+
 	/* If we are in CLOSED, or have otherwise not yet received a
 	 * SYN (i.e. we are in LISTEN or SYN_SENT), just delete the
 	 * connection.
@@ -373,6 +608,7 @@ static void tcp_close ( struct tcp_connection *tcp, int rc ) {
 			list_del ( &iobuf->list );
 			free_iob ( iobuf );
 		}
+		tcp->rx_ranges = 0;
 
 		/* Free any unsent I/O buffers */
 		list_for_each_entry_safe ( iobuf, tmp, &tcp->tx_queue, list ) {
@@ -380,6 +616,7 @@ static void tcp_close ( struct tcp_connection *tcp, int rc ) {
 			free_iob ( iobuf );
 			pending_put ( &tcp->pending_data );
 		}
+		tcp->tx_cursor = NULL;
 		assert ( ! is_pending ( &tcp->pending_data ) );
 
 		/* Remove pending operations for SYN and FIN, if applicable */
@@ -390,8 +627,11 @@ static void tcp_close ( struct tcp_connection *tcp, int rc ) {
 		process_del ( &tcp->process );
 		stop_timer ( &tcp->timer );
 		stop_timer ( &tcp->keepalive );
+		stop_timer ( &tcp->delack );
 		stop_timer ( &tcp->wait );
 		list_del ( &tcp->list );
+		list_del ( &tcp->hash );
+		tcp_dump_stats ( tcp );
 		ref_put ( &tcp->refcnt );
 		DBGC ( tcp, "TCP %p connection deleted\n", tcp );
 		return;
@@ -402,7 +642,7 @@ static void tcp_close ( struct tcp_connection *tcp, int rc ) {
 	 * can send a FIN without breaking things.
 	 */
 	if ( ! ( tcp->tcp_state & TCP_STATE_ACKED ( TCP_SYN ) ) )
-		tcp_rx_ack ( tcp, ( tcp->snd_seq + 1 ), 0 );
+		tcp_rx_ack ( tcp, ( tcp->snd_seq + 1 ), 0, 0, NULL );
 
 	/* Stop keepalive timer */
 	stop_timer ( &tcp->keepalive );
@@ -420,6 +660,55 @@ static void tcp_close ( struct tcp_connection *tcp, int rc ) {
 	}
 }
 
+/**
+ * Get TCP connection information
+ *
+ * @v index		Connection index
+ * @v info		Connection information to fill in
+ * @ret rc		Return status code
+ *
+ * Connections are numbered from zero.  An error is returned if no
+ * connection exists with the specified index.
+ */
+int tcp_info ( unsigned int index, struct tcp_info *info ) {
+	struct tcp_connection *tcp;
+	struct io_buffer *iobuf;
+
+	/* Find connection */
+	list_for_each_entry ( tcp, &tcp_conns, list ) {
+		if ( index-- == 0 )
+			break;
+	}
+	if ( &tcp->list == &tcp_conns )
+		return -ENOENT;
+
+	/* Fill in connection information */
+	memset ( info, 0, sizeof ( *info ) );
+	memcpy ( &info->peer, &tcp->peer, sizeof ( info->peer ) );
+	info->local_port = tcp->local_port;
+	info->state = tcp_state ( tcp->tcp_state );
+	info->snd_win = tcp->snd_win;
+	info->snd_win_scale = tcp->snd_win_scale;
+	info->cwnd = tcp->cwnd;
+	info->rcv_win = tcp->rcv_win;
+	info->rcv_win_scale = tcp->rcv_win_scale;
+	info->rcv_space = tcp->rcv_space;
+	info->rcv_space_max = tcp->rcv_space_max;
+	info->sack = ( !! ( tcp->flags & TCP_SACK_ENABLED ) );
+	info->ts = ( !! ( tcp->flags & TCP_TS_ENABLED ) );
+	info->snd_mss = tcp->snd_mss;
+	info->srtt = ( ( tcp->srtt * 1000 ) / ( 8 * TICKS_PER_SEC ) );
+	info->rto = ( ( tcp->rto * 1000 ) / TICKS_PER_SEC );
+	info->retransmits = tcp->retransmits;
+	info->in_octets = tcp->in_octets;
+	info->out_octets = tcp->out_octets;
+	list_for_each_entry ( iobuf, &tcp->rx_queue, list )
+		info->rx_queued++;
+	info->age = ( currticks() - tcp->start );
+
+	return 0;
+}
+
 /***************************************************************************
  *
  * Transmit data path
@@ -431,7 +720,7 @@ static void tcp_close ( struct tcp_connection *tcp, int rc ) {
  * Calculate transmission window
  *
  * @v tcp		TCP connection
- * @ret len		Maximum length that can be sent in a single packet
+ * @ret len		Maximum amount of sequence space that may be in flight
  */
 static size_t tcp_xmit_win ( struct tcp_connection *tcp ) {
 	size_t len;
@@ -440,10 +729,12 @@ static size_t tcp_xmit_win ( struct tcp_connection *tcp ) {
 	if ( ! TCP_CAN_SEND_DATA ( tcp->tcp_state ) )
 		return 0;
 
-	/* Length is the minimum of the receiver's window and the path MTU */
+	/* Length is the minimum of the receiver's window and the
+	 * congestion window.
+	 */
 	len = tcp->snd_win;
-	if ( len > TCP_PATH_MTU )
-		len = TCP_PATH_MTU;
+	if ( len > tcp->cwnd )
+		len = tcp->cwnd;
 
 	return len;
 }
@@ -455,16 +746,51 @@ static size_t tcp_xmit_win ( struct tcp_connection *tcp ) {
  * @ret len		Length of window
  */
 static size_t tcp_xfer_window ( struct tcp_connection *tcp ) {
+	size_t len;
+
+	/* Not ready if we're not in a suitable connection state */
+	if ( ! TCP_CAN_SEND_DATA ( tcp->tcp_state ) )
+		return 0;
 
-	/* Not ready if data queue is non-empty.  This imposes a limit
-	 * of only one unACKed packet in the TX queue at any time; we
-	 * do this to conserve memory usage.
+	/* Allow the transmit queue to be filled up to the receiver's
+	 * window, subject to an upper limit to conserve memory.  Data
+	 * remains in the transmit queue until it is acknowledged.
 	 */
-	if ( ! list_empty ( &tcp->tx_queue ) )
+	len = tcp->snd_win;
+	if ( len > TCP_MAX_TX_QUEUE )
+		len = TCP_MAX_TX_QUEUE;
+	if ( len <= tcp->tx_len )
 		return 0;
 
-	/* Return TCP window length */
-	return tcp_xmit_win ( tcp );
+	return ( len - tcp->tx_len );
+}
+
+/**
+ * Find received sequence range
+ *
+ * @v tcp		TCP connection
+ * @v seq		SEQ value (in host-endian order)
+ * @ret i		Index of first range not ending before SEQ
+ *
+ * The returned index will be equal to the number of ranges if all
+ * ranges end before SEQ.
+ */
+static unsigned int tcp_rx_range_find ( struct tcp_connection *tcp,
+					uint32_t seq ) {
+	unsigned int min = 0;
+	unsigned int max = tcp->rx_ranges;
+	unsigned int mid;
+
+	/* Binary search over ranges */
+	while ( min < max ) {
+		mid = ( ( min + max ) / 2 );
+		if ( tcp_cmp ( tcp->rx_range[mid].nxt, seq ) < 0 ) {
+			min = ( mid + 1 );
+		} else {
+			max = mid;
+		}
+	}
+	return min;
 }
 
 /**
@@ -477,31 +803,19 @@ static size_t tcp_xfer_window ( struct tcp_connection *tcp ) {
  */
 static uint32_t tcp_sack_block ( struct tcp_connection *tcp, uint32_t seq,
 				 struct tcp_sack_block *sack ) {
-	struct io_buffer *iobuf;
-	struct tcp_rx_queued_header *tcpqhdr;
-	uint32_t left = tcp->rcv_ack;
-	uint32_t right = left;
-
-	/* Find highest block which does not start after SEQ */
-	list_for_each_entry ( iobuf, &tcp->rx_queue, list ) {
-		tcpqhdr = iobuf->data;
-		if ( tcp_cmp ( tcpqhdr->seq, right ) > 0 ) {
-			if ( tcp_cmp ( tcpqhdr->seq, seq ) > 0 )
-				break;
-			left = tcpqhdr->seq;
-		}
-		if ( tcp_cmp ( tcpqhdr->nxt, right ) > 0 )
-			right = tcpqhdr->nxt;
-	}
+	struct tcp_rx_range *range;
+	unsigned int i;
 
-	/* Fail if this block does not contain SEQ */
-	if ( tcp_cmp ( right, seq ) < 0 )
+	/* Find range containing SEQ */
+	i = tcp_rx_range_find ( tcp, seq );
+	range = &tcp->rx_range[i];
+	if ( ( i == tcp->rx_ranges ) || ( tcp_cmp ( range->seq, seq ) > 0 ) )
 		return 0;
 
 	/* Populate SACK block */
-	sack->left = left;
-	sack->right = right;
-	return ( right - left );
+	sack->left = range->seq;
+	sack->right = range->nxt;
+	return ( range->nxt - range->seq );
 }
 
 /**
@@ -578,15 +892,27 @@ static size_t tcp_process_tx_queue ( struct tcp_connection *tcp, size_t max_len,
 
 	list_for_each_entry_safe ( iobuf, tmp, &tcp->tx_queue, list ) {
 		frag_len = iob_len ( iobuf );
-		if ( frag_len > max_len )
+		if ( frag_len > max_len ) {
+			/* Stop at the first I/O buffer that cannot be
+			 * processed in its entirety, rather than
+			 * walking the remainder of the queue.
+			 */
+			if ( ! max_len )
+				break;
 			frag_len = max_len;
+		}
 		if ( dest ) {
 			memcpy ( iob_put ( dest, frag_len ), iobuf->data,
 				 frag_len );
 		}
 		if ( remove ) {
 			iob_pull ( iobuf, frag_len );
+			tcp->tx_len -= frag_len;
+			if ( iobuf != tcp->tx_cursor )
+				tcp->tx_cursor_offset -= frag_len;
 			if ( ! iob_len ( iobuf ) ) {
+				if ( iobuf == tcp->tx_cursor )
+					tcp->tx_cursor = NULL;
 				list_del ( &iobuf->list );
 				free_iob ( iobuf );
 				pending_put ( &tcp->pending_data );
@@ -599,18 +925,99 @@ static size_t tcp_process_tx_queue ( struct tcp_connection *tcp, size_t max_len,
 }
 
 /**
- * Transmit any outstanding data (with selective acknowledgement)
+ * Copy data from TCP transmit queue
+ *
+ * @v tcp		TCP connection
+ * @v offset		Offset within transmit queue
+ * @v len		Length of data to copy
+ * @v dest		I/O buffer to fill with data
+ * @ret csum		Checksum of copied data
+ *
+ * The data is checksummed as it is copied, to avoid reading it a
+ * second time when calculating the segment checksum.
+ *
+ * The search for the starting I/O buffer resumes from the transmit
+ * queue cursor where possible, since segments are usually
+ * constructed in sequence order.
+ */
+static uint16_t tcp_copy_tx_queue ( struct tcp_connection *tcp,
+				    size_t offset, size_t len,
+				    struct io_buffer *dest ) {
+	struct io_buffer *iobuf;
+	uint16_t csum = TCPIP_EMPTY_CSUM;
+	size_t copied = 0;
+	size_t frag_len;
+
+	/* Do nothing if there is no data to copy */
+	if ( ! len )
+		return csum;
+
+	/* Start from the cursor, unless the data precedes the cursor */
+	iobuf = tcp->tx_cursor;
+	if ( iobuf && ( offset >= tcp->tx_cursor_offset ) ) {
+		offset -= tcp->tx_cursor_offset;
+	} else {
+		iobuf = list_first_entry ( &tcp->tx_queue, struct io_buffer,
+					   list );
+		tcp->tx_cursor_offset = 0;
+	}
+
+	for ( ; iobuf ; iobuf = list_next_entry ( iobuf, &tcp->tx_queue,
+						    list ) ) {
+		tcp->tx_cursor = iobuf;
+		frag_len = iob_len ( iobuf );
+		if ( offset < frag_len ) {
+			frag_len -= offset;
+			if ( frag_len > len )
+				frag_len = len;
+			/* Data starting at an odd offset is summed with
+			 * the bytes of each checksum word swapped.
+			 */
+			if ( copied & 1 )
+				csum = bswap_16 ( csum );
+			csum = tcpip_copy_chksum ( csum,
+						   iob_put ( dest, frag_len ),
+						   ( iobuf->data + offset ),
+						   frag_len );
+			if ( copied & 1 )
+				csum = bswap_16 ( csum );
+			copied += frag_len;
+			len -= frag_len;
+			if ( ! len )
+				break;
+			offset = 0;
+		} else {
+			offset -= frag_len;
+		}
+		tcp->tx_cursor_offset += iob_len ( iobuf );
+	}
+	assert ( len == 0 );
+
+	return csum;
+}
+
+/**
+ * Transmit segment
  *
  * @v tcp		TCP connection
+ * @v offset		Offset of segment from SND.UNA
+ * @v len		Length of data payload
+ * @v mss		Segment size for segmentation offload, or zero
+ * @v flags		TCP flags
  * @v sack_seq		SEQ for first selective acknowledgement (if any)
- * 
- * Transmits any outstanding data on the connection.
+ * @ret rc		Return status code
  *
- * Note that even if an error is returned, the retransmission timer
- * will have been started if necessary, and so the stack will
- * eventually attempt to retransmit the failed packet.
+ * The data payload (if any) is taken from the transmit queue at the
+ * specified offset.  The caller is responsible for updating the
+ * sequence counters and for starting the retransmission timer.
+ *
+ * If a segment size is specified, the payload may span multiple
+ * segments, which will be constructed by the network device (or in
+ * software, if the network device does not support segmentation).
  */
-static void tcp_xmit_sack ( struct tcp_connection *tcp, uint32_t sack_seq ) {
+static int tcp_xmit_segment ( struct tcp_connection *tcp, uint32_t offset,
+			      size_t len, size_t mss, unsigned int flags,
+			      uint32_t sack_seq ) {
 	struct io_buffer *iobuf;
 	struct tcp_header *tcphdr;
 	struct tcp_mss_option *mssopt;
@@ -620,11 +1027,11 @@ static void tcp_xmit_sack ( struct tcp_connection *tcp, uint32_t sack_seq ) {
 	struct tcp_sack_padded_option *sackopt;
 	struct tcp_sack_block *sack;
 	void *payload;
-	unsigned int flags;
+	uint16_t csum;
 	unsigned int sack_count;
 	unsigned int i;
-	size_t len = 0;
 	size_t sack_len;
+	uint32_t seq = ( tcp->snd_seq + offset );
 	uint32_t seq_len;
 	uint32_t max_rcv_win;
 	uint32_t max_representable_win;
@@ -633,55 +1040,32 @@ static void tcp_xmit_sack ( struct tcp_connection *tcp, uint32_t sack_seq ) {
 	/* Start profiling */
 	profile_start ( &tcp_tx_profiler );
 
-	/* If retransmission timer is already running, do nothing */
-	if ( timer_running ( &tcp->timer ) )
-		return;
-
-	/* Calculate both the actual (payload) and sequence space
-	 * lengths that we wish to transmit.
+	/* Calculate sequence space length.  SYN or FIN consume one
+	 * byte, and we can never send both.
 	 */
-	if ( TCP_CAN_SEND_DATA ( tcp->tcp_state ) ) {
-		len = tcp_process_tx_queue ( tcp, tcp_xmit_win ( tcp ),
-					     NULL, 0 );
-	}
 	seq_len = len;
-	flags = TCP_FLAGS_SENDING ( tcp->tcp_state );
 	if ( flags & ( TCP_SYN | TCP_FIN ) ) {
-		/* SYN or FIN consume one byte, and we can never send both */
 		assert ( ! ( ( flags & TCP_SYN ) && ( flags & TCP_FIN ) ) );
 		seq_len++;
 	}
-	tcp->snd_sent = seq_len;
-
-	/* If we have nothing to transmit, stop now */
-	if ( ( seq_len == 0 ) && ! ( tcp->flags & TCP_ACK_PENDING ) )
-		return;
-
-	/* If we are transmitting anything that requires
-	 * acknowledgement (i.e. consumes sequence space), start the
-	 * retransmission timer.  Do this before attempting to
-	 * allocate the I/O buffer, in case allocation itself fails.
-	 */
-	if ( seq_len )
-		start_timer ( &tcp->timer );
 
 	/* Allocate I/O buffer */
 	iobuf = alloc_iob ( len + TCP_MAX_HEADER_LEN );
 	if ( ! iobuf ) {
 		DBGC ( tcp, "TCP %p could not allocate iobuf for %08x..%08x "
-		       "%08x\n", tcp, tcp->snd_seq, ( tcp->snd_seq + seq_len ),
-		       tcp->rcv_ack );
-		return;
+		       "%08x\n", tcp, seq, ( seq + seq_len ), tcp->rcv_ack );
+		return -ENOMEM;
 	}
 	iob_reserve ( iobuf, TCP_MAX_HEADER_LEN );
+	iobuf->mss = mss;
 
 	/* Fill data payload from transmit queue */
-	tcp_process_tx_queue ( tcp, len, iobuf, 0 );
+	csum = tcp_copy_tx_queue ( tcp, offset, len, iobuf );
 
 	/* Expand receive window if possible */
 	max_rcv_win = xfer_window ( &tcp->xfer );
-	if ( max_rcv_win > TCP_MAX_WINDOW_SIZE )
-		max_rcv_win = TCP_MAX_WINDOW_SIZE;
+	if ( max_rcv_win > tcp->rcv_space )
+		max_rcv_win = tcp->rcv_space;
 	max_representable_win = ( 0xffff << tcp->rcv_win_scale );
 	if ( max_rcv_win > max_representable_win )
 		max_rcv_win = max_representable_win;
@@ -735,12 +1119,14 @@ static void tcp_xmit_sack ( struct tcp_connection *tcp, uint32_t sack_seq ) {
 	memset ( tcphdr, 0, sizeof ( *tcphdr ) );
 	tcphdr->src = htons ( tcp->local_port );
 	tcphdr->dest = tcp->peer.st_port;
-	tcphdr->seq = htonl ( tcp->snd_seq );
+	tcphdr->seq = htonl ( seq );
 	tcphdr->ack = htonl ( tcp->rcv_ack );
 	tcphdr->hlen = ( ( payload - iobuf->data ) << 2 );
 	tcphdr->flags = flags;
 	tcphdr->win = htons ( tcp->rcv_win >> tcp->rcv_win_scale );
-	tcphdr->csum = tcpip_chksum ( iobuf->data, iob_len ( iobuf ) );
+	tcphdr->csum = ( mss ? TCPIP_EMPTY_CSUM :
+			 tcpip_continue_chksum ( csum, iobuf->data,
+						 ( payload - iobuf->data ) ) );
 
 	/* Dump header */
 	DBGC2 ( tcp, "TCP %p TX %d->%d %08x..%08x           %08x %4zd",
@@ -754,15 +1140,233 @@ static void tcp_xmit_sack ( struct tcp_connection *tcp, uint32_t sack_seq ) {
 	if ( ( rc = tcpip_tx ( iobuf, &tcp_protocol, NULL, &tcp->peer, NULL,
 			       &tcphdr->csum ) ) != 0 ) {
 		DBGC ( tcp, "TCP %p could not transmit %08x..%08x %08x: %s\n",
-		       tcp, tcp->snd_seq, ( tcp->snd_seq + tcp->snd_sent ),
-		       tcp->rcv_ack, strerror ( rc ) );
-		return;
+		       tcp, seq, ( seq + seq_len ), tcp->rcv_ack,
+		       strerror ( rc ) );
+		return rc;
 	}
 
-	/* Clear ACK-pending flag */
-	tcp->flags &= ~TCP_ACK_PENDING;
+	/* Clear ACK-pending flag and any delayed acknowledgement */
+	tcp->flags &= ~( TCP_ACK_PENDING | TCP_ACK_DELAYED );
+	tcp->rcv_unacked = 0;
+	stop_timer ( &tcp->delack );
 
 	profile_stop ( &tcp_tx_profiler );
+	return 0;
+}
+
+/**
+ * Record transmitted sequence space
+ *
+ * @v tcp		TCP connection
+ * @v seq_len		Length of sequence space transmitted
+ *
+ * The retransmission timer is started (if not already running) before
+ * the segment is constructed, in case construction itself fails.
+ */
+static void tcp_xmit_seq ( struct tcp_connection *tcp, uint32_t seq_len ) {
+
+	/* Update sequence counters */
+	tcp->snd_sent += seq_len;
+	if ( tcp->snd_max < tcp->snd_sent ) {
+		tcp->snd_max = tcp->snd_sent;
+
+		/* Time this transmission if nothing is being timed
+		 * (and it is not a retransmission).
+		 */
+		if ( ! ( tcp->flags & TCP_RTT_TIMING ) ) {
+			tcp->rtt_seq = ( tcp->snd_seq + tcp->snd_sent );
+			tcp->rtt_start = currticks();
+			tcp->flags |= TCP_RTT_TIMING;
+		}
+	}
+
+	/* Start retransmission timer, if not already running */
+	if ( ! timer_running ( &tcp->timer ) )
+		start_timer_fixed ( &tcp->timer, tcp->rto );
+}
+
+/**
+ * Calculate maximum segment payload length
+ *
+ * @v tcp		TCP connection
+ * @v mss		Maximum segment size (excluding TCP options)
+ * @ret len		Maximum segment payload length
+ */
+static size_t tcp_xmit_len ( struct tcp_connection *tcp, size_t mss ) {
+	size_t opts_len = 0;
+
+	/* Allow for any timestamp and selective acknowledgement options */
+	if ( tcp->flags & TCP_TS_ENABLED )
+		opts_len += sizeof ( struct tcp_timestamp_padded_option );
+	if ( ( tcp->flags & TCP_SACK_ENABLED ) &&
+	     ( ! list_empty ( &tcp->rx_queue ) ) ) {
+		opts_len += ( sizeof ( struct tcp_sack_padded_option ) +
+			      ( TCP_SACK_MAX *
+				sizeof ( struct tcp_sack_block ) ) );
+	}
+
+	return ( mss - opts_len );
+}
+
+/**
+ * Choose path MTU probe size
+ *
+ * @v tcp		TCP connection
+ * @ret mss		Maximum segment size to probe, or zero
+ *
+ * Packetization layer path MTU discovery (RFC 4821) is used to find
+ * the largest segment that can traverse the path to the peer.  The
+ * first probe is made at the upper bound, since the path MTU will
+ * usually match the MTU of the local link.  Following a lost probe,
+ * the remaining range is searched by bisection.
+ */
+static size_t tcp_probe_mss ( struct tcp_connection *tcp ) {
+
+	/* Do not probe while a probe is already in flight, or while
+	 * recovering from loss.
+	 */
+	if ( tcp->probe_mss || ( tcp->flags & TCP_FAST_RECOVERY ) ||
+	     ( tcp->snd_sent != tcp->snd_max ) )
+		return 0;
+
+	/* Stop once the remaining search range is small */
+	if ( ( tcp->snd_mss_max - tcp->snd_mss ) < TCP_PROBE_MIN )
+		return 0;
+
+	/* Probe at upper bound, or bisect following a lost probe */
+	if ( tcp->flags & TCP_PROBE_LOST )
+		return ( ( tcp->snd_mss + tcp->snd_mss_max ) / 2 );
+	return tcp->snd_mss_max;
+}
+
+/**
+ * Complete path MTU probe
+ *
+ * @v tcp		TCP connection
+ * @v lost		Probe was lost
+ */
+static void tcp_probe_complete ( struct tcp_connection *tcp, int lost ) {
+
+	/* Update transmit maximum segment size or search range */
+	if ( lost ) {
+		DBGC ( tcp, "TCP %p lost path MTU probe with MSS %zd\n",
+		       tcp, tcp->probe_mss );
+		tcp->snd_mss_max = ( tcp->probe_mss - 1 );
+		tcp->flags |= TCP_PROBE_LOST;
+	} else {
+		DBGC ( tcp, "TCP %p increased MSS from %zd to %zd\n",
+		       tcp, tcp->snd_mss, tcp->probe_mss );
+		tcp->snd_mss = tcp->probe_mss;
+	}
+	tcp->probe_mss = 0;
+}
+
+/**
+ * Transmit any outstanding data (with selective acknowledgement)
+ *
+ * @v tcp		TCP connection
+ * @v sack_seq		SEQ for first selective acknowledgement (if any)
+ * 
+ * Transmits as much outstanding data as the transmission window
+ * allows, followed by a pure ACK if an acknowledgement is still
+ * pending.
+ *
+ * Note that even if transmission fails, the retransmission timer
+ * will have been started if necessary, and so the stack will
+ * eventually attempt to retransmit the failed packet.
+ */
+static void tcp_xmit_sack ( struct tcp_connection *tcp, uint32_t sack_seq ) {
+	unsigned int flags;
+	size_t probe_mss;
+	size_t max_len;
+	size_t mss;
+	size_t win;
+	size_t len;
+
+	/* Transmit SYN or FIN, if not already in flight.  We never
+	 * have data outstanding while sending either SYN or FIN.
+	 */
+	flags = TCP_FLAGS_SENDING ( tcp->tcp_state );
+	if ( ( flags & ( TCP_SYN | TCP_FIN ) ) && ( tcp->snd_sent == 0 ) ) {
+		tcp_xmit_seq ( tcp, 1 );
+		tcp_xmit_segment ( tcp, 0, 0, 0, flags, sack_seq );
+	}
+	flags &= ~( TCP_SYN | TCP_FIN );
+
+	/* Transmit as much data as the window allows */
+	win = tcp_xmit_win ( tcp );
+	while ( ( tcp->snd_sent < tcp->tx_len ) && ( tcp->snd_sent < win ) ) {
+
+		/* Calculate segment length.  A path MTU probe is sent
+		 * only if there is sufficient data and window for a
+		 * full-sized probe segment.  If the window is large
+		 * enough but not yet open, wait for it to open rather
+		 * than filling it with smaller segments.
+		 */
+		len = ( tcp->tx_len - tcp->snd_sent );
+		probe_mss = tcp_probe_mss ( tcp );
+		if ( probe_mss ) {
+			max_len = tcp_xmit_len ( tcp, probe_mss );
+			if ( ( len < max_len ) || ( win < max_len ) ) {
+				probe_mss = 0;
+			} else if ( ( win - tcp->snd_sent ) < max_len ) {
+				break;
+			}
+		}
+		if ( ! probe_mss )
+			max_len = tcp_xmit_len ( tcp, tcp->snd_mss );
+
+		/* Send multiple full-sized segments at once using
+		 * segmentation offload, if available.  The payload is
+		 * limited to a whole number of segments unless it
+		 * includes the end of the transmit queue.
+		 */
+		mss = 0;
+		if ( ( tcp->flags & TCP_TSO ) && ( ! probe_mss ) &&
+		     ( len > max_len ) &&
+		     ( ( win - tcp->snd_sent ) > max_len ) ) {
+			mss = max_len;
+			max_len = ( win - tcp->snd_sent );
+			if ( max_len > TCP_TSO_MAX_LEN )
+				max_len = TCP_TSO_MAX_LEN;
+			if ( len > max_len )
+				max_len -= ( max_len % mss );
+		}
+		if ( len > max_len )
+			len = max_len;
+		if ( len <= mss )
+			mss = 0;
+		if ( len > ( win - tcp->snd_sent ) ) {
+			/* Avoid silly window syndrome: wait for a
+			 * full-sized segment to fit within the window,
+			 * unless there is nothing currently in flight.
+			 */
+			if ( tcp->snd_sent )
+				break;
+			len = ( win - tcp->snd_sent );
+		}
+
+		/* Record path MTU probe, if applicable */
+		if ( probe_mss ) {
+			tcp->probe_mss = probe_mss;
+			tcp->probe_seq = ( tcp->snd_seq + tcp->snd_sent );
+			tcp->probe_nxt = ( tcp->probe_seq + len );
+			DBGC ( tcp, "TCP %p probing MSS %zd with %08x..%08x\n",
+			       tcp, probe_mss, tcp->probe_seq,
+			       tcp->probe_nxt );
+		}
+
+		/* Transmit segment */
+		tcp_xmit_seq ( tcp, len );
+		if ( tcp_xmit_segment ( tcp, ( tcp->snd_sent - len ), len,
+					mss, flags, sack_seq ) != 0 )
+			break;
+	}
+
+	/* Transmit pure ACK, if still pending and not delayed */
+	if ( ( tcp->flags & ( TCP_ACK_PENDING | TCP_ACK_DELAYED ) ) ==
+	     TCP_ACK_PENDING )
+		tcp_xmit_segment ( tcp, tcp->snd_sent, 0, 0, flags, sack_seq );
 }
 
 /**
@@ -776,9 +1380,114 @@ static void tcp_xmit ( struct tcp_connection *tcp ) {
 	tcp_xmit_sack ( tcp, tcp->rcv_ack );
 }
 
+/**
+ * Deliver received data and transmit any outstanding data
+ *
+ * @v tcp		TCP connection
+ *
+ * This runs once all packets received within a single poll of the
+ * network stack have been processed.
+ */
+static void tcp_step ( struct tcp_connection *tcp ) {
+
+	/* Deliver any gathered received data */
+	tcp_rx_deliver ( tcp );
+
+	/* Transmit any outstanding data and acknowledgement */
+	tcp_xmit ( tcp );
+}
+
 /** TCP process descriptor */
 static struct process_descriptor tcp_process_desc =
-	PROC_DESC_ONCE ( struct tcp_connection, process, tcp_xmit );
+	PROC_DESC_ONCE ( struct tcp_connection, process, tcp_step );
+
+/**
+ * Retransmit next missing segment during fast recovery
+ *
+ * @v tcp		TCP connection
+ *
+ * If the peer has reported selectively acknowledged blocks, then the
+ * first hole not yet retransmitted is sent.  Otherwise, the segment
+ * at SND.UNA is sent if it has not yet been retransmitted.
+ */
+static void tcp_xmit_rtx ( struct tcp_connection *tcp ) {
+	struct tcp_sack_block *sacked;
+	uint32_t start = tcp->snd_seq;
+	uint32_t end = ( tcp->snd_seq + tcp->snd_sent );
+	uint32_t highest = tcp->snd_seq;
+	uint32_t seq = start;
+	unsigned int flags;
+	unsigned int i;
+	uint32_t max_len;
+	uint32_t len;
+	int moved;
+
+	/* Do nothing unless we have data in flight */
+	flags = TCP_FLAGS_SENDING ( tcp->tcp_state );
+	if ( ( flags & ( TCP_SYN | TCP_FIN ) ) || ( tcp->snd_sent == 0 ) )
+		return;
+
+	/* Start from the first sequence number not yet retransmitted */
+	if ( tcp_cmp ( tcp->rtx_seq, seq ) > 0 )
+		seq = tcp->rtx_seq;
+
+	/* Skip over any selectively acknowledged blocks */
+	do {
+		moved = 0;
+		for ( i = 0 ; i < TCP_SACK_MAX ; i++ ) {
+			sacked = &tcp->sacked[i];
+			if ( sacked->left == sacked->right )
+				continue;
+			if ( tcp_cmp ( sacked->right, highest ) > 0 )
+				highest = sacked->right;
+			if ( ( tcp_cmp ( seq, sacked->left ) >= 0 ) &&
+			     ( tcp_cmp ( seq, sacked->right ) < 0 ) ) {
+				seq = sacked->right;
+				moved = 1;
+			}
+		}
+	} while ( moved );
+
+	/* Identify end of hole */
+	if ( highest != start ) {
+		/* Retransmit only holes below the highest SACKed data */
+		if ( tcp_cmp ( end, highest ) > 0 )
+			end = highest;
+		for ( i = 0 ; i < TCP_SACK_MAX ; i++ ) {
+			sacked = &tcp->sacked[i];
+			if ( sacked->left == sacked->right )
+				continue;
+			if ( ( tcp_cmp ( sacked->left, seq ) > 0 ) &&
+			     ( tcp_cmp ( sacked->left, end ) < 0 ) )
+				end = sacked->left;
+		}
+	} else if ( seq != start ) {
+		/* Without SACK, retransmit only the first segment */
+		return;
+	}
+	if ( tcp_cmp ( end, seq ) <= 0 )
+		return;
+	len = ( end - seq );
+	max_len = tcp_xmit_len ( tcp, tcp->snd_mss );
+	if ( len > max_len )
+		len = max_len;
+
+	/* Treat any path MTU probe being retransmitted as lost */
+	if ( tcp->probe_mss && ( tcp_cmp ( seq, tcp->probe_nxt ) < 0 ) &&
+	     ( tcp_cmp ( ( seq + len ), tcp->probe_seq ) > 0 ) ) {
+		tcp_probe_complete ( tcp, 1 );
+	}
+
+	/* Retransmit segment.  Any round-trip time measurement in
+	 * progress is abandoned, as per Karn's algorithm.
+	 */
+	DBGC ( tcp, "TCP %p retransmitting %08x..%08x\n",
+	       tcp, seq, ( seq + len ) );
+	tcp->rtx_seq = ( seq + len );
+	tcp->flags &= ~TCP_RTT_TIMING;
+	tcp->retransmits++;
+	tcp_xmit_segment ( tcp, ( seq - start ), len, 0, flags, tcp->rcv_ack );
+}
 
 /**
  * Retransmission timer expired
@@ -789,6 +1498,7 @@ static struct process_descriptor tcp_process_desc =
 static void tcp_expired ( struct retry_timer *timer, int over ) {
 	struct tcp_connection *tcp =
 		container_of ( timer, struct tcp_connection, timer );
+	uint32_t ssthresh;
 
 	DBGC ( tcp, "TCP %p timer %s in %s for %08x..%08x %08x\n", tcp,
 	       ( over ? "expired" : "fired" ), tcp_state ( tcp->tcp_state ),
@@ -809,11 +1519,40 @@ static void tcp_expired ( struct retry_timer *timer, int over ) {
 		tcp_dump_state ( tcp );
 		tcp_close ( tcp, -ETIMEDOUT );
 	} else {
-		/* Otherwise, retransmit the packet */
+		/* Back off the retransmission timeout (if anything
+		 * was actually in flight), as per RFC 6298, and
+		 * abandon any round-trip time measurement in
+		 * progress, as per Karn's algorithm.
+		 */
+		if ( tcp->snd_max ) {
+			tcp->rto <<= 1;
+			tcp->flags &= ~TCP_RTT_TIMING;
+			tcp->retransmits++;
+		}
+
+		/* Collapse the congestion window as per
+		 * RFC 5681, abandon any fast recovery, and retransmit
+		 * everything from the oldest unacknowledged byte.
+		 * The SACK information is discarded, since the peer
+		 * is permitted to renege on it.
+		 */
+		if ( TCP_CAN_SEND_DATA ( tcp->tcp_state ) ) {
+			ssthresh = ( tcp->snd_max / 2 );
+			if ( ssthresh < ( 2 * tcp->snd_mss ) )
+				ssthresh = ( 2 * tcp->snd_mss );
+			tcp->ssthresh = ssthresh;
+			tcp->cwnd = tcp->snd_mss;
+		}
+		tcp->flags &= ~TCP_FAST_RECOVERY;
+		tcp->recover = ( tcp->snd_seq + tcp->snd_max );
+		tcp->dupacks = 0;
+		if ( tcp->probe_mss )
+			tcp_probe_complete ( tcp, 1 );
+		memset ( tcp->sacked, 0, sizeof ( tcp->sacked ) );
+		tcp->snd_sent = 0;
 		tcp_xmit ( tcp );
 	}
 }
-
 /**
  * Keepalive timer expired
  *
@@ -837,6 +1576,23 @@ static void tcp_keepalive_expired ( struct retry_timer *timer,
 	 * pure ACK, to keep our transmit path simple.
 	 */
 	tcp->flags |= TCP_ACK_PENDING;
+	tcp->flags &= ~TCP_ACK_DELAYED;
+	tcp_xmit ( tcp );
+}
+
+/**
+ * Delayed acknowledgement timer expired
+ *
+ * @v timer		Delayed acknowledgement timer
+ * @v over		Failure indicator
+ */
+static void tcp_delack_expired ( struct retry_timer *timer,
+				 int over __unused ) {
+	struct tcp_connection *tcp =
+		container_of ( timer, struct tcp_connection, delack );
+
+	/* Send delayed acknowledgement */
+	tcp->flags &= ~TCP_ACK_DELAYED;
 	tcp_xmit ( tcp );
 }
 
@@ -933,7 +1689,7 @@ static int tcp_xmit_reset ( struct tcp_connection *tcp,
 static struct tcp_connection * tcp_demux ( unsigned int local_port ) {
 	struct tcp_connection *tcp;
 
-	list_for_each_entry ( tcp, &tcp_conns, list ) {
+	list_for_each_entry ( tcp, tcp_bucket ( local_port ), hash ) {
 		if ( tcp->local_port == local_port )
 			return tcp;
 	}
@@ -982,7 +1738,8 @@ static int tcp_rx_opts ( struct tcp_connection *tcp,
 		min = sizeof ( *option );
 		switch ( kind ) {
 		case TCP_OPTION_MSS:
-			/* Ignore received MSS */
+			options->mssopt = data;
+			min = sizeof ( *options->mssopt );
 			break;
 		case TCP_OPTION_WS:
 			options->wsopt = data;
@@ -993,7 +1750,8 @@ static int tcp_rx_opts ( struct tcp_connection *tcp,
 			min = sizeof ( *options->spopt );
 			break;
 		case TCP_OPTION_SACK:
-			/* Ignore received SACKs */
+			options->sackopt = data;
+			min = sizeof ( *options->sackopt );
 			break;
 		case TCP_OPTION_TS:
 			options->tsopt = data;
@@ -1064,6 +1822,64 @@ static void tcp_rx_seq ( struct tcp_connection *tcp, uint32_t seq_len ) {
 	tcp->flags |= TCP_ACK_PENDING;
 }
 
+/**
+ * Tune receive window limit
+ *
+ * @v tcp		TCP connection
+ *
+ * The amount of data received is measured over each round-trip time.
+ * The receive window limit is grown to twice this amount (as per
+ * Dynamic Right-Sizing), so that the window never limits a sender
+ * that is increasing its congestion window.
+ *
+ * A maximum limit reduced by memory pressure is allowed to double
+ * once per TCP_WINDOW_RECOVERY_TIME while it constrains the sender,
+ * so that a transient shortage of memory does not permanently limit
+ * the connection.  Any renewed pressure will reduce it again.
+ */
+static void tcp_rx_autotune ( struct tcp_connection *tcp ) {
+	unsigned long now = currticks();
+	unsigned long elapsed = ( now - tcp->rcv_space_start );
+	unsigned long rtt;
+	uint32_t rcvd;
+	uint32_t space;
+
+	/* Wait for more than one round-trip time to elapse, if known */
+	if ( ! ( tcp->flags & TCP_RTT_VALID ) )
+		return;
+	rtt = ( tcp->srtt >> 3 );
+	if ( elapsed <= rtt )
+		return;
+
+	/* Allow maximum window limit to recover from memory pressure */
+	rcvd = ( tcp->rcv_ack - tcp->rcv_space_seq );
+	if ( ( tcp->rcv_space_max < TCP_MAX_WINDOW_SIZE ) &&
+	     ( rcvd >= ( tcp->rcv_space_max / 2 ) ) &&
+	     ( ( now - tcp->rcv_space_changed ) >=
+	       TCP_WINDOW_RECOVERY_TIME ) ) {
+		tcp->rcv_space_max = ( ( tcp->rcv_space_max <
+					 ( TCP_MAX_WINDOW_SIZE / 2 ) ) ?
+				       ( 2 * tcp->rcv_space_max ) :
+				       TCP_MAX_WINDOW_SIZE );
+		tcp->rcv_space_changed = now;
+		DBGC ( tcp, "TCP %p maximum window limit recovered to %dkB\n",
+		       tcp, ( tcp->rcv_space_max >> 10 ) );
+	}
+
+	/* Grow window limit if necessary */
+	space = ( ( rcvd < ( tcp->rcv_space_max / 2 ) ) ?
+		  ( 2 * rcvd ) : tcp->rcv_space_max );
+	if ( space > tcp->rcv_space ) {
+		DBGC2 ( tcp, "TCP %p received %d bytes in %ld ticks; window "
+			"limit %dkB\n", tcp, rcvd, elapsed, ( space >> 10 ) );
+		tcp->rcv_space = space;
+	}
+
+	/* Start new measurement */
+	tcp->rcv_space_seq = tcp->rcv_ack;
+	tcp->rcv_space_start = now;
+}
+
 /**
  * Handle TCP received SYN
  *
@@ -1074,10 +1890,13 @@ static void tcp_rx_seq ( struct tcp_connection *tcp, uint32_t seq_len ) {
  */
 static int tcp_rx_syn ( struct tcp_connection *tcp, uint32_t seq,
 			struct tcp_options *options ) {
+	size_t peer_mss;
 
 	/* Synchronise sequence numbers on first SYN */
 	if ( ! ( tcp->tcp_state & TCP_STATE_RCVD ( TCP_SYN ) ) ) {
 		tcp->rcv_ack = seq;
+		tcp->rcv_space_seq = seq;
+		tcp->rcv_space_start = currticks();
 		if ( options->tsopt )
 			tcp->flags |= TCP_TS_ENABLED;
 		if ( options->spopt )
@@ -1086,12 +1905,21 @@ static int tcp_rx_syn ( struct tcp_connection *tcp, uint32_t seq,
 			tcp->snd_win_scale = options->wsopt->scale;
 			tcp->rcv_win_scale = TCP_RX_WINDOW_SCALE;
 		}
+		peer_mss = ( options->mssopt ? ntohs ( options->mssopt->mss ) :
+			     TCP_DEFAULT_MSS );
+		if ( tcp->snd_mss_max > peer_mss )
+			tcp->snd_mss_max = peer_mss;
+		if ( tcp->snd_mss > tcp->snd_mss_max ) {
+			tcp->snd_mss = tcp->snd_mss_max;
+			tcp->cwnd = tcp_initial_cwnd ( tcp->snd_mss );
+		}
 		DBGC ( tcp, "TCP %p using %stimestamps, %sSACK, TX window "
-		       "x%d, RX window x%d\n", tcp,
+		       "x%d, RX window x%d, TX MSS %zd (max %zd)\n", tcp,
 		       ( ( tcp->flags & TCP_TS_ENABLED ) ? "" : "no " ),
 		       ( ( tcp->flags & TCP_SACK_ENABLED ) ? "" : "no " ),
 		       ( 1 << tcp->snd_win_scale ),
-		       ( 1 << tcp->rcv_win_scale ) );
+		       ( 1 << tcp->rcv_win_scale ), tcp->snd_mss,
+		       tcp->snd_mss_max );
 	}
 
 	/* Ignore duplicate SYN */
@@ -1108,26 +1936,303 @@ static int tcp_rx_syn ( struct tcp_connection *tcp, uint32_t seq,
 	return 0;
 }
 
+/**
+ * Update round-trip time estimate
+ *
+ * @v tcp		TCP connection
+ * @v rtt		Round-trip time measurement (in ticks)
+ */
+static void tcp_rtt ( struct tcp_connection *tcp, unsigned long rtt ) {
+	unsigned long rtt8 = ( rtt << 3 );
+	unsigned long delta8;
+	unsigned long var;
+	unsigned long rto;
+
+	/* Update smoothed round-trip time and variation as per RFC
+	 * 6298, using scaled values to retain sub-tick precision.
+	 */
+	if ( tcp->flags & TCP_RTT_VALID ) {
+		delta8 = ( ( rtt8 > tcp->srtt ) ?
+			   ( rtt8 - tcp->srtt ) : ( tcp->srtt - rtt8 ) );
+		tcp->rttvar -= ( tcp->rttvar >> 2 );
+		tcp->rttvar += ( delta8 >> 3 );
+		tcp->srtt -= ( tcp->srtt >> 3 );
+		tcp->srtt += rtt;
+	} else {
+		tcp->srtt = rtt8;
+		tcp->rttvar = ( rtt << 1 );
+		tcp->flags |= TCP_RTT_VALID;
+	}
+
+	/* Calculate retransmission timeout, allowing for the clock
+	 * granularity of one tick.
+	 */
+	var = ( tcp->rttvar ? tcp->rttvar : 1 );
+	rto = ( ( tcp->srtt >> 3 ) + var );
+	if ( rto < TCP_MIN_RTO )
+		rto = TCP_MIN_RTO;
+	if ( rto > TCP_MAX_RTO )
+		rto = TCP_MAX_RTO;
+	tcp->rto = rto;
+	DBGC2 ( tcp, "TCP %p RTT %ld (SRTT %ld/8 RTTVAR %ld/4 RTO %ld)\n",
+		tcp, rtt, tcp->srtt, tcp->rttvar, tcp->rto );
+}
+
+/**
+ * Measure round-trip time from received ACK
+ *
+ * @v tcp		TCP connection
+ * @v ack		ACK value (in host-endian order)
+ * @v options		TCP options, or NULL
+ *
+ * This must be called only for an ACK that acknowledges new data.
+ * The echoed timestamp is used if available (as per RFC 7323), since
+ * this provides a valid measurement even for retransmitted segments.
+ * Otherwise, a single transmission at a time is timed, and timing is
+ * abandoned whenever a retransmission occurs (as per Karn's
+ * algorithm).
+ */
+static void tcp_rx_rtt ( struct tcp_connection *tcp, uint32_t ack,
+			 const struct tcp_options *options ) {
+	unsigned long now = currticks();
+	uint32_t tsecr;
+
+	/* Use echoed timestamp, if available */
+	if ( ( tcp->flags & TCP_TS_ENABLED ) && options && options->tsopt &&
+	     ( ( tsecr = ntohl ( options->tsopt->tsecr ) ) != 0 ) ) {
+		tcp->flags &= ~TCP_RTT_TIMING;
+		tcp_rtt ( tcp, ( ( uint32_t ) ( now - tsecr ) ) );
+		return;
+	}
+
+	/* Otherwise, use timed transmission, if acknowledged */
+	if ( ( tcp->flags & TCP_RTT_TIMING ) &&
+	     ( tcp_cmp ( ack, tcp->rtt_seq ) >= 0 ) ) {
+		tcp->flags &= ~TCP_RTT_TIMING;
+		tcp_rtt ( tcp, ( now - tcp->rtt_start ) );
+	}
+}
+
+/**
+ * Record selectively acknowledged transmitted data
+ *
+ * @v tcp		TCP connection
+ * @v options		TCP options, or NULL
+ */
+static void tcp_rx_sack ( struct tcp_connection *tcp,
+			  const struct tcp_options *options ) {
+	const struct tcp_sack_block *block;
+	struct tcp_sack_block *sacked;
+	struct tcp_sack_block *slot;
+	struct tcp_sack_block sack;
+	uint32_t end = ( tcp->snd_seq + tcp->snd_max );
+	unsigned int count;
+	unsigned int i;
+	unsigned int j;
+
+	/* Discard any blocks that have now been fully acknowledged */
+	for ( i = 0 ; i < TCP_SACK_MAX ; i++ ) {
+		sacked = &tcp->sacked[i];
+		if ( sacked->left == sacked->right )
+			continue;
+		if ( tcp_cmp ( sacked->right, tcp->snd_seq ) <= 0 ) {
+			memset ( sacked, 0, sizeof ( *sacked ) );
+		} else if ( tcp_cmp ( sacked->left, tcp->snd_seq ) < 0 ) {
+			sacked->left = tcp->snd_seq;
+		}
+	}
+
+	/* Do nothing more unless a SACK option is present */
+	if ( ! ( options && options->sackopt ) )
+		return;
+	count = ( ( options->sackopt->length - sizeof ( *options->sackopt ) )
+		  / sizeof ( *block ) );
+	block = ( ( ( const void * ) options->sackopt ) +
+		  sizeof ( *options->sackopt ) );
+
+	/* Merge each block into the list */
+	for ( i = 0 ; i < count ; i++, block++ ) {
+
+		/* Ignore blocks outside the unacknowledged sequence space
+		 * (including any duplicate SACK block, as per RFC 2883).
+		 */
+		sack.left = ntohl ( block->left );
+		sack.right = ntohl ( block->right );
+		if ( ( tcp_cmp ( sack.left, tcp->snd_seq ) <= 0 ) ||
+		     ( tcp_cmp ( sack.right, sack.left ) <= 0 ) ||
+		     ( tcp_cmp ( sack.right, end ) > 0 ) )
+			continue;
+
+		/* Absorb any overlapping or adjacent blocks */
+		slot = NULL;
+		for ( j = 0 ; j < TCP_SACK_MAX ; j++ ) {
+			sacked = &tcp->sacked[j];
+			if ( ( sacked->left != sacked->right ) &&
+			     ( tcp_cmp ( sack.left, sacked->right ) <= 0 ) &&
+			     ( tcp_cmp ( sack.right, sacked->left ) >= 0 ) ) {
+				if ( tcp_cmp ( sacked->left, sack.left ) < 0 )
+					sack.left = sacked->left;
+				if ( tcp_cmp ( sacked->right, sack.right ) > 0 )
+					sack.right = sacked->right;
+				memset ( sacked, 0, sizeof ( *sacked ) );
+			}
+			if ( sacked->left == sacked->right )
+				slot = sacked;
+		}
+
+		/* If the list is full, replace the lowest block (since
+		 * the highest blocks bound the holes still to be
+		 * retransmitted).
+		 */
+		if ( ! slot ) {
+			slot = &sack;
+			for ( j = 0 ; j < TCP_SACK_MAX ; j++ ) {
+				sacked = &tcp->sacked[j];
+				if ( tcp_cmp ( sacked->left, slot->left ) < 0 )
+					slot = sacked;
+			}
+		}
+		if ( slot != &sack )
+			memcpy ( slot, &sack, sizeof ( *slot ) );
+	}
+}
+
+/**
+ * Handle TCP received duplicate ACK
+ *
+ * @v tcp		TCP connection
+ */
+static void tcp_rx_dupack ( struct tcp_connection *tcp ) {
+	uint32_t ssthresh;
+
+	/* Inflate congestion window during fast recovery to reflect
+	 * the segment that has left the network, and retransmit the
+	 * next missing segment.
+	 */
+	if ( tcp->flags & TCP_FAST_RECOVERY ) {
+		if ( tcp->cwnd < TCP_MAX_TX_QUEUE )
+			tcp->cwnd += tcp->snd_mss;
+		tcp_xmit_rtx ( tcp );
+		return;
+	}
+
+	/* Wait for duplicate acknowledgement threshold */
+	if ( ++tcp->dupacks != TCP_DUPACK_THRESHOLD )
+		return;
+
+	/* Do not enter fast recovery if this acknowledgement does not
+	 * cover the recovery point, as per RFC 6582.  This avoids
+	 * multiple fast retransmits following a retransmission
+	 * timeout.
+	 */
+	if ( tcp_cmp ( tcp->snd_seq, tcp->recover ) <= 0 )
+		return;
+
+	/* Enter fast recovery, as per RFC 5681 and RFC 6582 */
+	ssthresh = ( tcp->snd_sent / 2 );
+	if ( ssthresh < ( 2 * tcp->snd_mss ) )
+		ssthresh = ( 2 * tcp->snd_mss );
+	tcp->ssthresh = ssthresh;
+	tcp->cwnd = ( ssthresh + ( TCP_DUPACK_THRESHOLD * tcp->snd_mss ) );
+	tcp->recover = ( tcp->snd_seq + tcp->snd_max );
+	tcp->rtx_seq = tcp->snd_seq;
+	tcp->flags |= TCP_FAST_RECOVERY;
+	DBGC ( tcp, "TCP %p fast recovery for %08x..%08x (cwnd %d)\n",
+	       tcp, tcp->snd_seq, tcp->recover, tcp->cwnd );
+
+	/* Retransmit first missing segment */
+	tcp_xmit_rtx ( tcp );
+}
+
+/**
+ * Update congestion window on receiving new acknowledgement
+ *
+ * @v tcp		TCP connection
+ * @v ack		ACK value (in host-endian order)
+ * @v ack_len		Length of newly acknowledged sequence space
+ */
+static void tcp_rx_cwnd ( struct tcp_connection *tcp, uint32_t ack,
+			  uint32_t ack_len ) {
+	uint32_t cwnd = tcp->cwnd;
+	uint32_t incr;
+
+	/* Reset duplicate acknowledgement counter */
+	tcp->dupacks = 0;
+
+	if ( tcp->flags & TCP_FAST_RECOVERY ) {
+
+		if ( tcp_cmp ( ack, tcp->recover ) < 0 ) {
+			/* Partial acknowledgement: deflate window by
+			 * the amount of new data acknowledged, and
+			 * retransmit the next missing segment.
+			 */
+			cwnd -= ( ( ack_len < cwnd ) ? ack_len : cwnd );
+			if ( ack_len >= tcp->snd_mss )
+				cwnd += tcp->snd_mss;
+			if ( cwnd < tcp->snd_mss )
+				cwnd = tcp->snd_mss;
+			tcp->cwnd = cwnd;
+			tcp_xmit_rtx ( tcp );
+			return;
+		}
+
+		/* Full acknowledgement: exit fast recovery */
+		cwnd = ( tcp->snd_sent + tcp->snd_mss );
+		if ( cwnd > tcp->ssthresh )
+			cwnd = tcp->ssthresh;
+		tcp->flags &= ~TCP_FAST_RECOVERY;
+		DBGC ( tcp, "TCP %p fast recovery complete (cwnd %d)\n",
+		       tcp, cwnd );
+
+	} else {
+
+		/* Keep recovery point within range for sequence
+		 * number comparisons.
+		 */
+		if ( tcp_cmp ( ack, tcp->recover ) > 0 )
+			tcp->recover = ( ack - 1 );
+
+		if ( cwnd < tcp->ssthresh ) {
+			/* Slow start */
+			cwnd += ( ( ack_len < tcp->snd_mss ) ?
+				  ack_len : tcp->snd_mss );
+		} else {
+			/* Congestion avoidance */
+			incr = ( ( tcp->snd_mss * tcp->snd_mss ) / cwnd );
+			cwnd += ( incr ? incr : 1 );
+		}
+	}
+
+	/* Limit congestion window to the maximum data in flight */
+	if ( cwnd > TCP_MAX_TX_QUEUE )
+		cwnd = TCP_MAX_TX_QUEUE;
+	tcp->cwnd = cwnd;
+}
+
 /**
  * Handle TCP received ACK
  *
  * @v tcp		TCP connection
  * @v ack		ACK value (in host-endian order)
  * @v win		WIN value (in host-endian order)
+ * @v seq_len		Length of received sequence space
+ * @v options		TCP options, or NULL
  * @ret rc		Return status code
  */
 static int tcp_rx_ack ( struct tcp_connection *tcp, uint32_t ack,
-			uint32_t win ) {
+			uint32_t win, size_t seq_len,
+			const struct tcp_options *options ) {
 	uint32_t ack_len = ( ack - tcp->snd_seq );
 	size_t len;
 	unsigned int acked_flags;
+	int duplicate;
 
 	/* Check for out-of-range or old duplicate ACKs */
-	if ( ack_len > tcp->snd_sent ) {
+	if ( ack_len > tcp->snd_max ) {
 		DBGC ( tcp, "TCP %p received ACK for %08x..%08x, "
 		       "sent only %08x..%08x\n", tcp, tcp->snd_seq,
 		       ( tcp->snd_seq + ack_len ), tcp->snd_seq,
-		       ( tcp->snd_seq + tcp->snd_sent ) );
+		       ( tcp->snd_seq + tcp->snd_max ) );
 
 		if ( TCP_HAS_BEEN_ESTABLISHED ( tcp->tcp_state ) ) {
 			/* Just ignore what might be old duplicate ACKs */
@@ -1141,6 +2246,10 @@ static int tcp_rx_ack ( struct tcp_connection *tcp, uint32_t ack,
 		}
 	}
 
+	/* Identify duplicate ACKs, as defined in RFC 5681 */
+	duplicate = ( ( ack_len == 0 ) && ( tcp->snd_sent != 0 ) &&
+		      ( seq_len == 0 ) && ( win == tcp->snd_win ) );
+
 	/* Update window size */
 	tcp->snd_win = win;
 
@@ -1148,14 +2257,18 @@ static int tcp_rx_ack ( struct tcp_connection *tcp, uint32_t ack,
 	if ( ! ( tcp->tcp_state & TCP_STATE_SENT ( TCP_FIN ) ) )
 		start_timer_fixed ( &tcp->keepalive, TCP_KEEPALIVE_DELAY );
 
-	/* Ignore ACKs that don't actually acknowledge any new data.
+	/* Handle ACKs that don't actually acknowledge any new data.
 	 * (In particular, do not stop the retransmission timer; this
 	 * avoids creating a sorceror's apprentice syndrome when a
 	 * duplicate ACK is received and we still have data in our
 	 * transmit queue.)
 	 */
-	if ( ack_len == 0 )
+	if ( ack_len == 0 ) {
+		tcp_rx_sack ( tcp, options );
+		if ( duplicate )
+			tcp_rx_dupack ( tcp );
 		return 0;
+	}
 
 	/* Stop the retransmission timer */
 	stop_timer ( &tcp->timer );
@@ -1171,11 +2284,29 @@ static int tcp_rx_ack ( struct tcp_connection *tcp, uint32_t ack,
 
 	/* Update SEQ and sent counters */
 	tcp->snd_seq = ack;
-	tcp->snd_sent = 0;
+	tcp->snd_sent = ( ( ack_len < tcp->snd_sent ) ?
+			  ( tcp->snd_sent - ack_len ) : 0 );
+	tcp->snd_max -= ack_len;
 
 	/* Remove any acknowledged data from transmit queue */
 	tcp_process_tx_queue ( tcp, len, NULL, 1 );
-		
+	tcp->out_octets += len;
+
+	/* Update round-trip time, selective acknowledgement and
+	 * congestion state.
+	 */
+	tcp_rx_rtt ( tcp, ack, options );
+	tcp_rx_sack ( tcp, options );
+	tcp_rx_cwnd ( tcp, ack, ack_len );
+
+	/* Complete path MTU probe, if acknowledged */
+	if ( tcp->probe_mss && ( tcp_cmp ( ack, tcp->probe_nxt ) >= 0 ) )
+		tcp_probe_complete ( tcp, 0 );
+
+	/* Restart the retransmission timer if data remains in flight */
+	if ( tcp->snd_sent && ! timer_running ( &tcp->timer ) )
+		start_timer_fixed ( &tcp->timer, tcp->rto );
+
 	/* Mark SYN/FIN as acknowledged if applicable. */
 	if ( acked_flags )
 		tcp->tcp_state |= TCP_STATE_ACKED ( acked_flags );
@@ -1191,6 +2322,64 @@ static int tcp_rx_ack ( struct tcp_connection *tcp, uint32_t ack,
 	return 0;
 }
 
+/**
+ * Deliver gathered received data to application
+ *
+ * @v tcp		TCP connection
+ */
+static void tcp_rx_deliver ( struct tcp_connection *tcp ) {
+	struct io_buffer *iobuf;
+	size_t len;
+	int rc;
+
+	/* Do nothing if no data is awaiting delivery */
+	if ( list_empty ( &tcp->rx_deliver ) )
+		return;
+
+	/* Deliver data to application.  The list is rechecked for
+	 * each I/O buffer, since delivery may close the connection
+	 * and so discard any data remaining on the list.
+	 */
+	profile_start ( &tcp_xfer_profiler );
+	while ( ( iobuf = list_first_entry ( &tcp->rx_deliver,
+					     struct io_buffer, list ) ) ) {
+		list_del ( &iobuf->list );
+		len = iob_len ( iobuf );
+		if ( ( rc = xfer_deliver_iob ( &tcp->xfer, iobuf ) ) != 0 ) {
+			DBGC ( tcp, "TCP %p could not deliver %zd bytes: "
+			       "%s\n", tcp, len, strerror ( rc ) );
+		}
+	}
+	profile_stop ( &tcp_xfer_profiler );
+}
+
+/**
+ * Gather received data for delivery to application
+ *
+ * @v tcp		TCP connection
+ * @v iobuf		I/O buffer
+ *
+ * Consecutive in-order data received within a single poll of the
+ * network stack is chained together (without copying) and delivered
+ * to the application as a single batch from the TCP process, once
+ * all received packets have been processed.
+ *
+ * This function takes ownership of the I/O buffer.
+ */
+static void tcp_rx_gather ( struct tcp_connection *tcp,
+			    struct io_buffer *iobuf ) {
+
+	/* Discard data if data transfer interface has been closed */
+	if ( tcp->flags & TCP_XFER_CLOSED ) {
+		free_iob ( iobuf );
+		return;
+	}
+
+	/* Chain to data awaiting delivery and schedule delivery */
+	list_add_tail ( &iobuf->list, &tcp->rx_deliver );
+	process_add ( &tcp->process );
+}
+
 /**
  * Handle TCP received data
  *
@@ -1205,7 +2394,6 @@ static int tcp_rx_data ( struct tcp_connection *tcp, uint32_t seq,
 			 struct io_buffer *iobuf ) {
 	uint32_t already_rcvd;
 	uint32_t len;
-	int rc;
 
 	/* Ignore duplicate or out-of-order data */
 	already_rcvd = ( tcp->rcv_ack - seq );
@@ -1222,15 +2410,13 @@ static int tcp_rx_data ( struct tcp_connection *tcp, uint32_t seq,
 
 	/* Update statistics */
 	tcp_stats.in_octets_good += len;
+	tcp->in_octets += len;
 
-	/* Deliver data to application */
-	profile_start ( &tcp_xfer_profiler );
-	if ( ( rc = xfer_deliver_iob ( &tcp->xfer, iobuf ) ) != 0 ) {
-		DBGC ( tcp, "TCP %p could not deliver %08x..%08x: %s\n",
-		       tcp, seq, ( seq + len ), strerror ( rc ) );
-		return rc;
-	}
-	profile_stop ( &tcp_xfer_profiler );
+	/* Tune receive window limit */
+	tcp_rx_autotune ( tcp );
+
+	/* Gather data for delivery to application */
+	tcp_rx_gather ( tcp, iobuf );
 
 	return 0;
 }
@@ -1251,6 +2437,9 @@ static int tcp_rx_fin ( struct tcp_connection *tcp, uint32_t seq ) {
 	/* Acknowledge FIN */
 	tcp_rx_seq ( tcp, 1 );
 
+	/* Deliver any gathered data before closing */
+	tcp_rx_deliver ( tcp );
+
 	/* Mark FIN as received */
 	tcp->tcp_state |= TCP_STATE_RCVD ( TCP_FIN );
 
@@ -1291,6 +2480,52 @@ static int tcp_rx_rst ( struct tcp_connection *tcp, uint32_t seq ) {
 	return -ECONNRESET;
 }
 
+/**
+ * Remove received sequence range
+ *
+ * @v tcp		TCP connection
+ * @v i			Index of range
+ */
+static void tcp_rx_range_remove ( struct tcp_connection *tcp,
+				  unsigned int i ) {
+
+	assert ( i < tcp->rx_ranges );
+	tcp->rx_ranges--;
+	memmove ( &tcp->rx_range[i], &tcp->rx_range[ i + 1 ],
+		  ( ( tcp->rx_ranges - i ) * sizeof ( tcp->rx_range[0] ) ) );
+}
+
+/**
+ * Discard last packet from receive queue
+ *
+ * @v tcp		TCP connection
+ * @ret discarded	Packet was discarded
+ */
+static int tcp_rx_discard ( struct tcp_connection *tcp ) {
+	struct tcp_rx_queued_header *tcpqhdr;
+	struct tcp_rx_range *range;
+	struct io_buffer *iobuf;
+
+	/* Do nothing if receive queue is empty */
+	if ( ! tcp->rx_ranges )
+		return 0;
+
+	/* Remove last packet from last range */
+	range = &tcp->rx_range[ tcp->rx_ranges - 1 ];
+	iobuf = range->last;
+	if ( iobuf == range->first ) {
+		tcp_rx_range_remove ( tcp, ( tcp->rx_ranges - 1 ) );
+	} else {
+		range->last = list_prev_entry ( iobuf, &tcp->rx_queue, list );
+		tcpqhdr = range->last->data;
+		range->nxt = tcpqhdr->nxt;
+	}
+	list_del ( &iobuf->list );
+	free_iob ( iobuf );
+
+	return 1;
+}
+
 /**
  * Enqueue received TCP packet
  *
@@ -1298,15 +2533,23 @@ static int tcp_rx_rst ( struct tcp_connection *tcp, uint32_t seq ) {
  * @v seq		SEQ value (in host-endian order)
  * @v flags		TCP flags
  * @v iobuf		I/O buffer
+ *
+ * Any data that has already been received (or is already held in the
+ * receive queue) is discarded, so that the receive queue never holds
+ * overlapping data.
  */
 static void tcp_rx_enqueue ( struct tcp_connection *tcp, uint32_t seq,
 			     uint8_t flags, struct io_buffer *iobuf ) {
 	struct tcp_rx_queued_header *tcpqhdr;
-	struct io_buffer *queued;
+	struct tcp_rx_range *range;
+	struct tcp_rx_range *next;
+	struct list_head *pos;
 	size_t len;
 	uint32_t seq_len;
 	uint32_t nxt;
-	uint32_t gap;
+	uint32_t skip;
+	unsigned int i;
+	int append = 0;
 
 	/* Calculate remaining flags and sequence length.  Note that
 	 * SYN, if present, has already been processed by this point.
@@ -1331,6 +2574,51 @@ static void tcp_rx_enqueue ( struct tcp_connection *tcp, uint32_t seq,
 		return;
 	}
 
+	/* Discard any data that has already been received */
+	if ( tcp_cmp ( seq, tcp->rcv_ack ) < 0 ) {
+		iob_pull ( iobuf, ( tcp->rcv_ack - seq ) );
+		seq = tcp->rcv_ack;
+	}
+
+	/* Find the range (if any) within which this packet starts, and
+	 * the following range (if any).  Discard any data already held
+	 * within the range in which this packet starts.
+	 */
+	i = tcp_rx_range_find ( tcp, seq );
+	range = &tcp->rx_range[i];
+	next = ( ( i < tcp->rx_ranges ) ? range : NULL );
+	if ( next && ( tcp_cmp ( range->seq, seq ) <= 0 ) ) {
+		skip = ( range->nxt - seq );
+		if ( skip >= seq_len ) {
+			free_iob ( iobuf );
+			return;
+		}
+		iob_pull ( iobuf, skip );
+		seq = range->nxt;
+		next = ( ( ( i + 1 ) < tcp->rx_ranges ) ? ( range + 1 ) : NULL );
+		append = 1;
+	}
+
+	/* Discard any data already held within the following range.
+	 * A FIN cannot legitimately precede data that has already
+	 * been received, so discard the FIN in this case.
+	 */
+	len = iob_len ( iobuf );
+	if ( next && ( tcp_cmp ( ( seq + len + ( flags ? 1 : 0 ) ),
+				 next->seq ) > 0 ) ) {
+		if ( tcp_cmp ( ( seq + len ), next->seq ) > 0 ) {
+			iob_unput ( iobuf, ( seq + len - next->seq ) );
+			len = iob_len ( iobuf );
+		}
+		flags = 0;
+	}
+	seq_len = ( len + ( flags ? 1 : 0 ) );
+	nxt = ( seq + seq_len );
+	if ( ! seq_len ) {
+		free_iob ( iobuf );
+		return;
+	}
+
 	/* Add internal header */
 	tcpqhdr = iob_push ( iobuf, sizeof ( *tcpqhdr ) );
 	tcpqhdr->seq = seq;
@@ -1338,17 +2626,64 @@ static void tcp_rx_enqueue ( struct tcp_connection *tcp, uint32_t seq,
 	tcpqhdr->flags = flags;
 
 	/* Add to RX queue */
-	gap = tcp->rcv_ack;
-	list_for_each_entry ( queued, &tcp->rx_queue, list ) {
-		tcpqhdr = queued->data;
-		if ( tcp_cmp ( seq, tcpqhdr->seq ) < 0 )
-			break;
-		gap = tcpqhdr->nxt;
+	if ( append ) {
+
+		/* Extend range, merging with following range if the
+		 * gap has now been filled.
+		 */
+		list_add ( &iobuf->list, &range->last->list );
+		range->last = iobuf;
+		range->nxt = nxt;
+		if ( next && ( next->seq == nxt ) ) {
+			range->nxt = next->nxt;
+			range->last = next->last;
+			tcp_rx_range_remove ( tcp, ( i + 1 ) );
+		}
+
+	} else if ( next && ( next->seq == nxt ) ) {
+
+		/* Extend following range */
+		list_add_tail ( &iobuf->list, &next->first->list );
+		next->first = iobuf;
+		next->seq = seq;
+
+	} else {
+
+		/* Discard out-of-order packets that would require a
+		 * new range if there is no space.  Always accept an
+		 * in-order packet (which will be processed
+		 * immediately), discarding the highest range if
+		 * necessary.
+		 */
+		if ( tcp->rx_ranges == TCP_RX_RANGES_MAX ) {
+			if ( seq != tcp->rcv_ack ) {
+				free_iob ( iobuf );
+				tcp_stats.in_discards++;
+				return;
+			}
+			assert ( i < ( TCP_RX_RANGES_MAX - 1 ) );
+			while ( tcp->rx_ranges == TCP_RX_RANGES_MAX ) {
+				tcp_rx_discard ( tcp );
+				tcp_stats.in_discards++;
+			}
+		}
+
+		/* Create new range */
+		pos = ( ( i < tcp->rx_ranges ) ?
+			&tcp->rx_range[i].first->list : &tcp->rx_queue );
+		list_add_tail ( &iobuf->list, pos );
+		memmove ( &tcp->rx_range[ i + 1 ], &tcp->rx_range[i],
+			  ( ( tcp->rx_ranges - i ) *
+			    sizeof ( tcp->rx_range[0] ) ) );
+		tcp->rx_ranges++;
+		range->seq = seq;
+		range->nxt = nxt;
+		range->first = iobuf;
+		range->last = iobuf;
 	}
-	list_add_tail ( &iobuf->list, &queued->list );
 
 	/* Update statistics */
-	if ( seq != gap )
+	if ( ( seq != tcp->rcv_ack ) && ! append )
 		tcp_stats.in_out_of_order++;
 }
 
@@ -1360,6 +2695,7 @@ static void tcp_rx_enqueue ( struct tcp_connection *tcp, uint32_t seq,
 static void tcp_process_rx_queue ( struct tcp_connection *tcp ) {
 	struct io_buffer *iobuf;
 	struct tcp_rx_queued_header *tcpqhdr;
+	struct tcp_rx_range *range = &tcp->rx_range[0];
 	uint32_t seq;
 	unsigned int flags;
 	size_t len;
@@ -1369,16 +2705,26 @@ static void tcp_process_rx_queue ( struct tcp_connection *tcp ) {
 	 * queue, since tcp_discard() may remove packets from the RX
 	 * queue while we are processing.
 	 */
-	while ( ( iobuf = list_first_entry ( &tcp->rx_queue, struct io_buffer,
-					     list ) ) ) {
+	while ( tcp->rx_ranges ) {
 
 		/* Stop processing when we hit the first gap */
-		tcpqhdr = iobuf->data;
-		if ( tcp_cmp ( tcpqhdr->seq, tcp->rcv_ack ) > 0 )
+		if ( tcp_cmp ( range->seq, tcp->rcv_ack ) > 0 )
 			break;
 
-		/* Strip internal header and remove from RX queue */
+		/* Remove from RX queue and range */
+		iobuf = range->first;
+		if ( iobuf == range->last ) {
+			tcp_rx_range_remove ( tcp, 0 );
+		} else {
+			range->first = list_next_entry ( iobuf, &tcp->rx_queue,
+							 list );
+			tcpqhdr = range->first->data;
+			range->seq = tcpqhdr->seq;
+		}
 		list_del ( &iobuf->list );
+
+		/* Strip internal header */
+		tcpqhdr = iobuf->data;
 		seq = tcpqhdr->seq;
 		flags = tcpqhdr->flags;
 		iob_pull ( iobuf, sizeof ( *tcpqhdr ) );
@@ -1423,6 +2769,8 @@ static int tcp_rx ( struct io_buffer *iobuf,
 	unsigned int flags;
 	size_t len;
 	uint32_t seq_len;
+	uint32_t nxt;
+	uint32_t old_rcv_ack;
 	size_t old_xfer_window;
 	int rc;
 
@@ -1450,13 +2798,15 @@ static int tcp_rx ( struct io_buffer *iobuf,
 		rc = -EINVAL;
 		goto discard;
 	}
-	csum = tcpip_continue_chksum ( pshdr_csum, iobuf->data,
-				       iob_len ( iobuf ) );
-	if ( csum != 0 ) {
-		DBG ( "TCP checksum incorrect (is %04x including checksum "
-		      "field, should be 0000)\n", csum );
-		rc = -EINVAL;
-		goto discard;
+	if ( ! ( iobuf->flags & IOB_CSUM_VERIFIED ) ) {
+		csum = tcpip_continue_chksum ( pshdr_csum, iobuf->data,
+					       iob_len ( iobuf ) );
+		if ( csum != 0 ) {
+			DBG ( "TCP checksum incorrect (is %04x including "
+			      "checksum field, should be 0000)\n", csum );
+			rc = -EINVAL;
+			goto discard;
+		}
 	}
 	
 	/* Parse parameters from header and strip header */
@@ -1492,13 +2842,16 @@ static int tcp_rx ( struct io_buffer *iobuf,
 		goto discard;
 	}
 
-	/* Record old data-transfer window */
+	/* Record old data-transfer window and acknowledgement number */
 	old_xfer_window = tcp_xfer_window ( tcp );
+	old_rcv_ack = tcp->rcv_ack;
+	nxt = ( seq + seq_len );
 
 	/* Handle ACK, if present */
 	if ( flags & TCP_ACK ) {
 		win = ( raw_win << tcp->snd_win_scale );
-		if ( ( rc = tcp_rx_ack ( tcp, ack, win ) ) != 0 ) {
+		if ( ( rc = tcp_rx_ack ( tcp, ack, win, seq_len,
+					 &options ) ) != 0 ) {
 			tcp_xmit_reset ( tcp, st_src, tcphdr );
 			goto discard;
 		}
@@ -1531,15 +2884,41 @@ static int tcp_rx ( struct io_buffer *iobuf,
 	/* Dump out any state change as a result of the received packet */
 	tcp_dump_state ( tcp );
 
+	/* Allow the acknowledgement of a lone in-order data segment
+	 * to be delayed, unless the sender has requested a push.
+	 * Any other segment occupying sequence space (including a
+	 * segment that fills a gap) will cause any delayed
+	 * acknowledgement to be sent along with its own.
+	 */
+	if ( tcp->rcv_ack != old_rcv_ack )
+		tcp->rcv_unacked++;
+	if ( ( tcp->rcv_unacked == 1 ) && ( old_rcv_ack == seq ) &&
+	     ( tcp->rcv_ack == nxt ) && ( len != 0 ) &&
+	     ! ( flags & ( TCP_SYN | TCP_PSH | TCP_FIN ) ) ) {
+		tcp->flags |= TCP_ACK_DELAYED;
+		if ( ! timer_running ( &tcp->delack ) ) {
+			start_timer_fixed ( &tcp->delack,
+					    TCP_DELAYED_ACK_TIMEOUT );
+		}
+	} else if ( seq_len ) {
+		tcp->flags &= ~TCP_ACK_DELAYED;
+	}
+
 	/* Schedule transmission of ACK (and any pending data).  If we
 	 * have received any out-of-order packets (i.e. if the receive
 	 * queue remains non-empty after processing) then send the ACK
-	 * immediately in order to trigger Fast Retransmission.
+	 * immediately in order to trigger Fast Retransmission.  If
+	 * many segments have been received without an ACK, then send
+	 * the ACK immediately in order to keep the sender's window
+	 * moving.  Otherwise, send a single ACK covering all segments
+	 * received during this poll of the network stack.
 	 */
-	if ( list_empty ( &tcp->rx_queue ) ) {
-		process_add ( &tcp->process );
-	} else {
+	if ( ! list_empty ( &tcp->rx_queue ) ) {
 		tcp_xmit_sack ( tcp, seq );
+	} else if ( tcp->rcv_unacked >= TCP_ACK_SEGMENTS_MAX ) {
+		tcp_xmit ( tcp );
+	} else {
+		process_add ( &tcp->process );
 	}
 
 	/* If this packet was the last we expect to receive, set up
@@ -1567,6 +2946,7 @@ static int tcp_rx ( struct io_buffer *iobuf,
 struct tcpip_protocol tcp_protocol __tcpip_protocol = {
 	.name = "TCP",
 	.rx = tcp_rx,
+	.dontfrag = 1,
 	.tcpip_proto = IP_TCP,
 };
 
@@ -1577,23 +2957,28 @@ struct tcpip_protocol tcp_protocol __tcpip_protocol = {
  */
 static unsigned int tcp_discard ( void ) {
 	struct tcp_connection *tcp;
-	struct io_buffer *iobuf;
 	unsigned int discarded = 0;
 
-	/* Try to drop one queued RX packet from each connection */
+	/* Back off receive window and try to drop one queued RX
+	 * packet from each connection.
+	 */
 	list_for_each_entry ( tcp, &tcp_conns, list ) {
-		list_for_each_entry_reverse ( iobuf, &tcp->rx_queue, list ) {
 
-			/* Remove packet from queue */
-			list_del ( &iobuf->list );
-			free_iob ( iobuf );
+		/* Reduce receive window limit */
+		tcp->rcv_space_max = ( tcp->rcv_space / 2 );
+		if ( tcp->rcv_space_max < TCP_MIN_WINDOW_SIZE )
+			tcp->rcv_space_max = TCP_MIN_WINDOW_SIZE;
+		tcp->rcv_space = tcp->rcv_space_max;
+		tcp->rcv_space_changed = currticks();
+
+		/* Discard packet, if any */
+		if ( tcp_rx_discard ( tcp ) ) {
 
 			/* Update statistics */
 			tcp_stats.in_discards++;
 
 			/* Report discard */
 			discarded++;
-			break;
 		}
 	}
 
@@ -1717,12 +3102,22 @@ static int tcp_xfer_deliver ( struct tcp_connection *tcp,
 
 	/* Enqueue packet */
 	list_add_tail ( &iobuf->list, &tcp->tx_queue );
+	tcp->tx_len += iob_len ( iobuf );
 
 	/* Each enqueued packet is a pending operation */
 	pending_get ( &tcp->pending_data );
 
-	/* Transmit data, if possible */
-	tcp_xmit ( tcp );
+	/* Transmit data, if possible.  When using segmentation
+	 * offload, defer transmission until the end of the current
+	 * poll of the network stack, so that data delivered in
+	 * response to several acknowledgements may be sent as a
+	 * single multi-segment packet.
+	 */
+	if ( tcp->flags & TCP_TSO ) {
+		process_add ( &tcp->process );
+	} else {
+		tcp_xmit ( tcp );
+	}
 
 	return 0;
 }
@@ -1814,12 +1814,13 @@ static int iscsi_vredirect ( struct iscsi_session *iscsi, int type,
 	struct sockaddr *peer;
 	int rc;
 
-	/* Intercept redirects to a LOCATION_SOCKET and record the IP
+	/* Intercept redirects to a LOCATION_SOCKET (or to an
+	 * established LOCATION_CONNECTED socket) and record the IP
 	 * address for the iBFT.  This is a bit of a hack, but avoids
 	 * inventing an ioctl()-style call to retrieve the socket
 	 * address from a data-xfer interface.
 	 */
-	if ( type == LOCATION_SOCKET ) {
+	if ( ( type == LOCATION_SOCKET ) || ( type == LOCATION_CONNECTED ) ) {
 		va_copy ( tmp, args );
 		( void ) va_arg ( tmp, int ); /* Discard "semantics" */
 		peer = va_arg ( tmp, struct sockaddr * );
@@ -2,12 +2,14 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <assert.h>
 #include <byteswap.h>
 #include <ipxe/iobuf.h>
 #include <ipxe/tables.h>
 #include <ipxe/ipstat.h>
 #include <ipxe/netdevice.h>
 #include <ipxe/tcpip.h>
+#include <ipxe/tcp.h>
 
 /** @file
  *
@@ -150,6 +152,84 @@ size_t tcpip_mtu ( struct sockaddr_tcpip *st_dest ) {
 	return mtu;
 }
 
+/**
+ * Segment TCP packet
+ *
+ * @v iobuf		I/O buffer (starting at network-layer header)
+ * @v hdrlen		Network-layer header length
+ * @v segments		List of segments to fill in
+ * @ret rc		Return status code
+ *
+ * Each segment comprises a copy of the network-layer and TCP headers
+ * followed by up to @c iobuf->mss bytes of payload.  The TCP sequence
+ * number, flags and checksum are updated.  The caller must update
+ * the network-layer header and add the pseudo-header checksum.
+ *
+ * On failure, any segments already created will be freed.
+ */
+int tcpip_segment ( struct io_buffer *iobuf, size_t hdrlen,
+		    struct list_head *segments ) {
+	struct tcp_header *tcphdr = ( iobuf->data + hdrlen );
+	struct tcp_header *seg_tcphdr;
+	struct io_buffer *segment;
+	struct io_buffer *tmp;
+	const void *payload;
+	size_t thlen;
+	size_t len;
+	size_t offset;
+	size_t frag_len;
+	uint32_t seq;
+
+	/* Sanity checks */
+	assert ( iobuf->mss != 0 );
+	thlen = ( ( tcphdr->hlen & TCP_MASK_HLEN ) / 16 ) * 4;
+	assert ( ( hdrlen + thlen ) <= iob_len ( iobuf ) );
+
+	/* Construct segments */
+	payload = ( iobuf->data + hdrlen + thlen );
+	len = ( iob_len ( iobuf ) - hdrlen - thlen );
+	seq = ntohl ( tcphdr->seq );
+	for ( offset = 0 ; offset < len ; offset += frag_len ) {
+
+		/* Allocate segment */
+		frag_len = ( len - offset );
+		if ( frag_len > iobuf->mss )
+			frag_len = iobuf->mss;
+		segment = alloc_iob ( MAX_LL_HEADER_LEN + hdrlen + thlen +
+				      frag_len );
+		if ( ! segment )
+			goto err_alloc;
+		iob_reserve ( segment, MAX_LL_HEADER_LEN );
+		list_add_tail ( &segment->list, segments );
+
+		/* Copy headers and payload */
+		memcpy ( iob_put ( segment, ( hdrlen + thlen ) ),
+			 iobuf->data, ( hdrlen + thlen ) );
+		memcpy ( iob_put ( segment, frag_len ), ( payload + offset ),
+			 frag_len );
+
+		/* Update TCP header.  Only the final segment may carry
+		 * the PSH or FIN flags.
+		 */
+		seg_tcphdr = ( segment->data + hdrlen );
+		seg_tcphdr->seq = htonl ( seq + offset );
+		if ( ( offset + frag_len ) < len )
+			seg_tcphdr->flags &= ~( TCP_PSH | TCP_FIN );
+		seg_tcphdr->csum = 0;
+		seg_tcphdr->csum = tcpip_chksum ( seg_tcphdr,
+						  ( thlen + frag_len ) );
+	}
+
+	return 0;
+
+ err_alloc:
+	list_for_each_entry_safe ( segment, tmp, segments, list ) {
+		list_del ( &segment->list );
+		free_iob ( segment );
+	}
+	return -ENOMEM;
+}
+
 /**
  * Calculate continued TCP/IP checkum
  *
@@ -191,6 +271,54 @@ uint16_t generic_tcpip_continue_chksum ( uint16_t partial,
 	return ( ~cksum );
 }
 
+/**
+ * Copy data and calculate continued TCP/IP checksum
+ *
+ * @v partial		Checksum of already-summed data, in network byte order
+ * @v dest		Destination buffer
+ * @v src		Source buffer
+ * @v len		Length of data
+ * @ret cksum		Updated checksum, in network byte order
+ *
+ * Copies the data block and calculates a TCP/IP-style 16-bit checksum
+ * over it, reading the data only once.  The same restrictions on
+ * alignment of the old and new data apply as for
+ * generic_tcpip_continue_chksum().  The source and destination
+ * buffers must not overlap.
+ *
+ * If the source and destination buffers are both aligned to a 32-bit
+ * boundary, then the data is copied and summed a word at a time;
+ * otherwise it is copied and then summed in a second pass.
+ */
+uint16_t generic_tcpip_copy_chksum ( uint16_t partial, void *dest,
+				     const void *src, size_t len ) {
+	const uint32_t *src_word = src;
+	uint32_t *dest_word = dest;
+	uint64_t sum = ( ( ~partial ) & 0xffff );
+	uint32_t value;
+	size_t count;
+	size_t done;
+
+	/* Copy and sum whole words, if suitably aligned */
+	if ( ! ( ( ( intptr_t ) src | ( intptr_t ) dest ) &
+		 ( sizeof ( value ) - 1 ) ) ) {
+		for ( count = ( len / sizeof ( value ) ) ; count ; count-- ) {
+			value = *(src_word++);
+			*(dest_word++) = value;
+			sum += value;
+		}
+	}
+	done = ( ( ( void * ) dest_word ) - dest );
+
+	/* Fold down to a uint16_t */
+	while ( sum >> 16 )
+		sum = ( ( sum & 0xffff ) + ( sum >> 16 ) );
+
+	/* Copy and sum any remaining data */
+	memcpy ( ( dest + done ), ( src + done ), ( len - done ) );
+	return tcpip_continue_chksum ( ~sum, ( dest + done ), ( len - done ) );
+}
+
 /**
  * Calculate TCP/IP checkum
  *
@@ -205,6 +333,37 @@ uint16_t tcpip_chksum ( const void *data, size_t len ) {
 	return tcpip_continue_chksum ( TCPIP_EMPTY_CSUM, data, len );
 }
 
+/**
+ * Complete partial TCP/IP checksum
+ *
+ * @v iobuf		I/O buffer
+ * @v start		Offset at which to start checksumming
+ * @v offset		Offset of checksum field (relative to start)
+ * @ret rc		Return status code
+ *
+ * A packet received from a virtual network device may originate
+ * within the host and carry only a partial checksum, i.e. a checksum
+ * field containing only the pseudo-header sum.  Complete the checksum
+ * over the remainder of the packet, so that the packet remains valid
+ * if it is passed on intact (e.g. via PXE UNDI or EFI SNP).
+ */
+int tcpip_complete_chksum ( struct io_buffer *iobuf, size_t start,
+			    size_t offset ) {
+	size_t len = iob_len ( iobuf );
+	uint16_t *csum;
+
+	/* Sanity check */
+	if ( ( start > len ) || ( offset > ( len - start ) ) ||
+	     ( sizeof ( *csum ) > ( len - start - offset ) ) )
+		return -EINVAL;
+
+	/* Complete checksum */
+	csum = ( iobuf->data + start + offset );
+	*csum = tcpip_chksum ( ( iobuf->data + start ), ( len - start ) );
+
+	return 0;
+}
+
 /**
  * Bind to local TCP/IP port
  *
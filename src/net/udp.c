@@ -27,7 +27,10 @@ FILE_SECBOOT ( PERMITTED );
 struct udp_connection {
 	/** Reference counter */
 	struct refcnt refcnt;
-	/** List of UDP connections */
+	/** List of UDP connections within local port hash bucket
+	 *
+	 * Promiscuous connections are held in a separate list.
+	 */
 	struct list_head list;
 
 	/** Data transfer interface */
@@ -40,28 +43,64 @@ struct udp_connection {
 };
 
 /**
- * List of registered UDP connections
+ * UDP connections indexed by local port
+ *
+ * Each bound connection has a unique local port, and so may be
+ * identified by local port alone.  Each hash bucket is initialised on
+ * first use (see udp_bucket()).
+ */
+static struct list_head udp_hash[TCPIP_PORT_HASH_SIZE];
+
+/**
+ * List of promiscuous UDP connections
  */
-static LIST_HEAD ( udp_conns );
+static LIST_HEAD ( udp_promisc_conns );
 
 /* Forward declatations */
 static struct interface_descriptor udp_xfer_desc;
 struct tcpip_protocol udp_protocol __tcpip_protocol;
 
 /**
- * Check if local UDP port is available
+ * Get local port hash bucket
  *
  * @v port		Local port number
- * @ret port		Local port number, or negative error
+ * @ret bucket		List of connections within hash bucket
  */
-static int udp_port_available ( int port ) {
+static inline struct list_head * udp_bucket ( unsigned int port ) {
+	struct list_head *bucket = &udp_hash[ tcpip_port_hash ( port ) ];
+
+	/* Initialise bucket on first use */
+	if ( ! bucket->next )
+		INIT_LIST_HEAD ( bucket );
+
+	return bucket;
+}
+
+/**
+ * Find UDP connection bound to local port
+ *
+ * @v port		Local port number
+ * @ret udp		UDP connection, or NULL
+ */
+static struct udp_connection * udp_find ( unsigned int port ) {
 	struct udp_connection *udp;
 
-	list_for_each_entry ( udp, &udp_conns, list ) {
+	list_for_each_entry ( udp, udp_bucket ( port ), list ) {
 		if ( udp->local.st_port == htons ( port ) )
-			return -EADDRINUSE;
+			return udp;
 	}
-	return port;
+	return NULL;
+}
+
+/**
+ * Check if local UDP port is available
+ *
+ * @v port		Local port number
+ * @ret port		Local port number, or negative error
+ */
+static int udp_port_available ( int port ) {
+
+	return ( udp_find ( port ) ? -EADDRINUSE : port );
 }
 
 /**
@@ -112,7 +151,12 @@ static int udp_open_common ( struct interface *xfer,
 	 * list and return
 	 */
 	intf_plug_plug ( &udp->xfer, xfer );
-	list_add ( &udp->list, &udp_conns );
+	if ( promisc ) {
+		list_add ( &udp->list, &udp_promisc_conns );
+	} else {
+		list_add ( &udp->list,
+			   udp_bucket ( ntohs ( udp->local.st_port ) ) );
+	}
 	return 0;
 
  err:
@@ -219,28 +263,50 @@ static int udp_tx ( struct udp_connection *udp, struct io_buffer *iobuf,
 	return 0;
 }
 
+/**
+ * Check if UDP connection matches local address
+ *
+ * @v udp		UDP connection
+ * @v local		Local address
+ * @ret matches		Connection matches local address
+ */
+static int udp_matches ( struct udp_connection *udp,
+			 struct sockaddr_tcpip *local ) {
+	static const struct sockaddr_tcpip empty_sockaddr = { .pad = { 0, } };
+
+	return ( ( ( udp->local.st_family == local->st_family ) ||
+		   ( udp->local.st_family == 0 ) ) &&
+		 ( ( udp->local.st_port == local->st_port ) ||
+		   ( udp->local.st_port == 0 ) ) &&
+		 ( ( memcmp ( udp->local.pad, local->pad,
+			      sizeof ( udp->local.pad ) ) == 0 ) ||
+		   ( memcmp ( udp->local.pad, empty_sockaddr.pad,
+			      sizeof ( udp->local.pad ) ) == 0 ) ) );
+}
+
 /**
  * Identify UDP connection by local address
  *
  * @v local		Local address
  * @ret udp		UDP connection, or NULL
+ *
+ * A connection bound to the local port takes precedence over any
+ * promiscuous connection.
  */
 static struct udp_connection * udp_demux ( struct sockaddr_tcpip *local ) {
-	static const struct sockaddr_tcpip empty_sockaddr = { .pad = { 0, } };
 	struct udp_connection *udp;
 
-	list_for_each_entry ( udp, &udp_conns, list ) {
-		if ( ( ( udp->local.st_family == local->st_family ) ||
-		       ( udp->local.st_family == 0 ) ) &&
-		     ( ( udp->local.st_port == local->st_port ) ||
-		       ( udp->local.st_port == 0 ) ) &&
-		     ( ( memcmp ( udp->local.pad, local->pad,
-				  sizeof ( udp->local.pad ) ) == 0 ) ||
-		       ( memcmp ( udp->local.pad, empty_sockaddr.pad,
-				  sizeof ( udp->local.pad ) ) == 0 ) ) ) {
+	/* Check for a connection bound to the local port */
+	udp = udp_find ( ntohs ( local->st_port ) );
+	if ( udp && udp_matches ( udp, local ) )
+		return udp;
+
+	/* Check for a promiscuous connection */
+	list_for_each_entry ( udp, &udp_promisc_conns, list ) {
+		if ( udp_matches ( udp, local ) )
 			return udp;
-		}
 	}
+
 	return NULL;
 }
 
@@ -286,7 +352,7 @@ static int udp_rx ( struct io_buffer *iobuf,
 		rc = -EINVAL;
 		goto done;
 	}
-	if ( udphdr->chksum ) {
+	if ( udphdr->chksum && ! ( iobuf->flags & IOB_CSUM_VERIFIED ) ) {
 		csum = tcpip_continue_chksum ( pshdr_csum, iobuf->data, ulen );
 		if ( csum != 0 ) {
 			DBG ( "UDP checksum incorrect (is %04x including "
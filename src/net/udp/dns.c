@@ -34,12 +34,14 @@ FILE_SECBOOT ( PERMITTED );
 #include <ctype.h>
 #include <errno.h>
 #include <byteswap.h>
+#include <ipxe/list.h>
 #include <ipxe/refcnt.h>
 #include <ipxe/iobuf.h>
 #include <ipxe/xfer.h>
 #include <ipxe/open.h>
 #include <ipxe/resolv.h>
 #include <ipxe/retry.h>
+#include <ipxe/timer.h>
 #include <ipxe/tcpip.h>
 #include <ipxe/settings.h>
 #include <ipxe/features.h>
@@ -445,37 +447,303 @@ static const char * dns_type ( uint16_t type ) {
 	case htons ( DNS_TYPE_A ):	return "A";
 	case htons ( DNS_TYPE_AAAA ):	return "AAAA";
 	case htons ( DNS_TYPE_CNAME ):	return "CNAME";
+	case htons ( DNS_TYPE_SOA ):	return "SOA";
+	case 0:				return "*";
 	default:			return "<UNKNOWN>";
 	}
 }
 
-/** A DNS request */
-struct dns_request {
-	/** Reference counter */
-	struct refcnt refcnt;
-	/** Name resolution interface */
-	struct interface resolv;
-	/** Data transfer interface */
-	struct interface socket;
-	/** Retry timer */
-	struct retry_timer timer;
+/******************************************************************************
+ *
+ * Cache
+ *
+ ******************************************************************************
+ */
 
-	/** Socket address to fill in with resolved address */
+/** A DNS cache entry */
+struct dns_cache_entry {
+	/** List of cache entries */
+	struct list_head list;
+	/** Record type (in network byte order), or zero for any type */
+	uint16_t type;
+	/** Entry records the absence of a record */
+	int negative;
+	/** Creation time (in ticks) */
+	unsigned long created;
+	/** Time to live (in ticks) */
+	unsigned long ttl;
+	/** Name */
+	struct dns_name name;
+	/** Canonical name (for CNAME records) */
+	struct dns_name cname;
+	/** Address (for A and AAAA records) */
 	union {
-		struct sockaddr sa;
-		struct sockaddr_in sin;
-		struct sockaddr_in6 sin6;
+		/** IPv4 address */
+		struct in_addr in;
+		/** IPv6 address */
+		struct in6_addr in6;
 	} address;
-	/** Current name server address */
+};
+
+/** DNS cache, in order of most recent use */
+static LIST_HEAD ( dns_cache );
+
+/** Number of DNS cache entries */
+static unsigned int dns_cache_count;
+
+/**
+ * Free DNS cache entry
+ *
+ * @v cache		DNS cache entry
+ */
+static void dns_cache_free ( struct dns_cache_entry *cache ) {
+
+	list_del ( &cache->list );
+	dns_cache_count--;
+	free ( cache );
+}
+
+/**
+ * Check if DNS cache entry has expired
+ *
+ * @v cache		DNS cache entry
+ * @ret expired		Entry has expired
+ */
+static int dns_cache_expired ( struct dns_cache_entry *cache ) {
+
+	return ( ( currticks() - cache->created ) >= cache->ttl );
+}
+
+/**
+ * Find DNS cache entry
+ *
+ * @v name		DNS name
+ * @v type		Record type (in network byte order)
+ * @ret cache		DNS cache entry, or NULL if not found
+ *
+ * A positive CNAME record or a nonexistent domain will match any
+ * record type, since neither may coexist with other records for the
+ * same name.
+ */
+static struct dns_cache_entry * dns_cache_find ( struct dns_name *name,
+						 uint16_t type ) {
+	struct dns_cache_entry *cache;
+	struct dns_cache_entry *tmp;
+
+	list_for_each_entry_safe ( cache, tmp, &dns_cache, list ) {
+
+		/* Discard expired entries */
+		if ( dns_cache_expired ( cache ) ) {
+			DBGC2 ( &dns_cache, "DNS cache expired %s type %s\n",
+				dns_name ( &cache->name ),
+				dns_type ( cache->type ) );
+			dns_cache_free ( cache );
+			continue;
+		}
+
+		/* Check for a matching type */
+		if ( ! ( ( cache->type == type ) || ( cache->type == 0 ) ||
+			 ( ( cache->type == htons ( DNS_TYPE_CNAME ) ) &&
+			   ( ! cache->negative ) ) ) ) {
+			continue;
+		}
+
+		/* Check for a matching name */
+		if ( dns_compare ( &cache->name, name ) != 0 )
+			continue;
+
+		/* Mark as most recently used */
+		list_del ( &cache->list );
+		list_add ( &cache->list, &dns_cache );
+		return cache;
+	}
+
+	return NULL;
+}
+
+/**
+ * Add DNS cache entry
+ *
+ * @v name		DNS name
+ * @v type		Record type (in network byte order), or zero
+ * @v ttl		Time to live (in seconds)
+ * @v cname		Canonical name, or NULL
+ * @ret cache		DNS cache entry, or NULL if not cached
+ *
+ * Any existing entry for the same name and record type will be
+ * replaced.  The caller must fill in the address (for A and AAAA
+ * records) or the negative flag, as applicable.
+ */
+static struct dns_cache_entry * dns_cache_add ( struct dns_name *name,
+						uint16_t type,
+						unsigned long ttl,
+						struct dns_name *cname ) {
+	struct dns_cache_entry *cache;
+	struct dns_cache_entry *tmp;
+	struct dns_name nul = { .len = 0 };
+	int name_len;
+	int cname_len;
+
+	/* Do not cache records that must not be cached */
+	if ( ! ttl )
+		return NULL;
+	if ( ttl > DNS_CACHE_MAX_TTL )
+		ttl = DNS_CACHE_MAX_TTL;
+
+	/* Determine lengths */
+	name_len = dns_copy ( name, &nul );
+	if ( name_len < 0 )
+		return NULL;
+	cname_len = ( cname ? dns_copy ( cname, &nul ) : 0 );
+	if ( cname_len < 0 )
+		return NULL;
+
+	/* Remove any existing entry */
+	list_for_each_entry_safe ( cache, tmp, &dns_cache, list ) {
+		if ( ( cache->type == type ) &&
+		     ( dns_compare ( &cache->name, name ) == 0 ) ) {
+			dns_cache_free ( cache );
+		}
+	}
+
+	/* Discard least recently used entry if cache is full */
+	if ( dns_cache_count >= DNS_CACHE_MAX ) {
+		cache = list_last_entry ( &dns_cache, struct dns_cache_entry,
+					  list );
+		assert ( cache != NULL );
+		dns_cache_free ( cache );
+	}
+
+	/* Allocate and populate entry */
+	cache = zalloc ( sizeof ( *cache ) + name_len + cname_len );
+	if ( ! cache )
+		return NULL;
+	cache->type = type;
+	cache->created = currticks();
+	cache->ttl = ( ttl * TICKS_PER_SEC );
+	cache->name.data = ( ( ( void * ) cache ) + sizeof ( *cache ) );
+	cache->name.len = name_len;
+	dns_copy ( name, &cache->name );
+	if ( cname ) {
+		cache->cname.data = ( cache->name.data + name_len );
+		cache->cname.len = cname_len;
+		dns_copy ( cname, &cache->cname );
+	}
+	list_add ( &cache->list, &dns_cache );
+	dns_cache_count++;
+
+	DBGC2 ( &dns_cache, "DNS cache added %s type %s for %lds\n",
+		dns_name ( &cache->name ), dns_type ( type ), ttl );
+	return cache;
+}
+
+/**
+ * Flush DNS cache
+ *
+ */
+void dns_cache_flush ( void ) {
+	struct dns_cache_entry *cache;
+	struct dns_cache_entry *tmp;
+
+	list_for_each_entry_safe ( cache, tmp, &dns_cache, list )
+		dns_cache_free ( cache );
+	assert ( dns_cache_count == 0 );
+}
+
+/**
+ * Age DNS cache
+ *
+ * @v ticks		Time by which to age all entries (in ticks)
+ *
+ * This allows cache expiry to be exercised by self-tests without
+ * waiting for each entry's time to live to elapse.
+ */
+void dns_cache_age ( unsigned long ticks ) {
+	struct dns_cache_entry *cache;
+
+	list_for_each_entry ( cache, &dns_cache, list )
+		cache->created -= ticks;
+}
+
+/**
+ * Get DNS cache entry information
+ *
+ * @v index		Entry index
+ * @v info		Entry information to fill in
+ * @ret rc		Return status code
+ */
+int dns_cache_info ( unsigned int index, struct dns_cache_info *info ) {
+	struct dns_cache_entry *cache;
+	struct dns_cache_entry *tmp;
+	unsigned long elapsed;
 	union {
 		struct sockaddr sa;
-		struct sockaddr_tcpip st;
 		struct sockaddr_in sin;
 		struct sockaddr_in6 sin6;
-	} nameserver;
-	/** Initial query type */
-	uint16_t qtype;
-	/** Buffer for current query */
+	} u;
+	int len;
+
+	/* Find entry, discarding any expired entries */
+	list_for_each_entry_safe ( cache, tmp, &dns_cache, list ) {
+		if ( dns_cache_expired ( cache ) ) {
+			dns_cache_free ( cache );
+			continue;
+		}
+		if ( index-- == 0 )
+			goto found;
+	}
+	return -ENOENT;
+
+ found:
+	memset ( info, 0, sizeof ( *info ) );
+	len = dns_decode ( &cache->name, info->name,
+			   ( sizeof ( info->name ) - 1 /* NUL */ ) );
+	if ( len < 0 )
+		return len;
+	info->type = dns_type ( cache->type );
+	elapsed = ( currticks() - cache->created );
+	info->ttl = ( ( cache->ttl - elapsed ) / TICKS_PER_SEC );
+
+	/* Describe value */
+	memset ( &u, 0, sizeof ( u ) );
+	if ( cache->negative ) {
+		snprintf ( info->value, sizeof ( info->value ), "%s",
+			   ( cache->type ? "<no record>" : "<no such name>" ) );
+	} else if ( cache->type == htons ( DNS_TYPE_AAAA ) ) {
+		u.sin6.sin6_family = AF_INET6;
+		memcpy ( &u.sin6.sin6_addr, &cache->address.in6,
+			 sizeof ( u.sin6.sin6_addr ) );
+		snprintf ( info->value, sizeof ( info->value ), "%s",
+			   sock_ntoa ( &u.sa ) );
+	} else if ( cache->type == htons ( DNS_TYPE_A ) ) {
+		u.sin.sin_family = AF_INET;
+		u.sin.sin_addr = cache->address.in;
+		snprintf ( info->value, sizeof ( info->value ), "%s",
+			   sock_ntoa ( &u.sa ) );
+	} else {
+		len = dns_decode ( &cache->cname, info->value,
+				   ( sizeof ( info->value ) - 1 /* NUL */ ) );
+		if ( len < 0 )
+			return len;
+	}
+
+	return 0;
+}
+
+/******************************************************************************
+ *
+ * Name resolution
+ *
+ ******************************************************************************
+ */
+
+/** A DNS query
+ *
+ * A DNS request issues one query for each combination of search
+ * suffix and record type.
+ */
+struct dns_query {
+	/** Buffer for query */
 	struct {
 		/** Query header */
 		struct dns_header query;
@@ -484,22 +752,70 @@ struct dns_request {
 		/** Space for question */
 		struct dns_question padding;
 	} __attribute__ (( packed )) buf;
-	/** Current query name */
+	/** Query name */
 	struct dns_name name;
-	/** Question within current query */
+	/** Question within query */
 	struct dns_question *question;
-	/** Length of current query */
+	/** Query type (in network byte order) */
+	uint16_t qtype;
+	/** Length of query */
 	size_t len;
-	/** Offset of search suffix within current query */
+	/** Offset of search suffix within query */
 	size_t offset;
-	/** Search list */
+	/** Search suffix */
 	struct dns_name search;
-	/** Server index */
-	unsigned int index;
 	/** Recursion counter */
 	unsigned int recursion;
+	/** Resolved address */
+	union {
+		struct sockaddr sa;
+		struct sockaddr_in sin;
+		struct sockaddr_in6 sin6;
+	} address;
+	/** Query status
+	 *
+	 * This is -EINPROGRESS while the query is outstanding, zero
+	 * once an address has been found, and a negative error
+	 * otherwise.
+	 */
+	int rc;
+};
+
+/** A DNS request */
+struct dns_request {
+	/** Reference counter */
+	struct refcnt refcnt;
+	/** Name resolution interface */
+	struct interface resolv;
+	/** Data transfer interface */
+	struct interface socket;
+	/** Retry timer */
+	struct retry_timer timer;
+
+	/** Current name server address */
+	union {
+		struct sockaddr sa;
+		struct sockaddr_tcpip st;
+		struct sockaddr_in sin;
+		struct sockaddr_in6 sin6;
+	} nameserver;
+	/** Server index */
+	unsigned int index;
+	/** Number of queries */
+	unsigned int count;
+	/** Queries, in order of preference */
+	struct dns_query queries[0];
 };
 
+/**
+ * Get DNS query index (for debugging)
+ *
+ * @v dns		DNS request
+ * @v query		DNS query
+ * @ret index		Query index
+ */
+#define dns_query_index( dns, query ) ( ( int ) ( (query) - (dns)->queries ) )
+
 /**
  * Mark DNS request as complete
  *
@@ -520,15 +836,16 @@ static void dns_done ( struct dns_request *dns, int rc ) {
  * Mark DNS request as resolved and complete
  *
  * @v dns		DNS request
- * @v rc		Return status code
+ * @v query		Successful DNS query
  */
-static void dns_resolved ( struct dns_request *dns ) {
+static void dns_resolved ( struct dns_request *dns, struct dns_query *query ) {
 
-	DBGC ( dns, "DNS %p found address %s\n",
-	       dns, sock_ntoa ( &dns->address.sa ) );
+	DBGC ( dns, "DNS %p/%d found address %s\n", dns,
+	       dns_query_index ( dns, query ),
+	       sock_ntoa ( &query->address.sa ) );
 
 	/* Return resolved address */
-	resolv_done ( &dns->resolv, &dns->address.sa );
+	resolv_done ( &dns->resolv, &query->address.sa );
 
 	/* Mark operation as complete */
 	dns_done ( dns, 0 );
@@ -538,14 +855,15 @@ static void dns_resolved ( struct dns_request *dns ) {
  * Construct DNS question
  *
  * @v dns		DNS request
+ * @v query		DNS query
  * @ret rc		Return status code
  */
-static int dns_question ( struct dns_request *dns ) {
+static int dns_question ( struct dns_request *dns, struct dns_query *query ) {
 	static struct dns_name search_root = {
 		.data = "",
 		.len = 1,
 	};
-	struct dns_name *search = &dns->search;
+	struct dns_name *search = &query->search;
 	int len;
 	size_t offset;
 
@@ -554,48 +872,73 @@ static int dns_question ( struct dns_request *dns ) {
 		search = &search_root;
 
 	/* Overwrite current suffix */
-	dns->name.offset = dns->offset;
-	len = dns_copy ( search, &dns->name );
+	query->name.offset = query->offset;
+	len = dns_copy ( search, &query->name );
 	if ( len < 0 )
 		return len;
 
 	/* Sanity check */
-	offset = ( dns->name.offset + len );
-	if ( offset > dns->name.len ) {
-		DBGC ( dns, "DNS %p name is too long\n", dns );
+	offset = ( query->name.offset + len );
+	if ( offset > query->name.len ) {
+		DBGC ( dns, "DNS %p/%d name is too long\n",
+		       dns, dns_query_index ( dns, query ) );
 		return -EINVAL;
 	}
 
 	/* Construct question */
-	dns->question = ( ( ( void * ) &dns->buf ) + offset );
-	dns->question->qtype = dns->qtype;
-	dns->question->qclass = htons ( DNS_CLASS_IN );
+	query->question = ( ( ( void * ) &query->buf ) + offset );
+	query->question->qtype = query->qtype;
+	query->question->qclass = htons ( DNS_CLASS_IN );
 
 	/* Store length */
-	dns->len = ( offset + sizeof ( *(dns->question) ) );
+	query->len = ( offset + sizeof ( *(query->question) ) );
 
 	/* Restore name */
-	dns->name.offset = offsetof ( typeof ( dns->buf ), name );
+	query->name.offset = offsetof ( typeof ( query->buf ), name );
 
 	/* Reset query ID */
-	dns->buf.query.id = 0;
+	query->buf.query.id = 0;
 
-	DBGC2 ( dns, "DNS %p question is %s type %s\n", dns,
-		dns_name ( &dns->name ), dns_type ( dns->question->qtype ) );
+	DBGC2 ( dns, "DNS %p/%d question is %s type %s\n", dns,
+		dns_query_index ( dns, query ), dns_name ( &query->name ),
+		dns_type ( query->qtype ) );
 
 	return 0;
 }
 
+/**
+ * Find outstanding DNS query by query identifier
+ *
+ * @v dns		DNS request
+ * @v id		Query identifier
+ * @ret query		DNS query, or NULL if not found
+ */
+static struct dns_query * dns_query ( struct dns_request *dns, uint16_t id ) {
+	struct dns_query *query;
+	unsigned int i;
+
+	for ( i = 0 ; i < dns->count ; i++ ) {
+		query = &dns->queries[i];
+		if ( ( query->rc == -EINPROGRESS ) &&
+		     ( query->buf.query.id == id ) )
+			return query;
+	}
+	return NULL;
+}
+
 /**
  * Send DNS query
  *
  * @v dns		DNS request
+ * @v query		DNS query
  * @ret rc		Return status code
  */
-static int dns_send_packet ( struct dns_request *dns ) {
-	struct dns_header *query = &dns->buf.query;
+static int dns_send_packet ( struct dns_request *dns,
+			     struct dns_query *query ) {
+	struct dns_header *header = &query->buf.query;
 	struct xfer_metadata meta;
 	unsigned int index;
+	uint16_t id;
 
 	/* Start retransmission timer */
 	start_timer ( &dns->timer );
@@ -621,17 +964,168 @@ static int dns_send_packet ( struct dns_request *dns ) {
 	memset ( &meta, 0, sizeof ( meta ) );
 	meta.dest = &dns->nameserver.sa;
 
-	/* Generate query identifier if applicable */
-	if ( ! query->id )
-		query->id = random();
+	/* Generate query identifier if applicable.  All queries share
+	 * a single socket, so the identifier must be unique within
+	 * this request.
+	 */
+	while ( ! header->id ) {
+		id = random();
+		if ( id && ( ! dns_query ( dns, id ) ) )
+			header->id = id;
+	}
 
 	/* Send query */
-	DBGC ( dns, "DNS %p sending %s query ID %#04x for %s type %s\n", dns,
-	       sock_ntoa ( &dns->nameserver.sa ), ntohs ( query->id ),
-	       dns_name ( &dns->name ), dns_type ( dns->question->qtype ) );
+	DBGC ( dns, "DNS %p/%d sending %s query ID %#04x for %s type %s\n",
+	       dns, dns_query_index ( dns, query ),
+	       sock_ntoa ( &dns->nameserver.sa ), ntohs ( header->id ),
+	       dns_name ( &query->name ), dns_type ( query->qtype ) );
 
 	/* Send the data */
-	return xfer_deliver_raw_meta ( &dns->socket, query, dns->len, &meta );
+	return xfer_deliver_raw_meta ( &dns->socket, header, query->len,
+				       &meta );
+}
+
+/**
+ * Follow DNS canonical name
+ *
+ * @v dns		DNS request
+ * @v query		DNS query
+ * @v cname		Canonical name
+ * @ret rc		Return status code
+ */
+static int dns_cname ( struct dns_request *dns, struct dns_query *query,
+		       struct dns_name *cname ) {
+	int name_len;
+
+	/* Terminate the query if we recurse too far */
+	if ( ++query->recursion > DNS_MAX_CNAME_RECURSION ) {
+		DBGC ( dns, "DNS %p/%d recursion exceeded\n",
+		       dns, dns_query_index ( dns, query ) );
+		return -ELOOP;
+	}
+
+	/* Update query and recurse */
+	DBGC ( dns, "DNS %p/%d found CNAME %s\n", dns,
+	       dns_query_index ( dns, query ), dns_name ( cname ) );
+	query->search.offset = query->search.len;
+	name_len = dns_copy ( cname, &query->name );
+	if ( name_len < 0 )
+		return name_len;
+	query->offset = ( offsetof ( typeof ( query->buf ), name ) +
+			  name_len - 1 /* Strip root label */ );
+	return dns_question ( dns, query );
+}
+
+/**
+ * Ask DNS query
+ *
+ * @v dns		DNS request
+ * @v query		DNS query
+ *
+ * The query will be answered from the DNS cache if possible, and
+ * sent to a DNS server otherwise.
+ */
+static void dns_ask ( struct dns_request *dns, struct dns_query *query ) {
+	struct dns_cache_entry *cache;
+	int rc;
+
+	/* Answer from cache for as long as possible */
+	while ( ( cache = dns_cache_find ( &query->name,
+					   query->qtype ) ) ) {
+
+		/* Fail query if there is no such record */
+		if ( cache->negative ) {
+			DBGC ( dns, "DNS %p/%d cached no %s type %s\n", dns,
+			       dns_query_index ( dns, query ),
+			       dns_name ( &query->name ),
+			       dns_type ( cache->type ) );
+			query->rc = -ENXIO_NO_RECORD;
+			return;
+		}
+
+		/* Handle cached record */
+		switch ( cache->type ) {
+		case htons ( DNS_TYPE_AAAA ):
+			DBGC ( dns, "DNS %p/%d using cached AAAA record\n",
+			       dns, dns_query_index ( dns, query ) );
+			query->address.sin6.sin6_family = AF_INET6;
+			memcpy ( &query->address.sin6.sin6_addr,
+				 &cache->address.in6,
+				 sizeof ( query->address.sin6.sin6_addr ) );
+			query->rc = 0;
+			return;
+		case htons ( DNS_TYPE_A ):
+			DBGC ( dns, "DNS %p/%d using cached A record\n",
+			       dns, dns_query_index ( dns, query ) );
+			query->address.sin.sin_family = AF_INET;
+			query->address.sin.sin_addr = cache->address.in;
+			query->rc = 0;
+			return;
+		case htons ( DNS_TYPE_CNAME ):
+			DBGC ( dns, "DNS %p/%d using cached CNAME record\n",
+			       dns, dns_query_index ( dns, query ) );
+			if ( ( rc = dns_cname ( dns, query,
+						&cache->cname ) ) != 0 ) {
+				query->rc = rc;
+				return;
+			}
+			break;
+		default:
+			assert ( 0 );
+			query->rc = -EINVAL;
+			return;
+		}
+	}
+
+	/* Send DNS query */
+	dns_send_packet ( dns, query );
+}
+
+/**
+ * Check for DNS request completion
+ *
+ * @v dns		DNS request
+ *
+ * The most preferred successful query determines the resolved
+ * address, once all more preferred queries have failed.  Any less
+ * preferred queries that are still outstanding at that point are
+ * cancelled.
+ */
+static void dns_check ( struct dns_request *dns ) {
+	struct dns_query *query;
+	unsigned int best;
+	unsigned int i;
+
+	/* Find most preferred successful query, if any */
+	for ( best = 0 ; best < dns->count ; best++ ) {
+		if ( dns->queries[best].rc == 0 )
+			break;
+	}
+
+	/* Cancel any less preferred outstanding queries */
+	for ( i = ( best + 1 ) ; i < dns->count ; i++ ) {
+		query = &dns->queries[i];
+		if ( query->rc == -EINPROGRESS ) {
+			DBGC2 ( dns, "DNS %p/%d cancelled\n", dns, i );
+			query->rc = -ECANCELED;
+		}
+	}
+
+	/* Wait for any more preferred outstanding queries */
+	for ( i = 0 ; i < best ; i++ ) {
+		if ( dns->queries[i].rc == -EINPROGRESS )
+			return;
+	}
+
+	/* Use successful query, if any */
+	if ( best < dns->count ) {
+		dns_resolved ( dns, &dns->queries[best] );
+		return;
+	}
+
+	/* All queries have failed */
+	DBGC ( dns, "DNS %p found no record\n", dns );
+	dns_done ( dns, dns->queries[0].rc );
 }
 
 /**
@@ -643,19 +1137,34 @@ static int dns_send_packet ( struct dns_request *dns ) {
 static void dns_timer_expired ( struct retry_timer *timer, int fail ) {
 	struct dns_request *dns =
 		container_of ( timer, struct dns_request, timer );
+	struct dns_query *query;
+	unsigned int i;
 
-	/* Terminate DNS request on failure */
-	if ( fail ) {
-		dns_done ( dns, -ETIMEDOUT );
-		return;
+	/* Move to next DNS server if this is a retransmission */
+	for ( i = 0 ; i < dns->count ; i++ ) {
+		query = &dns->queries[i];
+		if ( ( query->rc == -EINPROGRESS ) && query->buf.query.id ) {
+			dns->index++;
+			break;
+		}
 	}
 
-	/* Move to next DNS server if this is a retransmission */
-	if ( dns->buf.query.id )
-		dns->index++;
+	/* Fail, ask, or resend each outstanding query */
+	for ( i = 0 ; i < dns->count ; i++ ) {
+		query = &dns->queries[i];
+		if ( query->rc != -EINPROGRESS )
+			continue;
+		if ( fail ) {
+			query->rc = -ETIMEDOUT;
+		} else if ( query->buf.query.id ) {
+			dns_send_packet ( dns, query );
+		} else {
+			dns_ask ( dns, query );
+		}
+	}
 
-	/* Send DNS query */
-	dns_send_packet ( dns );
+	/* Check for completion */
+	dns_check ( dns );
 }
 
 /**
@@ -669,16 +1178,21 @@ static void dns_timer_expired ( struct retry_timer *timer, int fail ) {
 static int dns_xfer_deliver ( struct dns_request *dns,
 			      struct io_buffer *iobuf,
 			      struct xfer_metadata *meta __unused ) {
-	struct dns_header *query = &dns->buf.query;
-	unsigned int qtype = dns->question->qtype;
+	unsigned int recursion;
+	struct dns_cache_entry *cache;
 	struct dns_header *response;
+	struct dns_query *query;
 	struct dns_name buf;
+	struct dns_soa *soa;
 	union dns_rr *rr;
 	int offset;
 	size_t answer_offset;
 	size_t next_offset;
 	size_t rdlength;
-	int name_len;
+	unsigned long ttl;
+	unsigned long negative_ttl = 0;
+	unsigned int qtype;
+	unsigned int rcode;
 	int rc;
 
 	/* Sanity check */
@@ -690,16 +1204,19 @@ static int dns_xfer_deliver ( struct dns_request *dns,
 	}
 	response = iobuf->data;
 
-	/* Check response ID matches query ID */
-	if ( response->id != query->id ) {
-		DBGC ( dns, "DNS %p received unexpected response ID %#04x "
-		       "(wanted %d)\n", dns, ntohs ( response->id ),
-		       ntohs ( query->id ) );
+	/* Identify query */
+	query = dns_query ( dns, response->id );
+	if ( ! query ) {
+		DBGC ( dns, "DNS %p received unexpected response ID %#04x\n",
+		       dns, ntohs ( response->id ) );
 		rc = -EINVAL;
 		goto done;
 	}
-	DBGC ( dns, "DNS %p received response ID %#04x\n",
-	       dns, ntohs ( response->id ) );
+	DBGC ( dns, "DNS %p/%d received response ID %#04x\n", dns,
+	       dns_query_index ( dns, query ), ntohs ( response->id ) );
+	qtype = query->qtype;
+	recursion = query->recursion;
+	rcode = DNS_FLAG_RCODE ( ntohs ( response->flags ) );
 
 	/* Check that we have exactly one question */
 	if ( response->qdcount != htons ( 1 ) ) {
@@ -755,9 +1272,31 @@ static int dns_xfer_deliver ( struct dns_request *dns,
 			rc = -EINVAL;
 			goto done;
 		}
+		ttl = ntohl ( rr->common.ttl );
+
+		/* Record negative caching time from any SOA record
+		 * (as per RFC2308 section 5).
+		 */
+		if ( ( rr->common.type == htons ( DNS_TYPE_SOA ) ) &&
+		     ( rdlength >= sizeof ( *soa ) ) ) {
+			soa = ( buf.data + next_offset - sizeof ( *soa ) );
+			negative_ttl = ntohl ( soa->minimum );
+			if ( negative_ttl > ttl )
+				negative_ttl = ttl;
+			continue;
+		}
 
 		/* Skip non-matching names */
-		if ( dns_compare ( &buf, &dns->name ) != 0 ) {
+		if ( dns_compare ( &buf, &query->name ) != 0 ) {
+			DBGC2 ( dns, "DNS %p ignoring response for %s type "
+				"%s\n", dns, dns_name ( &buf ),
+				dns_type ( rr->common.type ) );
+			continue;
+		}
+
+		/* Skip records of types that were not requested */
+		if ( ( rr->common.type != qtype ) &&
+		     ( rr->common.type != htons ( DNS_TYPE_CNAME ) ) ) {
 			DBGC2 ( dns, "DNS %p ignoring response for %s type "
 				"%s\n", dns, dns_name ( &buf ),
 				dns_type ( rr->common.type ) );
@@ -770,146 +1309,94 @@ static int dns_xfer_deliver ( struct dns_request *dns,
 		case htons ( DNS_TYPE_AAAA ):
 
 			/* Found the target AAAA record */
-			if ( rdlength < sizeof ( dns->address.sin6.sin6_addr )){
+			if ( rdlength < sizeof ( query->address.sin6.sin6_addr )){
 				DBGC ( dns, "DNS %p received response with "
 				       "underlength AAAA\n", dns );
 				rc = -EINVAL;
 				goto done;
 			}
-			dns->address.sin6.sin6_family = AF_INET6;
-			memcpy ( &dns->address.sin6.sin6_addr,
+			query->address.sin6.sin6_family = AF_INET6;
+			memcpy ( &query->address.sin6.sin6_addr,
 				 &rr->aaaa.in6_addr,
-				 sizeof ( dns->address.sin6.sin6_addr ) );
-			dns_resolved ( dns );
+				 sizeof ( query->address.sin6.sin6_addr ) );
+			cache = dns_cache_add ( &query->name, rr->common.type,
+						ttl, NULL );
+			if ( cache ) {
+				memcpy ( &cache->address.in6,
+					 &rr->aaaa.in6_addr,
+					 sizeof ( cache->address.in6 ) );
+			}
+			query->rc = 0;
 			rc = 0;
-			goto done;
+			goto check;
 
 		case htons ( DNS_TYPE_A ):
 
 			/* Found the target A record */
-			if ( rdlength < sizeof ( dns->address.sin.sin_addr ) ) {
+			if ( rdlength < sizeof ( query->address.sin.sin_addr )){
 				DBGC ( dns, "DNS %p received response with "
 				       "underlength A\n", dns );
 				rc = -EINVAL;
 				goto done;
 			}
-			dns->address.sin.sin_family = AF_INET;
-			dns->address.sin.sin_addr = rr->a.in_addr;
-			dns_resolved ( dns );
+			query->address.sin.sin_family = AF_INET;
+			query->address.sin.sin_addr = rr->a.in_addr;
+			cache = dns_cache_add ( &query->name, rr->common.type,
+						ttl, NULL );
+			if ( cache )
+				cache->address.in = rr->a.in_addr;
+			query->rc = 0;
 			rc = 0;
-			goto done;
+			goto check;
 
 		case htons ( DNS_TYPE_CNAME ):
 
-			/* Terminate the operation if we recurse too far */
-			if ( ++dns->recursion > DNS_MAX_CNAME_RECURSION ) {
-				DBGC ( dns, "DNS %p recursion exceeded\n",
-				       dns );
-				rc = -ELOOP;
-				dns_done ( dns, rc );
-				goto done;
-			}
-
-			/* Found a CNAME record; update query and recurse */
+			/* Found a CNAME record; cache it, update query
+			 * and recurse
+			 */
 			buf.offset = ( offset + sizeof ( rr->cname ) );
-			DBGC ( dns, "DNS %p found CNAME %s\n",
-			       dns, dns_name ( &buf ) );
-			dns->search.offset = dns->search.len;
-			name_len = dns_copy ( &buf, &dns->name );
-			if ( name_len < 0 ) {
-				rc = name_len;
-				dns_done ( dns, rc );
-				goto done;
-			}
-			dns->offset = ( offsetof ( typeof ( dns->buf ), name ) +
-					name_len - 1 /* Strip root label */ );
-			if ( ( rc = dns_question ( dns ) ) != 0 ) {
-				dns_done ( dns, rc );
-				goto done;
+			dns_cache_add ( &query->name, rr->common.type, ttl,
+					&buf );
+			if ( ( rc = dns_cname ( dns, query, &buf ) ) != 0 ) {
+				query->rc = rc;
+				goto check;
 			}
 			next_offset = answer_offset;
 			break;
 
 		default:
-			DBGC ( dns, "DNS %p got unknown record type %d\n",
-			       dns, ntohs ( rr->common.type ) );
+			assert ( 0 );
 			break;
 		}
 	}
 
-	/* Stop the retry timer.  After this point, each code path
-	 * must either restart the timer by calling dns_send_packet(),
-	 * or mark the DNS operation as complete by calling
-	 * dns_done()
+	/* Record the absence of the requested record, if applicable.
+	 * A nonexistent domain has no records of any type.
 	 */
-	stop_timer ( &dns->timer );
+	if ( negative_ttl && ( ( rcode == DNS_RCODE_NOERROR ) ||
+			       ( rcode == DNS_RCODE_NXDOMAIN ) ) ) {
+		cache = dns_cache_add ( &query->name,
+					( ( rcode == DNS_RCODE_NXDOMAIN ) ?
+					  0 : qtype ), negative_ttl, NULL );
+		if ( cache )
+			cache->negative = 1;
+	}
 
-	/* Determine what to do next based on the type of query we
-	 * issued and the response we received
+	/* If we followed a CNAME, then ask about the canonical name.
+	 * Otherwise, there is no such record.
 	 */
-	switch ( qtype ) {
-
-	case htons ( DNS_TYPE_AAAA ):
-		/* We asked for an AAAA record and got nothing; try
-		 * the A.
-		 */
-		DBGC ( dns, "DNS %p found no AAAA record; trying A\n", dns );
-		dns->question->qtype = htons ( DNS_TYPE_A );
-		dns_send_packet ( dns );
-		rc = 0;
-		goto done;
-
-	case htons ( DNS_TYPE_A ):
-		/* We asked for an A record and got nothing;
-		 * try the CNAME.
-		 */
-		DBGC ( dns, "DNS %p found no A record; trying CNAME\n", dns );
-		dns->question->qtype = htons ( DNS_TYPE_CNAME );
-		dns_send_packet ( dns );
-		rc = 0;
-		goto done;
-
-	case htons ( DNS_TYPE_CNAME ):
-		/* We asked for a CNAME record.  If we got a response
-		 * (i.e. if the next AAAA/A query is already set up),
-		 * then issue it.
-		 */
-		if ( qtype == dns->qtype ) {
-			dns_send_packet ( dns );
-			rc = 0;
-			goto done;
-		}
-
-		/* If we have already reached the end of the search list,
-		 * then terminate lookup.
-		 */
-		if ( dns->search.offset == dns->search.len ) {
-			DBGC ( dns, "DNS %p found no CNAME record\n", dns );
-			rc = -ENXIO_NO_RECORD;
-			dns_done ( dns, rc );
-			goto done;
-		}
-
-		/* Move to next entry in search list.  This can never fail,
-		 * since we have already used this entry.
-		 */
-		DBGC ( dns, "DNS %p found no CNAME record; trying next "
-		       "suffix\n", dns );
-		dns->search.offset = dns_skip_search ( &dns->search );
-		if ( ( rc = dns_question ( dns ) ) != 0 ) {
-			dns_done ( dns, rc );
-			goto done;
-		}
-		dns_send_packet ( dns );
-		goto done;
-
-	default:
-		assert ( 0 );
-		rc = -EINVAL;
-		dns_done ( dns, rc );
-		goto done;
+	if ( query->recursion != recursion ) {
+		dns_ask ( dns, query );
+	} else {
+		DBGC ( dns, "DNS %p/%d found no %s record\n", dns,
+		       dns_query_index ( dns, query ), dns_type ( qtype ) );
+		query->rc = -ENXIO_NO_RECORD;
 	}
+	rc = 0;
 
+ check:
+	/* Check for completion */
+	dns_check ( dns );
  done:
 	/* Free I/O buffer */
 	free_iob ( iobuf );
@@ -939,10 +1426,18 @@ static void dns_xfer_close ( struct dns_request *dns, int rc ) {
  */
 static int dns_progress ( struct dns_request *dns,
 			  struct job_progress *progress ) {
+	struct dns_query *query = &dns->queries[0];
+	unsigned int i;
 	int len;
 
-	/* Show current question as progress message */
-	len = dns_decode ( &dns->name, progress->message,
+	/* Show most preferred outstanding question as progress message */
+	for ( i = 0 ; i < dns->count ; i++ ) {
+		if ( dns->queries[i].rc == -EINPROGRESS ) {
+			query = &dns->queries[i];
+			break;
+		}
+	}
+	len = dns_decode ( &query->name, progress->message,
 			   ( sizeof ( progress->message ) - 1 /* NUL */ ) );
 	if ( len < 0 ) {
 		/* Ignore undecodable names */
@@ -979,12 +1474,25 @@ static struct interface_descriptor dns_resolv_desc =
  * @v name		Name to resolve
  * @v sa		Socket address to fill in
  * @ret rc		Return status code
+ *
+ * A query is issued concurrently for each combination of search
+ * suffix and record type.  Queries are ordered by preference: by
+ * position within the search list, and then by record type (AAAA
+ * before A).  If the socket address already specifies an address
+ * family, then only the corresponding record type is queried.
  */
 static int dns_resolv ( struct interface *resolv,
 			const char *name, struct sockaddr *sa ) {
 	struct dns_request *dns;
-	struct dns_header *query;
+	struct dns_query *query;
+	struct dns_name search;
+	uint16_t qtypes[2];
+	unsigned int num_qtypes = 0;
+	unsigned int num_suffixes = 0;
+	unsigned int i;
 	size_t search_len;
+	void *search_data;
+	int offset;
 	int name_len;
 	int rc;
 
@@ -999,8 +1507,36 @@ static int dns_resolv ( struct interface *resolv,
 	/* Determine whether or not to use search list */
 	search_len = ( strchr ( name, '.' ) ? 0 : dns_search.len );
 
+	/* Count search suffixes */
+	memset ( &search, 0, sizeof ( search ) );
+	search.data = dns_search.data;
+	search.len = search_len;
+	while ( search.offset < search.len ) {
+		num_suffixes++;
+		offset = dns_skip_search ( &search );
+		if ( offset < 0 )
+			break;
+		search.offset = offset;
+	}
+	if ( ! num_suffixes )
+		num_suffixes = 1;
+
+	/* Determine query types, in order of preference */
+	if ( ( dns6.count != 0 ) && ( sa->sa_family != AF_INET ) )
+		qtypes[num_qtypes++] = htons ( DNS_TYPE_AAAA );
+	if ( sa->sa_family != AF_INET6 )
+		qtypes[num_qtypes++] = htons ( DNS_TYPE_A );
+	if ( ! num_qtypes ) {
+		DBG ( "DNS not attempting to resolve \"%s\": no IPv6 "
+		      "nameservers\n", name );
+		rc = -ENXIO_NO_RECORD;
+		goto err_no_qtypes;
+	}
+
 	/* Allocate DNS structure */
-	dns = zalloc ( sizeof ( *dns ) + search_len );
+	dns = zalloc ( sizeof ( *dns ) +
+		       ( num_suffixes * num_qtypes * sizeof ( *query ) ) +
+		       search_len );
 	if ( ! dns ) {
 		rc = -ENOMEM;
 		goto err_alloc_dns;
@@ -1009,31 +1545,42 @@ static int dns_resolv ( struct interface *resolv,
 	intf_init ( &dns->resolv, &dns_resolv_desc, &dns->refcnt );
 	intf_init ( &dns->socket, &dns_socket_desc, &dns->refcnt );
 	timer_init ( &dns->timer, dns_timer_expired, &dns->refcnt );
-	memcpy ( &dns->address.sa, sa, sizeof ( dns->address.sa ) );
-	dns->search.data = ( ( ( void * ) dns ) + sizeof ( *dns ) );
-	dns->search.len = search_len;
-	memcpy ( dns->search.data, dns_search.data, search_len );
-
-	/* Determine initial query type */
-	dns->qtype = ( ( dns6.count != 0 ) ?
-		       htons ( DNS_TYPE_AAAA ) : htons ( DNS_TYPE_A ) );
-
-	/* Construct query */
-	query = &dns->buf.query;
-	query->flags = htons ( DNS_FLAG_RD );
-	query->qdcount = htons ( 1 );
-	dns->name.data = &dns->buf;
-	dns->name.offset = offsetof ( typeof ( dns->buf ), name );
-	dns->name.len = offsetof ( typeof ( dns->buf ), padding );
-	name_len = dns_encode ( name, &dns->name );
-	if ( name_len < 0 ) {
-		rc = name_len;
-		goto err_encode;
+	dns->count = ( num_suffixes * num_qtypes );
+	search_data = &dns->queries[dns->count];
+	memcpy ( search_data, dns_search.data, search_len );
+
+	/* Construct queries */
+	search.offset = 0;
+	for ( i = 0 ; i < dns->count ; i++ ) {
+		query = &dns->queries[i];
+		query->rc = -EINPROGRESS;
+		memcpy ( &query->address.sa, sa, sizeof ( query->address.sa ) );
+		query->search.data = search_data;
+		query->search.offset = search.offset;
+		query->search.len = search_len;
+		query->buf.query.flags = htons ( DNS_FLAG_RD );
+		query->buf.query.qdcount = htons ( 1 );
+		query->name.data = &query->buf;
+		query->name.offset = offsetof ( typeof ( query->buf ), name );
+		query->name.len = offsetof ( typeof ( query->buf ), padding );
+		name_len = dns_encode ( name, &query->name );
+		if ( name_len < 0 ) {
+			rc = name_len;
+			goto err_encode;
+		}
+		query->offset = ( offsetof ( typeof ( query->buf ), name ) +
+				  name_len - 1 /* Strip root label */ );
+		query->qtype = qtypes[ i % num_qtypes ];
+		if ( ( rc = dns_question ( dns, query ) ) != 0 )
+			goto err_question;
+
+		/* Move to next search suffix, if applicable */
+		if ( ( ( i + 1 ) % num_qtypes ) == 0 ) {
+			offset = dns_skip_search ( &search );
+			if ( offset >= 0 )
+				search.offset = offset;
+		}
 	}
-	dns->offset = ( offsetof ( typeof ( dns->buf ), name ) +
-			name_len - 1 /* Strip root label */ );
-	if ( ( rc = dns_question ( dns ) ) != 0 )
-		goto err_question;
 
 	/* Open UDP connection */
 	if ( ( rc = xfer_open_socket ( &dns->socket, SOCK_DGRAM,
@@ -1043,19 +1590,20 @@ static int dns_resolv ( struct interface *resolv,
 		goto err_open_socket;
 	}
 
-	/* Start timer to trigger first packet */
+	/* Start timer to trigger first packets */
 	start_timer_nodelay ( &dns->timer );
 
 	/* Attach parent interface, mortalise self, and return */
 	intf_plug_plug ( &dns->resolv, resolv );
 	ref_put ( &dns->refcnt );
-	return 0;	
+	return 0;
 
  err_open_socket:
  err_question:
  err_encode:
 	ref_put ( &dns->refcnt );
  err_alloc_dns:
+ err_no_qtypes:
  err_no_nameserver:
 	return rc;
 }
@@ -1148,22 +1696,34 @@ const struct setting dnssl_setting __setting ( SETTING_IP_EXTRA, dnssl ) = {
 	.type = &setting_type_dnssl,
 };
 
+/**
+ * Check if DNS server list has changed
+ *
+ * @v old		Old server list
+ * @v new		New server list
+ * @v size		Size of each server address
+ * @ret changed		Server list has changed
+ */
+static int dns_server_changed ( struct dns_server *old, struct dns_server *new,
+				size_t size ) {
+
+	return ( ( old->count != new->count ) ||
+		 ( memcmp ( old->data, new->data,
+			    ( new->count * size ) ) != 0 ) );
+}
+
 /**
  * Apply DNS server addresses
  *
  */
 static void apply_dns_servers ( void ) {
+	struct dns_server old4 = dns4;
+	struct dns_server old6 = dns6;
 	int len;
 
-	/* Free existing server addresses */
-	free ( dns4.data );
-	free ( dns6.data );
-	dns4.data = NULL;
-	dns6.data = NULL;
-	dns4.count = 0;
-	dns6.count = 0;
-
 	/* Fetch DNS server addresses */
+	memset ( &dns4, 0, sizeof ( dns4 ) );
+	memset ( &dns6, 0, sizeof ( dns6 ) );
 	len = fetch_raw_setting_copy ( NULL, &dns_setting, &dns4.data );
 	if ( len >= 0 )
 		dns4.count = ( len / sizeof ( dns4.in[0] ) );
@@ -1171,6 +1731,19 @@ static void apply_dns_servers ( void ) {
 	if ( len >= 0 )
 		dns6.count = ( len / sizeof ( dns6.in6[0] ) );
 	dns_count = ( dns4.count + dns6.count );
+
+	/* Flush DNS cache if the servers have changed, since the new
+	 * servers may give different answers.
+	 */
+	if ( dns_server_changed ( &old4, &dns4, sizeof ( dns4.in[0] ) ) ||
+	     dns_server_changed ( &old6, &dns6, sizeof ( dns6.in6[0] ) ) ) {
+		DBGC ( &dns_cache, "DNS servers changed; flushing cache\n" );
+		dns_cache_flush();
+	}
+
+	/* Free old server addresses */
+	free ( old4.data );
+	free ( old6.data );
 }
 
 /**
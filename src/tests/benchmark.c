@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2026 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * Benchmark infrastructure
+ *
+ * Each benchmark records the time taken (as measured by
+ * profile_timestamp()) for each of a fixed number of iterations of
+ * an operation on fixed, pseudo-randomly generated data.  Results
+ * are reported in timestamp ticks (which are CPU cycles on most
+ * platforms) per byte and, using a timestamp frequency calibrated
+ * against the system timer, in megabytes per second.
+ *
+ */
+
+/* Forcibly enable profiling */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <ipxe/bench.h>
+#include <ipxe/timer.h>
+#include <ipxe/init.h>
+#include <ipxe/image.h>
+
+/** Number of timer ticks used to calibrate timestamp frequency */
+#define BENCH_CALIBRATE_TICKS ( TICKS_PER_SEC / 4 )
+
+/** Timestamp frequency (in ticks per second) */
+static unsigned long long bench_frequency;
+
+/**
+ * Calibrate timestamp frequency
+ *
+ */
+static void bench_calibrate ( void ) {
+	unsigned long start;
+	unsigned long stop;
+	unsigned long ticks;
+
+	/* Wait for start of a timer tick */
+	ticks = currticks();
+	while ( currticks() == ticks ) {}
+
+	/* Count timestamp ticks over a fixed number of timer ticks */
+	ticks = currticks();
+	start = profile_timestamp();
+	while ( ( currticks() - ticks ) < BENCH_CALIBRATE_TICKS ) {}
+	stop = profile_timestamp();
+
+	/* Calculate frequency */
+	bench_frequency = ( ( ( unsigned long long ) ( stop - start ) ) *
+			    TICKS_PER_SEC / BENCH_CALIBRATE_TICKS );
+	printf ( "Timestamp frequency %lld.%03lldMHz\n",
+		 ( bench_frequency / 1000000 ),
+		 ( ( bench_frequency / 1000 ) % 1000 ) );
+}
+
+/**
+ * Report benchmark result
+ *
+ * @v name		Benchmark name
+ * @v profiler		Profiler holding one sample per iteration
+ * @v len		Number of bytes processed per iteration, or zero
+ *
+ * Benchmarks that process a quantity of data (such as a digest
+ * calculation) are reported as a throughput.  Benchmarks that do not
+ * (such as a public-key operation) are reported as an operation
+ * rate.
+ */
+void bench_report ( const char *name, struct profiler *profiler,
+		    size_t len ) {
+	unsigned long long mean = profile_mean ( profiler );
+	unsigned long long cost;
+	unsigned long long rate;
+
+	/* Avoid division by zero */
+	if ( ! mean )
+		mean = 1;
+
+	if ( len ) {
+		/* Report throughput */
+		cost = ( ( ( mean * 100 ) + ( len / 2 ) ) / len );
+		rate = ( ( bench_frequency * len ) / ( mean * 1000000 ) );
+		printf ( "%s: %lld.%02lld cycles/byte, %lldMB/s\n",
+			 name, ( cost / 100 ), ( cost % 100 ), rate );
+	} else {
+		/* Report operation rate */
+		rate = ( bench_frequency / mean );
+		printf ( "%s: %lld cycles/op, %lld ops/s\n",
+			 name, mean, rate );
+	}
+}
+
+/**
+ * Run all benchmarks
+ *
+ * @ret rc		Return status code
+ */
+static int run_all_benchmarks ( void ) {
+	struct benchmark *benchmark;
+
+	/* Calibrate timestamp frequency */
+	bench_calibrate();
+
+	/* Run all compiled-in benchmarks */
+	printf ( "Starting %s benchmarks\n", _S2 ( ARCH ) );
+	for_each_table_entry ( benchmark, BENCHMARKS ) {
+		printf ( "Running \"%s\" benchmarks\n", benchmark->name );
+		benchmark->exec();
+	}
+
+	return 0;
+}
+
+static int bench_image_probe ( struct image *image __unused ) {
+	return -ENOTTY;
+}
+
+static int bench_image_exec ( struct image *image __unused ) {
+	return run_all_benchmarks();
+}
+
+static struct image_type bench_image_type = {
+	.name = "benchmarks",
+	.probe = bench_image_probe,
+	.exec = bench_image_exec,
+};
+
+static struct image bench_image = {
+	.refcnt = REF_INIT ( ref_no_free ),
+	.name = "<BENCHMARKS>",
+	.flags = ( IMAGE_STATIC | IMAGE_STATIC_NAME ),
+	.type = &bench_image_type,
+	.data = empty_image_data,
+};
+
+static void bench_init ( void ) {
+	int rc;
+
+	/* Register benchmarks image */
+	if ( ( rc = register_image ( &bench_image ) ) != 0 ) {
+		DBG ( "Could not register benchmark image: %s\n",
+		      strerror ( rc ) );
+		/* No way to report failure */
+		return;
+	}
+}
+
+/** Benchmark initialisation function */
+struct init_fn bench_init_fn __init_fn ( INIT_EARLY ) = {
+	.name = "bench",
+	.initialise = bench_init,
+};
@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2026 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * Cipher algorithm benchmarks
+ *
+ */
+
+/* Forcibly enable profiling */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <ipxe/crypto.h>
+#include <ipxe/aes.h>
+#include <ipxe/des.h>
+#include <ipxe/arc4.h>
+#include <ipxe/bench.h>
+
+/** A cipher benchmark */
+struct cipher_bench {
+	/** Cipher algorithm */
+	struct cipher_algorithm *cipher;
+	/** Key length */
+	size_t key_len;
+};
+
+/** Encrypted data */
+static uint8_t cipher_bench_data[8192];
+
+/** Cipher benchmarks */
+static struct cipher_bench cipher_benches[] = {
+	{ &aes_ecb_algorithm, 16 },
+	{ &aes_ecb_algorithm, 32 },
+	{ &aes_cbc_algorithm, 16 },
+	{ &aes_cbc_algorithm, 32 },
+	{ &aes_gcm_algorithm, 16 },
+	{ &aes_gcm_algorithm, 32 },
+	{ &des_ecb_algorithm, 8 },
+	{ &des_cbc_algorithm, 8 },
+	{ &arc4_algorithm, 16 },
+};
+
+/**
+ * Benchmark cipher encryption or decryption
+ *
+ * @v bench		Cipher benchmark
+ * @v op		Encryption or decryption operation
+ * @v op_name		Operation name
+ */
+static void
+cipher_bench_op ( struct cipher_bench *bench,
+		  void ( * op ) ( struct cipher_algorithm *cipher, void *ctx,
+				  const void *src, void *dst, size_t len ),
+		  const char *op_name ) {
+	struct cipher_algorithm *cipher = bench->cipher;
+	uint8_t key[bench->key_len];
+	uint8_t iv[cipher->blocksize];
+	uint8_t ctx[cipher->ctxsize];
+	struct profiler profiler;
+	char name[32];
+	unsigned int i;
+	int rc;
+
+	/* Generate pseudo-random key and IV */
+	for ( i = 0 ; i < sizeof ( key ) ; i++ )
+		key[i] = rand();
+	for ( i = 0 ; i < sizeof ( iv ) ; i++ )
+		iv[i] = rand();
+
+	/* Initialise cipher */
+	rc = cipher_setkey ( cipher, ctx, key, sizeof ( key ) );
+	assert ( rc == 0 );
+	cipher_setiv ( cipher, ctx, iv, sizeof ( iv ) );
+
+	/* Profile cipher operation */
+	memset ( &profiler, 0, sizeof ( profiler ) );
+	for ( i = 0 ; i < BENCH_COUNT ; i++ ) {
+		profile_start ( &profiler );
+		op ( cipher, ctx, cipher_bench_data, cipher_bench_data,
+		     sizeof ( cipher_bench_data ) );
+		profile_stop ( &profiler );
+	}
+
+	snprintf ( name, sizeof ( name ), "%s-%zd %s", cipher->name,
+		   ( bench->key_len * 8 ), op_name );
+	bench_report ( name, &profiler, sizeof ( cipher_bench_data ) );
+}
+
+/**
+ * Perform cipher algorithm benchmarks
+ *
+ */
+static void cipher_bench_exec ( void ) {
+	struct cipher_bench *bench;
+	unsigned int i;
+
+	/* Fill buffer with pseudo-random data */
+	srand ( 0x1234568 );
+	for ( i = 0 ; i < sizeof ( cipher_bench_data ) ; i++ )
+		cipher_bench_data[i] = rand();
+
+	/* Perform benchmarks */
+	for ( i = 0 ; i < ( sizeof ( cipher_benches ) /
+			    sizeof ( cipher_benches[0] ) ) ; i++ ) {
+		bench = &cipher_benches[i];
+		cipher_bench_op ( bench, cipher_encrypt, "encrypt" );
+		cipher_bench_op ( bench, cipher_decrypt, "decrypt" );
+	}
+}
+
+/** Cipher algorithm benchmark */
+struct benchmark cipher_bench __benchmark = {
+	.name = "cipher",
+	.exec = cipher_bench_exec,
+};
@@ -0,0 +1,279 @@
+/*
+ * Copyright (C) 2026 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * DEFLATE decompression benchmarks
+ *
+ */
+
+/* Forcibly enable profiling */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <ipxe/deflate.h>
+#include <ipxe/bench.h>
+
+/** Length of decompressed data */
+#define DEFLATE_BENCH_LEN 8192
+
+/** Compressed data
+ *
+ * This is 8kB of pseudo-randomly generated English-like text,
+ * compressed using zlib at maximum compression level.
+ */
+static const uint8_t deflate_bench_compressed[] = {
+	0x75, 0x59, 0x5b, 0x62, 0xdb, 0x46, 0x0c, 0xfc, 0xdf, 0x53,
+	0xe8, 0x6a, 0x8a, 0x4d, 0x47, 0xae, 0x63, 0xd3, 0x91, 0x95,
+	0xa6, 0xe9, 0xe9, 0xab, 0xc5, 0x0c, 0x80, 0x99, 0x15, 0xfb,
+	0xe1, 0x87, 0x96, 0x20, 0x16, 0x6f, 0x0c, 0xa0, 0x6f, 0xfb,
+	0x7e, 0x1b, 0xaf, 0xef, 0xe7, 0xef, 0xdb, 0xe9, 0xc7, 0xf9,
+	0xdf, 0x3f, 0xa7, 0xe7, 0xcb, 0xd3, 0xe7, 0xe9, 0xdb, 0x75,
+	0xff, 0xfd, 0x71, 0x7a, 0xdb, 0xae, 0x1f, 0xdb, 0x8f, 0x13,
+	0x1e, 0xf2, 0xc3, 0xe7, 0xf9, 0xe9, 0x6d, 0xbb, 0x9d, 0x6e,
+	0x2f, 0xb7, 0xcf, 0xfc, 0xff, 0x65, 0xff, 0xe7, 0x74, 0xbb,
+	0x6c, 0xa7, 0xa7, 0x1f, 0xaf, 0xdb, 0xc7, 0xed, 0x74, 0xb9,
+	0xdd, 0x1f, 0x7d, 0x6d, 0xd7, 0xbf, 0xb7, 0xeb, 0xe9, 0xe7,
+	0xaf, 0xd7, 0xa7, 0xb7, 0xd3, 0xc7, 0x76, 0x7b, 0x3f, 0x7f,
+	0xbd, 0x0d, 0xb2, 0xd8, 0xe7, 0x13, 0x9e, 0x91, 0x22, 0x6e,
+	0xce, 0xa3, 0x97, 0xeb, 0xf9, 0x7d, 0x0b, 0xae, 0x21, 0x4b,
+	0x90, 0xc7, 0x2f, 0xde, 0x87, 0x57, 0xf0, 0x9b, 0x77, 0x3e,
+	0xef, 0xdf, 0x4f, 0xd7, 0xfd, 0xd7, 0x6d, 0x83, 0x60, 0xbc,
+	0x7d, 0x9e, 0xde, 0x7f, 0x06, 0x48, 0xcf, 0xcf, 0xcf, 0xd7,
+	0xed, 0xeb, 0x8b, 0x74, 0x71, 0xc9, 0xf8, 0x7e, 0xbe, 0x6d,
+	0xbf, 0xcf, 0x7f, 0xa8, 0x22, 0x98, 0x8d, 0x10, 0x26, 0xa9,
+	0x27, 0x8f, 0xfa, 0xff, 0x2e, 0xce, 0xc8, 0x0f, 0x54, 0x86,
+	0x02, 0xc4, 0x3b, 0x3c, 0xe2, 0xed, 0xf6, 0x87, 0x16, 0x36,
+	0xa1, 0xd3, 0x2c, 0x53, 0xe4, 0x92, 0x04, 0xca, 0x83, 0xfa,
+	0xf5, 0xe3, 0xf5, 0x76, 0x7d, 0x4e, 0x46, 0x25, 0x2b, 0x4e,
+	0x69, 0x8c, 0x6f, 0x77, 0xf7, 0x91, 0xed, 0x34, 0x7c, 0xda,
+	0x38, 0x2c, 0xa7, 0xb2, 0x83, 0x63, 0xf8, 0x26, 0x6c, 0x09,
+	0x2b, 0xb4, 0x75, 0x42, 0x81, 0x30, 0x1e, 0x24, 0x08, 0xbe,
+	0x7d, 0x98, 0x6c, 0x52, 0x08, 0x04, 0x08, 0x9e, 0x5f, 0x10,
+	0x39, 0x03, 0x67, 0x14, 0x6f, 0xba, 0x8f, 0x7a, 0xe2, 0x7c,
+	0x92, 0xc5, 0xf5, 0xf1, 0x4b, 0x7c, 0x38, 0xe4, 0xc2, 0x78,
+	0x56, 0x22, 0x17, 0x27, 0xca, 0x98, 0x97, 0xa7, 0xea, 0xc1,
+	0x17, 0xbf, 0x43, 0x9d, 0x91, 0x11, 0xc4, 0x37, 0xf7, 0x0c,
+	0x82, 0x50, 0x21, 0x84, 0x85, 0x19, 0xa6, 0x2c, 0x53, 0xc0,
+	0xa4, 0xf7, 0x30, 0xc8, 0xfb, 0x43, 0xa2, 0x49, 0x46, 0x07,
+	0xe4, 0x39, 0x84, 0x99, 0x0f, 0x60, 0xc4, 0x60, 0x8c, 0xc3,
+	0xbf, 0x7e, 0xbd, 0x7f, 0x22, 0x66, 0xa0, 0x14, 0xc4, 0x8a,
+	0xeb, 0x4b, 0x8e, 0xd0, 0x31, 0xfc, 0x83, 0xeb, 0xca, 0x55,
+	0x91, 0x47, 0x49, 0x0a, 0x7e, 0xf4, 0x26, 0x43, 0xf6, 0xfe,
+	0x9c, 0x07, 0x78, 0x8a, 0xe3, 0xcc, 0xc8, 0xbb, 0x4e, 0xa9,
+	0x4f, 0x4a, 0x0a, 0x21, 0x3a, 0x8b, 0x18, 0x5c, 0xb4, 0x6b,
+	0x7c, 0x28, 0xd2, 0x3b, 0xf3, 0xf0, 0x22, 0x0f, 0x20, 0xf4,
+	0xde, 0x49, 0xcc, 0xe4, 0x08, 0x66, 0x50, 0x33, 0xf4, 0x8e,
+	0x7f, 0xc7, 0x41, 0x4a, 0xbb, 0x4d, 0xfd, 0x6c, 0x97, 0x78,
+	0x1e, 0x14, 0x27, 0x18, 0x27, 0x41, 0xb0, 0x66, 0xdc, 0xcc,
+	0xec, 0x40, 0xa0, 0x30, 0x9e, 0x3c, 0xcd, 0xc0, 0x19, 0xb4,
+	0xed, 0x70, 0x3a, 0xb8, 0x6d, 0x2d, 0x9a, 0x84, 0x44, 0x8c,
+	0x3a, 0x71, 0x53, 0x32, 0x4c, 0x79, 0xd2, 0x89, 0x62, 0x89,
+	0xe0, 0xc4, 0xeb, 0x83, 0x35, 0x2a, 0xe6, 0x9d, 0x32, 0x05,
+	0x4f, 0xeb, 0x69, 0x38, 0xe4, 0xb3, 0x29, 0x54, 0x94, 0x10,
+	0x9a, 0xb2, 0xa2, 0xb5, 0x8b, 0x2f, 0x45, 0x50, 0xa9, 0x92,
+	0xca, 0x8b, 0x06, 0x1f, 0x86, 0x10, 0x14, 0x28, 0xc2, 0xb5,
+	0x03, 0x70, 0xfe, 0x1c, 0x15, 0xb4, 0x69, 0x96, 0x99, 0x52,
+	0x62, 0x90, 0xf8, 0x37, 0x5e, 0xaf, 0x90, 0xa7, 0x11, 0xf2,
+	0xb6, 0xc9, 0x8c, 0x47, 0x70, 0xcd, 0xa4, 0x4b, 0x8e, 0x49,
+	0xd4, 0xed, 0xc3, 0x1d, 0x25, 0x09, 0xef, 0x15, 0x8d, 0x91,
+	0x1b, 0xd7, 0x07, 0x11, 0x94, 0x2a, 0x2f, 0xb6, 0xcd, 0xeb,
+	0xc8, 0xcb, 0x59, 0x3c, 0x23, 0xb3, 0x94, 0x22, 0xbc, 0x35,
+	0x4d, 0xad, 0x0a, 0x83, 0x1c, 0xf7, 0x0d, 0x5a, 0x40, 0x5b,
+	0xd9, 0x10, 0x7e, 0x1e, 0xb8, 0x93, 0x53, 0x68, 0x5b, 0x99,
+	0xa9, 0x52, 0xc3, 0xdc, 0x94, 0x20, 0x4e, 0x40, 0xf6, 0x60,
+	0x84, 0x01, 0x4a, 0xea, 0x3f, 0x99, 0x82, 0xfd, 0xff, 0x57,
+	0xa1, 0xae, 0xe9, 0x9e, 0xa9, 0x70, 0xdc, 0xe4, 0xa0, 0x7e,
+	0x07, 0x49, 0x72, 0x40, 0x52, 0x4e, 0xde, 0x48, 0x1c, 0xd4,
+	0xf5, 0xfa, 0x88, 0xdf, 0x90, 0x25, 0xff, 0x64, 0x13, 0xa7,
+	0x76, 0x4b, 0xbd, 0x1f, 0x21, 0x87, 0x27, 0x38, 0x9c, 0x95,
+	0x42, 0x44, 0xfe, 0xcd, 0xb8, 0x82, 0xf4, 0x52, 0x95, 0xbb,
+	0xc0, 0x45, 0x14, 0x59, 0x89, 0xed, 0x86, 0x20, 0x75, 0xf6,
+	0xe8, 0x1a, 0x98, 0x4f, 0xe3, 0x23, 0x0a, 0x28, 0xcc, 0xd9,
+	0x9e, 0xf2, 0x94, 0x12, 0xcb, 0x44, 0x6f, 0x04, 0x43, 0x01,
+	0x38, 0x4b, 0xbd, 0x84, 0x93, 0x86, 0x3a, 0xd8, 0x20, 0x87,
+	0xaa, 0x26, 0xa5, 0xb5, 0xe3, 0xbe, 0x62, 0xf0, 0x92, 0xfe,
+	0x0b, 0x11, 0x1c, 0x2a, 0x94, 0xa9, 0x16, 0xc0, 0x63, 0x59,
+	0xca, 0x57, 0xcc, 0xa1, 0x88, 0x2d, 0x38, 0x2f, 0x84, 0x5b,
+	0xbb, 0x83, 0x95, 0xd2, 0xae, 0x9e, 0x49, 0x07, 0x26, 0x79,
+	0x29, 0x3e, 0xe1, 0x6a, 0x89, 0x65, 0x0a, 0xa9, 0x81, 0x3d,
+	0xe8, 0x17, 0x89, 0x39, 0xc1, 0x0c, 0x4c, 0x2a, 0x1a, 0xaa,
+	0x7b, 0x02, 0xae, 0x56, 0x63, 0x51, 0xba, 0x46, 0x16, 0x02,
+	0x15, 0x52, 0x6f, 0xbc, 0x1a, 0x24, 0x79, 0xab, 0x02, 0x3a,
+	0x71, 0x3a, 0xb4, 0x3e, 0xc0, 0x23, 0x0a, 0x0b, 0xf8, 0x1e,
+	0x75, 0xbd, 0xdf, 0xb3, 0x6b, 0x23, 0xa7, 0xae, 0xfc, 0x43,
+	0x0d, 0xc0, 0x17, 0xae, 0xee, 0xca, 0xb4, 0x54, 0xe1, 0x19,
+	0xc9, 0xb8, 0x01, 0xee, 0xa8, 0xa2, 0x38, 0xaa, 0x5e, 0x10,
+	0xd5, 0x28, 0x90, 0x6e, 0xbc, 0x3c, 0xa4, 0xda, 0x67, 0x3b,
+	0x48, 0x55, 0xd0, 0xb3, 0x0a, 0x02, 0x50, 0x05, 0x88, 0x95,
+	0x92, 0x8b, 0x99, 0x13, 0x39, 0x64, 0x03, 0xe7, 0x31, 0x0d,
+	0x09, 0x5b, 0x68, 0xb5, 0xe6, 0xa5, 0xde, 0x47, 0x20, 0xac,
+	0xd5, 0xa8, 0xd0, 0xc6, 0x22, 0x47, 0x31, 0xae, 0x44, 0x0f,
+	0x4b, 0xdb, 0xfe, 0x28, 0xa5, 0xba, 0x0e, 0xf8, 0xa3, 0x41,
+	0x61, 0x59, 0x10, 0xa5, 0x25, 0x44, 0x2c, 0x0c, 0x7c, 0x27,
+	0x93, 0x2b, 0xf9, 0xc6, 0x82, 0x7f, 0xb5, 0x1b, 0xd8, 0xf8,
+	0xa0, 0xf3, 0x47, 0x03, 0x58, 0x38, 0xd4, 0xf3, 0x89, 0x8c,
+	0xb5, 0xc2, 0x24, 0x81, 0x77, 0x30, 0x83, 0xc0, 0x92, 0xf9,
+	0x82, 0xff, 0x60, 0x69, 0x9d, 0x14, 0xd0, 0xef, 0xab, 0xe4,
+	0x39, 0x02, 0x8a, 0x77, 0x02, 0x6f, 0xa1, 0x3a, 0x4e, 0x58,
+	0xa0, 0x5d, 0x5f, 0x9a, 0x39, 0xa3, 0xc6, 0x6a, 0x9d, 0xfa,
+	0xab, 0x80, 0xa5, 0x8c, 0x02, 0x14, 0xbf, 0x9b, 0x51, 0x3c,
+	0x23, 0x0b, 0x1f, 0x87, 0x8e, 0x30, 0x33, 0x73, 0x5a, 0x3b,
+	0x68, 0x70, 0x59, 0x12, 0x87, 0xa1, 0xd4, 0x48, 0x88, 0xa2,
+	0x52, 0xae, 0xb4, 0x81, 0x0e, 0x5c, 0x34, 0x68, 0x70, 0x14,
+	0xd8, 0x14, 0xb4, 0xf3, 0x50, 0x42, 0x60, 0xcc, 0xe1, 0x44,
+	0x41, 0xde, 0x68, 0xa4, 0x3b, 0x1c, 0xbc, 0x76, 0x3a, 0x1a,
+	0x24, 0x8e, 0xb4, 0x08, 0x42, 0x09, 0xba, 0x03, 0x04, 0x2d,
+	0x80, 0x27, 0xfb, 0x9d, 0x97, 0xe6, 0x94, 0x4a, 0x46, 0x4c,
+	0x03, 0x3d, 0x16, 0xbd, 0xe0, 0xdc, 0x50, 0x1f, 0x80, 0xa4,
+	0x8b, 0xa1, 0x1b, 0x4f, 0x0a, 0x97, 0x57, 0xd2, 0x5d, 0x66,
+	0xc8, 0xbc, 0x8c, 0xb2, 0x2f, 0x2e, 0x0b, 0xe3, 0x2d, 0x7d,
+	0x5b, 0x11, 0x08, 0xe2, 0x1f, 0xb4, 0x5e, 0x89, 0x70, 0xf9,
+	0x82, 0x5d, 0xbd, 0xad, 0x90, 0x32, 0xfa, 0x67, 0x21, 0x8f,
+	0xd0, 0x77, 0x7e, 0x1a, 0xda, 0x5f, 0xc0, 0xcd, 0xe7, 0x1c,
+	0x8a, 0x40, 0x9b, 0x5c, 0xac, 0x11, 0x53, 0xa4, 0xa0, 0x13,
+	0x70, 0x39, 0x2c, 0x9b, 0xad, 0x5d, 0x45, 0x75, 0x15, 0xe0,
+	0x9e, 0xb6, 0xaa, 0x2e, 0x50, 0x33, 0x24, 0xd2, 0x44, 0x51,
+	0x83, 0x24, 0x6c, 0x21, 0x21, 0x41, 0x76, 0x0e, 0x3a, 0x6c,
+	0x6f, 0x21, 0xa3, 0xde, 0xbc, 0x3f, 0xc8, 0x97, 0x51, 0x54,
+	0xe2, 0x0b, 0xa1, 0x1c, 0x32, 0x2e, 0x73, 0xa3, 0x22, 0x7c,
+	0xb0, 0xe3, 0x24, 0x19, 0xaa, 0xe4, 0x65, 0x36, 0x1b, 0xcd,
+	0x9b, 0xdd, 0x49, 0x82, 0x93, 0x5a, 0x0d, 0xe8, 0xa9, 0xa2,
+	0x6b, 0xf3, 0xd4, 0xf9, 0x43, 0x1a, 0xb7, 0x24, 0x03, 0xae,
+	0x90, 0x3a, 0x6e, 0xb5, 0x54, 0xeb, 0x97, 0x68, 0xe7, 0xfd,
+	0xaa, 0xad, 0x9b, 0xf5, 0x2a, 0xde, 0x3a, 0xec, 0x5e, 0x9a,
+	0x07, 0xa3, 0x5d, 0xd0, 0xff, 0x05, 0x3e, 0x16, 0xb4, 0xa0,
+	0xa3, 0x47, 0x6f, 0x0b, 0x86, 0x2d, 0xa6, 0x3a, 0xe6, 0xb4,
+	0x01, 0xb2, 0x3b, 0x6a, 0xbf, 0x05, 0x51, 0x19, 0x85, 0xf7,
+	0x0d, 0xc9, 0xed, 0xaa, 0x1b, 0xcc, 0x4e, 0x99, 0x79, 0x9b,
+	0x6b, 0xaf, 0xa5, 0x72, 0x01, 0xa2, 0x81, 0x26, 0x15, 0xc8,
+	0x66, 0x84, 0x49, 0x6b, 0x86, 0x33, 0x24, 0x2c, 0x98, 0xbf,
+	0x67, 0x32, 0xdf, 0x5b, 0x3d, 0x34, 0x5b, 0x86, 0x9e, 0x4e,
+	0x38, 0x95, 0xf8, 0x17, 0x02, 0x90, 0x51, 0x56, 0xd5, 0x78,
+	0xc1, 0xa3, 0x1c, 0x49, 0x7a, 0xf5, 0x13, 0x41, 0xd7, 0xbd,
+	0xa4, 0xba, 0x39, 0x67, 0x6a, 0xad, 0xdb, 0xb2, 0x55, 0x92,
+	0x86, 0x5d, 0x6b, 0xa1, 0x24, 0xd3, 0xc5, 0x1f, 0xe7, 0x8d,
+	0x69, 0x72, 0xdd, 0x55, 0x49, 0x78, 0x79, 0x2a, 0x42, 0x26,
+	0x2a, 0x26, 0xe1, 0xa7, 0x15, 0x2e, 0xa4, 0x15, 0x93, 0x1f,
+	0x36, 0x3a, 0xc8, 0x9a, 0x4b, 0x37, 0xb1, 0x23, 0x1e, 0x60,
+	0x55, 0x83, 0x70, 0x7b, 0xc0, 0xf9, 0xa0, 0x5e, 0x5b, 0x66,
+	0x57, 0x23, 0x98, 0xd2, 0x6f, 0x6a, 0x0f, 0x7a, 0x6f, 0x91,
+	0xa1, 0x61, 0x99, 0xb2, 0xa5, 0x7c, 0xd9, 0x9c, 0x6c, 0x28,
+	0x76, 0x79, 0x47, 0x0b, 0x9d, 0xad, 0x57, 0xd8, 0x5f, 0xaa,
+	0x24, 0x71, 0xc2, 0xbd, 0x7f, 0x94, 0x58, 0x3d, 0xc4, 0xd2,
+	0x47, 0x6b, 0x5f, 0x83, 0xd3, 0x5e, 0x91, 0xa6, 0x15, 0xec,
+	0x81, 0x45, 0xa4, 0xc2, 0x3f, 0x66, 0x7c, 0x63, 0x82, 0x8e,
+	0xb2, 0xd1, 0xb9, 0xa3, 0xfb, 0x40, 0x85, 0x44, 0x86, 0xc3,
+	0x1f, 0x66, 0x66, 0x5b, 0x8a, 0x7a, 0xb3, 0xb3, 0x8e, 0x8f,
+	0xbc, 0x5e, 0x2a, 0xf3, 0x94, 0xa8, 0x33, 0x9b, 0xf2, 0xf7,
+	0x98, 0x29, 0x60, 0xcc, 0x56, 0xc1, 0xeb, 0xba, 0xad, 0x56,
+	0x15, 0xd9, 0x97, 0x74, 0x28, 0x72, 0x0c, 0x11, 0xa4, 0x56,
+	0x88, 0x74, 0x1e, 0x93, 0x50, 0x16, 0x88, 0xb9, 0xec, 0x45,
+	0x23, 0x63, 0x69, 0x52, 0x55, 0x44, 0x56, 0x61, 0xbd, 0x79,
+	0xed, 0x8a, 0x30, 0x96, 0xfa, 0xc4, 0x02, 0x4c, 0xac, 0xaa,
+	0x88, 0x4a, 0xd6, 0x01, 0x85, 0x00, 0xb5, 0x31, 0x69, 0xe8,
+	0xc5, 0x12, 0x25, 0xa9, 0x46, 0xcf, 0x5b, 0x8a, 0x0f, 0x96,
+	0xc9, 0xb3, 0xf2, 0x74, 0xe8, 0x77, 0x0a, 0xdd, 0x04, 0x90,
+	0x90, 0xba, 0x72, 0x4b, 0xe1, 0xbc, 0x22, 0x4a, 0x38, 0x5b,
+	0x22, 0x49, 0x18, 0x49, 0x3d, 0x7c, 0xd8, 0x68, 0x76, 0x4a,
+	0x78, 0x0c, 0x71, 0x37, 0x5d, 0x13, 0xcb, 0xb0, 0x95, 0xc1,
+	0xf0, 0xa1, 0xd1, 0x18, 0x3a, 0x36, 0xb5, 0x14, 0xab, 0xbb,
+	0x6a, 0xa1, 0x25, 0xdb, 0x5b, 0xcd, 0xfc, 0x87, 0xfe, 0xe1,
+	0x15, 0xa1, 0x5e, 0xc7, 0x5d, 0xbd, 0x4f, 0x4a, 0x3f, 0x4e,
+	0xec, 0xdc, 0x51, 0x9d, 0xa5, 0xbb, 0xd9, 0x19, 0x2c, 0x2e,
+	0x38, 0xe0, 0x53, 0xcf, 0x6a, 0x6e, 0xbf, 0x2f, 0x3a, 0x70,
+	0xd7, 0xb8, 0x87, 0xbd, 0x17, 0xe5, 0xe9, 0xb6, 0x22, 0x96,
+	0xd7, 0xe1, 0xd4, 0xef, 0xac, 0x98, 0x91, 0xe8, 0x66, 0xdf,
+	0x2f, 0x28, 0x24, 0xb6, 0x61, 0xd7, 0xa8, 0x21, 0x0b, 0x8c,
+	0x75, 0xef, 0xb8, 0xe8, 0xb2, 0x7c, 0xec, 0xd1, 0xa5, 0x91,
+	0x61, 0xed, 0x40, 0x73, 0x5f, 0xab, 0xcb, 0x05, 0x87, 0x30,
+	0x47, 0xf0, 0x73, 0x39, 0x4b, 0x47, 0x18, 0xde, 0xb0, 0xd2,
+	0xa8, 0x30, 0xd8, 0xca, 0xac, 0x7f, 0x79, 0x96, 0xad, 0xd7,
+	0xd6, 0x6e, 0xda, 0x7d, 0x66, 0x2e, 0x6b, 0xc1, 0xe9, 0xa1,
+	0xa8, 0x67, 0x14, 0x7c, 0xee, 0xb1, 0x64, 0x99, 0x2f, 0x64,
+	0x3e, 0xf7, 0x38, 0xf4, 0xaf, 0x3e, 0x7a, 0x83, 0xe3, 0xeb,
+	0x97, 0x8a, 0xee, 0x5a, 0x1b, 0xcb, 0xbe, 0x66, 0xad, 0xdc,
+	0xae, 0x9d, 0xac, 0x8c, 0x6a, 0x7f, 0xaf, 0x4b, 0x23, 0x5d,
+	0x3b, 0x8c, 0x06, 0x32, 0x1d, 0x7f, 0xba, 0xad, 0xd3, 0xb9,
+	0x47, 0x57, 0x49, 0x93, 0xf3, 0x23, 0xa6, 0x57, 0xf0, 0x7b,
+	0xb0, 0x4b, 0x9d, 0x25, 0x53, 0x07, 0x61, 0xc3, 0x64, 0xb2,
+	0x8b, 0xb0, 0x95, 0xc2, 0xd2, 0xf1, 0x1d, 0xfe, 0x4a, 0x3b,
+	0x36, 0x7f, 0xb5, 0xb1, 0xa2, 0x26, 0x8f, 0xfa, 0x02, 0xc3,
+	0xfa, 0xc4, 0x32, 0xfa, 0x8f, 0xda, 0xae, 0x72, 0xd5, 0x9b,
+	0x41, 0xeb, 0x5f, 0x3a, 0x75, 0xe4, 0xf4, 0xde, 0xb9, 0x82,
+	0x7f, 0xd8, 0xde, 0x5b, 0x96, 0x81, 0x56, 0x0a, 0x1d, 0x71,
+	0x54, 0xc1, 0x3a, 0xf8, 0xa2, 0x4a, 0xa0, 0xb4, 0xaf, 0x3e,
+	0x75, 0x2b, 0x23, 0x1b, 0x78, 0x5f, 0x8d, 0xf8, 0xec, 0x45,
+	0x4b, 0xba, 0x5d, 0xbb, 0xde, 0x3d, 0x2c, 0x11, 0xac, 0xfa,
+	0xa8, 0xad, 0xaa, 0xcd, 0xe9, 0x2e, 0x37, 0xa1, 0xce, 0x61,
+	0xb0, 0xdb, 0x38, 0xa3, 0x21, 0x30, 0x43, 0xc2, 0xc3, 0x38,
+	0x4b, 0x92, 0x76, 0x6f, 0x67, 0x73, 0xb0, 0x57, 0x5d, 0x34,
+	0x56, 0x2c, 0xeb, 0x01, 0xa3, 0x5a, 0xdb, 0x16, 0x28, 0xbb,
+	0xb7, 0x8d, 0x6b, 0x91, 0xf7, 0x0d, 0x63, 0xe5, 0x8b, 0xbf,
+	0xa3, 0x2f, 0xe6, 0x9e, 0xff, 0x03
+};
+
+/** Decompressed data */
+static uint8_t deflate_bench_data[DEFLATE_BENCH_LEN];
+
+/**
+ * Perform DEFLATE decompression benchmarks
+ *
+ */
+static void deflate_bench_exec ( void ) {
+	static struct deflate deflate; /* Too large for stack */
+	struct deflate_chunk out;
+	struct profiler profiler;
+	unsigned int i;
+	int rc;
+
+	/* Profile decompression */
+	memset ( &profiler, 0, sizeof ( profiler ) );
+	for ( i = 0 ; i < BENCH_COUNT ; i++ ) {
+		profile_start ( &profiler );
+		deflate_init ( &deflate, DEFLATE_RAW );
+		deflate_chunk_init ( &out, deflate_bench_data, 0,
+				     sizeof ( deflate_bench_data ) );
+		rc = deflate_inflate ( &deflate, deflate_bench_compressed,
+				       sizeof ( deflate_bench_compressed ),
+				       &out );
+		profile_stop ( &profiler );
+		if ( ( rc != 0 ) || ( ! deflate_finished ( &deflate ) ) ||
+		     ( out.offset != sizeof ( deflate_bench_data ) ) ) {
+			printf ( "inflate: failed\n" );
+			return;
+		}
+	}
+
+	bench_report ( "inflate", &profiler, sizeof ( deflate_bench_data ) );
+}
+
+/** DEFLATE decompression benchmark */
+struct benchmark deflate_bench __benchmark = {
+	.name = "deflate",
+	.exec = deflate_bench_exec,
+};
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2026 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * Digest algorithm benchmarks
+ *
+ */
+
+/* Forcibly enable profiling */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ipxe/crypto.h>
+#include <ipxe/md4.h>
+#include <ipxe/md5.h>
+#include <ipxe/sha1.h>
+#include <ipxe/sha256.h>
+#include <ipxe/sha512.h>
+#include <ipxe/bench.h>
+
+/** Digested data */
+static uint8_t digest_bench_data[8192];
+
+/** Digest algorithms */
+static struct digest_algorithm *digest_bench_algorithms[] = {
+	&md4_algorithm,
+	&md5_algorithm,
+	&sha1_algorithm,
+	&sha224_algorithm,
+	&sha256_algorithm,
+	&sha384_algorithm,
+	&sha512_algorithm,
+	&sha512_224_algorithm,
+	&sha512_256_algorithm,
+};
+
+/**
+ * Benchmark digest algorithm
+ *
+ * @v digest		Digest algorithm
+ */
+static void digest_bench_algorithm ( struct digest_algorithm *digest ) {
+	uint8_t ctx[digest->ctxsize];
+	uint8_t out[digest->digestsize];
+	struct profiler profiler;
+	unsigned int i;
+
+	/* Profile digest calculation */
+	memset ( &profiler, 0, sizeof ( profiler ) );
+	for ( i = 0 ; i < BENCH_COUNT ; i++ ) {
+		profile_start ( &profiler );
+		digest_init ( digest, ctx );
+		digest_update ( digest, ctx, digest_bench_data,
+				sizeof ( digest_bench_data ) );
+		digest_final ( digest, ctx, out );
+		profile_stop ( &profiler );
+	}
+
+	bench_report ( digest->name, &profiler,
+		       sizeof ( digest_bench_data ) );
+}
+
+/**
+ * Perform digest algorithm benchmarks
+ *
+ */
+static void digest_bench_exec ( void ) {
+	unsigned int i;
+
+	/* Fill buffer with pseudo-random data */
+	srand ( 0x1234568 );
+	for ( i = 0 ; i < sizeof ( digest_bench_data ) ; i++ )
+		digest_bench_data[i] = rand();
+
+	/* Perform benchmarks */
+	for ( i = 0 ; i < ( sizeof ( digest_bench_algorithms ) /
+			    sizeof ( digest_bench_algorithms[0] ) ) ; i++ ) {
+		digest_bench_algorithm ( digest_bench_algorithms[i] );
+	}
+}
+
+/** Digest algorithm benchmark */
+struct benchmark digest_bench __benchmark = {
+	.name = "digest",
+	.exec = digest_bench_exec,
+};
@@ -0,0 +1,277 @@
+/*
+ * Copyright (C) 2026 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * Fragment reassembly tests
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <string.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/ipstat.h>
+#include <ipxe/fragment.h>
+#include <ipxe/test.h>
+
+/** A test fragment header
+ *
+ * The non-fragmentable portion of a test packet comprises this
+ * header, followed by padding up to the header length.
+ */
+struct fragment_test_header {
+	/** Packet identifier */
+	uint16_t ident;
+	/** Fragment offset */
+	uint16_t offset;
+	/** More fragments exist */
+	uint8_t more;
+	/** Header length */
+	uint8_t hdrlen;
+} __attribute__ (( packed ));
+
+/** Length of test packet payload */
+#define FRAGMENT_TEST_LEN 4000
+
+/** Test packet payload */
+static uint8_t fragment_test_data[FRAGMENT_TEST_LEN];
+
+/** Test statistics */
+static struct ip_statistics fragment_test_stats;
+
+/**
+ * Check if fragment matches fragment reassembly buffer
+ *
+ * @v fragment		Fragment reassembly buffer
+ * @v iobuf		I/O buffer
+ * @v hdrlen		Length of non-fragmentable potion of I/O buffer
+ * @ret is_fragment	Fragment matches this reassembly buffer
+ */
+static int fragment_test_is_fragment ( struct fragment *fragment,
+				       struct io_buffer *iobuf,
+				       size_t hdrlen __unused ) {
+	struct fragment_test_header *frag_hdr = fragment->iobuf->data;
+	struct fragment_test_header *hdr = iobuf->data;
+
+	return ( hdr->ident == frag_hdr->ident );
+}
+
+/**
+ * Get fragment offset
+ *
+ * @v iobuf		I/O buffer
+ * @v hdrlen		Length of non-fragmentable potion of I/O buffer
+ * @ret offset		Offset
+ */
+static size_t fragment_test_offset ( struct io_buffer *iobuf,
+				     size_t hdrlen __unused ) {
+	struct fragment_test_header *hdr = iobuf->data;
+
+	return hdr->offset;
+}
+
+/**
+ * Check if more fragments exist
+ *
+ * @v iobuf		I/O buffer
+ * @v hdrlen		Length of non-fragmentable potion of I/O buffer
+ * @ret more_frags	More fragments exist
+ */
+static int fragment_test_more ( struct io_buffer *iobuf,
+				size_t hdrlen __unused ) {
+	struct fragment_test_header *hdr = iobuf->data;
+
+	return hdr->more;
+}
+
+/** Test fragment reassembler */
+static struct fragment_reassembler fragment_test_reassembler = {
+	.list = LIST_HEAD_INIT ( fragment_test_reassembler.list ),
+	.is_fragment = fragment_test_is_fragment,
+	.fragment_offset = fragment_test_offset,
+	.more_fragments = fragment_test_more,
+	.stats = &fragment_test_stats,
+};
+
+/**
+ * Receive test fragment
+ *
+ * @v ident		Packet identifier
+ * @v hdrlen		Header length
+ * @v start		Start offset
+ * @v end		End offset
+ * @v more		More fragments exist
+ * @ret iobuf		Reassembled packet, or NULL
+ */
+static struct io_buffer * fragment_test_rx ( unsigned int ident, size_t hdrlen,
+					     size_t start, size_t end,
+					     int more ) {
+	struct fragment_test_header *hdr;
+	struct io_buffer *iobuf;
+
+	/* Construct fragment */
+	iobuf = alloc_iob ( hdrlen + ( end - start ) );
+	assert ( iobuf != NULL );
+	hdr = iob_put ( iobuf, hdrlen );
+	memset ( hdr, 0, hdrlen );
+	hdr->ident = ident;
+	hdr->offset = start;
+	hdr->more = more;
+	hdr->hdrlen = hdrlen;
+	memcpy ( iob_put ( iobuf, ( end - start ) ),
+		 &fragment_test_data[start], ( end - start ) );
+
+	/* Reassemble */
+	return fragment_reassemble ( &fragment_test_reassembler, iobuf,
+				     &hdrlen );
+}
+
+/**
+ * Check reassembled test packet
+ *
+ * @v iobuf		Reassembled packet
+ * @v ident		Expected packet identifier
+ * @v hdrlen		Expected header length
+ * @v len		Expected payload length
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void fragment_test_okx ( struct io_buffer *iobuf, unsigned int ident,
+				size_t hdrlen, size_t len, const char *file,
+				unsigned int line ) {
+	struct fragment_test_header *hdr;
+
+	okx ( iobuf != NULL, file, line );
+	if ( ! iobuf )
+		return;
+	hdr = iobuf->data;
+	okx ( hdr->ident == ident, file, line );
+	okx ( hdr->offset == 0, file, line );
+	okx ( hdr->hdrlen == hdrlen, file, line );
+	okx ( iob_len ( iobuf ) == ( hdrlen + len ), file, line );
+	okx ( memcmp ( ( iobuf->data + hdrlen ), fragment_test_data,
+		       len ) == 0, file, line );
+	free_iob ( iobuf );
+}
+#define fragment_test_ok( iobuf, ident, hdrlen, len ) \
+	fragment_test_okx ( iobuf, ident, hdrlen, len, __FILE__, __LINE__ )
+
+/**
+ * Perform fragment reassembly self-tests
+ *
+ */
+static void fragment_test_exec ( void ) {
+	unsigned int oks;
+	unsigned int fails;
+	unsigned int i;
+
+	/* Initialise test payload */
+	for ( i = 0 ; i < sizeof ( fragment_test_data ) ; i++ )
+		fragment_test_data[i] = ( ( i * 7 ) ^ ( i >> 8 ) );
+
+	/* In-order fragments */
+	ok ( fragment_test_rx ( 1, 8, 0, 1000, 1 ) == NULL );
+	ok ( fragment_test_rx ( 1, 8, 1000, 2000, 1 ) == NULL );
+	fragment_test_ok ( fragment_test_rx ( 1, 8, 2000, 2500, 0 ),
+			   1, 8, 2500 );
+
+	/* Reverse-order fragments */
+	ok ( fragment_test_rx ( 2, 8, 2000, 2500, 0 ) == NULL );
+	ok ( fragment_test_rx ( 2, 8, 1000, 2000, 1 ) == NULL );
+	fragment_test_ok ( fragment_test_rx ( 2, 8, 0, 1000, 1 ),
+			   2, 8, 2500 );
+
+	/* Interleaved packets with overlapping and duplicate fragments */
+	ok ( fragment_test_rx ( 3, 8, 1000, 2000, 1 ) == NULL );
+	ok ( fragment_test_rx ( 4, 8, 0, 1500, 1 ) == NULL );
+	ok ( fragment_test_rx ( 3, 8, 3000, 4000, 0 ) == NULL );
+	ok ( fragment_test_rx ( 3, 8, 1000, 2000, 1 ) == NULL );
+	ok ( fragment_test_rx ( 3, 8, 500, 3500, 1 ) == NULL );
+	ok ( fragment_test_rx ( 4, 8, 1800, 2000, 0 ) == NULL );
+	fragment_test_ok ( fragment_test_rx ( 3, 8, 0, 600, 1 ),
+			   3, 8, 4000 );
+	fragment_test_ok ( fragment_test_rx ( 4, 8, 1000, 1800, 1 ),
+			   4, 8, 2000 );
+
+	/* First fragment with a longer non-fragmentable portion */
+	ok ( fragment_test_rx ( 5, 8, 800, 1600, 0 ) == NULL );
+	ok ( fragment_test_rx ( 5, 8, 400, 800, 1 ) == NULL );
+	fragment_test_ok ( fragment_test_rx ( 5, 24, 0, 400, 1 ),
+			   5, 24, 1600 );
+
+	/* Fragments creating too many holes should be dropped */
+	fails = fragment_test_stats.reasm_fails;
+	for ( i = 0 ; i <= FRAGMENT_MAX_RANGES ; i++ ) {
+		ok ( fragment_test_rx ( 6, 8, ( ( 2 * i ) + 1 ) * 100,
+					( ( 2 * i ) + 2 ) * 100,
+					1 ) == NULL );
+	}
+	ok ( fragment_test_stats.reasm_fails == ( fails + 1 ) );
+	ok ( fragment_test_rx ( 6, 8, 0, 1700, 1 ) == NULL );
+	fragment_test_ok ( fragment_test_rx ( 6, 8, 1700, 1900, 0 ),
+			   6, 8, 1900 );
+
+	/* Inconsistent final fragment should discard reassembly */
+	fails = fragment_test_stats.reasm_fails;
+	ok ( fragment_test_rx ( 7, 8, 0, 1000, 1 ) == NULL );
+	ok ( fragment_test_rx ( 7, 8, 1200, 1500, 0 ) == NULL );
+	ok ( fragment_test_rx ( 7, 8, 1500, 2000, 1 ) == NULL );
+	ok ( fragment_test_stats.reasm_fails == ( fails + 1 ) );
+	ok ( fragment_test_rx ( 7, 8, 0, 1500, 1 ) == NULL );
+	fragment_test_ok ( fragment_test_rx ( 7, 8, 1500, 2500, 0 ),
+			   7, 8, 2500 );
+
+	/* Oldest reassembly should be discarded when limit is reached */
+	fails = fragment_test_stats.reasm_fails;
+	for ( i = 0 ; i <= FRAGMENT_MAX_BUFFERS ; i++ )
+		ok ( fragment_test_rx ( ( 10 + i ), 8, 0, 1000, 1 ) == NULL );
+	ok ( fragment_test_stats.reasm_fails == ( fails + 1 ) );
+	for ( i = 1 ; i <= FRAGMENT_MAX_BUFFERS ; i++ ) {
+		fragment_test_ok ( fragment_test_rx ( ( 10 + i ), 8, 1000,
+						      1200, 0 ),
+				   ( 10 + i ), 8, 1200 );
+	}
+	ok ( fragment_test_rx ( 10, 8, 1000, 1200, 0 ) == NULL );
+	fragment_test_ok ( fragment_test_rx ( 10, 8, 0, 1000, 1 ),
+			   10, 8, 1200 );
+
+	/* Unfragmented packet should be returned immediately */
+	oks = fragment_test_stats.reasm_oks;
+	fragment_test_ok ( fragment_test_rx ( 20, 8, 0, 100, 0 ),
+			   20, 8, 100 );
+	ok ( fragment_test_stats.reasm_oks == ( oks + 1 ) );
+
+	/* No reassembly buffers should remain */
+	ok ( list_empty ( &fragment_test_reassembler.list ) );
+}
+
+/** Fragment reassembly self-test */
+struct self_test fragment_test __self_test = {
+	.name = "fragment",
+	.exec = fragment_test_exec,
+};
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2026 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * I/O buffer allocation benchmarks
+ *
+ */
+
+/* Forcibly enable profiling */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/bench.h>
+
+/** Number of I/O buffers allocated in each iteration
+ *
+ * This approximates the receive ring of a typical network device.
+ */
+#define IOBUF_BENCH_RING_COUNT 32
+
+/**
+ * Benchmark I/O buffer allocation
+ *
+ * @v len		Length
+ */
+static void iobuf_bench_alloc ( size_t len ) {
+	struct io_buffer *iobufs[IOBUF_BENCH_RING_COUNT];
+	struct profiler profiler;
+	char name[32];
+	unsigned int i;
+	unsigned int j;
+
+	/* Profile allocation and freeing of a ring's worth of buffers */
+	memset ( &profiler, 0, sizeof ( profiler ) );
+	for ( i = 0 ; i < BENCH_COUNT ; i++ ) {
+		profile_start ( &profiler );
+		for ( j = 0 ; j < IOBUF_BENCH_RING_COUNT ; j++ )
+			iobufs[j] = alloc_iob ( len );
+		for ( j = 0 ; j < IOBUF_BENCH_RING_COUNT ; j++ )
+			free_iob ( iobufs[j] );
+		profile_stop ( &profiler );
+	}
+
+	snprintf ( name, sizeof ( name ), "alloc_iob %d x %zd",
+		   IOBUF_BENCH_RING_COUNT, len );
+	bench_report ( name, &profiler, 0 );
+}
+
+/**
+ * Perform I/O buffer allocation benchmarks
+ *
+ */
+static void iobuf_bench_exec ( void ) {
+
+	iobuf_bench_alloc ( 128 );
+	iobuf_bench_alloc ( 1536 );
+	iobuf_bench_alloc ( 9000 );
+	iobuf_bench_alloc ( 16384 );
+}
+
+/** I/O buffer allocation benchmark */
+struct benchmark iobuf_bench __benchmark = {
+	.name = "iobuf",
+	.exec = iobuf_bench_exec,
+};
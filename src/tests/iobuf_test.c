@@ -105,6 +105,37 @@ static inline void alloc_iob_fail_okx ( size_t len, size_t align, size_t offset,
 #define alloc_iob_fail_ok( len, align, offset ) \
 	alloc_iob_fail_okx ( len, align, offset, __FILE__, __LINE__ )
 
+/**
+ * Report I/O buffer reuse test result
+ *
+ * @v len		Length of first buffer
+ * @v reuse_len		Length of second buffer
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static inline void alloc_iob_reuse_okx ( size_t len, size_t reuse_len,
+					 const char *file, unsigned int line ) {
+	struct io_buffer *iobuf;
+	void *head;
+
+	/* Allocate and free first I/O buffer */
+	iobuf = alloc_iob ( len );
+	okx ( iobuf != NULL, file, line );
+	head = iobuf->head;
+	free_iob ( iobuf );
+
+	/* Allocate second I/O buffer */
+	iobuf = alloc_iob ( reuse_len );
+	okx ( iobuf != NULL, file, line );
+	okx ( iob_tailroom ( iobuf ) >= reuse_len, file, line );
+
+	/* Check that the cached buffer was reused */
+	okx ( iobuf->head == head, file, line );
+	free_iob ( iobuf );
+}
+#define alloc_iob_reuse_ok( len, reuse_len ) \
+	alloc_iob_reuse_okx ( len, reuse_len, __FILE__, __LINE__ )
+
 /**
  * Perform I/O buffer self-tests
  *
@@ -133,6 +164,12 @@ static void iobuf_test_exec ( void ) {
 	alloc_iob_fail_ok ( -1UL, 1024, 0 );
 	alloc_iob_fail_ok ( 0, -1UL, 0 );
 	alloc_iob_fail_ok ( 1024, -1UL, 0 );
+
+	/* Check reuse of cached buffers */
+	alloc_iob_reuse_ok ( 60, 128 );
+	alloc_iob_reuse_ok ( 1536, 1500 );
+	alloc_iob_reuse_ok ( 2048, 1024 );
+	alloc_iob_reuse_ok ( 9000, 5000 );
 }
 
 /** I/O buffer self-test */
@@ -0,0 +1,326 @@
+/*
+ * Copyright (C) 2026 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * Dynamic memory allocation tests
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <assert.h>
+#include <ipxe/malloc.h>
+#include <ipxe/profile.h>
+#include <ipxe/test.h>
+
+/** Test heap area size */
+#define MALLOC_TEST_HEAP_SIZE ( 2 * 1024 * 1024 )
+
+/** Test heap free block alignment */
+#define MALLOC_TEST_HEAP_ALIGN 64
+
+/** Number of live allocations tracked during trace replay */
+#define MALLOC_TEST_SLOTS 256
+
+/** Number of operations in trace replay */
+#define MALLOC_TEST_STEPS 200000
+
+/** Length of allocation exceeding the internal heap area size */
+#define MALLOC_TEST_EXTEND_LEN ( 6 * 1024 * 1024 )
+
+/** Test heap area */
+static char __attribute__ (( aligned ( MALLOC_TEST_HEAP_ALIGN ) ))
+	malloc_test_area[MALLOC_TEST_HEAP_SIZE];
+
+/** Test heap */
+static struct heap malloc_test_heap = {
+	.align = MALLOC_TEST_HEAP_ALIGN,
+	.ptr_align = sizeof ( void * ),
+};
+
+/** A live allocation */
+struct malloc_test_slot {
+	/** Allocated memory, or NULL */
+	uint8_t *data;
+	/** Length of allocated memory */
+	size_t len;
+};
+
+/** Live allocations */
+static struct malloc_test_slot malloc_test_slots[MALLOC_TEST_SLOTS];
+
+/**
+ * Choose allocation length for trace replay
+ *
+ * @ret len		Allocation length
+ *
+ * The distribution is loosely modelled on a long TLS download with
+ * TCP reassembly: mostly packet-sized buffers, a steady stream of
+ * small control structures, and occasional large record buffers.
+ */
+static size_t malloc_test_len ( void ) {
+	unsigned int type = ( random() % 16 );
+
+	if ( type < 8 ) {
+		/* Packet buffer */
+		return ( 1514 + ( random() % 128 ) );
+	} else if ( type < 14 ) {
+		/* Small control structure */
+		return ( 16 + ( random() % 240 ) );
+	} else {
+		/* Record buffer */
+		return ( 4096 + ( random() % 16384 ) );
+	}
+}
+
+/**
+ * Check that all free memory has been merged into a single block
+ *
+ * @v heap		Heap
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void malloc_test_merged_okx ( struct heap *heap, const char *file,
+				     unsigned int line ) {
+	unsigned int i;
+
+	okx ( heap->freeblocks == 1, file, line );
+	okx ( heap->freemem == MALLOC_TEST_HEAP_SIZE, file, line );
+	okx ( heap_largest ( heap ) == MALLOC_TEST_HEAP_SIZE, file, line );
+	for ( i = 0 ; i < HEAP_CLASSES ; i++ )
+		okx ( heap->inuse[i] == 0, file, line );
+}
+#define malloc_test_merged_ok( heap ) \
+	malloc_test_merged_okx ( heap, __FILE__, __LINE__ )
+
+/**
+ * Perform basic allocation tests
+ *
+ */
+static void malloc_test_basic ( void ) {
+	struct heap *heap = &malloc_test_heap;
+	unsigned long failures;
+	uint8_t *a;
+	uint8_t *b;
+	uint8_t *c;
+
+	/* Allocate three adjacent-sized blocks */
+	a = heap_realloc ( heap, NULL, 100 );
+	b = heap_realloc ( heap, NULL, 2000 );
+	c = heap_realloc ( heap, NULL, 30000 );
+	ok ( a != NULL );
+	ok ( b != NULL );
+	ok ( c != NULL );
+	ok ( ( ( ( intptr_t ) a ) & ( sizeof ( void * ) - 1 ) ) == 0 );
+	ok ( ( ( ( intptr_t ) b ) & ( sizeof ( void * ) - 1 ) ) == 0 );
+	ok ( ( ( ( intptr_t ) c ) & ( sizeof ( void * ) - 1 ) ) == 0 );
+	memset ( a, 0xaa, 100 );
+	memset ( b, 0xbb, 2000 );
+	memset ( c, 0xcc, 30000 );
+
+	/* Free middle block, then reallocate the others */
+	heap_realloc ( heap, b, 0 );
+	a = heap_realloc ( heap, a, 5000 );
+	ok ( a != NULL );
+	ok ( a[99] == 0xaa );
+	c = heap_realloc ( heap, c, 10 );
+	ok ( c != NULL );
+	ok ( c[9] == 0xcc );
+	ok ( heap->inuse[ flsl ( 5000 ) - 1 ] == 1 );
+	ok ( heap->inuse[ flsl ( 2000 ) - 1 ] == 0 );
+
+	/* Impossibly large allocations should fail */
+	failures = heap->failures;
+	ok ( heap_realloc ( heap, NULL, ( MALLOC_TEST_HEAP_SIZE + 1 ) ) ==
+	     NULL );
+	ok ( heap_realloc ( heap, NULL, -1UL ) == NULL );
+	ok ( heap->failures == ( failures + 2 ) );
+
+	/* Free remaining blocks and check that heap is fully merged */
+	heap_realloc ( heap, a, 0 );
+	heap_realloc ( heap, c, 0 );
+	malloc_test_merged_ok ( heap );
+}
+
+/**
+ * Perform trace replay
+ *
+ * Replay a pseudo-random (but reproducible) sequence of allocations,
+ * reallocations and frees, checking data integrity and recording the
+ * latency of each operation and the resulting fragmentation.
+ */
+static void malloc_test_trace ( void ) {
+	struct heap *heap = &malloc_test_heap;
+	struct malloc_test_slot *slot;
+	struct profiler alloc_profiler;
+	struct profiler free_profiler;
+	unsigned int max_freeblocks = 0;
+	unsigned int failures = 0;
+	unsigned int corrupt = 0;
+	unsigned int step;
+	unsigned int i;
+	uint8_t *data;
+	uint8_t fill;
+	size_t len;
+
+	/* Replay trace */
+	memset ( &alloc_profiler, 0, sizeof ( alloc_profiler ) );
+	memset ( &free_profiler, 0, sizeof ( free_profiler ) );
+	srandom ( 0x4d414c4c );
+	for ( step = 0 ; step < MALLOC_TEST_STEPS ; step++ ) {
+		i = ( random() % MALLOC_TEST_SLOTS );
+		slot = &malloc_test_slots[i];
+		fill = i;
+
+		if ( slot->data ) {
+
+			/* Check data integrity */
+			if ( ( slot->data[0] != fill ) ||
+			     ( slot->data[ slot->len - 1 ] != fill ) )
+				corrupt++;
+
+			if ( ( random() % 8 ) == 0 ) {
+				/* Grow existing allocation */
+				len = ( slot->len + malloc_test_len() );
+				profile_start ( &alloc_profiler );
+				data = heap_realloc ( heap, slot->data, len );
+				profile_stop ( &alloc_profiler );
+				if ( ! data ) {
+					failures++;
+					continue;
+				}
+				memset ( data, fill, len );
+				slot->data = data;
+				slot->len = len;
+			} else {
+				/* Free existing allocation */
+				profile_start ( &free_profiler );
+				heap_realloc ( heap, slot->data, 0 );
+				profile_stop ( &free_profiler );
+				slot->data = NULL;
+			}
+
+		} else {
+
+			/* Create new allocation */
+			len = malloc_test_len();
+			profile_start ( &alloc_profiler );
+			data = heap_realloc ( heap, NULL, len );
+			profile_stop ( &alloc_profiler );
+			if ( ! data ) {
+				failures++;
+				continue;
+			}
+			memset ( data, fill, len );
+			slot->data = data;
+			slot->len = len;
+		}
+
+		/* Record fragmentation */
+		if ( heap->freeblocks > max_freeblocks )
+			max_freeblocks = heap->freeblocks;
+	}
+
+	/* Free all remaining allocations */
+	for ( i = 0 ; i < MALLOC_TEST_SLOTS ; i++ ) {
+		slot = &malloc_test_slots[i];
+		heap_realloc ( heap, slot->data, 0 );
+		slot->data = NULL;
+	}
+
+	/* Check that no data was corrupted and that the heap is
+	 * fully merged.
+	 */
+	ok ( corrupt == 0 );
+	malloc_test_merged_ok ( heap );
+
+	DBG ( "MALLOC replayed %d operations: alloc %ld +/- %ld ticks, free "
+	      "%ld +/- %ld ticks, %d failures, peak %zdkB used in at most %d "
+	      "free blocks\n", MALLOC_TEST_STEPS, profile_mean ( &alloc_profiler ),
+	      profile_stddev ( &alloc_profiler ),
+	      profile_mean ( &free_profiler ),
+	      profile_stddev ( &free_profiler ), failures,
+	      ( heap->maxusedmem >> 10 ), max_freeblocks );
+}
+
+/**
+ * Perform internal heap extension tests
+ *
+ */
+static void malloc_test_extend ( void ) {
+	uint8_t *data;
+	uint8_t *phys;
+
+	/* Allocate more than the initial heap area size */
+	data = malloc ( MALLOC_TEST_EXTEND_LEN );
+	ok ( data != NULL );
+	if ( data ) {
+		memset ( data, 0x5a, MALLOC_TEST_EXTEND_LEN );
+		ok ( data[ MALLOC_TEST_EXTEND_LEN - 1 ] == 0x5a );
+	}
+
+	/* Allocate an aligned block while the heap is extended */
+	phys = malloc_phys ( MALLOC_TEST_EXTEND_LEN, 4096 );
+	ok ( phys != NULL );
+	ok ( ( ( ( intptr_t ) phys ) & ( 4096 - 1 ) ) == 0 );
+	if ( phys )
+		memset ( phys, 0xa5, MALLOC_TEST_EXTEND_LEN );
+
+	/* Free allocations */
+	free_phys ( phys, MALLOC_TEST_EXTEND_LEN );
+	free ( data );
+
+	/* Check that the heap cannot be extended without limit */
+	ok ( malloc ( 1024 * 1024 * 1024 ) == NULL );
+}
+
+/**
+ * Perform dynamic memory allocation self-tests
+ *
+ */
+static void malloc_test_exec ( void ) {
+
+	/* Populate test heap */
+	heap_populate ( &malloc_test_heap, malloc_test_area,
+			sizeof ( malloc_test_area ) );
+	malloc_test_merged_ok ( &malloc_test_heap );
+
+	/* Perform tests */
+	malloc_test_basic();
+	malloc_test_trace();
+	malloc_test_extend();
+}
+
+/** Dynamic memory allocation self-test */
+struct self_test malloc_test __self_test = {
+	.name = "malloc",
+	.exec = malloc_test_exec,
+};
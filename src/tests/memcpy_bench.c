@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2026 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * Memory copy and fill benchmarks
+ *
+ */
+
+/* Forcibly enable profiling */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ipxe/bench.h>
+
+/** Largest buffer length */
+#define MEMCPY_BENCH_MAX_LEN 65536
+
+/** Source buffer */
+static uint8_t memcpy_bench_src[ MEMCPY_BENCH_MAX_LEN + 1 ];
+
+/** Destination buffer */
+static uint8_t memcpy_bench_dst[ MEMCPY_BENCH_MAX_LEN + 1 ];
+
+/**
+ * Benchmark memcpy()
+ *
+ * @v len		Length
+ * @v offset		Misalignment offset
+ */
+static void memcpy_bench_copy ( size_t len, unsigned int offset ) {
+	struct profiler profiler;
+	char name[32];
+	unsigned int i;
+
+	/* Profile copy */
+	memset ( &profiler, 0, sizeof ( profiler ) );
+	for ( i = 0 ; i < BENCH_COUNT ; i++ ) {
+		profile_start ( &profiler );
+		memcpy ( ( memcpy_bench_dst + offset ), memcpy_bench_src, len );
+		profile_stop ( &profiler );
+	}
+
+	snprintf ( name, sizeof ( name ), "memcpy %zd+%d", len, offset );
+	bench_report ( name, &profiler, len );
+}
+
+/**
+ * Benchmark memmove() with overlapping buffers
+ *
+ * @v len		Length
+ */
+static void memcpy_bench_move ( size_t len ) {
+	struct profiler profiler;
+	char name[32];
+	unsigned int i;
+
+	/* Profile move, alternating direction */
+	memset ( &profiler, 0, sizeof ( profiler ) );
+	for ( i = 0 ; i < BENCH_COUNT ; i++ ) {
+		profile_start ( &profiler );
+		if ( i & 1 ) {
+			memmove ( memcpy_bench_dst, ( memcpy_bench_dst + 1 ),
+				  len );
+		} else {
+			memmove ( ( memcpy_bench_dst + 1 ), memcpy_bench_dst,
+				  len );
+		}
+		profile_stop ( &profiler );
+	}
+
+	snprintf ( name, sizeof ( name ), "memmove %zd", len );
+	bench_report ( name, &profiler, len );
+}
+
+/**
+ * Benchmark memset()
+ *
+ * @v len		Length
+ */
+static void memcpy_bench_set ( size_t len ) {
+	struct profiler profiler;
+	char name[32];
+	unsigned int i;
+
+	/* Profile fill */
+	memset ( &profiler, 0, sizeof ( profiler ) );
+	for ( i = 0 ; i < BENCH_COUNT ; i++ ) {
+		profile_start ( &profiler );
+		memset ( memcpy_bench_dst, i, len );
+		profile_stop ( &profiler );
+	}
+
+	snprintf ( name, sizeof ( name ), "memset %zd", len );
+	bench_report ( name, &profiler, len );
+}
+
+/**
+ * Perform memory copy and fill benchmarks
+ *
+ */
+static void memcpy_bench_exec ( void ) {
+	unsigned int i;
+
+	/* Fill source buffer with pseudo-random data */
+	srand ( 0x6d656d63 );
+	for ( i = 0 ; i < sizeof ( memcpy_bench_src ) ; i++ )
+		memcpy_bench_src[i] = rand();
+
+	/* Perform benchmarks */
+	memcpy_bench_copy ( 64, 0 );
+	memcpy_bench_copy ( 1500, 0 );
+	memcpy_bench_copy ( 1500, 1 );
+	memcpy_bench_copy ( MEMCPY_BENCH_MAX_LEN, 0 );
+	memcpy_bench_copy ( MEMCPY_BENCH_MAX_LEN, 1 );
+	memcpy_bench_move ( 1500 );
+	memcpy_bench_move ( MEMCPY_BENCH_MAX_LEN );
+	memcpy_bench_set ( 64 );
+	memcpy_bench_set ( 1500 );
+	memcpy_bench_set ( MEMCPY_BENCH_MAX_LEN );
+}
+
+/** Memory copy and fill benchmark */
+struct benchmark memcpy_bench __benchmark = {
+	.name = "memcpy",
+	.exec = memcpy_bench_exec,
+};
@@ -0,0 +1,2768 @@
+/*
+ * Copyright (C) 2026 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/* Forcibly enable profiling */
+#undef NDEBUG
+
+/** @file
+ *
+ * Emulated network link
+ *
+ * An emulated link connects a network device to a minimal responder
+ * within the same image.  Frames travelling in each direction are
+ * subject to configurable bandwidth, latency, jitter, loss,
+ * reordering and duplication, in the style of the Linux "netem"
+ * queueing discipline.
+ *
+ * The responder answers ARP requests for its IPv4 address (and, if
+ * IPv6 is enabled, neighbour solicitations for its IPv6 address), and
+ * provides:
+ *
+ * - an HTTP server (on TCP port 80), which responds to "GET /<len>"
+ *   with <len> bytes of generated data, and to "POST /" by checking
+ *   that the request body matches the generated data;
+ *
+ * - a TFTP server (on UDP port 69), which responds to a read request
+ *   for "<len>" with <len> bytes of generated data;
+ *
+ * - a DNS server (on UDP port 53), which resolves any name to the
+ *   responder's IPv4 address (and IPv6 address, if enabled), except that names containing a
+ *   "missing" label do not exist and names beginning with "alias."
+ *   are CNAMEs for the remainder of the name.
+ *
+ * The responder's TCP implementation is deliberately simple: it
+ * retransmits a single segment upon receiving three duplicate
+ * acknowledgements, and falls back to go-back-N upon a
+ * retransmission timeout.  Since received data is checked rather
+ * than stored, out-of-order request body data can be accepted and
+ * reported via selective acknowledgements.  Timestamps are echoed,
+ * and bursts of response data are scrambled, only if enabled in the
+ * link characteristics.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <byteswap.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/netdevice.h>
+#include <ipxe/ethernet.h>
+#include <ipxe/if_ether.h>
+#include <ipxe/if_arp.h>
+#include <ipxe/ip.h>
+#include <ipxe/ipv6.h>
+#include <ipxe/icmpv6.h>
+#include <ipxe/ndp.h>
+#include <ipxe/tcp.h>
+#include <ipxe/udp.h>
+#include <ipxe/tftp.h>
+#include <ipxe/dns.h>
+#include <ipxe/resolv.h>
+#include <ipxe/tcpip.h>
+#include <ipxe/settings.h>
+#include <ipxe/interface.h>
+#include <ipxe/xfer.h>
+#include <ipxe/open.h>
+#include <ipxe/process.h>
+#include <ipxe/profile.h>
+#include <ipxe/malloc.h>
+#include "netem.h"
+
+/** Generated response data
+ *
+ * Response data is a repeating sequence of period
+ * NETEM_PATTERN_PERIOD.  The table is long enough that any segment
+ * may be copied directly from it.
+ */
+uint8_t netem_pattern[ NETEM_PATTERN_PERIOD + NETEM_MAX_MTU ];
+
+/** Emulated segmentation offload profiler */
+static struct profiler netem_segment_profiler __profiler =
+	{ .name = "netem.segment", .hist = PROFILE_HISTOGRAM };
+
+/** Network device MAC address */
+static const uint8_t netem_hwaddr[ETH_ALEN] =
+	{ 0x02, 0x6e, 0x65, 0x74, 0x65, 0x6d };
+
+/** Responder MAC address */
+static const uint8_t netem_peer_hwaddr[ETH_ALEN] =
+	{ 0x02, 0x70, 0x65, 0x65, 0x72, 0x00 };
+
+/** HTTP port */
+#define NETEM_HTTP_PORT 80
+
+/** First responder TFTP transfer port */
+#define NETEM_TFTP_PORT 1069
+
+/** Maximum TFTP block size */
+#define NETEM_TFTP_MAX_BLKSIZE 1432
+
+/** Maximum length of DNS records appended to a response */
+#define NETEM_DNS_RECORDS_MAX 128
+
+/**
+ * Construct DNS compression pointer
+ *
+ * @v offset		Offset
+ * @ret word		Compression pointer (in network byte order)
+ */
+#define NETEM_DNS_POINTER( offset ) htons ( 0xc000 | (offset) )
+
+/** Timeout for netem_fetch(), netem_upload() and netem_resolve() */
+#define NETEM_FETCH_TIMEOUT ( 120 * TICKS_PER_SEC )
+
+/** Maximum length of each I/O buffer sent by netem_upload() */
+#define NETEM_UPLOAD_CHUNK 16384
+
+/** Timeout for connections to close when destroying an emulated link */
+#define NETEM_DRAIN_TIMEOUT ( 10 * TICKS_PER_SEC )
+
+/******************************************************************************
+ *
+ * Link emulation
+ *
+ ******************************************************************************
+ */
+
+/**
+ * Generate pseudo-random number
+ *
+ * @v netem		Emulated link
+ * @ret random		Pseudo-random number
+ */
+static unsigned long netem_random ( struct netem *netem ) {
+
+	/* Use a simple linear congruential generator, so that results
+	 * are reproducible regardless of other users of random().
+	 */
+	netem->random = ( ( netem->random * 1103515245UL ) + 12345UL );
+	return ( ( netem->random >> 16 ) & 0x7fff );
+}
+
+/**
+ * Test a probability
+ *
+ * @v netem		Emulated link
+ * @v ppm		Probability (in parts per million)
+ * @ret happens		Event happens
+ */
+static int netem_chance ( struct netem *netem, unsigned int ppm ) {
+	unsigned long sample;
+
+	if ( ! ppm )
+		return 0;
+	sample = ( ( netem_random ( netem ) << 15 ) | netem_random ( netem ) );
+	return ( ( sample % 1000000 ) < ppm );
+}
+
+/**
+ * Discard frame
+ *
+ * @v netem		Emulated link
+ * @v iobuf		I/O buffer
+ * @v owned		I/O buffer is on the network device's transmit queue
+ */
+static void netem_discard ( struct netem *netem, struct io_buffer *iobuf,
+			    int owned ) {
+
+	if ( owned ) {
+		netdev_tx_complete ( netem->netdev, iobuf );
+	} else {
+		free_iob ( iobuf );
+	}
+}
+
+/**
+ * Check if frame may be fragmented by a router
+ *
+ * @v iobuf		I/O buffer
+ * @ret may_fragment	Frame may be fragmented
+ */
+static int netem_may_fragment ( struct io_buffer *iobuf ) {
+	struct ethhdr *ethhdr = iobuf->data;
+	struct iphdr *iphdr = ( iobuf->data + sizeof ( *ethhdr ) );
+
+	if ( iob_len ( iobuf ) < ( sizeof ( *ethhdr ) + sizeof ( *iphdr ) ) )
+		return 0;
+	if ( ethhdr->h_protocol != htons ( ETH_P_IP ) )
+		return 0;
+	return ( ! ( iphdr->frags & htons ( IP_MASK_DONOTFRAG ) ) );
+}
+
+/**
+ * Place frame on link
+ *
+ * @v netem		Emulated link
+ * @v queue		Link direction
+ * @v iobuf		I/O buffer
+ * @v owned		I/O buffer is on the network device's transmit queue
+ */
+static void netem_enqueue ( struct netem *netem, struct netem_queue *queue,
+			    struct io_buffer *iobuf, int owned ) {
+	struct netem_config *config = &netem->config;
+	unsigned int limit = ( config->limit ? config->limit : NETEM_LIMIT );
+	unsigned long long now = ( ( ( unsigned long long ) currticks() ) << 16);
+	struct netem_slot *slot;
+	struct netem_slot *prev;
+	struct io_buffer *copy;
+	unsigned long due;
+	size_t len = iob_len ( iobuf );
+
+	/* Drop frame if it exceeds the path MTU, unless it is an IPv4
+	 * datagram that a router would be permitted to fragment.  The
+	 * fragments would be reassembled by the receiver, so deliver
+	 * the frame intact.
+	 */
+	if ( config->path_mtu && ( ( len - ETH_HLEN ) > config->path_mtu ) ) {
+		if ( netem_may_fragment ( iobuf ) ) {
+			queue->stats.fragmented++;
+		} else {
+			queue->stats.oversized++;
+			netem_discard ( netem, iobuf, owned );
+			return;
+		}
+	}
+
+	/* Duplicate frame, if applicable */
+	if ( netem_chance ( netem, config->duplicate ) ) {
+		copy = alloc_iob ( len );
+		if ( copy ) {
+			memcpy ( iob_put ( copy, len ), iobuf->data, len );
+			queue->stats.duplicated++;
+			netem_enqueue ( netem, queue, copy, 0 );
+		}
+	}
+
+	/* Lose frame, if applicable */
+	if ( netem_chance ( netem, config->loss ) ) {
+		queue->stats.lost++;
+		netem_discard ( netem, iobuf, owned );
+		return;
+	}
+
+	/* Drop frame if queue is full */
+	if ( ( queue->prod - queue->cons ) >= limit ) {
+		queue->stats.overflows++;
+		netem_discard ( netem, iobuf, owned );
+		return;
+	}
+
+	/* Calculate time at which frame has been fully serialised */
+	if ( queue->busy < now )
+		queue->busy = now;
+	if ( config->bandwidth ) {
+		queue->busy += ( ( ( ( unsigned long long ) len ) *
+				   TICKS_PER_SEC ) << 16 ) / config->bandwidth;
+	}
+
+	/* Calculate delivery time */
+	due = ( ( queue->busy >> 16 ) + config->latency );
+	if ( config->jitter )
+		due += ( netem_random ( netem ) % ( config->jitter + 1 ) );
+
+	/* Add to queue */
+	slot = &queue->slots[ queue->prod++ % NETEM_LIMIT ];
+	slot->iobuf = iobuf;
+	slot->due = due;
+	slot->owned = owned;
+
+	/* Reorder frame, if applicable.  The delivery times remain in
+	 * place, so that the frame overtakes its predecessor.
+	 */
+	if ( ( ( queue->prod - queue->cons ) >= 2 ) &&
+	     netem_chance ( netem, config->reorder ) ) {
+		prev = &queue->slots[ ( queue->prod - 2 ) % NETEM_LIMIT ];
+		slot->iobuf = prev->iobuf;
+		slot->owned = prev->owned;
+		prev->iobuf = iobuf;
+		prev->owned = owned;
+		queue->stats.reordered++;
+	}
+}
+
+/**
+ * Remove next deliverable frame from link
+ *
+ * @v queue		Link direction
+ * @v owned		I/O buffer is on the network device's transmit queue
+ * @ret iobuf		I/O buffer, or NULL
+ */
+static struct io_buffer * netem_dequeue ( struct netem_queue *queue,
+					  int *owned ) {
+	struct netem_slot *slot;
+
+	/* Check for a frame that is due for delivery */
+	if ( queue->cons == queue->prod )
+		return NULL;
+	slot = &queue->slots[ queue->cons % NETEM_LIMIT ];
+	if ( ( ( signed long ) ( currticks() - slot->due ) ) < 0 )
+		return NULL;
+
+	/* Remove from queue */
+	queue->cons++;
+	queue->stats.delivered++;
+	*owned = slot->owned;
+	return slot->iobuf;
+}
+
+/**
+ * Discard all frames on link
+ *
+ * @v queue		Link direction
+ */
+static void netem_flush ( struct netem_queue *queue ) {
+	struct netem_slot *slot;
+
+	/* Free any frames not on the network device's transmit queue
+	 * (which will be flushed by the network device core).
+	 */
+	while ( queue->cons != queue->prod ) {
+		slot = &queue->slots[ queue->cons++ % NETEM_LIMIT ];
+		if ( ! slot->owned )
+			free_iob ( slot->iobuf );
+	}
+}
+
+/******************************************************************************
+ *
+ * Responder network layers
+ *
+ ******************************************************************************
+ */
+
+/**
+ * Allocate I/O buffer for responder transmission
+ *
+ * @v len		Length of transport-layer payload and headers
+ * @ret iobuf		I/O buffer, or NULL
+ */
+static struct io_buffer * netem_alloc_iob ( size_t len ) {
+	struct io_buffer *iobuf;
+
+	iobuf = alloc_iob ( MAX_LL_NET_HEADER_LEN + len );
+	if ( iobuf )
+		iob_reserve ( iobuf, MAX_LL_NET_HEADER_LEN );
+	return iobuf;
+}
+
+/**
+ * Transmit Ethernet frame from responder
+ *
+ * @v netem		Emulated link
+ * @v iobuf		I/O buffer
+ * @v net_proto		Network-layer protocol (in network byte order)
+ */
+static void netem_eth_tx ( struct netem *netem, struct io_buffer *iobuf,
+			   uint16_t net_proto ) {
+	struct ethhdr *ethhdr;
+
+	ethhdr = iob_push ( iobuf, sizeof ( *ethhdr ) );
+	memcpy ( ethhdr->h_dest, netem->netdev->ll_addr, ETH_ALEN );
+	memcpy ( ethhdr->h_source, netem->peer_hwaddr, ETH_ALEN );
+	ethhdr->h_protocol = net_proto;
+	netem_enqueue ( netem, &netem->rx, iobuf, 0 );
+}
+
+/**
+ * Transmit IPv4 packet from responder
+ *
+ * @v netem		Emulated link
+ * @v iobuf		I/O buffer
+ * @v dest		Destination address
+ * @v protocol		Transport-layer protocol
+ * @v csum		Transport-layer checksum to complete, or NULL
+ */
+static void netem_ipv4_tx ( struct netem *netem, struct io_buffer *iobuf,
+			    struct in_addr dest, unsigned int protocol,
+			    uint16_t *csum ) {
+	struct ipv4_pseudo_header pshdr;
+	struct iphdr *iphdr;
+	size_t len = iob_len ( iobuf );
+
+	/* Complete transport-layer checksum, if applicable */
+	if ( csum ) {
+		pshdr.src = netem->peer;
+		pshdr.dest = dest;
+		pshdr.zero_padding = 0;
+		pshdr.protocol = protocol;
+		pshdr.len = htons ( len );
+		*csum = tcpip_continue_chksum ( *csum, &pshdr,
+						sizeof ( pshdr ) );
+	}
+
+	/* Construct IPv4 header */
+	iphdr = iob_push ( iobuf, sizeof ( *iphdr ) );
+	memset ( iphdr, 0, sizeof ( *iphdr ) );
+	iphdr->verhdrlen = ( IP_VER | ( sizeof ( *iphdr ) / 4 ) );
+	iphdr->len = htons ( sizeof ( *iphdr ) + len );
+	iphdr->ident = htons ( netem->ident++ );
+	iphdr->ttl = IP_TTL;
+	iphdr->protocol = protocol;
+	iphdr->src = netem->peer;
+	iphdr->dest = dest;
+	iphdr->chksum = tcpip_chksum ( iphdr, sizeof ( *iphdr ) );
+
+	/* Transmit packet */
+	netem_eth_tx ( netem, iobuf, htons ( ETH_P_IP ) );
+}
+
+/**
+ * Transmit IPv6 packet from responder
+ *
+ * @v netem		Emulated link
+ * @v iobuf		I/O buffer
+ * @v dest		Destination address
+ * @v protocol		Transport-layer protocol
+ * @v csum		Transport-layer checksum to complete, or NULL
+ */
+static void netem_ipv6_tx ( struct netem *netem, struct io_buffer *iobuf,
+			    struct in6_addr *dest, unsigned int protocol,
+			    uint16_t *csum ) {
+	struct ipv6_pseudo_header pshdr;
+	struct ipv6_header *iphdr;
+	size_t len = iob_len ( iobuf );
+
+	/* Complete transport-layer checksum, if applicable */
+	if ( csum ) {
+		memcpy ( &pshdr.src, &netem->peer6, sizeof ( pshdr.src ) );
+		memcpy ( &pshdr.dest, dest, sizeof ( pshdr.dest ) );
+		pshdr.len = htonl ( len );
+		memset ( pshdr.zero, 0, sizeof ( pshdr.zero ) );
+		pshdr.next_header = protocol;
+		*csum = tcpip_continue_chksum ( *csum, &pshdr,
+						sizeof ( pshdr ) );
+	}
+
+	/* Construct IPv6 header */
+	iphdr = iob_push ( iobuf, sizeof ( *iphdr ) );
+	memset ( iphdr, 0, sizeof ( *iphdr ) );
+	iphdr->ver_tc_label = htonl ( IPV6_VER );
+	iphdr->len = htons ( len );
+	iphdr->next_header = protocol;
+	iphdr->hop_limit = IPV6_HOP_LIMIT;
+	memcpy ( &iphdr->src, &netem->peer6, sizeof ( iphdr->src ) );
+	memcpy ( &iphdr->dest, dest, sizeof ( iphdr->dest ) );
+
+	/* Transmit packet */
+	netem_eth_tx ( netem, iobuf, htons ( ETH_P_IPV6 ) );
+}
+
+/**
+ * Transmit IP packet from responder
+ *
+ * @v netem		Emulated link
+ * @v iobuf		I/O buffer
+ * @v dest		Destination address
+ * @v protocol		Transport-layer protocol
+ * @v csum		Transport-layer checksum to complete, or NULL
+ */
+static void netem_ip_tx ( struct netem *netem, struct io_buffer *iobuf,
+			  struct sockaddr_tcpip *dest, unsigned int protocol,
+			  uint16_t *csum ) {
+	struct sockaddr_in *sin = ( ( struct sockaddr_in * ) dest );
+	struct sockaddr_in6 *sin6 = ( ( struct sockaddr_in6 * ) dest );
+
+	if ( dest->st_family == AF_INET6 ) {
+		netem_ipv6_tx ( netem, iobuf, &sin6->sin6_addr, protocol,
+				csum );
+	} else {
+		netem_ipv4_tx ( netem, iobuf, sin->sin_addr, protocol, csum );
+	}
+}
+
+/**
+ * Handle ARP packet received by responder
+ *
+ * @v netem		Emulated link
+ * @v iobuf		I/O buffer
+ */
+static void netem_arp_rx ( struct netem *netem, struct io_buffer *iobuf ) {
+	struct arphdr *arphdr = iobuf->data;
+	struct io_buffer *reply;
+	struct arphdr *rarphdr;
+	size_t len = ( sizeof ( *arphdr ) + ( 2 * ETH_ALEN ) +
+		       ( 2 * sizeof ( struct in_addr ) ) );
+
+	/* Ignore anything other than a request for our address */
+	if ( ( iob_len ( iobuf ) < len ) ||
+	     ( arphdr->ar_op != htons ( ARPOP_REQUEST ) ) ||
+	     ( arphdr->ar_hln != ETH_ALEN ) ||
+	     ( arphdr->ar_pln != sizeof ( struct in_addr ) ) ||
+	     ( memcmp ( arp_target_pa ( arphdr ), &netem->peer,
+			sizeof ( netem->peer ) ) != 0 ) ) {
+		return;
+	}
+
+	/* Construct reply */
+	reply = netem_alloc_iob ( len );
+	if ( ! reply )
+		return;
+	rarphdr = iob_put ( reply, len );
+	memcpy ( rarphdr, arphdr, sizeof ( *rarphdr ) );
+	rarphdr->ar_op = htons ( ARPOP_REPLY );
+	memcpy ( arp_sender_ha ( rarphdr ), netem->peer_hwaddr, ETH_ALEN );
+	memcpy ( arp_sender_pa ( rarphdr ), &netem->peer,
+		 sizeof ( netem->peer ) );
+	memcpy ( arp_target_ha ( rarphdr ), arp_sender_ha ( arphdr ),
+		 ETH_ALEN );
+	memcpy ( arp_target_pa ( rarphdr ), arp_sender_pa ( arphdr ),
+		 sizeof ( struct in_addr ) );
+	netem_eth_tx ( netem, reply, htons ( ETH_P_ARP ) );
+}
+
+/******************************************************************************
+ *
+ * Responder TCP
+ *
+ ******************************************************************************
+ */
+
+/**
+ * Get responder TCP maximum segment size
+ *
+ * @v netem		Emulated link
+ * @v peer		Client address
+ * @ret mss		Maximum segment size
+ */
+static size_t netem_mss ( struct netem *netem, struct sockaddr_tcpip *peer ) {
+	size_t mtu = ( netem->config.mtu ? netem->config.mtu : ETH_MAX_MTU );
+	size_t hlen = ( ( peer->st_family == AF_INET6 ) ?
+			sizeof ( struct ipv6_header ) :
+			sizeof ( struct iphdr ) );
+
+	return ( mtu - hlen - sizeof ( struct tcp_header ) );
+}
+
+/**
+ * Get responder TCP maximum segment payload length
+ *
+ * @v conn		TCP connection
+ * @ret max_len		Maximum segment payload length
+ */
+static size_t netem_tcp_max_len ( struct netem_tcp *conn ) {
+	size_t max_len = conn->mss;
+
+	/* Allow for timestamp option, if enabled */
+	if ( conn->ts )
+		max_len -= sizeof ( struct tcp_timestamp_padded_option );
+	return max_len;
+}
+
+/**
+ * Transmit TCP segment from responder
+ *
+ * @v netem		Emulated link
+ * @v conn		TCP connection
+ * @v offset		Stream offset of segment
+ * @v len		Length of data
+ * @v flags		TCP flags
+ */
+static void netem_tcp_tx ( struct netem *netem, struct netem_tcp *conn,
+			   size_t offset, size_t len, unsigned int flags ) {
+	struct tcp_sack_permitted_padded_option *spopt;
+	struct tcp_window_scale_padded_option *wsopt;
+	struct tcp_timestamp_padded_option *tsopt;
+	struct tcp_sack_padded_option *sackopt;
+	struct tcp_sack_block *sack;
+	struct tcp_mss_option *mssopt;
+	struct tcp_header *tcphdr;
+	struct io_buffer *iobuf;
+	unsigned int count;
+	unsigned int i;
+	uint32_t seq;
+	size_t hlen;
+	size_t frag_len;
+	void *data;
+
+	/* Count selective acknowledgement blocks, leaving space for
+	 * any timestamp option
+	 */
+	for ( count = 0 ; count < ( conn->ts ? ( TCP_SACK_MAX - 1 ) :
+				    TCP_SACK_MAX ) ; count++ ) {
+		if ( conn->sack[count].left == conn->sack[count].right )
+			break;
+	}
+
+	/* Allocate I/O buffer */
+	hlen = sizeof ( *tcphdr );
+	if ( flags & TCP_SYN ) {
+		hlen += ( sizeof ( *mssopt ) + sizeof ( *wsopt ) );
+		if ( conn->sack_permitted )
+			hlen += sizeof ( *spopt );
+	} else if ( count ) {
+		hlen += ( sizeof ( *sackopt ) + ( count * sizeof ( *sack ) ) );
+	}
+	if ( conn->ts )
+		hlen += sizeof ( *tsopt );
+	iobuf = netem_alloc_iob ( hlen + len );
+	if ( ! iobuf )
+		return;
+
+	/* Construct data */
+	iob_reserve ( iobuf, hlen );
+	data = iob_put ( iobuf, len );
+	seq = ( conn->iss + 1 + offset );
+	if ( offset < conn->header_len ) {
+		frag_len = ( conn->header_len - offset );
+		if ( frag_len > len )
+			frag_len = len;
+		memcpy ( data, &conn->header[offset], frag_len );
+		data += frag_len;
+		offset += frag_len;
+		len -= frag_len;
+	}
+	if ( len ) {
+		memcpy ( data, netem_pattern_data ( offset - conn->header_len ),
+			 len );
+	}
+
+	/* Construct options */
+	if ( conn->ts ) {
+		tsopt = iob_push ( iobuf, sizeof ( *tsopt ) );
+		memset ( tsopt->nop, TCP_OPTION_NOP, sizeof ( tsopt->nop ) );
+		tsopt->tsopt.kind = TCP_OPTION_TS;
+		tsopt->tsopt.length = sizeof ( tsopt->tsopt );
+		tsopt->tsopt.tsval = htonl ( currticks() );
+		tsopt->tsopt.tsecr = htonl ( conn->ts_recent );
+	}
+	if ( flags & TCP_SYN ) {
+		seq = conn->iss;
+		if ( conn->sack_permitted ) {
+			spopt = iob_push ( iobuf, sizeof ( *spopt ) );
+			memset ( spopt->nop, TCP_OPTION_NOP,
+				 sizeof ( spopt->nop ) );
+			spopt->spopt.kind = TCP_OPTION_SACK_PERMITTED;
+			spopt->spopt.length = sizeof ( spopt->spopt );
+		}
+		wsopt = iob_push ( iobuf, sizeof ( *wsopt ) );
+		wsopt->nop = TCP_OPTION_NOP;
+		wsopt->wsopt.kind = TCP_OPTION_WS;
+		wsopt->wsopt.length = sizeof ( wsopt->wsopt );
+		wsopt->wsopt.scale = conn->rcv_wscale;
+		mssopt = iob_push ( iobuf, sizeof ( *mssopt ) );
+		mssopt->kind = TCP_OPTION_MSS;
+		mssopt->length = sizeof ( *mssopt );
+		mssopt->mss = htons ( netem_mss ( netem, &conn->peer ) );
+	} else if ( count ) {
+		sack = iob_push ( iobuf, ( count * sizeof ( *sack ) ) );
+		for ( i = 0 ; i < count ; i++ ) {
+			sack[i].left = htonl ( conn->sack[i].left );
+			sack[i].right = htonl ( conn->sack[i].right );
+		}
+		sackopt = iob_push ( iobuf, sizeof ( *sackopt ) );
+		memset ( sackopt->nop, TCP_OPTION_NOP,
+			 sizeof ( sackopt->nop ) );
+		sackopt->sackopt.kind = TCP_OPTION_SACK;
+		sackopt->sackopt.length = ( sizeof ( sackopt->sackopt ) +
+					    ( count * sizeof ( *sack ) ) );
+	}
+
+	/* Construct header */
+	tcphdr = iob_push ( iobuf, sizeof ( *tcphdr ) );
+	memset ( tcphdr, 0, sizeof ( *tcphdr ) );
+	tcphdr->src = htons ( conn->local_port );
+	tcphdr->dest = htons ( conn->port );
+	tcphdr->seq = htonl ( seq );
+	tcphdr->ack = htonl ( conn->rcv_nxt );
+	tcphdr->hlen = ( ( hlen / 4 ) << 4 );
+	tcphdr->flags = ( flags | TCP_ACK );
+	tcphdr->win = htons ( 0xffff );
+
+	/* Update statistics */
+	if ( len )
+		netem->tcp_stats.data++;
+
+	/* Transmit segment, omitting checksum if offloaded */
+	if ( netem->config.rx_csum ) {
+		netem_ip_tx ( netem, iobuf, &conn->peer, IP_TCP, NULL );
+	} else {
+		tcphdr->csum = tcpip_chksum ( iobuf->data, iob_len ( iobuf ) );
+		netem_ip_tx ( netem, iobuf, &conn->peer, IP_TCP,
+			      &tcphdr->csum );
+	}
+}
+
+/**
+ * Reset unrecognised TCP connection
+ *
+ * @v netem		Emulated link
+ * @v tcphdr		Received TCP header
+ * @v len		Length of received data
+ * @v src		Source address
+ */
+static void netem_tcp_rst ( struct netem *netem, struct tcp_header *tcphdr,
+			    size_t len, struct sockaddr_tcpip *src ) {
+	struct netem_tcp conn;
+
+	/* Construct a temporary connection with matching sequence
+	 * numbers, so that the client will accept the reset.
+	 */
+	memset ( &conn, 0, sizeof ( conn ) );
+	memcpy ( &conn.peer, src, sizeof ( conn.peer ) );
+	conn.port = ntohs ( tcphdr->src );
+	conn.local_port = ntohs ( tcphdr->dest );
+	conn.iss = ( ntohl ( tcphdr->ack ) - 1 );
+	conn.rcv_nxt = ( ntohl ( tcphdr->seq ) + len );
+	if ( tcphdr->flags & ( TCP_SYN | TCP_FIN ) )
+		conn.rcv_nxt++;
+	netem_tcp_tx ( netem, &conn, 0, 0, TCP_RST );
+}
+
+/**
+ * Construct responder HTTP response
+ *
+ * @v conn		TCP connection
+ */
+static void netem_http_respond ( struct netem_tcp *conn ) {
+	const char *status = "200 OK";
+	unsigned long len = 0;
+	char *path;
+	char *end;
+
+	/* Parse request line */
+	if ( strncmp ( conn->request, "GET /", 5 ) == 0 ) {
+		path = &conn->request[5];
+		len = strtoul ( path, &end, 10 );
+		if ( ( end == path ) || ( *end != ' ' ) ) {
+			status = "404 Not Found";
+			len = 0;
+		}
+	} else if ( strncmp ( conn->request, "POST /", 6 ) != 0 ) {
+		status = "501 Not Implemented";
+	} else if ( conn->corrupt ) {
+		status = "400 Bad Request";
+	}
+
+	/* Construct response */
+	conn->header_len = snprintf ( conn->header, sizeof ( conn->header ),
+				      "HTTP/1.1 %s\r\nContent-Length: %ld\r\n"
+				      "Connection: close\r\n\r\n",
+				      status, len );
+	conn->len = ( conn->header_len + len );
+	conn->responding = 1;
+}
+
+/**
+ * Check request body data received by responder HTTP server
+ *
+ * @v conn		TCP connection
+ * @v seq		Sequence number of data
+ * @v data		Data
+ * @v len		Length of data
+ */
+static void netem_http_body ( struct netem_tcp *conn, uint32_t seq,
+			      const void *data, size_t len ) {
+	size_t offset;
+	size_t frag_len;
+
+	/* Ignore any data preceding the request body */
+	if ( tcp_cmp ( seq, conn->body_seq ) < 0 ) {
+		offset = ( conn->body_seq - seq );
+		if ( offset >= len )
+			return;
+		data += offset;
+		len -= offset;
+		seq = conn->body_seq;
+	}
+
+	/* Ignore any data following the request body */
+	offset = ( seq - conn->body_seq );
+	if ( offset >= conn->body_len )
+		return;
+	if ( len > ( conn->body_len - offset ) )
+		len = ( conn->body_len - offset );
+
+	/* Check data against generated data */
+	while ( len ) {
+		frag_len = len;
+		if ( frag_len > ETH_FRAME_LEN )
+			frag_len = ETH_FRAME_LEN;
+		if ( memcmp ( data, netem_pattern_data ( offset ),
+			      frag_len ) != 0 ) {
+			conn->corrupt = 1;
+		}
+		data += frag_len;
+		offset += frag_len;
+		len -= frag_len;
+	}
+}
+
+/**
+ * Handle in-order data received by responder HTTP server
+ *
+ * @v conn		TCP connection
+ * @v seq		Sequence number of data
+ * @v data		Data
+ * @v len		Length of data
+ */
+static void netem_http_rx ( struct netem_tcp *conn, uint32_t seq,
+			    const void *data, size_t len ) {
+	size_t frag_len;
+	char *header_end;
+	char *content_len;
+
+	/* Ignore any data received after the response has started */
+	if ( conn->responding )
+		return;
+
+	/* Accumulate request header */
+	if ( ! conn->body ) {
+		frag_len = ( sizeof ( conn->request ) - 1 /* NUL */ -
+			     conn->request_len );
+		if ( frag_len > len )
+			frag_len = len;
+		memcpy ( &conn->request[conn->request_len], data, frag_len );
+		conn->request_len += frag_len;
+		conn->request[conn->request_len] = '\0';
+
+		/* Wait for end of request header */
+		header_end = strstr ( conn->request, "\r\n\r\n" );
+		if ( ! header_end ) {
+			if ( conn->request_len ==
+			     ( sizeof ( conn->request ) - 1 ) ) {
+				netem_http_respond ( conn );
+			}
+			return;
+		}
+		header_end += 4;
+
+		/* Locate request body, if applicable */
+		conn->body = 1;
+		conn->body_seq = ( conn->irs + 1 +
+				   ( header_end - conn->request ) );
+		content_len = strstr ( conn->request, "Content-Length:" );
+		if ( content_len && ( content_len < header_end ) ) {
+			conn->body_len = strtoul ( ( content_len + 15 ),
+						   NULL, 10 );
+		}
+	}
+
+	/* Check request body */
+	netem_http_body ( conn, seq, data, len );
+}
+
+/**
+ * Construct responder HTTP response once request is complete
+ *
+ * @v conn		TCP connection
+ */
+static void netem_http_check ( struct netem_tcp *conn ) {
+
+	/* Wait for complete request */
+	if ( conn->responding || ( ! conn->body ) ||
+	     ( ( conn->rcv_nxt - conn->body_seq ) < conn->body_len ) )
+		return;
+
+	/* Construct response */
+	netem_http_respond ( conn );
+}
+
+/**
+ * Record out-of-order data received by responder
+ *
+ * @v conn		TCP connection
+ * @v seq		Sequence number of data
+ * @v len		Length of data
+ */
+static void netem_tcp_sack ( struct netem_tcp *conn, uint32_t seq,
+			     size_t len ) {
+	struct tcp_sack_block sack;
+	struct tcp_sack_block *block;
+	unsigned int i;
+	unsigned int j;
+
+	/* Absorb any overlapping or adjacent blocks */
+	sack.left = seq;
+	sack.right = ( seq + len );
+	for ( i = 0, j = 0 ; i < TCP_SACK_MAX ; i++ ) {
+		block = &conn->sack[i];
+		if ( block->left == block->right )
+			continue;
+		if ( ( tcp_cmp ( sack.left, block->right ) <= 0 ) &&
+		     ( tcp_cmp ( sack.right, block->left ) >= 0 ) ) {
+			if ( tcp_cmp ( block->left, sack.left ) < 0 )
+				sack.left = block->left;
+			if ( tcp_cmp ( block->right, sack.right ) > 0 )
+				sack.right = block->right;
+			continue;
+		}
+		memmove ( &conn->sack[j++], block, sizeof ( *block ) );
+	}
+	memset ( &conn->sack[j], 0,
+		 ( ( TCP_SACK_MAX - j ) * sizeof ( conn->sack[0] ) ) );
+
+	/* Record as most recent block, forgetting the oldest if
+	 * necessary (as per RFC 2018).
+	 */
+	memmove ( &conn->sack[1], &conn->sack[0],
+		  ( ( TCP_SACK_MAX - 1 ) * sizeof ( conn->sack[0] ) ) );
+	memcpy ( &conn->sack[0], &sack, sizeof ( conn->sack[0] ) );
+}
+
+/**
+ * Advance over out-of-order data that is now in sequence
+ *
+ * @v conn		TCP connection
+ */
+static void netem_tcp_advance ( struct netem_tcp *conn ) {
+	struct tcp_sack_block *block;
+	unsigned int i;
+	unsigned int j;
+
+	for ( i = 0, j = 0 ; i < TCP_SACK_MAX ; i++ ) {
+		block = &conn->sack[i];
+		if ( block->left == block->right )
+			continue;
+		if ( tcp_cmp ( block->left, conn->rcv_nxt ) <= 0 ) {
+			if ( tcp_cmp ( block->right, conn->rcv_nxt ) > 0 )
+				conn->rcv_nxt = block->right;
+			continue;
+		}
+		memmove ( &conn->sack[j++], block, sizeof ( *block ) );
+	}
+	memset ( &conn->sack[j], 0,
+		 ( ( TCP_SACK_MAX - j ) * sizeof ( conn->sack[0] ) ) );
+}
+
+/**
+ * Find responder TCP connection
+ *
+ * @v netem		Emulated link
+ * @v port		Client port
+ * @v local_port	Responder port
+ * @ret conn		TCP connection, or NULL
+ */
+static struct netem_tcp * netem_tcp_find ( struct netem *netem,
+					   unsigned int port,
+					   unsigned int local_port ) {
+	struct netem_tcp *conn;
+	unsigned int i;
+
+	for ( i = 0 ; i < NETEM_TCP_MAX ; i++ ) {
+		conn = &netem->tcp[i];
+		if ( conn->state && ( conn->port == port ) &&
+		     ( conn->local_port == local_port ) )
+			return conn;
+	}
+	return NULL;
+}
+
+/**
+ * Handle TCP segment received by responder
+ *
+ * @v netem		Emulated link
+ * @v iobuf		I/O buffer
+ * @v src		Source address
+ */
+static void netem_tcp_rx ( struct netem *netem, struct io_buffer *iobuf,
+			   struct sockaddr_tcpip *src ) {
+	struct tcp_header *tcphdr = iobuf->data;
+	struct tcp_timestamp_option *tsopt = NULL;
+	struct tcp_option *option;
+	struct netem_tcp *conn;
+	unsigned int port;
+	unsigned int local_port;
+	unsigned int flags;
+	unsigned int i;
+	size_t hlen;
+	size_t acked;
+	size_t max_len;
+	size_t win;
+	size_t len;
+	uint32_t seq;
+	uint8_t *opts;
+	uint8_t *end;
+	void *data;
+
+	/* Sanity checks */
+	if ( iob_len ( iobuf ) < sizeof ( *tcphdr ) )
+		return;
+	hlen = ( ( tcphdr->hlen & 0xf0 ) >> 2 );
+	if ( ( hlen < sizeof ( *tcphdr ) ) || ( hlen > iob_len ( iobuf ) ) )
+		return;
+	port = ntohs ( tcphdr->src );
+	local_port = ntohs ( tcphdr->dest );
+	flags = tcphdr->flags;
+	seq = ntohl ( tcphdr->seq );
+	data = ( iobuf->data + hlen );
+	len = ( iob_len ( iobuf ) - hlen );
+
+	/* Count connection requests */
+	if ( ( flags & TCP_SYN ) && ! ( flags & TCP_ACK ) ) {
+		if ( src->st_family == AF_INET6 ) {
+			netem->tcp_stats.syns6++;
+		} else {
+			netem->tcp_stats.syns++;
+		}
+	}
+
+	/* Discard anything received over a black-holed IPv6 path */
+	if ( ( src->st_family == AF_INET6 ) && netem->config.blackhole6 )
+		return;
+
+	/* Find or create connection */
+	conn = netem_tcp_find ( netem, port, local_port );
+	if ( ( ! conn ) && ( flags & TCP_SYN ) && ( ! ( flags & TCP_ACK ) ) &&
+	     ( local_port == NETEM_HTTP_PORT ) ) {
+		for ( i = 0 ; i < NETEM_TCP_MAX ; i++ ) {
+			if ( ! netem->tcp[i].state ) {
+				conn = &netem->tcp[i];
+				memset ( conn, 0, sizeof ( *conn ) );
+				conn->state = NETEM_TCP_SYN_RCVD;
+				conn->port = port;
+				conn->local_port = local_port;
+				conn->iss = ( 0x6e650000UL + ( i << 24 ) +
+					      netem->ident );
+				conn->irs = ntohl ( tcphdr->seq );
+				conn->rcv_nxt = ( conn->irs + 1 );
+				memcpy ( &conn->peer, src,
+					 sizeof ( conn->peer ) );
+				conn->mss = netem_mss ( netem, src );
+				break;
+			}
+		}
+	}
+	if ( ! conn ) {
+		if ( ! ( flags & TCP_RST ) )
+			netem_tcp_rst ( netem, tcphdr, len, src );
+		return;
+	}
+	conn->progress = currticks();
+
+	/* Handle reset */
+	if ( flags & TCP_RST ) {
+		conn->state = NETEM_TCP_CLOSED;
+		return;
+	}
+
+	/* Parse options.  Options other than timestamps are relevant
+	 * only within a SYN (including any retransmission).
+	 */
+	opts = ( iobuf->data + sizeof ( *tcphdr ) );
+	end = ( iobuf->data + hlen );
+	while ( opts < end ) {
+		option = ( ( void * ) opts );
+		if ( option->kind == TCP_OPTION_END )
+			break;
+		if ( option->kind == TCP_OPTION_NOP ) {
+			opts++;
+			continue;
+		}
+		if ( ( ( opts + 2 ) > end ) || ( option->length < 2 ) ||
+		     ( ( opts + option->length ) > end ) )
+			break;
+		if ( ( option->kind == TCP_OPTION_TS ) &&
+		     ( option->length == sizeof ( *tsopt ) ) ) {
+			tsopt = ( ( void * ) opts );
+		}
+		if ( ( option->kind == TCP_OPTION_WS ) &&
+		     ( option->length == 3 ) && ( flags & TCP_SYN ) ) {
+			conn->wscale = opts[2];
+			conn->rcv_wscale = NETEM_WSCALE;
+		}
+		if ( ( option->kind == TCP_OPTION_SACK_PERMITTED ) &&
+		     ( flags & TCP_SYN ) ) {
+			conn->sack_permitted = 1;
+		}
+		if ( ( option->kind == TCP_OPTION_MSS ) &&
+		     ( option->length == 4 ) && ( flags & TCP_SYN ) ) {
+			conn->mss = ( ( opts[2] << 8 ) | opts[3] );
+			if ( conn->mss > netem_mss ( netem, src ) )
+				conn->mss = netem_mss ( netem, src );
+		}
+		opts += option->length;
+	}
+
+	/* Record timestamp to be echoed, as per RFC 7323.  Only a
+	 * segment that does not lie beyond the next expected
+	 * sequence number may update the recorded timestamp.
+	 */
+	if ( ( flags & TCP_SYN ) && tsopt && netem->config.ts )
+		conn->ts = 1;
+	if ( conn->ts && tsopt && ( tcp_cmp ( seq, conn->rcv_nxt ) <= 0 ) )
+		conn->ts_recent = ntohl ( tsopt->tsval );
+
+	/* Handle SYN (including any retransmission) */
+	if ( flags & TCP_SYN ) {
+		conn->win = ntohs ( tcphdr->win );
+		netem_tcp_tx ( netem, conn, 0, 0, TCP_SYN );
+		return;
+	}
+
+	/* Ignore anything without an acknowledgement */
+	if ( ! ( flags & TCP_ACK ) )
+		return;
+
+	/* Handle acknowledgement */
+	acked = ( ( uint32_t ) ( ntohl ( tcphdr->ack ) - conn->iss - 1 ) );
+	win = ( ntohs ( tcphdr->win ) << conn->wscale );
+	if ( conn->state == NETEM_TCP_SYN_RCVD ) {
+		if ( acked != 0 )
+			return;
+		conn->state = NETEM_TCP_ESTABLISHED;
+	}
+	if ( ( acked > conn->una ) && ( acked <= conn->nxt ) ) {
+		/* New data acknowledged */
+		conn->una = acked;
+		conn->dupacks = 0;
+	} else if ( ( acked == conn->una ) && ( conn->una != conn->nxt ) &&
+		    ( ! len ) && ( win == conn->win ) &&
+		    ( ++conn->dupacks == 3 ) ) {
+		/* Fast retransmission */
+		max_len = netem_tcp_max_len ( conn );
+		netem_tcp_tx ( netem, conn, conn->una,
+			       ( ( conn->una < conn->len ) ?
+				 ( ( ( conn->len - conn->una ) < max_len ) ?
+				   ( conn->len - conn->una ) : max_len ) : 0 ),
+			       ( ( conn->una < conn->len ) ? 0 : TCP_FIN ) );
+	}
+	conn->win = win;
+
+	/* Trim any previously received data */
+	if ( ( tcp_cmp ( seq, conn->rcv_nxt ) < 0 ) &&
+	     ( tcp_cmp ( ( seq + len ), conn->rcv_nxt ) > 0 ) ) {
+		data += ( conn->rcv_nxt - seq );
+		len -= ( conn->rcv_nxt - seq );
+		seq = conn->rcv_nxt;
+	}
+
+	/* Handle data and FIN.  Out-of-order request body data is
+	 * checked and recorded (if selective acknowledgements are
+	 * permitted); anything else out of order is discarded.
+	 */
+	if ( len || ( flags & TCP_FIN ) ) {
+		if ( seq == conn->rcv_nxt ) {
+			if ( len )
+				netem_http_rx ( conn, seq, data, len );
+			conn->rcv_nxt += len;
+			netem_tcp_advance ( conn );
+			if ( flags & TCP_FIN ) {
+				conn->rcv_nxt++;
+				conn->fin_rcvd = 1;
+			}
+			netem_http_check ( conn );
+		} else if ( len && conn->sack_permitted && conn->body &&
+			    ( tcp_cmp ( seq, conn->rcv_nxt ) > 0 ) &&
+			    ( ( seq - conn->rcv_nxt ) <
+			      ( 0xffffUL << conn->rcv_wscale ) ) ) {
+			netem_http_body ( conn, seq, data, len );
+			netem_tcp_sack ( conn, seq, len );
+		}
+		netem_tcp_tx ( netem, conn, conn->nxt, 0, 0 );
+	}
+
+	/* Close connection once both sides have finished */
+	if ( conn->responding && conn->fin_rcvd &&
+	     ( conn->una == ( conn->len + 1 ) ) ) {
+		conn->state = NETEM_TCP_CLOSED;
+	}
+}
+
+/**
+ * Transmit scrambled burst from responder TCP connection
+ *
+ * @v netem		Emulated link
+ * @v conn		TCP connection
+ * @v end		Stream offset of end of burst
+ * @ret end		Stream offset of end of transmitted data
+ *
+ * The burst is divided into segments that each overlap the following
+ * segment by a quarter of the maximum segment payload length, and
+ * the segments are transmitted in a random order.
+ */
+static size_t netem_tcp_scramble ( struct netem *netem, struct netem_tcp *conn,
+				   size_t end ) {
+	unsigned int order[NETEM_SCRAMBLE_MAX];
+	unsigned int count;
+	unsigned int tmp;
+	unsigned int i;
+	unsigned int j;
+	size_t max_len;
+	size_t stride;
+	size_t offset;
+	size_t len;
+
+	/* Calculate number of segments, truncating burst if needed */
+	max_len = netem_tcp_max_len ( conn );
+	stride = ( ( 3 * max_len ) / 4 );
+	count = ( ( end - conn->nxt + stride - 1 ) / stride );
+	if ( count > NETEM_SCRAMBLE_MAX ) {
+		count = NETEM_SCRAMBLE_MAX;
+		end = ( conn->nxt + ( count * stride ) );
+	}
+
+	/* Shuffle segments */
+	for ( i = 0 ; i < count ; i++ ) {
+		j = ( netem_random ( netem ) % ( i + 1 ) );
+		tmp = ( ( i == j ) ? i : order[j] );
+		order[j] = i;
+		order[i] = tmp;
+	}
+
+	/* Transmit segments, setting PSH only on the final segment */
+	for ( i = 0 ; i < count ; i++ ) {
+		offset = ( conn->nxt + ( order[i] * stride ) );
+		len = ( end - offset );
+		if ( len > max_len )
+			len = max_len;
+		netem_tcp_tx ( netem, conn, offset, len,
+			       ( ( ( i + 1 ) == count ) ? TCP_PSH : 0 ) );
+	}
+
+	return end;
+}
+
+/**
+ * Transmit pending data from responder TCP connection
+ *
+ * @v netem		Emulated link
+ * @v conn		TCP connection
+ */
+static void netem_tcp_poll ( struct netem *netem, struct netem_tcp *conn ) {
+	struct cache_discarder *discarder;
+	size_t max_len;
+	size_t win;
+	size_t end;
+	size_t len;
+	int last;
+
+	/* Handle retransmission timeout */
+	if ( ( currticks() - conn->progress ) > netem->rto ) {
+		conn->progress = currticks();
+		if ( conn->state == NETEM_TCP_SYN_RCVD ) {
+			netem_tcp_tx ( netem, conn, 0, 0, TCP_SYN );
+			return;
+		}
+		conn->nxt = conn->una;
+		conn->dupacks = 0;
+	}
+
+	/* Do nothing until response is ready */
+	if ( ( conn->state != NETEM_TCP_ESTABLISHED ) || ! conn->responding )
+		return;
+
+	/* Emulate memory pressure, if applicable */
+	if ( netem->config.pressure && ( ! netem->pressures ) &&
+	     ( conn->una >= netem->config.pressure ) ) {
+		for_each_table_entry ( discarder, CACHE_DISCARDERS )
+			discarder->discard();
+		netem->pressures++;
+	}
+
+	/* Transmit as much as the window allows, setting PSH only on
+	 * the final segment of each burst (as a typical sender would)
+	 */
+	win = conn->win;
+	if ( win > NETEM_TCP_MAX_INFLIGHT )
+		win = NETEM_TCP_MAX_INFLIGHT;
+	if ( netem->config.scramble && ( conn->nxt < conn->len ) &&
+	     ( ( conn->nxt - conn->una ) < win ) ) {
+		end = ( conn->una + win );
+		if ( end > conn->len )
+			end = conn->len;
+		conn->nxt = netem_tcp_scramble ( netem, conn, end );
+	}
+	max_len = netem_tcp_max_len ( conn );
+	while ( ( conn->nxt < conn->len ) &&
+		( ( conn->nxt - conn->una ) < win ) ) {
+		len = ( conn->len - conn->nxt );
+		if ( len > max_len )
+			len = max_len;
+		if ( len > ( win - ( conn->nxt - conn->una ) ) )
+			len = ( win - ( conn->nxt - conn->una ) );
+		last = ( ( ( conn->nxt + len ) == conn->len ) ||
+			 ( ( conn->nxt + len - conn->una ) >= win ) );
+		netem_tcp_tx ( netem, conn, conn->nxt, len,
+			       ( last ? TCP_PSH : 0 ) );
+		conn->nxt += len;
+	}
+
+	/* Transmit FIN once all data has been sent */
+	if ( conn->nxt == conn->len ) {
+		netem_tcp_tx ( netem, conn, conn->nxt, 0, TCP_FIN );
+		conn->nxt++;
+	}
+}
+
+/******************************************************************************
+ *
+ * Responder UDP
+ *
+ ******************************************************************************
+ */
+
+/**
+ * Transmit UDP packet from responder
+ *
+ * @v netem		Emulated link
+ * @v iobuf		I/O buffer
+ * @v dest		Destination address and port
+ * @v local_port	Source port
+ */
+static void netem_udp_tx ( struct netem *netem, struct io_buffer *iobuf,
+			   struct sockaddr_tcpip *dest,
+			   unsigned int local_port ) {
+	struct udp_header *udphdr;
+
+	/* Construct UDP header */
+	udphdr = iob_push ( iobuf, sizeof ( *udphdr ) );
+	udphdr->src = htons ( local_port );
+	udphdr->dest = dest->st_port;
+	udphdr->len = htons ( iob_len ( iobuf ) );
+	udphdr->chksum = 0;
+	udphdr->chksum = tcpip_chksum ( udphdr, iob_len ( iobuf ) );
+
+	/* Transmit packet */
+	netem_ip_tx ( netem, iobuf, dest, IP_UDP, &udphdr->chksum );
+}
+
+/**
+ * Transmit current TFTP block (or OACK)
+ *
+ * @v netem		Emulated link
+ */
+static void netem_tftp_tx ( struct netem *netem ) {
+	struct netem_tftp *tftp = &netem->tftp;
+	struct tftp_data *data;
+	struct tftp_oack *oack;
+	struct io_buffer *iobuf;
+	size_t offset;
+	size_t len;
+
+	/* Allocate I/O buffer */
+	iobuf = netem_alloc_iob ( sizeof ( struct udp_header ) +
+				  sizeof ( *data ) + tftp->blksize );
+	if ( ! iobuf )
+		return;
+	iob_reserve ( iobuf, sizeof ( struct udp_header ) );
+
+	/* Construct OACK or DATA */
+	if ( tftp->block == 0 ) {
+		oack = iob_put ( iobuf, sizeof ( *oack ) );
+		oack->opcode = htons ( TFTP_OACK );
+		len = snprintf ( iobuf->tail, iob_tailroom ( iobuf ),
+				 "blksize%c%zd%ctsize%c%zd", 0, tftp->blksize,
+				 0, 0, tftp->len );
+		iob_put ( iobuf, ( len + 1 /* NUL */ ) );
+	} else {
+		offset = ( ( tftp->block - 1 ) * tftp->blksize );
+		len = ( ( offset < tftp->len ) ? ( tftp->len - offset ) : 0 );
+		if ( len > tftp->blksize )
+			len = tftp->blksize;
+		data = iob_put ( iobuf, sizeof ( *data ) );
+		data->opcode = htons ( TFTP_DATA );
+		data->block = htons ( tftp->block );
+		memcpy ( iob_put ( iobuf, len ), netem_pattern_data ( offset ),
+			 len );
+	}
+
+	/* Transmit packet */
+	tftp->sent = currticks();
+	netem_udp_tx ( netem, iobuf, &tftp->peer, tftp->local_port );
+}
+
+/**
+ * Handle TFTP read request received by responder
+ *
+ * @v netem		Emulated link
+ * @v iobuf		I/O buffer
+ * @v src		Source address and port
+ */
+static void netem_tftp_rrq ( struct netem *netem, struct io_buffer *iobuf,
+			     struct sockaddr_tcpip *src ) {
+	struct netem_tftp *tftp = &netem->tftp;
+	struct tftp_rrq *rrq = iobuf->data;
+	char *string = rrq->data;
+	char *end = ( iobuf->data + iob_len ( iobuf ) );
+	char *filename;
+	char *option;
+	char *value;
+	unsigned long blksize;
+	int options = 0;
+
+	/* Parse filename and mode */
+	if ( ( end <= string ) || ( end[-1] != '\0' ) )
+		return;
+	filename = string;
+	string += ( strlen ( string ) + 1 );
+	if ( string >= end )
+		return;
+	string += ( strlen ( string ) + 1 );
+
+	/* Start new transfer */
+	memset ( tftp, 0, sizeof ( *tftp ) );
+	tftp->active = 1;
+	memcpy ( &tftp->peer, src, sizeof ( tftp->peer ) );
+	tftp->local_port = ( NETEM_TFTP_PORT + netem->ident );
+	tftp->len = strtoul ( filename, NULL, 10 );
+	tftp->blksize = 512;
+	tftp->block = 1;
+
+	/* Parse options */
+	while ( string < end ) {
+		option = string;
+		string += ( strlen ( string ) + 1 );
+		if ( string >= end )
+			break;
+		value = string;
+		string += ( strlen ( string ) + 1 );
+		if ( strcmp ( option, "blksize" ) == 0 ) {
+			blksize = strtoul ( value, NULL, 10 );
+			if ( blksize > NETEM_TFTP_MAX_BLKSIZE )
+				blksize = NETEM_TFTP_MAX_BLKSIZE;
+			if ( blksize >= 8 )
+				tftp->blksize = blksize;
+			options = 1;
+		} else if ( strcmp ( option, "tsize" ) == 0 ) {
+			options = 1;
+		}
+	}
+
+	/* Send OACK (if options were requested) or first block */
+	if ( options )
+		tftp->block = 0;
+	netem_tftp_tx ( netem );
+}
+
+/**
+ * Handle TFTP acknowledgement received by responder
+ *
+ * @v netem		Emulated link
+ * @v iobuf		I/O buffer
+ */
+static void netem_tftp_ack ( struct netem *netem, struct io_buffer *iobuf ) {
+	struct netem_tftp *tftp = &netem->tftp;
+	struct tftp_ack *ack = iobuf->data;
+
+	/* Ignore stale acknowledgements */
+	if ( ( iob_len ( iobuf ) < sizeof ( *ack ) ) ||
+	     ( ntohs ( ack->block ) != ( tftp->block & 0xffff ) ) )
+		return;
+
+	/* Finish transfer after final (short) block */
+	if ( tftp->block &&
+	     ( ( tftp->block * tftp->blksize ) > tftp->len ) ) {
+		tftp->active = 0;
+		return;
+	}
+
+	/* Send next block */
+	tftp->block++;
+	netem_tftp_tx ( netem );
+}
+
+/**
+ * Check DNS label
+ *
+ * @v label		RFC1035-encoded label
+ * @v string		Label string
+ * @ret is_equal	Label matches string
+ */
+static int netem_dns_label ( const uint8_t *label, const char *string ) {
+
+	return ( ( label[0] == strlen ( string ) ) &&
+		 ( memcmp ( &label[1], string, label[0] ) == 0 ) );
+}
+
+/**
+ * Append DNS resource record to responder response
+ *
+ * @v iobuf		I/O buffer
+ * @v name		Offset of owner name
+ * @v type		Record type
+ * @v rdlength		Length of resource data
+ * @ret rdata		Resource data
+ */
+static void * netem_dns_rr ( struct io_buffer *iobuf, size_t name,
+			     unsigned int type, size_t rdlength ) {
+	struct dns_rr_common *common;
+	uint16_t *ptr;
+
+	ptr = iob_put ( iobuf, sizeof ( *ptr ) );
+	*ptr = NETEM_DNS_POINTER ( name );
+	common = iob_put ( iobuf, sizeof ( *common ) );
+	common->type = htons ( type );
+	common->class = htons ( DNS_CLASS_IN );
+	common->ttl = htonl ( NETEM_DNS_TTL );
+	common->rdlength = htons ( rdlength );
+	return iob_put ( iobuf, rdlength );
+}
+
+/**
+ * Handle DNS query received by responder
+ *
+ * @v netem		Emulated link
+ * @v iobuf		I/O buffer
+ * @v src		Source address and port
+ */
+static void netem_dns_rx ( struct netem *netem, struct io_buffer *iobuf,
+			   struct sockaddr_tcpip *src ) {
+	struct dns_header *query = iobuf->data;
+	struct dns_header *response;
+	struct dns_question *question;
+	struct io_buffer *reply;
+	struct dns_name name;
+	struct in_addr *in;
+	struct in6_addr *in6;
+	struct dns_soa *soa;
+	uint16_t *ptr;
+	const uint8_t *label;
+	unsigned int rcode = DNS_RCODE_NOERROR;
+	int found = 0;
+	size_t owner = sizeof ( *query );
+	size_t len;
+	int offset;
+
+	/* Parse question */
+	if ( ( iob_len ( iobuf ) < sizeof ( *query ) ) ||
+	     ( query->qdcount != htons ( 1 ) ) )
+		return;
+	name.data = iobuf->data;
+	name.offset = owner;
+	name.len = iob_len ( iobuf );
+	offset = dns_skip ( &name );
+	if ( offset < 0 )
+		return;
+	len = ( offset + sizeof ( *question ) );
+	if ( len > iob_len ( iobuf ) )
+		return;
+	question = ( iobuf->data + offset );
+
+	/* Defer AAAA queries, if applicable */
+	if ( netem->config.aaaa_delay &&
+	     ( question->qtype == htons ( DNS_TYPE_AAAA ) ) &&
+	     ( iobuf != netem->dns_deferred ) ) {
+		if ( netem->dns_deferred )
+			return;
+		netem->dns_deferred = netem_alloc_iob ( iob_len ( iobuf ) );
+		if ( ! netem->dns_deferred )
+			return;
+		memcpy ( iob_put ( netem->dns_deferred, iob_len ( iobuf ) ),
+			 iobuf->data, iob_len ( iobuf ) );
+		memcpy ( &netem->dns_deferred_src, src,
+			 sizeof ( netem->dns_deferred_src ) );
+		netem->dns_deferred_due =
+			( currticks() + netem->config.aaaa_delay );
+		return;
+	}
+	netem->dns_queries++;
+	if ( netem->dns_outstanding <
+	     ( netem->dns_queries - netem->dns_responses ) ) {
+		netem->dns_outstanding =
+			( netem->dns_queries - netem->dns_responses );
+	}
+
+	/* Construct response header and question */
+	reply = netem_alloc_iob ( sizeof ( struct udp_header ) + len +
+				  NETEM_DNS_RECORDS_MAX );
+	if ( ! reply )
+		return;
+	iob_reserve ( reply, sizeof ( struct udp_header ) );
+	response = iob_put ( reply, len );
+	memcpy ( response, query, len );
+	response->ancount = 0;
+	response->nscount = 0;
+	response->arcount = 0;
+
+	/* Check for nonexistent names */
+	for ( label = ( iobuf->data + owner ) ;
+	      ( label < ( ( uint8_t * ) question ) ) && *label ;
+	      label += ( 1 /* length byte */ + label[0] ) ) {
+		if ( netem_dns_label ( label, "missing" ) )
+			rcode = DNS_RCODE_NXDOMAIN;
+	}
+	label = ( iobuf->data + owner );
+
+	/* Construct answers */
+	if ( rcode == DNS_RCODE_NOERROR ) {
+		if ( netem_dns_label ( label, "alias" ) && label[6] ) {
+			ptr = netem_dns_rr ( reply, owner, DNS_TYPE_CNAME,
+					     sizeof ( *ptr ) );
+			owner += ( 1 /* length byte */ + label[0] );
+			*ptr = NETEM_DNS_POINTER ( owner );
+			response->ancount = htons ( 1 );
+		}
+		if ( question->qtype == htons ( DNS_TYPE_A ) ) {
+			in = netem_dns_rr ( reply, owner, DNS_TYPE_A,
+					    sizeof ( *in ) );
+			*in = netem->peer;
+			response->ancount =
+				htons ( ntohs ( response->ancount ) + 1 );
+			found = 1;
+		}
+		if ( ( question->qtype == htons ( DNS_TYPE_AAAA ) ) &&
+		     ( ! IN6_IS_ADDR_UNSPECIFIED ( &netem->peer6 ) ) ) {
+			in6 = netem_dns_rr ( reply, owner, DNS_TYPE_AAAA,
+					     sizeof ( *in6 ) );
+			memcpy ( in6, &netem->peer6, sizeof ( *in6 ) );
+			response->ancount =
+				htons ( ntohs ( response->ancount ) + 1 );
+			found = 1;
+		}
+	}
+
+	/* Construct authority record for negative responses */
+	if ( ! found ) {
+		ptr = netem_dns_rr ( reply, owner, DNS_TYPE_SOA,
+				     ( ( 2 * sizeof ( *ptr ) ) +
+				       sizeof ( *soa ) ) );
+		ptr[0] = NETEM_DNS_POINTER ( owner );
+		ptr[1] = NETEM_DNS_POINTER ( owner );
+		soa = ( ( void * ) &ptr[2] );
+		memset ( soa, 0, sizeof ( *soa ) );
+		soa->minimum = htonl ( NETEM_DNS_TTL );
+		response->nscount = htons ( 1 );
+	}
+
+	/* Send response */
+	response->flags = htons ( DNS_FLAG_QR | DNS_FLAG_RD | DNS_FLAG_RA |
+				  rcode );
+	netem_udp_tx ( netem, reply, src, DNS_PORT );
+}
+
+/**
+ * Handle UDP datagram received by responder
+ *
+ * @v netem		Emulated link
+ * @v iobuf		I/O buffer
+ * @v src		Source address
+ */
+static void netem_udp_rx ( struct netem *netem, struct io_buffer *iobuf,
+			   struct sockaddr_tcpip *src ) {
+	struct netem_tftp *tftp = &netem->tftp;
+	struct udp_header *udphdr = iobuf->data;
+	struct tftp_common *common;
+	struct sockaddr_tcpip peer;
+	unsigned int local_port;
+
+	/* Sanity check */
+	if ( iob_len ( iobuf ) < ( sizeof ( *udphdr ) + sizeof ( *common ) ) )
+		return;
+	memcpy ( &peer, src, sizeof ( peer ) );
+	peer.st_port = udphdr->src;
+	local_port = ntohs ( udphdr->dest );
+	iob_pull ( iobuf, sizeof ( *udphdr ) );
+	common = iobuf->data;
+
+	/* Handle DNS and TFTP packets */
+	if ( local_port == DNS_PORT ) {
+		netem_dns_rx ( netem, iobuf, &peer );
+	} else if ( ( local_port == TFTP_PORT ) &&
+	     ( common->opcode == htons ( TFTP_RRQ ) ) ) {
+		netem_tftp_rrq ( netem, iobuf, &peer );
+	} else if ( tftp->active && ( local_port == tftp->local_port ) &&
+		    ( peer.st_port == tftp->peer.st_port ) &&
+		    ( common->opcode == htons ( TFTP_ACK ) ) ) {
+		netem_tftp_ack ( netem, iobuf );
+	} else if ( tftp->active && ( local_port == tftp->local_port ) &&
+		    ( common->opcode == htons ( TFTP_ERROR ) ) ) {
+		tftp->active = 0;
+	}
+}
+
+/******************************************************************************
+ *
+ * Responder
+ *
+ ******************************************************************************
+ */
+
+/**
+ * Handle IPv4 packet received by responder
+ *
+ * @v netem		Emulated link
+ * @v iobuf		I/O buffer
+ */
+static void netem_ipv4_rx ( struct netem *netem, struct io_buffer *iobuf ) {
+	struct iphdr *iphdr = iobuf->data;
+	struct sockaddr_in src;
+	size_t hlen;
+	size_t len;
+
+	/* Sanity checks */
+	if ( iob_len ( iobuf ) < sizeof ( *iphdr ) )
+		return;
+	hlen = ( ( iphdr->verhdrlen & IP_MASK_HLEN ) * 4 );
+	len = ntohs ( iphdr->len );
+	if ( ( hlen < sizeof ( *iphdr ) ) || ( len < hlen ) ||
+	     ( len > iob_len ( iobuf ) ) )
+		return;
+	if ( iphdr->dest.s_addr != netem->peer.s_addr )
+		return;
+	if ( iphdr->frags & htons ( IP_MASK_OFFSET | IP_MASK_MOREFRAGS ) )
+		return;
+
+	/* Construct source address */
+	memset ( &src, 0, sizeof ( src ) );
+	src.sin_family = AF_INET;
+	src.sin_addr = iphdr->src;
+
+	/* Strip IPv4 header and any link-layer padding */
+	iob_unput ( iobuf, ( iob_len ( iobuf ) - len ) );
+	iob_pull ( iobuf, hlen );
+
+	/* Hand off to transport layer */
+	switch ( iphdr->protocol ) {
+	case IP_TCP:
+		netem_tcp_rx ( netem, iobuf, ( struct sockaddr_tcpip * ) &src );
+		break;
+	case IP_UDP:
+		netem_udp_rx ( netem, iobuf, ( struct sockaddr_tcpip * ) &src );
+		break;
+	default:
+		break;
+	}
+}
+
+/**
+ * Handle ICMPv6 packet received by responder
+ *
+ * @v netem		Emulated link
+ * @v iobuf		I/O buffer
+ * @v src		Source address
+ */
+static void netem_icmpv6_rx ( struct netem *netem, struct io_buffer *iobuf,
+			      struct sockaddr_in6 *src ) {
+	struct ndp_neighbour_header *sol = iobuf->data;
+	struct ndp_neighbour_header *adv;
+	struct ndp_ll_addr_option *ll_addr;
+	struct io_buffer *reply;
+	size_t len = ( sizeof ( *adv ) + NDP_OPTION_BLKSZ );
+
+	/* Ignore anything other than a solicitation for our address */
+	if ( ( iob_len ( iobuf ) < sizeof ( *sol ) ) ||
+	     ( sol->icmp.type != ICMPV6_NEIGHBOUR_SOLICITATION ) ||
+	     ( memcmp ( &sol->target, &netem->peer6,
+			sizeof ( sol->target ) ) != 0 ) ) {
+		return;
+	}
+
+	/* Construct advertisement */
+	reply = netem_alloc_iob ( len );
+	if ( ! reply )
+		return;
+	adv = iob_put ( reply, len );
+	memset ( adv, 0, len );
+	adv->icmp.type = ICMPV6_NEIGHBOUR_ADVERTISEMENT;
+	adv->flags = ( NDP_NEIGHBOUR_SOLICITED | NDP_NEIGHBOUR_OVERRIDE );
+	memcpy ( &adv->target, &netem->peer6, sizeof ( adv->target ) );
+	ll_addr = &adv->option[0].ll_addr;
+	ll_addr->header.type = NDP_OPT_LL_TARGET;
+	ll_addr->header.blocks = 1;
+	memcpy ( ll_addr->ll_addr, netem->peer_hwaddr, ETH_ALEN );
+	adv->icmp.chksum = tcpip_chksum ( adv, len );
+	netem_ipv6_tx ( netem, reply, &src->sin6_addr, IP_ICMP6,
+			&adv->icmp.chksum );
+}
+
+/**
+ * Handle IPv6 packet received by responder
+ *
+ * @v netem		Emulated link
+ * @v iobuf		I/O buffer
+ */
+static void netem_ipv6_rx ( struct netem *netem, struct io_buffer *iobuf ) {
+	struct ipv6_header *iphdr = iobuf->data;
+	struct in6_addr solicited;
+	struct sockaddr_in6 src;
+	size_t len;
+
+	/* Sanity checks */
+	if ( IN6_IS_ADDR_UNSPECIFIED ( &netem->peer6 ) )
+		return;
+	if ( iob_len ( iobuf ) < sizeof ( *iphdr ) )
+		return;
+	if ( ( iphdr->ver_tc_label & htonl ( IPV6_MASK_VER ) ) !=
+	     htonl ( IPV6_VER ) )
+		return;
+	len = ntohs ( iphdr->len );
+	if ( ( sizeof ( *iphdr ) + len ) > iob_len ( iobuf ) )
+		return;
+	memset ( &solicited, 0, sizeof ( solicited ) );
+	ipv6_solicited_node ( &solicited, &netem->peer6 );
+	if ( ( memcmp ( &iphdr->dest, &netem->peer6,
+			sizeof ( iphdr->dest ) ) != 0 ) &&
+	     ( memcmp ( &iphdr->dest, &solicited,
+			sizeof ( iphdr->dest ) ) != 0 ) )
+		return;
+
+	/* Construct source address */
+	memset ( &src, 0, sizeof ( src ) );
+	src.sin6_family = AF_INET6;
+	memcpy ( &src.sin6_addr, &iphdr->src, sizeof ( src.sin6_addr ) );
+
+	/* Strip IPv6 header and any link-layer padding */
+	iob_unput ( iobuf, ( iob_len ( iobuf ) - sizeof ( *iphdr ) - len ) );
+	iob_pull ( iobuf, sizeof ( *iphdr ) );
+
+	/* Hand off to transport layer */
+	switch ( iphdr->next_header ) {
+	case IP_TCP:
+		netem_tcp_rx ( netem, iobuf, ( struct sockaddr_tcpip * ) &src );
+		break;
+	case IP_UDP:
+		netem_udp_rx ( netem, iobuf, ( struct sockaddr_tcpip * ) &src );
+		break;
+	case IP_ICMP6:
+		netem_icmpv6_rx ( netem, iobuf, &src );
+		break;
+	default:
+		break;
+	}
+}
+
+/**
+ * Handle frame received by responder
+ *
+ * @v netem		Emulated link
+ * @v iobuf		I/O buffer
+ *
+ * The I/O buffer contents may be modified, but the I/O buffer itself
+ * remains owned by the caller.
+ */
+static void netem_peer_rx ( struct netem *netem, struct io_buffer *iobuf ) {
+	struct ethhdr *ethhdr = iobuf->data;
+
+	/* Sanity check */
+	if ( iob_len ( iobuf ) < sizeof ( *ethhdr ) )
+		return;
+	iob_pull ( iobuf, sizeof ( *ethhdr ) );
+
+	/* Hand off to network layer */
+	switch ( ethhdr->h_protocol ) {
+	case htons ( ETH_P_ARP ):
+		netem_arp_rx ( netem, iobuf );
+		break;
+	case htons ( ETH_P_IP ):
+		netem_ipv4_rx ( netem, iobuf );
+		break;
+	case htons ( ETH_P_IPV6 ):
+		netem_ipv6_rx ( netem, iobuf );
+		break;
+	default:
+		break;
+	}
+}
+
+/**
+ * Poll responder
+ *
+ * @v netem		Emulated link
+ */
+static void netem_peer_poll ( struct netem *netem ) {
+	struct netem_tftp *tftp = &netem->tftp;
+	struct netem_tcp *conn;
+	struct io_buffer *iobuf;
+	unsigned int i;
+
+	/* Poll TCP connections */
+	for ( i = 0 ; i < NETEM_TCP_MAX ; i++ ) {
+		conn = &netem->tcp[i];
+		if ( conn->state )
+			netem_tcp_poll ( netem, conn );
+	}
+
+	/* Retransmit TFTP block, if applicable */
+	if ( tftp->active && ( ( currticks() - tftp->sent ) > netem->rto ) )
+		netem_tftp_tx ( netem );
+
+	/* Answer deferred DNS query, if due */
+	iobuf = netem->dns_deferred;
+	if ( iobuf && ( ( signed long ) ( currticks() -
+					  netem->dns_deferred_due ) >= 0 ) ) {
+		netem_dns_rx ( netem, iobuf, &netem->dns_deferred_src );
+		netem->dns_deferred = NULL;
+		free_iob ( iobuf );
+	}
+}
+
+/******************************************************************************
+ *
+ * Network device interface
+ *
+ ******************************************************************************
+ */
+
+/**
+ * Check whether or not emulated link is idle
+ *
+ * @v netem		Emulated link
+ * @ret is_idle		Link is idle
+ */
+static int netem_idle ( struct netem *netem ) {
+	unsigned int i;
+
+	/* Check for frames in transit */
+	if ( ( netem->tx.prod != netem->tx.cons ) ||
+	     ( netem->rx.prod != netem->rx.cons ) )
+		return 0;
+
+	/* Check for deferred DNS queries */
+	if ( netem->dns_deferred )
+		return 0;
+
+	/* Check for open responder connections */
+	for ( i = 0 ; i < NETEM_TCP_MAX ; i++ ) {
+		if ( netem->tcp[i].state )
+			return 0;
+	}
+	return 1;
+}
+
+/**
+ * Open network device
+ *
+ * @v netdev		Network device
+ * @ret rc		Return status code
+ */
+static int netem_open ( struct net_device *netdev __unused ) {
+
+	/* Nothing to do */
+	return 0;
+}
+
+/**
+ * Close network device
+ *
+ * @v netdev		Network device
+ */
+static void netem_close ( struct net_device *netdev ) {
+	struct netem *netem = netdev->priv;
+
+	/* Discard all frames in transit */
+	netem_flush ( &netem->tx );
+	netem_flush ( &netem->rx );
+
+	/* Reset responder */
+	memset ( netem->tcp, 0, sizeof ( netem->tcp ) );
+	memset ( &netem->tftp, 0, sizeof ( netem->tftp ) );
+	free_iob ( netem->dns_deferred );
+	netem->dns_deferred = NULL;
+}
+
+/**
+ * Record statistics for acknowledgement transmitted by network device
+ *
+ * @v netem		Emulated link
+ * @v iobuf		I/O buffer
+ */
+static void netem_tcp_ack_stats ( struct netem *netem,
+				  struct io_buffer *iobuf ) {
+	struct netem_tcp_stats *stats = &netem->tcp_stats;
+	struct ethhdr *ethhdr = iobuf->data;
+	struct iphdr *iphdr = ( iobuf->data + sizeof ( *ethhdr ) );
+	struct tcp_header *tcphdr;
+	struct tcp_option *option;
+	unsigned long delay = ( currticks() - netem->delivered );
+	uint8_t *opts;
+	uint8_t *end;
+	size_t ihlen;
+	size_t hlen;
+	size_t len;
+
+	/* Ignore anything other than a pure TCP acknowledgement */
+	if ( ( iob_len ( iobuf ) < ( sizeof ( *ethhdr ) + sizeof ( *iphdr ) ) ) ||
+	     ( ethhdr->h_protocol != htons ( ETH_P_IP ) ) ||
+	     ( iphdr->protocol != IP_TCP ) )
+		return;
+	ihlen = ( ( iphdr->verhdrlen & IP_MASK_HLEN ) * 4 );
+	len = ntohs ( iphdr->len );
+	if ( ( ihlen < sizeof ( *iphdr ) ) ||
+	     ( len < ( ihlen + sizeof ( *tcphdr ) ) ) ||
+	     ( ( sizeof ( *ethhdr ) + len ) > iob_len ( iobuf ) ) )
+		return;
+	tcphdr = ( ( ( void * ) iphdr ) + ihlen );
+	hlen = ( ( tcphdr->hlen & 0xf0 ) >> 2 );
+	if ( ( hlen < sizeof ( *tcphdr ) ) || ( ( ihlen + hlen ) != len ) ||
+	     ( ( tcphdr->flags & ( TCP_SYN | TCP_FIN | TCP_RST | TCP_ACK ) )
+	       != TCP_ACK ) )
+		return;
+
+	/* Record acknowledgement */
+	stats->acks++;
+	if ( stats->ack_delay < delay )
+		stats->ack_delay = delay;
+
+	/* Record selective acknowledgement, if present */
+	opts = ( ( ( void * ) tcphdr ) + sizeof ( *tcphdr ) );
+	end = ( ( ( void * ) tcphdr ) + hlen );
+	while ( opts < end ) {
+		option = ( ( void * ) opts );
+		if ( option->kind == TCP_OPTION_END )
+			break;
+		if ( option->kind == TCP_OPTION_NOP ) {
+			opts++;
+			continue;
+		}
+		if ( ( ( opts + 2 ) > end ) || ( option->length < 2 ) )
+			break;
+		if ( option->kind == TCP_OPTION_SACK ) {
+			stats->sacks++;
+			break;
+		}
+		opts += option->length;
+	}
+}
+
+/**
+ * Record statistics for DNS response delivered to network device
+ *
+ * @v netem		Emulated link
+ * @v iobuf		I/O buffer
+ */
+static void netem_dns_stats ( struct netem *netem, struct io_buffer *iobuf ) {
+	struct ethhdr *ethhdr = iobuf->data;
+	struct iphdr *iphdr = ( iobuf->data + sizeof ( *ethhdr ) );
+	struct ipv6_header *ip6hdr = ( iobuf->data + sizeof ( *ethhdr ) );
+	struct udp_header *udphdr;
+	size_t len = iob_len ( iobuf );
+	size_t hlen;
+
+	/* Ignore anything other than a UDP packet from the DNS port */
+	if ( ( len >= ( sizeof ( *ethhdr ) + sizeof ( *iphdr ) ) ) &&
+	     ( ethhdr->h_protocol == htons ( ETH_P_IP ) ) &&
+	     ( iphdr->protocol == IP_UDP ) ) {
+		hlen = ( ( iphdr->verhdrlen & IP_MASK_HLEN ) * 4 );
+	} else if ( ( len >= ( sizeof ( *ethhdr ) + sizeof ( *ip6hdr ) ) ) &&
+		    ( ethhdr->h_protocol == htons ( ETH_P_IPV6 ) ) &&
+		    ( ip6hdr->next_header == IP_UDP ) ) {
+		hlen = sizeof ( *ip6hdr );
+	} else {
+		return;
+	}
+	if ( ( sizeof ( *ethhdr ) + hlen + sizeof ( *udphdr ) ) > len )
+		return;
+	udphdr = ( iobuf->data + sizeof ( *ethhdr ) + hlen );
+	if ( udphdr->src != htons ( DNS_PORT ) )
+		return;
+
+	/* Record response */
+	netem->dns_responses++;
+}
+
+/**
+ * Transmit packet
+ *
+ * @v netdev		Network device
+ * @v iobuf		I/O buffer
+ * @ret rc		Return status code
+ */
+static int netem_transmit ( struct net_device *netdev,
+			    struct io_buffer *iobuf ) {
+	struct netem *netem = netdev->priv;
+	struct ethhdr ethhdr;
+	struct io_buffer *segment;
+	struct io_buffer *tmp;
+	LIST_HEAD ( segments );
+	int rc;
+
+	/* Record activity */
+	netem->active = currticks();
+	netem_tcp_ack_stats ( netem, iobuf );
+
+	/* Place frame on link.  Transmission will be completed once
+	 * the frame has been delivered to (or lost before reaching)
+	 * the responder.
+	 */
+	if ( ! iobuf->mss ) {
+		netem_enqueue ( netem, &netem->tx, iobuf, 1 );
+		return 0;
+	}
+
+	/* Split packet requiring segmentation, as would be done by
+	 * the hardware, and place each segment on the link.  Exclude
+	 * the time taken from other profiling results, since real
+	 * hardware would not consume CPU time for segmentation.
+	 */
+	profile_start ( &netem_segment_profiler );
+	memcpy ( &ethhdr, iobuf->data, sizeof ( ethhdr ) );
+	assert ( ethhdr.h_protocol == htons ( ETH_P_IP ) );
+	iob_pull ( iobuf, sizeof ( ethhdr ) );
+	rc = net_segment ( iobuf, &ipv4_protocol, &segments );
+	iob_push ( iobuf, sizeof ( ethhdr ) );
+	list_for_each_entry ( segment, &segments, list ) {
+		memcpy ( iob_push ( segment, sizeof ( ethhdr ) ), &ethhdr,
+			 sizeof ( ethhdr ) );
+	}
+	profile_stop ( &netem_segment_profiler );
+	profile_exclude ( &netem_segment_profiler );
+	if ( rc != 0 )
+		return rc;
+	list_for_each_entry_safe ( segment, tmp, &segments, list ) {
+		list_del ( &segment->list );
+		netem_enqueue ( netem, &netem->tx, segment, 0 );
+	}
+	netdev_tx_complete ( netdev, iobuf );
+	return 0;
+}
+
+/**
+ * Poll for completed and received packets
+ *
+ * @v netdev		Network device
+ */
+static void netem_poll ( struct net_device *netdev ) {
+	struct netem *netem = netdev->priv;
+	struct io_buffer *iobuf;
+	int owned;
+
+	/* Deliver frames to responder */
+	while ( ( iobuf = netem_dequeue ( &netem->tx, &owned ) ) ) {
+		netem_peer_rx ( netem, iobuf );
+		netem_discard ( netem, iobuf, owned );
+	}
+
+	/* Allow responder to transmit */
+	netem_peer_poll ( netem );
+
+	/* Deliver frames to network device */
+	while ( ( iobuf = netem_dequeue ( &netem->rx, &owned ) ) ) {
+		if ( netem->config.rx_csum )
+			iobuf->flags |= IOB_CSUM_VERIFIED;
+		netem->delivered = currticks();
+		netem_dns_stats ( netem, iobuf );
+		netdev_rx ( netdev, iobuf );
+	}
+}
+
+/** Emulated link network device operations */
+static struct net_device_operations netem_operations = {
+	.open		= netem_open,
+	.close		= netem_close,
+	.transmit	= netem_transmit,
+	.poll		= netem_poll,
+};
+
+/**
+ * Create emulated link
+ *
+ * @v config		Link characteristics
+ * @v address		Network device IPv4 address
+ * @v netmask		Network device IPv4 subnet mask
+ * @v peer		Responder IPv4 address
+ * @ret netem		Emulated link
+ * @ret rc		Return status code
+ */
+int netem_create ( const struct netem_config *config,
+		   struct in_addr address, struct in_addr netmask,
+		   struct in_addr peer, struct netem **netem ) {
+	struct net_device *netdev;
+	struct settings *settings;
+	struct netem *link;
+	unsigned int i;
+	int rc;
+
+	/* Initialise generated response data */
+	for ( i = 0 ; i < sizeof ( netem_pattern ) ; i++ ) {
+		netem_pattern[i] = ( ( i % NETEM_PATTERN_PERIOD ) ^ 0x5a );
+	}
+
+	/* Allocate and initialise device */
+	netdev = alloc_etherdev ( sizeof ( *link ) );
+	if ( ! netdev ) {
+		rc = -ENOMEM;
+		goto err_alloc;
+	}
+	netdev_init ( netdev, &netem_operations );
+	link = netdev->priv;
+	link->netdev = netdev;
+	link->dev.desc.bus_type = BUS_TYPE_TAP;
+	snprintf ( link->dev.name, sizeof ( link->dev.name ), "netem" );
+	link->dev.driver_name = "netem";
+	INIT_LIST_HEAD ( &link->dev.siblings );
+	INIT_LIST_HEAD ( &link->dev.children );
+	netdev->dev = &link->dev;
+	memcpy ( netdev->hw_addr, netem_hwaddr, ETH_ALEN );
+	memcpy ( &link->config, config, sizeof ( link->config ) );
+	link->random = config->seed;
+	memcpy ( link->peer_hwaddr, netem_peer_hwaddr, ETH_ALEN );
+	link->peer = peer;
+	link->rto = ( ( TICKS_PER_SEC / 5 ) +
+		      ( 2 * ( config->latency + config->jitter ) ) );
+	if ( config->mtu ) {
+		assert ( config->mtu <= NETEM_MAX_MTU );
+		netdev->max_pkt_len = ( ETH_HLEN + config->mtu );
+		netdev->mtu = config->mtu;
+	}
+	if ( config->rx_csum )
+		netdev->state |= NETDEV_RX_CSUM;
+	if ( config->tso )
+		netdev->state |= NETDEV_TX_TSO;
+
+	/* Register network device */
+	if ( ( rc = register_netdev ( netdev ) ) != 0 )
+		goto err_register;
+
+	/* Configure IPv4 address and DNS server */
+	settings = netdev_settings ( netdev );
+	if ( ( rc = store_setting ( settings, &ip_setting, &address,
+				    sizeof ( address ) ) ) != 0 )
+		goto err_settings;
+	if ( ( rc = store_setting ( settings, &netmask_setting, &netmask,
+				    sizeof ( netmask ) ) ) != 0 )
+		goto err_settings;
+	if ( ( rc = store_setting ( settings, &dns_setting, &peer,
+				    sizeof ( peer ) ) ) != 0 )
+		goto err_settings;
+
+	/* Open network device */
+	if ( ( rc = netdev_open ( netdev ) ) != 0 )
+		goto err_open;
+
+	*netem = link;
+	return 0;
+
+	netdev_close ( netdev );
+ err_open:
+ err_settings:
+	unregister_netdev ( netdev );
+ err_register:
+	netdev_nullify ( netdev );
+	netdev_put ( netdev );
+ err_alloc:
+	return rc;
+}
+
+/**
+ * Enable IPv6 on emulated link
+ *
+ * @v netem		Emulated link
+ * @v address		Network device IPv6 address
+ * @v prefix_len	Network device IPv6 prefix length
+ * @v peer		Responder IPv6 address (also used as DNS server)
+ * @ret rc		Return status code
+ *
+ * The responder will answer AAAA queries with its IPv6 address, in
+ * addition to answering A queries with its IPv4 address.
+ */
+int netem_ipv6 ( struct netem *netem, struct in6_addr *address,
+		 unsigned int prefix_len, struct in6_addr *peer ) {
+	struct settings *settings = netdev_settings ( netem->netdev );
+	uint8_t len6 = prefix_len;
+	int rc;
+
+	/* Configure IPv6 address and DNS server */
+	memcpy ( &netem->peer6, peer, sizeof ( netem->peer6 ) );
+	if ( ( rc = store_setting ( settings, &ip6_setting, address,
+				    sizeof ( *address ) ) ) != 0 )
+		return rc;
+	if ( ( rc = store_setting ( settings, &len6_setting, &len6,
+				    sizeof ( len6 ) ) ) != 0 )
+		return rc;
+	if ( ( rc = store_setting ( settings, &dns6_setting, peer,
+				    sizeof ( *peer ) ) ) != 0 )
+		return rc;
+
+	return 0;
+}
+
+/**
+ * Destroy emulated link
+ *
+ * @v netem		Emulated link
+ */
+void netem_destroy ( struct netem *netem ) {
+	struct net_device *netdev = netem->netdev;
+	unsigned long start = currticks();
+
+	/* Allow connections to close, so that no client connections
+	 * are left attempting to retransmit via a nonexistent device.
+	 * A lossy link may lose the final acknowledgement, so wait
+	 * for the client to become quiet before relying on the
+	 * responder's view of the connection state.
+	 */
+	while ( ( currticks() - start ) < NETEM_DRAIN_TIMEOUT ) {
+		if ( netem_idle ( netem ) &&
+		     ( ( ! netem->config.loss ) ||
+		       ( ( currticks() - netem->active ) >
+			 ( 2 * netem->rto ) ) ) ) {
+			break;
+		}
+		step();
+	}
+
+	unregister_netdev ( netdev );
+	netdev_nullify ( netdev );
+	netdev_put ( netdev );
+}
+
+/******************************************************************************
+ *
+ * Data transfer clients
+ *
+ ******************************************************************************
+ */
+
+/** A data transfer client */
+struct netem_fetch {
+	/** Reference count */
+	struct refcnt refcnt;
+	/** Data transfer interface */
+	struct interface xfer;
+	/** Current position */
+	size_t pos;
+	/** Total length received */
+	size_t len;
+	/** Data has been corrupted */
+	int corrupt;
+	/** Transfer is complete */
+	int done;
+	/** Completion status */
+	int rc;
+	/** Statistics */
+	struct netem_fetch_stats stats;
+};
+
+/**
+ * Receive data
+ *
+ * @v fetch		Data transfer client
+ * @v iobuf		I/O buffer
+ * @v meta		Data transfer metadata
+ * @ret rc		Return status code
+ */
+static int netem_fetch_deliver ( struct netem_fetch *fetch,
+				 struct io_buffer *iobuf,
+				 struct xfer_metadata *meta ) {
+	size_t len = iob_len ( iobuf );
+	size_t offset = 0;
+	size_t frag_len;
+
+	/* Update statistics */
+	fetch->stats.count++;
+	if ( fetch->stats.max_len < len )
+		fetch->stats.max_len = len;
+
+	/* Calculate position */
+	if ( meta->flags & XFER_FL_ABS_OFFSET )
+		fetch->pos = 0;
+	fetch->pos += meta->offset;
+
+	/* Verify data */
+	while ( offset < len ) {
+		frag_len = ( len - offset );
+		if ( frag_len > ETH_FRAME_LEN )
+			frag_len = ETH_FRAME_LEN;
+		if ( memcmp ( ( iobuf->data + offset ),
+			      netem_pattern_data ( fetch->pos + offset ),
+			      frag_len ) != 0 ) {
+			fetch->corrupt = 1;
+		}
+		offset += frag_len;
+	}
+
+	/* Update position */
+	fetch->pos += len;
+	if ( fetch->len < fetch->pos )
+		fetch->len = fetch->pos;
+
+	free_iob ( iobuf );
+	return 0;
+}
+
+/**
+ * Close data transfer client
+ *
+ * @v fetch		Data transfer client
+ * @v rc		Reason for close
+ */
+static void netem_fetch_close ( struct netem_fetch *fetch, int rc ) {
+
+	intf_shutdown ( &fetch->xfer, rc );
+	fetch->rc = rc;
+	fetch->done = 1;
+}
+
+/** Data transfer client interface operations */
+static struct interface_operation netem_fetch_xfer_operations[] = {
+	INTF_OP ( xfer_deliver, struct netem_fetch *, netem_fetch_deliver ),
+	INTF_OP ( intf_close, struct netem_fetch *, netem_fetch_close ),
+};
+
+/** Data transfer client interface descriptor */
+static struct interface_descriptor netem_fetch_xfer_desc =
+	INTF_DESC ( struct netem_fetch, xfer, netem_fetch_xfer_operations );
+
+/**
+ * Fetch generated data from a URI
+ *
+ * @v uri		URI string
+ * @ret len		Length of data received
+ * @ret stats		Data transfer client statistics (or NULL)
+ * @ret rc		Return status code
+ *
+ * The received data is checked against the data generated by the
+ * responder.
+ */
+int netem_fetch ( const char *uri, size_t *len,
+		  struct netem_fetch_stats *stats ) {
+	struct netem_fetch fetch;
+	unsigned long start;
+	int rc;
+
+	/* Initialise client */
+	memset ( &fetch, 0, sizeof ( fetch ) );
+	ref_init ( &fetch.refcnt, NULL );
+	intf_init ( &fetch.xfer, &netem_fetch_xfer_desc, &fetch.refcnt );
+
+	/* Open URI */
+	if ( ( rc = xfer_open_uri_string ( &fetch.xfer, uri ) ) != 0 )
+		return rc;
+
+	/* Wait for transfer to complete */
+	start = currticks();
+	while ( ! fetch.done ) {
+		if ( ( currticks() - start ) > NETEM_FETCH_TIMEOUT ) {
+			netem_fetch_close ( &fetch, -ETIMEDOUT );
+			break;
+		}
+		step();
+	}
+
+	/* Check data */
+	*len = fetch.len;
+	if ( stats )
+		memcpy ( stats, &fetch.stats, sizeof ( *stats ) );
+	if ( fetch.rc != 0 )
+		return fetch.rc;
+	if ( fetch.corrupt )
+		return -EIO;
+	return 0;
+}
+
+/** A data upload client */
+struct netem_upload {
+	/** Reference count */
+	struct refcnt refcnt;
+	/** Data transfer interface */
+	struct interface xfer;
+	/** Request header */
+	char header[NETEM_HEADER_MAX];
+	/** Length of request header */
+	size_t header_len;
+	/** Total length of request (including header) */
+	size_t len;
+	/** Length of request sent */
+	size_t sent;
+	/** Start of response */
+	char response[16];
+	/** Length of response received */
+	size_t response_len;
+	/** Peer socket address (if redirected to a socket) */
+	struct sockaddr peer;
+	/** Transfer is complete */
+	int done;
+	/** Completion status */
+	int rc;
+};
+
+/**
+ * Send as much request data as the transfer window allows
+ *
+ * @v upload		Data upload client
+ */
+static void netem_upload_window_changed ( struct netem_upload *upload ) {
+	struct io_buffer *iobuf;
+	size_t offset;
+	size_t len;
+	size_t frag_len;
+	void *data;
+	int rc;
+
+	while ( ( upload->sent < upload->len ) &&
+		( ( len = xfer_window ( &upload->xfer ) ) != 0 ) ) {
+
+		/* Allocate I/O buffer */
+		if ( len > NETEM_UPLOAD_CHUNK )
+			len = NETEM_UPLOAD_CHUNK;
+		if ( len > ( upload->len - upload->sent ) )
+			len = ( upload->len - upload->sent );
+		iobuf = xfer_alloc_iob ( &upload->xfer, len );
+		if ( ! iobuf ) {
+			rc = -ENOMEM;
+			goto err;
+		}
+
+		/* Construct request header and body */
+		offset = upload->sent;
+		while ( len ) {
+			if ( offset < upload->header_len ) {
+				frag_len = ( upload->header_len - offset );
+				data = &upload->header[offset];
+			} else {
+				frag_len = ETH_FRAME_LEN;
+				data = ( ( void * ) netem_pattern_data (
+					   offset - upload->header_len ) );
+			}
+			if ( frag_len > len )
+				frag_len = len;
+			memcpy ( iob_put ( iobuf, frag_len ), data, frag_len );
+			offset += frag_len;
+			len -= frag_len;
+		}
+		upload->sent = offset;
+
+		/* Send data */
+		if ( ( rc = xfer_deliver_iob ( &upload->xfer, iobuf ) ) != 0 )
+			goto err;
+	}
+	return;
+
+ err:
+	intf_shutdown ( &upload->xfer, rc );
+	upload->rc = rc;
+	upload->done = 1;
+}
+
+/**
+ * Receive response
+ *
+ * @v upload		Data upload client
+ * @v iobuf		I/O buffer
+ * @v meta		Data transfer metadata
+ * @ret rc		Return status code
+ */
+static int netem_upload_deliver ( struct netem_upload *upload,
+				  struct io_buffer *iobuf,
+				  struct xfer_metadata *meta __unused ) {
+	size_t len;
+
+	/* Record start of response */
+	len = ( sizeof ( upload->response ) - 1 /* NUL */ -
+		upload->response_len );
+	if ( len > iob_len ( iobuf ) )
+		len = iob_len ( iobuf );
+	memcpy ( &upload->response[upload->response_len], iobuf->data, len );
+	upload->response_len += len;
+
+	free_iob ( iobuf );
+	return 0;
+}
+
+/**
+ * Close data upload client
+ *
+ * @v upload		Data upload client
+ * @v rc		Reason for close
+ */
+static void netem_upload_close ( struct netem_upload *upload, int rc ) {
+
+	intf_shutdown ( &upload->xfer, rc );
+	upload->rc = rc;
+	upload->done = 1;
+}
+
+/**
+ * Handle redirection
+ *
+ * @v upload		Data upload client
+ * @v type		New location type
+ * @v args		Remaining arguments depend upon location type
+ * @ret rc		Return status code
+ *
+ * Redirections are intercepted (in the same way as by an iSCSI
+ * session) in order to record the peer socket address.
+ */
+static int netem_upload_vredirect ( struct netem_upload *upload, int type,
+				    va_list args ) {
+	struct sockaddr *peer;
+	va_list tmp;
+	int rc;
+
+	/* Record peer socket address */
+	if ( ( type == LOCATION_SOCKET ) || ( type == LOCATION_CONNECTED ) ) {
+		va_copy ( tmp, args );
+		( void ) va_arg ( tmp, int ); /* Discard "semantics" */
+		peer = va_arg ( tmp, struct sockaddr * );
+		memcpy ( &upload->peer, peer, sizeof ( upload->peer ) );
+		va_end ( tmp );
+	}
+
+	/* Redirect to new location */
+	if ( ( rc = xfer_vreopen ( &upload->xfer, type, args ) ) != 0 ) {
+		netem_upload_close ( upload, rc );
+		return rc;
+	}
+
+	return 0;
+}
+
+/** Data upload client interface operations */
+static struct interface_operation netem_upload_xfer_operations[] = {
+	INTF_OP ( xfer_deliver, struct netem_upload *, netem_upload_deliver ),
+	INTF_OP ( xfer_window_changed, struct netem_upload *,
+		  netem_upload_window_changed ),
+	INTF_OP ( intf_close, struct netem_upload *, netem_upload_close ),
+	INTF_OP ( xfer_vredirect, struct netem_upload *,
+		  netem_upload_vredirect ),
+};
+
+/** Data upload client interface descriptor */
+static struct interface_descriptor netem_upload_xfer_desc =
+	INTF_DESC ( struct netem_upload, xfer, netem_upload_xfer_operations );
+
+/**
+ * Upload generated data to the responder
+ *
+ * @v uri		URI string (for a TCP connection to the responder)
+ * @v len		Length of data to upload
+ * @v peer		Peer socket address to fill in, or NULL
+ * @ret rc		Return status code
+ *
+ * The generated data is sent as the body of an HTTP POST request,
+ * and the responder checks the received data.  The peer socket
+ * address is recorded only if the connection was opened via a
+ * redirection to a socket (e.g. when opening a named socket), and
+ * will otherwise have an unspecified address family.
+ */
+int netem_upload ( const char *uri, size_t len, struct sockaddr *peer ) {
+	struct netem_upload upload;
+	unsigned long start;
+	int rc;
+
+	/* Initialise client */
+	memset ( &upload, 0, sizeof ( upload ) );
+	ref_init ( &upload.refcnt, NULL );
+	intf_init ( &upload.xfer, &netem_upload_xfer_desc, &upload.refcnt );
+	upload.header_len = snprintf ( upload.header, sizeof ( upload.header ),
+				       "POST / HTTP/1.1\r\n"
+				       "Content-Length: %zd\r\n\r\n", len );
+	upload.len = ( upload.header_len + len );
+
+	/* Open URI */
+	if ( ( rc = xfer_open_uri_string ( &upload.xfer, uri ) ) != 0 )
+		return rc;
+
+	/* Wait for transfer to complete */
+	start = currticks();
+	while ( ! upload.done ) {
+		if ( ( currticks() - start ) > NETEM_FETCH_TIMEOUT ) {
+			netem_upload_close ( &upload, -ETIMEDOUT );
+			break;
+		}
+		step();
+	}
+
+	/* Record peer socket address, if applicable */
+	if ( peer )
+		memcpy ( peer, &upload.peer, sizeof ( *peer ) );
+
+	/* Check response */
+	if ( upload.rc != 0 )
+		return upload.rc;
+	if ( upload.sent != upload.len )
+		return -EPIPE;
+	if ( strncmp ( upload.response, "HTTP/1.1 200 ", 13 ) != 0 )
+		return -EIO;
+	return 0;
+}
+
+/** A name resolution client */
+struct netem_resolve {
+	/** Reference count */
+	struct refcnt refcnt;
+	/** Name resolution interface */
+	struct interface resolv;
+	/** Resolved socket address */
+	struct sockaddr *sa;
+	/** Resolution is complete */
+	int done;
+	/** Completion status */
+	int rc;
+};
+
+/**
+ * Handle resolved name
+ *
+ * @v resolve		Name resolution client
+ * @v sa		Completed socket address
+ */
+static void netem_resolve_done ( struct netem_resolve *resolve,
+				 struct sockaddr *sa ) {
+
+	memcpy ( resolve->sa, sa, sizeof ( *resolve->sa ) );
+}
+
+/**
+ * Close name resolution client
+ *
+ * @v resolve		Name resolution client
+ * @v rc		Reason for close
+ */
+static void netem_resolve_close ( struct netem_resolve *resolve, int rc ) {
+
+	intf_shutdown ( &resolve->resolv, rc );
+	resolve->rc = rc;
+	resolve->done = 1;
+}
+
+/** Name resolution client interface operations */
+static struct interface_operation netem_resolve_operations[] = {
+	INTF_OP ( resolv_done, struct netem_resolve *, netem_resolve_done ),
+	INTF_OP ( intf_close, struct netem_resolve *, netem_resolve_close ),
+};
+
+/** Name resolution client interface descriptor */
+static struct interface_descriptor netem_resolve_desc =
+	INTF_DESC ( struct netem_resolve, resolv, netem_resolve_operations );
+
+/**
+ * Resolve name
+ *
+ * @v name		Name to resolve
+ * @v sa		Socket address to fill in
+ * @ret rc		Return status code
+ */
+int netem_resolve ( const char *name, struct sockaddr *sa ) {
+	struct netem_resolve resolve;
+	unsigned long start;
+	int rc;
+
+	/* Initialise client */
+	memset ( &resolve, 0, sizeof ( resolve ) );
+	ref_init ( &resolve.refcnt, NULL );
+	intf_init ( &resolve.resolv, &netem_resolve_desc, &resolve.refcnt );
+	resolve.sa = sa;
+
+	/* Start name resolution */
+	memset ( sa, 0, sizeof ( *sa ) );
+	if ( ( rc = resolv ( &resolve.resolv, name, sa ) ) != 0 )
+		return rc;
+
+	/* Wait for resolution to complete */
+	start = currticks();
+	while ( ! resolve.done ) {
+		if ( ( currticks() - start ) > NETEM_FETCH_TIMEOUT ) {
+			netem_resolve_close ( &resolve, -ETIMEDOUT );
+			break;
+		}
+		step();
+	}
+
+	return resolve.rc;
+}
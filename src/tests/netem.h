@@ -0,0 +1,356 @@
+#ifndef _NETEM_H
+#define _NETEM_H
+
+/** @file
+ *
+ * Emulated network link
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdint.h>
+#include <ipxe/in.h>
+#include <ipxe/tcpip.h>
+#include <ipxe/device.h>
+#include <ipxe/netdevice.h>
+#include <ipxe/if_ether.h>
+#include <ipxe/timer.h>
+#include <ipxe/tcp.h>
+
+/** Maximum number of frames held in each direction of an emulated link */
+#define NETEM_LIMIT 1024
+
+/** Maximum number of concurrent TCP connections at the responder */
+#define NETEM_TCP_MAX 4
+
+/** Maximum emulated link MTU */
+#define NETEM_MAX_MTU 9000
+
+/** Responder TCP window scale (applied to a window of 0xffff) */
+#define NETEM_WSCALE 4
+
+/** Maximum amount of unacknowledged data sent by the responder */
+#define NETEM_TCP_MAX_INFLIGHT ( 512 * 1024 )
+
+/** Maximum number of segments in a burst scrambled by the responder */
+#define NETEM_SCRAMBLE_MAX 64
+
+/** Maximum length of a request received by the responder */
+#define NETEM_REQUEST_MAX 512
+
+/** Maximum length of a response header sent by the responder */
+#define NETEM_HEADER_MAX 128
+
+/** Time to live of records sent by the responder (in seconds) */
+#define NETEM_DNS_TTL 2
+
+/** Period of generated response data */
+#define NETEM_PATTERN_PERIOD 251
+
+/** Emulated link characteristics
+ *
+ * The same characteristics apply to each direction of the link.
+ * Probabilities are expressed in parts per million.
+ */
+struct netem_config {
+	/** Bandwidth (in bytes per second), or zero for unlimited */
+	unsigned long bandwidth;
+	/** One-way latency (in timer ticks) */
+	unsigned long latency;
+	/** Maximum additional random latency (in timer ticks) */
+	unsigned long jitter;
+	/** Probability of a frame being lost */
+	unsigned int loss;
+	/** Probability of a frame being delivered before its predecessor */
+	unsigned int reorder;
+	/** Probability of a frame being duplicated */
+	unsigned int duplicate;
+	/** Maximum number of frames queued (zero for NETEM_LIMIT) */
+	unsigned int limit;
+	/** Link MTU (zero for the standard Ethernet MTU) */
+	size_t mtu;
+	/** Largest datagram that can traverse the link (zero for no limit)
+	 *
+	 * Larger datagrams are silently discarded, as by a router
+	 * that does not report fragmentation errors.
+	 */
+	size_t path_mtu;
+	/** Emulate receive checksum offload
+	 *
+	 * Responder TCP checksums are omitted, and delivered frames
+	 * are marked as having had their checksums verified.
+	 */
+	int rx_csum;
+	/** Emulate TCP segmentation offload
+	 *
+	 * Packets requiring segmentation are split into individual
+	 * segments as they are placed on the link.
+	 */
+	int tso;
+	/** Responder supports TCP timestamps (RFC 7323) */
+	int ts;
+	/** Responder transmits each burst as overlapping segments in
+	 * a random order
+	 */
+	int scramble;
+	/** Responder silently discards TCP segments received over IPv6
+	 *
+	 * This emulates a broken IPv6 path, such as a firewall that
+	 * drops IPv6 connection requests.
+	 */
+	int blackhole6;
+	/** Additional delay before answering AAAA queries (in ticks) */
+	unsigned long aaaa_delay;
+	/** Amount of response data after which to emulate memory
+	 * pressure (zero for never)
+	 *
+	 * All cache discarders are invoked once the responder has
+	 * received an acknowledgement for this much response data.
+	 */
+	size_t pressure;
+	/** Pseudo-random number generator seed */
+	unsigned long seed;
+};
+
+/** A frame in transit */
+struct netem_slot {
+	/** I/O buffer */
+	struct io_buffer *iobuf;
+	/** Delivery time */
+	unsigned long due;
+	/** I/O buffer is on the network device's transmit queue */
+	int owned;
+};
+
+/** Emulated link statistics (for one direction) */
+struct netem_stats {
+	/** Number of frames delivered */
+	unsigned int delivered;
+	/** Number of frames lost */
+	unsigned int lost;
+	/** Number of frames dropped due to a full queue */
+	unsigned int overflows;
+	/** Number of frames dropped due to exceeding the path MTU */
+	unsigned int oversized;
+	/** Number of frames fragmented due to exceeding the path MTU */
+	unsigned int fragmented;
+	/** Number of frames reordered */
+	unsigned int reordered;
+	/** Number of frames duplicated */
+	unsigned int duplicated;
+};
+
+/** Emulated link TCP statistics */
+struct netem_tcp_stats {
+	/** Number of data segments transmitted by responder */
+	unsigned int data;
+	/** Number of pure acknowledgements transmitted by network device */
+	unsigned int acks;
+	/** Number of pure acknowledgements including selective
+	 * acknowledgements
+	 */
+	unsigned int sacks;
+	/** Longest delay before a pure acknowledgement (in ticks)
+	 *
+	 * Delays are measured from the most recent delivery of a
+	 * frame to the network device.
+	 */
+	unsigned long ack_delay;
+	/** Number of connection requests received over IPv4 */
+	unsigned int syns;
+	/** Number of connection requests received over IPv6 */
+	unsigned int syns6;
+};
+
+/** Data transfer client statistics */
+struct netem_fetch_stats {
+	/** Number of deliveries of received data */
+	unsigned int count;
+	/** Length of longest delivery */
+	size_t max_len;
+};
+
+/** One direction of an emulated link */
+struct netem_queue {
+	/** Frames in transit */
+	struct netem_slot slots[NETEM_LIMIT];
+	/** Producer index */
+	unsigned int prod;
+	/** Consumer index */
+	unsigned int cons;
+	/** Time at which link becomes idle (in 1/65536 timer ticks) */
+	unsigned long long busy;
+	/** Statistics */
+	struct netem_stats stats;
+};
+
+/** Responder TCP connection state */
+enum netem_tcp_state {
+	/** Connection slot is unused */
+	NETEM_TCP_CLOSED = 0,
+	/** SYN received and SYN-ACK sent */
+	NETEM_TCP_SYN_RCVD,
+	/** Connection established */
+	NETEM_TCP_ESTABLISHED,
+};
+
+/** A responder TCP connection */
+struct netem_tcp {
+	/** State */
+	enum netem_tcp_state state;
+	/** Client address */
+	struct sockaddr_tcpip peer;
+	/** Client port */
+	uint16_t port;
+	/** Responder port */
+	uint16_t local_port;
+	/** Initial send sequence number */
+	uint32_t iss;
+	/** Initial receive sequence number */
+	uint32_t irs;
+	/** Next expected receive sequence number */
+	uint32_t rcv_nxt;
+	/** Receive window scale */
+	unsigned int rcv_wscale;
+	/** Client permits selective acknowledgements */
+	int sack_permitted;
+	/** Timestamps are enabled */
+	int ts;
+	/** Most recent timestamp received from client */
+	uint32_t ts_recent;
+	/** Out-of-order data received (most recent first) */
+	struct tcp_sack_block sack[TCP_SACK_MAX];
+	/** Oldest unacknowledged stream offset */
+	size_t una;
+	/** Next stream offset to send */
+	size_t nxt;
+	/** Client receive window */
+	size_t win;
+	/** Client window scale */
+	unsigned int wscale;
+	/** Maximum segment size */
+	size_t mss;
+	/** Number of duplicate acknowledgements received */
+	unsigned int dupacks;
+	/** Time of last forward progress */
+	unsigned long progress;
+	/** Client has closed its side of the connection */
+	int fin_rcvd;
+	/** Request */
+	char request[NETEM_REQUEST_MAX];
+	/** Length of request received */
+	size_t request_len;
+	/** Request header has been received */
+	int body;
+	/** Sequence number of start of request body */
+	uint32_t body_seq;
+	/** Length of request body */
+	size_t body_len;
+	/** Request body has been corrupted */
+	int corrupt;
+	/** Response has been constructed */
+	int responding;
+	/** Response header */
+	char header[NETEM_HEADER_MAX];
+	/** Length of response header */
+	size_t header_len;
+	/** Length of response (including header) */
+	size_t len;
+};
+
+/** A responder TFTP transfer */
+struct netem_tftp {
+	/** Transfer is active */
+	int active;
+	/** Client address and port */
+	struct sockaddr_tcpip peer;
+	/** Responder port */
+	uint16_t local_port;
+	/** File length */
+	size_t len;
+	/** Block size */
+	size_t blksize;
+	/** Most recently sent block (zero for OACK) */
+	unsigned int block;
+	/** Time at which most recent block was sent */
+	unsigned long sent;
+};
+
+/** An emulated link */
+struct netem {
+	/** Network device */
+	struct net_device *netdev;
+	/** Dummy physical device */
+	struct device dev;
+	/** Link characteristics */
+	struct netem_config config;
+	/** Pseudo-random number generator state */
+	unsigned long random;
+	/** Frames travelling from the network device to the responder */
+	struct netem_queue tx;
+	/** Frames travelling from the responder to the network device */
+	struct netem_queue rx;
+	/** Responder MAC address */
+	uint8_t peer_hwaddr[ETH_ALEN];
+	/** Responder IPv4 address */
+	struct in_addr peer;
+	/** Responder IPv6 address (or all zeroes if IPv6 is disabled) */
+	struct in6_addr peer6;
+	/** Next IPv4 identifier */
+	uint16_t ident;
+	/** Responder retransmission timeout (in timer ticks) */
+	unsigned long rto;
+	/** Time of most recent transmission by the network device */
+	unsigned long active;
+	/** Time of most recent delivery to the network device */
+	unsigned long delivered;
+	/** TCP statistics */
+	struct netem_tcp_stats tcp_stats;
+	/** TCP connections */
+	struct netem_tcp tcp[NETEM_TCP_MAX];
+	/** TFTP transfer */
+	struct netem_tftp tftp;
+	/** Number of DNS queries received */
+	unsigned int dns_queries;
+	/** Number of DNS responses delivered to network device */
+	unsigned int dns_responses;
+	/** Maximum number of DNS queries received by the responder
+	 * for which no response had yet been delivered to the
+	 * network device
+	 */
+	unsigned int dns_outstanding;
+	/** Deferred DNS query, if any */
+	struct io_buffer *dns_deferred;
+	/** Source of deferred DNS query */
+	struct sockaddr_tcpip dns_deferred_src;
+	/** Time at which deferred DNS query is due to be answered */
+	unsigned long dns_deferred_due;
+	/** Number of times memory pressure has been emulated */
+	unsigned int pressures;
+};
+
+extern uint8_t netem_pattern[];
+extern int netem_create ( const struct netem_config *config,
+			  struct in_addr address, struct in_addr netmask,
+			  struct in_addr peer, struct netem **netem );
+extern int netem_ipv6 ( struct netem *netem, struct in6_addr *address,
+			unsigned int prefix_len, struct in6_addr *peer );
+extern void netem_destroy ( struct netem *netem );
+extern int netem_fetch ( const char *uri, size_t *len,
+			 struct netem_fetch_stats *stats );
+extern int netem_upload ( const char *uri, size_t len,
+			  struct sockaddr *peer );
+extern int netem_resolve ( const char *name, struct sockaddr *sa );
+
+/**
+ * Get generated response data
+ *
+ * @v offset		Offset within response body
+ * @ret data		Response data
+ */
+static inline const uint8_t * netem_pattern_data ( size_t offset ) {
+	return &netem_pattern[ offset % NETEM_PATTERN_PERIOD ];
+}
+
+#endif /* _NETEM_H */
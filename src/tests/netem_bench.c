@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2026 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * End-to-end network stack benchmarks
+ *
+ */
+
+/* Forcibly enable profiling */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <ipxe/bench.h>
+#include "netem.h"
+
+/** An end-to-end network stack benchmark */
+struct netem_bench {
+	/** Name */
+	const char *name;
+	/** Link characteristics */
+	struct netem_config config;
+	/** URI */
+	const char *uri;
+	/** Length to upload (if not fetching) */
+	size_t upload;
+};
+
+/** Emulated link benchmarks */
+static struct netem_bench netem_benches[] = {
+	{
+		.name = "http ideal",
+		.config = { .seed = 1 },
+		.uri = "http://10.254.254.1/16777216",
+	},
+	{
+		.name = "http 100Mbps 5ms",
+		.config = {
+			.bandwidth = ( 100 * 1000 * 1000 / 8 ),
+			.latency = ( 5 * TICKS_PER_SEC / 1000 ),
+			.seed = 2,
+		},
+		.uri = "http://10.254.254.1/4194304",
+	},
+	{
+		.name = "http 1% loss",
+		.config = {
+			.bandwidth = ( 100 * 1000 * 1000 / 8 ),
+			.latency = ( 1 * TICKS_PER_SEC / 1000 ),
+			.loss = 10000,
+			.seed = 3,
+		},
+		.uri = "http://10.254.254.1/4194304",
+	},
+	{
+		.name = "http 0.5% loss 20ms",
+		.config = {
+			.latency = ( 20 * TICKS_PER_SEC / 1000 ),
+			.loss = 5000,
+			.seed = 8,
+		},
+		.uri = "http://10.254.254.1/16777216",
+	},
+	{
+		.name = "http rx csum offload",
+		.config = { .rx_csum = 1, .seed = 11 },
+		.uri = "http://10.254.254.1/16777216",
+	},
+	{
+		.name = "http jumbo",
+		.config = { .mtu = 9000, .seed = 9 },
+		.uri = "http://10.254.254.1/16777216",
+	},
+	{
+		.name = "tcp upload ideal",
+		.config = { .seed = 5 },
+		.uri = "tcp://10.254.254.1:80",
+		.upload = 16777216,
+	},
+	{
+		.name = "tcp upload tso",
+		.config = { .tso = 1, .seed = 12 },
+		.uri = "tcp://10.254.254.1:80",
+		.upload = 16777216,
+	},
+	{
+		.name = "tcp upload jumbo",
+		.config = { .mtu = 9000, .seed = 10 },
+		.uri = "tcp://10.254.254.1:80",
+		.upload = 16777216,
+	},
+	{
+		.name = "tcp upload 100Mbps 5ms",
+		.config = {
+			.bandwidth = ( 100 * 1000 * 1000 / 8 ),
+			.latency = ( 5 * TICKS_PER_SEC / 1000 ),
+			.seed = 6,
+		},
+		.uri = "tcp://10.254.254.1:80",
+		.upload = 4194304,
+	},
+	{
+		.name = "tcp upload 1% loss",
+		.config = {
+			.bandwidth = ( 100 * 1000 * 1000 / 8 ),
+			.latency = ( 1 * TICKS_PER_SEC / 1000 ),
+			.loss = 10000,
+			.seed = 7,
+		},
+		.uri = "tcp://10.254.254.1:80",
+		.upload = 4194304,
+	},
+	{
+		.name = "tftp ideal",
+		.config = { .seed = 4 },
+		.uri = "tftp://10.254.254.1/4194304",
+	},
+};
+
+/**
+ * Perform end-to-end network stack benchmark
+ *
+ * @v bench		Benchmark
+ */
+static void netem_bench_run ( struct netem_bench *bench ) {
+	struct profiler profiler;
+	struct in_addr address;
+	struct in_addr netmask;
+	struct in_addr peer;
+	struct netem *netem;
+	size_t len;
+	int rc;
+
+	/* Create emulated link */
+	inet_aton ( "10.254.254.2", &address );
+	inet_aton ( "255.255.255.0", &netmask );
+	inet_aton ( "10.254.254.1", &peer );
+	if ( ( rc = netem_create ( &bench->config, address, netmask, peer,
+				   &netem ) ) != 0 ) {
+		printf ( "%s: could not create link: %s\n",
+			 bench->name, strerror ( rc ) );
+		return;
+	}
+
+	/* Profile transfer */
+	memset ( &profiler, 0, sizeof ( profiler ) );
+	profile_start ( &profiler );
+	if ( bench->upload ) {
+		len = bench->upload;
+		rc = netem_upload ( bench->uri, len, NULL );
+	} else {
+		rc = netem_fetch ( bench->uri, &len, NULL );
+	}
+	profile_stop ( &profiler );
+	if ( rc != 0 ) {
+		printf ( "%s: failed: %s\n", bench->name, strerror ( rc ) );
+	} else {
+		bench_report ( bench->name, &profiler, len );
+	}
+
+	/* Destroy emulated link */
+	netem_destroy ( netem );
+}
+
+/**
+ * Perform end-to-end network stack benchmarks
+ *
+ */
+static void netem_bench_exec ( void ) {
+	unsigned int i;
+
+	for ( i = 0 ; i < ( sizeof ( netem_benches ) /
+			    sizeof ( netem_benches[0] ) ) ; i++ ) {
+		netem_bench_run ( &netem_benches[i] );
+	}
+}
+
+/** End-to-end network stack benchmark */
+struct benchmark netem_bench __benchmark = {
+	.name = "netem",
+	.exec = netem_bench_exec,
+};
@@ -0,0 +1,881 @@
+/*
+ * Copyright (C) 2026 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * Emulated network link tests
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <ipxe/netdevice.h>
+#include <ipxe/timer.h>
+#include <ipxe/process.h>
+#include <ipxe/settings.h>
+#include <ipxe/dns.h>
+#include <ipxe/tcp.h>
+#include <ipxe/resolv.h>
+#include <ipxe/test.h>
+#include "netem.h"
+
+/** Emulated link test IPv4 address */
+#define NETEM_TEST_ADDRESS "10.254.254.2"
+
+/** Emulated link test IPv4 subnet mask */
+#define NETEM_TEST_NETMASK "255.255.255.0"
+
+/** Emulated link test responder IPv4 address */
+#define NETEM_TEST_PEER "10.254.254.1"
+
+/** Emulated link test IPv6 address */
+#define NETEM_TEST_ADDRESS6 "fdfe::2"
+
+/** Emulated link test IPv6 prefix length */
+#define NETEM_TEST_PREFIX_LEN6 64
+
+/** Emulated link test responder IPv6 address */
+#define NETEM_TEST_PEER6 "fdfe::1"
+
+/** Emulated link test DNS search list (RFC1035-encoded) */
+#define NETEM_TEST_SEARCH \
+	"\007missing\005netem\004test\000\005netem\004test\000"
+
+/**
+ * Create emulated link
+ *
+ * @v config		Link characteristics
+ * @ret netem		Emulated link, or NULL
+ */
+static struct netem * netem_test_create ( const struct netem_config *config ) {
+	struct in_addr address;
+	struct in_addr netmask;
+	struct in_addr peer;
+	struct netem *netem;
+
+	inet_aton ( NETEM_TEST_ADDRESS, &address );
+	inet_aton ( NETEM_TEST_NETMASK, &netmask );
+	inet_aton ( NETEM_TEST_PEER, &peer );
+	if ( netem_create ( config, address, netmask, peer, &netem ) != 0 )
+		return NULL;
+	return netem;
+}
+
+/**
+ * Report a fetch test result
+ *
+ * @v config		Link characteristics
+ * @v uri		URI string
+ * @v expected		Expected length
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void netem_fetch_okx ( const struct netem_config *config,
+			      const char *uri, size_t expected,
+			      const char *file, unsigned int line ) {
+	struct netem *netem;
+	size_t len = 0;
+	int rc;
+
+	/* Create emulated link */
+	netem = netem_test_create ( config );
+	okx ( netem != NULL, file, line );
+	if ( ! netem )
+		return;
+
+	/* Fetch and verify data */
+	rc = netem_fetch ( uri, &len, NULL );
+	okx ( rc == 0, file, line );
+	okx ( len == expected, file, line );
+	DBG ( "NETEM fetched %s: %zd bytes, %d/%d lost, %d/%d reordered, "
+	      "%d/%d duplicated\n", uri, len, netem->tx.stats.lost,
+	      netem->rx.stats.lost, netem->tx.stats.reordered,
+	      netem->rx.stats.reordered, netem->tx.stats.duplicated,
+	      netem->rx.stats.duplicated );
+
+	/* Destroy emulated link */
+	netem_destroy ( netem );
+}
+#define netem_fetch_ok( config, uri, expected ) \
+	netem_fetch_okx ( config, uri, expected, __FILE__, __LINE__ )
+
+/**
+ * Report an upload test result
+ *
+ * @v config		Link characteristics
+ * @v len		Length to upload
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void netem_upload_okx ( const struct netem_config *config,
+			       size_t len, const char *file,
+			       unsigned int line ) {
+	struct netem *netem;
+
+	/* Create emulated link */
+	netem = netem_test_create ( config );
+	okx ( netem != NULL, file, line );
+	if ( ! netem )
+		return;
+
+	/* Upload data */
+	okx ( netem_upload ( "tcp://" NETEM_TEST_PEER ":80", len, NULL ) == 0,
+	      file, line );
+
+	/* TCP must never rely on fragmentation */
+	okx ( netem->tx.stats.fragmented == 0, file, line );
+	DBG ( "NETEM uploaded %zd bytes, %d/%d lost, %d/%d reordered, "
+	      "%d/%d duplicated\n", len, netem->tx.stats.lost,
+	      netem->rx.stats.lost, netem->tx.stats.reordered,
+	      netem->rx.stats.reordered, netem->tx.stats.duplicated,
+	      netem->rx.stats.duplicated );
+
+	/* Destroy emulated link */
+	netem_destroy ( netem );
+}
+#define netem_upload_ok( config, len ) \
+	netem_upload_okx ( config, len, __FILE__, __LINE__ )
+
+/**
+ * Report an acknowledgement test result
+ *
+ * @v config		Link characteristics
+ * @v uri		URI string
+ * @v expected		Expected length
+ * @v delayed		Acknowledgements are expected to be delayed
+ * @v file		Test code file
+ * @v line		Test code line
+ *
+ * Received data segments should be delivered without being copied
+ * into larger buffers, with an acknowledgement sent for at least
+ * every TCP_ACK_SEGMENTS_MAX data segments.  A lone data
+ * segment should be acknowledged after TCP_DELAYED_ACK_TIMEOUT,
+ * and each out-of-order segment should be acknowledged immediately
+ * with a selective acknowledgement.
+ *
+ * Acknowledgements are checked by counting, rather than by measuring
+ * their delays, since the time taken depends upon the speed at which
+ * the test is run (e.g. under valgrind).  The delay is checked only
+ * as a lower bound.
+ */
+static void netem_ack_okx ( const struct netem_config *config,
+			    const char *uri, size_t expected, int delayed,
+			    const char *file, unsigned int line ) {
+	struct netem_fetch_stats fetch;
+	struct netem_tcp_stats *stats;
+	struct tcp_statistics before;
+	struct netem *netem;
+	unsigned long out_of_order;
+	size_t len = 0;
+
+	/* Create emulated link */
+	netem = netem_test_create ( config );
+	okx ( netem != NULL, file, line );
+	if ( ! netem )
+		return;
+	stats = &netem->tcp_stats;
+
+	/* Fetch and verify data */
+	memcpy ( &before, &tcp_stats, sizeof ( before ) );
+	okx ( netem_fetch ( uri, &len, &fetch ) == 0, file, line );
+	okx ( len == expected, file, line );
+	out_of_order = ( tcp_stats.in_out_of_order - before.in_out_of_order );
+	DBG ( "NETEM fetched %s: %d data segments, %d ACKs (max delay %ld), "
+	      "%d SACKs for %ld out of order, %d deliveries (max %zd "
+	      "bytes)\n", uri, stats->data, stats->acks, stats->ack_delay,
+	      stats->sacks, out_of_order, fetch.count, fetch.max_len );
+
+	/* Check acknowledgements */
+	okx ( stats->data > 0, file, line );
+	okx ( ( stats->acks * TCP_ACK_SEGMENTS_MAX ) >= stats->data,
+	      file, line );
+	if ( delayed ) {
+		okx ( stats->ack_delay >= TCP_DELAYED_ACK_TIMEOUT,
+		      file, line );
+		okx ( stats->acks >= ( stats->data / 2 ), file, line );
+	} else {
+		okx ( stats->acks < ( stats->data / 2 ), file, line );
+	}
+
+	/* Check selective acknowledgements */
+	if ( config->reorder ) {
+		okx ( out_of_order > 0, file, line );
+		okx ( stats->sacks >= out_of_order, file, line );
+	} else {
+		okx ( stats->sacks == 0, file, line );
+	}
+
+	/* Check that received data was not coalesced by copying,
+	 * i.e. that no delivery exceeds a single received segment.
+	 */
+	okx ( fetch.count > 0, file, line );
+	okx ( fetch.max_len < netem->netdev->mtu, file, line );
+
+	/* Destroy emulated link */
+	netem_destroy ( netem );
+}
+#define netem_ack_ok( config, uri, expected, delayed )			\
+	netem_ack_okx ( config, uri, expected, delayed, __FILE__, __LINE__ )
+
+/**
+ * Report a receive reassembly test result
+ *
+ * @v config		Link characteristics
+ * @v uri		URI string
+ * @v expected		Expected length
+ * @v file		Test code file
+ * @v line		Test code line
+ *
+ * The responder should be scrambling each burst into overlapping
+ * segments transmitted in a random order.  Each segment will then
+ * create a new range in the receive queue (at a position found via
+ * binary search), or extend and possibly merge existing ranges, and
+ * any overlapping data will be trimmed.  Bursts are long enough to
+ * require more than TCP_RX_RANGES_MAX ranges, and so some segments
+ * will be discarded.  The reassembled data must nonetheless match
+ * the data generated by the responder.
+ */
+static void netem_reassemble_okx ( const struct netem_config *config,
+				   const char *uri, size_t expected,
+				   const char *file, unsigned int line ) {
+	struct tcp_statistics before;
+	struct netem *netem;
+	unsigned long out_of_order;
+	unsigned long discards;
+	unsigned long octets;
+	size_t len = 0;
+
+	/* Create emulated link */
+	netem = netem_test_create ( config );
+	okx ( netem != NULL, file, line );
+	if ( ! netem )
+		return;
+
+	/* Fetch and verify data */
+	memcpy ( &before, &tcp_stats, sizeof ( before ) );
+	okx ( netem_fetch ( uri, &len, NULL ) == 0, file, line );
+	okx ( len == expected, file, line );
+	out_of_order = ( tcp_stats.in_out_of_order - before.in_out_of_order );
+	discards = ( tcp_stats.in_discards - before.in_discards );
+	octets = ( tcp_stats.in_octets - before.in_octets );
+	DBG ( "NETEM reassembled %s: %ld out of order, %ld discarded, %ld "
+	      "octets received\n", uri, out_of_order, discards, octets );
+
+	/* Check that reassembly was exercised */
+	okx ( out_of_order > 0, file, line );
+	okx ( discards > 0, file, line );
+	okx ( octets > len, file, line );
+	okx ( ( tcp_stats.in_octets_good - before.in_octets_good ) >= len,
+	      file, line );
+
+	/* Destroy emulated link */
+	netem_destroy ( netem );
+}
+#define netem_reassemble_ok( config, uri, expected )			\
+	netem_reassemble_okx ( config, uri, expected, __FILE__, __LINE__ )
+
+/**
+ * Report a receive window tuning test result
+ *
+ * @v config		Link characteristics
+ * @v uri		URI string
+ * @v expected		Expected length
+ * @v grow		Receive window limit is expected to grow
+ * @v file		Test code file
+ * @v line		Test code line
+ *
+ * The receive window limit should grow beyond its initial size only
+ * if the bandwidth-delay product requires it.  Memory pressure
+ * should reduce the maximum receive window limit to at most half of
+ * the initial size, and so any further growth shows that the
+ * maximum limit has recovered.
+ */
+static void netem_window_okx ( const struct netem_config *config,
+			       const char *uri, size_t expected, int grow,
+			       const char *file, unsigned int line ) {
+	struct tcp_info info;
+	struct netem *netem;
+	size_t len = 0;
+
+	/* Create emulated link */
+	netem = netem_test_create ( config );
+	okx ( netem != NULL, file, line );
+	if ( ! netem )
+		return;
+
+	/* Fetch data and inspect connection */
+	okx ( netem_fetch ( uri, &len, NULL ) == 0, file, line );
+	okx ( len == expected, file, line );
+	okx ( tcp_info ( 0, &info ) == 0, file, line );
+	DBG ( "NETEM fetched %s: window %d limit %dkB (max %dkB), %d "
+	      "pressures\n", uri, info.rcv_win, ( info.rcv_space >> 10 ),
+	      ( info.rcv_space_max >> 10 ), netem->pressures );
+	okx ( info.in_octets >= len, file, line );
+	okx ( info.rcv_space <= info.rcv_space_max, file, line );
+
+	/* Check window limit */
+	if ( grow ) {
+		okx ( info.rcv_space > TCP_INITIAL_WINDOW_SIZE, file, line );
+	} else {
+		okx ( info.rcv_space == TCP_INITIAL_WINDOW_SIZE, file, line );
+	}
+
+	/* Check maximum window limit */
+	if ( config->pressure ) {
+		okx ( netem->pressures == 1, file, line );
+		okx ( info.rcv_space_max < TCP_MAX_WINDOW_SIZE, file, line );
+	} else {
+		okx ( info.rcv_space_max == TCP_MAX_WINDOW_SIZE, file, line );
+	}
+
+	/* Destroy emulated link */
+	netem_destroy ( netem );
+}
+#define netem_window_ok( config, uri, expected, grow )			\
+	netem_window_okx ( config, uri, expected, grow, __FILE__, __LINE__ )
+
+/**
+ * Report a round-trip time estimation test result
+ *
+ * @v config		Link characteristics
+ * @v len		Length to upload
+ * @v file		Test code file
+ * @v line		Test code line
+ *
+ * The smoothed round-trip time can be no less than the link's
+ * latency permits, and the retransmission timeout should be no less
+ * than the smoothed round-trip time and clamped to the permitted
+ * range.  Upper bounds on the round-trip time are not checked, since
+ * they depend upon the speed at which the test is run (e.g. under
+ * valgrind).
+ */
+static void netem_rtt_okx ( const struct netem_config *config, size_t len,
+			    const char *file, unsigned int line ) {
+	unsigned long min_rto = ( ( TCP_MIN_RTO * 1000 ) / TICKS_PER_SEC );
+	unsigned long max_rto = ( ( TCP_MAX_RTO * 1000 ) / TICKS_PER_SEC );
+	unsigned long min_rtt;
+	struct tcp_info info;
+	struct netem *netem;
+
+	/* Calculate minimum round-trip time (in ms), allowing one
+	 * tick for timer granularity.
+	 */
+	min_rtt = ( 2 * config->latency );
+	min_rtt = ( min_rtt ? ( min_rtt - 1 ) : 0 );
+	min_rtt = ( ( min_rtt * 1000 ) / TICKS_PER_SEC );
+
+	/* Create emulated link */
+	netem = netem_test_create ( config );
+	okx ( netem != NULL, file, line );
+	if ( ! netem )
+		return;
+
+	/* Upload data and inspect connection */
+	okx ( netem_upload ( "tcp://" NETEM_TEST_PEER ":80", len, NULL ) == 0,
+	      file, line );
+	okx ( tcp_info ( 0, &info ) == 0, file, line );
+	DBG ( "NETEM RTT >=%ldms: SRTT %ldms RTO %ldms, %ld "
+	      "retransmits\n", min_rtt, info.srtt, info.rto,
+	      info.retransmits );
+	okx ( info.out_octets >= len, file, line );
+	okx ( info.srtt >= min_rtt, file, line );
+	okx ( info.rto >= info.srtt, file, line );
+	okx ( info.rto >= min_rto, file, line );
+	okx ( info.rto <= max_rto, file, line );
+
+	/* Destroy emulated link */
+	netem_destroy ( netem );
+}
+#define netem_rtt_ok( config, len ) \
+	netem_rtt_okx ( config, len, __FILE__, __LINE__ )
+
+/**
+ * Report a name resolution test result
+ *
+ * @v netem		Emulated link
+ * @v name		Name to resolve
+ * @v exists		Name is expected to exist
+ * @v queries		Expected number of DNS queries received by responder
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void netem_resolve_okx ( struct netem *netem, const char *name,
+				int exists, unsigned int queries,
+				const char *file, unsigned int line ) {
+	union {
+		struct sockaddr sa;
+		struct sockaddr_in sin;
+	} u;
+	int rc;
+
+	/* Resolve name */
+	rc = netem_resolve ( name, &u.sa );
+	if ( exists ) {
+		okx ( rc == 0, file, line );
+		okx ( u.sin.sin_family == AF_INET, file, line );
+		okx ( u.sin.sin_addr.s_addr == netem->peer.s_addr,
+		      file, line );
+	} else {
+		okx ( rc != 0, file, line );
+	}
+	okx ( netem->dns_queries == queries, file, line );
+}
+
+/**
+ * Report a DNS cache test result
+ *
+ * @v config		Link characteristics
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void netem_dns_okx ( const struct netem_config *config,
+			    const char *file, unsigned int line ) {
+	struct dns_cache_info info;
+	struct netem *netem;
+
+	/* Create emulated link */
+	netem = netem_test_create ( config );
+	okx ( netem != NULL, file, line );
+	if ( ! netem )
+		return;
+
+	/* Repeated lookups should be answered from the cache */
+	netem_resolve_okx ( netem, "boot.netem.test", 1, 1, file, line );
+	netem_resolve_okx ( netem, "boot.netem.test", 1, 1, file, line );
+	netem_resolve_okx ( netem, "BOOT.netem.test", 1, 1, file, line );
+	okx ( dns_cache_info ( 0, &info ) == 0, file, line );
+	okx ( strcmp ( info.name, "boot.netem.test" ) == 0, file, line );
+	okx ( strcmp ( info.type, "A" ) == 0, file, line );
+	okx ( strcmp ( info.value, NETEM_TEST_PEER ) == 0, file, line );
+	okx ( info.ttl <= NETEM_DNS_TTL, file, line );
+
+	/* CNAMEs should be cached along with their targets */
+	netem_resolve_okx ( netem, "alias.other.netem.test", 1, 2,
+			    file, line );
+	netem_resolve_okx ( netem, "alias.other.netem.test", 1, 2,
+			    file, line );
+	netem_resolve_okx ( netem, "other.netem.test", 1, 2, file, line );
+
+	/* Nonexistent names should be cached */
+	netem_resolve_okx ( netem, "missing.netem.test", 0, 3, file, line );
+	netem_resolve_okx ( netem, "missing.netem.test", 0, 3, file, line );
+
+	/* Flushed entries should be looked up again */
+	dns_cache_flush();
+	okx ( dns_cache_info ( 0, &info ) != 0, file, line );
+	netem_resolve_okx ( netem, "boot.netem.test", 1, 4, file, line );
+
+	/* Expired entries should be looked up again */
+	dns_cache_age ( NETEM_DNS_TTL * TICKS_PER_SEC );
+	netem_resolve_okx ( netem, "boot.netem.test", 1, 5, file, line );
+	netem_resolve_okx ( netem, "missing.netem.test", 0, 6, file, line );
+
+	/* Destroy emulated link */
+	netem_destroy ( netem );
+}
+#define netem_dns_ok( config ) \
+	netem_dns_okx ( config, __FILE__, __LINE__ )
+
+/**
+ * Report a DNS search list test result
+ *
+ * @v config		Link characteristics
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void netem_dns_search_okx ( const struct netem_config *config,
+				   const char *file, unsigned int line ) {
+	const struct setting *setting;
+	struct netem *netem;
+
+	/* Create emulated link */
+	netem = netem_test_create ( config );
+	okx ( netem != NULL, file, line );
+	if ( ! netem )
+		return;
+
+	/* Configure search list */
+	setting = find_setting ( "dnssl" );
+	okx ( setting != NULL, file, line );
+	if ( ! setting )
+		goto err_setting;
+	okx ( store_setting ( netdev_settings ( netem->netdev ), setting,
+			      NETEM_TEST_SEARCH,
+			      ( sizeof ( NETEM_TEST_SEARCH ) -
+				1 /* NUL */ ) ) == 0, file, line );
+
+	/* All suffixes should be queried concurrently, i.e. each
+	 * query should be sent before any response is received.
+	 */
+	netem_resolve_okx ( netem, "missing", 0, 2, file, line );
+	okx ( netem->dns_outstanding >= 2, file, line );
+	netem->dns_outstanding = 0;
+	netem_resolve_okx ( netem, "boot", 1, 4, file, line );
+	okx ( netem->dns_outstanding >= 2, file, line );
+
+	/* Results for all suffixes should be cached */
+	netem_resolve_okx ( netem, "missing", 0, 4, file, line );
+	netem_resolve_okx ( netem, "boot", 1, 4, file, line );
+
+ err_setting:
+	/* Destroy emulated link */
+	netem_destroy ( netem );
+}
+#define netem_dns_search_ok( config ) \
+	netem_dns_search_okx ( config, __FILE__, __LINE__ )
+
+/**
+ * Report a named connection test result
+ *
+ * @v config		Link characteristics
+ * @v uri		URI string (using the responder's name)
+ * @v upload		Upload (rather than fetch) data
+ * @v family		Expected address family of established connection
+ * @v min		Minimum expected time to complete (in ticks)
+ * @v file		Test code file
+ * @v line		Test code line
+ *
+ * The responder is reachable via both IPv4 and IPv6 (unless the
+ * IPv6 path is black-holed), and the connection attempt that
+ * completes its handshake first should win.  All other attempts
+ * should be cancelled, leaving no connections of any other address
+ * family.  The winning connection is handed over without
+ * reconnecting, and so the responder should see only a single
+ * connection request via the winning address family.  An upload
+ * intercepts redirection (in the same way as an iSCSI session), and
+ * so should see the peer address of the winning connection.
+ *
+ * The elapsed time is checked only as a lower bound (showing that
+ * the relevant delay was applied), since the time taken depends upon
+ * the speed at which the test is run.  The winner is identified by
+ * its address family.
+ */
+static void netem_named_okx ( const struct netem_config *config,
+			      const char *uri, int upload,
+			      sa_family_t family, unsigned long min,
+			      const char *file, unsigned int line ) {
+	struct in6_addr address6;
+	struct in6_addr peer6;
+	struct sockaddr peer;
+	struct tcp_info info;
+	struct netem *netem;
+	unsigned long start;
+	unsigned long elapsed;
+	unsigned int syns6;
+	unsigned int i;
+	size_t len = 0;
+
+	/* Create emulated link */
+	netem = netem_test_create ( config );
+	okx ( netem != NULL, file, line );
+	if ( ! netem )
+		return;
+	okx ( inet6_aton ( NETEM_TEST_ADDRESS6, &address6 ) == 0, file, line );
+	okx ( inet6_aton ( NETEM_TEST_PEER6, &peer6 ) == 0, file, line );
+	okx ( netem_ipv6 ( netem, &address6, NETEM_TEST_PREFIX_LEN6,
+			   &peer6 ) == 0, file, line );
+
+	/* Fetch or upload data */
+	start = currticks();
+	if ( upload ) {
+		okx ( netem_upload ( uri, 1024, &peer ) == 0, file, line );
+		okx ( peer.sa_family == family, file, line );
+	} else {
+		okx ( netem_fetch ( uri, &len, NULL ) == 0, file, line );
+		okx ( len == 1024, file, line );
+	}
+	elapsed = ( currticks() - start );
+	DBG ( "NETEM %s %s in %ld ticks via %d IPv4 and %d IPv6 "
+	      "connection requests\n", ( upload ? "uploaded" : "fetched" ),
+	      uri, elapsed, netem->tcp_stats.syns, netem->tcp_stats.syns6 );
+	okx ( elapsed >= min, file, line );
+
+	/* Check connection requests */
+	syns6 = ( config->blackhole6 ? 1 : 0 );
+	if ( family == AF_INET6 ) {
+		okx ( netem->tcp_stats.syns == 0, file, line );
+		okx ( netem->tcp_stats.syns6 == 1, file, line );
+	} else {
+		okx ( netem->tcp_stats.syns == 1, file, line );
+		okx ( netem->tcp_stats.syns6 == syns6, file, line );
+	}
+
+	/* Check that all other connection attempts were cancelled */
+	for ( i = 0 ; ( tcp_info ( i, &info ) == 0 ) ; i++ ) {
+		if ( info.age > ( currticks() - start ) )
+			break;
+		okx ( info.peer.st_family == family, file, line );
+	}
+	okx ( i > 0, file, line );
+
+	/* Destroy emulated link */
+	netem_destroy ( netem );
+}
+#define netem_named_ok( config, uri, upload, family, min )		\
+	netem_named_okx ( config, uri, upload, family, min,		\
+			  __FILE__, __LINE__ )
+
+/** An ideal link */
+static struct netem_config netem_test_ideal = {
+	.seed = 1,
+};
+
+/** A poor link */
+static struct netem_config netem_test_poor = {
+	.latency = 2,
+	.jitter = 2,
+	.loss = 20000,
+	.reorder = 20000,
+	.duplicate = 10000,
+	.seed = 2,
+};
+
+/** A lossy link */
+static struct netem_config netem_test_lossy = {
+	.latency = 2,
+	.loss = 50000,
+	.seed = 4,
+};
+
+/** A high-latency link */
+static struct netem_config netem_test_distant = {
+	.latency = ( TICKS_PER_SEC / 10 ),
+	.jitter = ( TICKS_PER_SEC / 100 ),
+	.seed = 5,
+};
+
+/** A high-latency link with a timestamp-capable responder */
+static struct netem_config netem_test_distant_ts = {
+	.latency = ( TICKS_PER_SEC / 10 ),
+	.jitter = ( TICKS_PER_SEC / 100 ),
+	.ts = 1,
+	.seed = 13,
+};
+
+/** A high-latency link with emulated memory pressure */
+static struct netem_config netem_test_distant_pressure = {
+	.latency = ( TICKS_PER_SEC / 10 ),
+	.jitter = ( TICKS_PER_SEC / 100 ),
+	.pressure = 65536,
+	.seed = 17,
+};
+
+/** A moderate-latency link */
+static struct netem_config netem_test_nearby = {
+	.latency = ( TICKS_PER_SEC / 50 ),
+	.seed = 9,
+};
+
+/** A slow link */
+static struct netem_config netem_test_slow = {
+	.bandwidth = ( 10 * 1000 * 1000 / 8 ),
+	.latency = 5,
+	.limit = 64,
+	.seed = 3,
+};
+
+/** A very slow link */
+static struct netem_config netem_test_trickle = {
+	.bandwidth = 24000,
+	.latency = 5,
+	.seed = 14,
+};
+
+/** A reordering link */
+static struct netem_config netem_test_reorder = {
+	.latency = 5,
+	.reorder = 50000,
+	.seed = 15,
+};
+
+/** A link with a scrambling responder */
+static struct netem_config netem_test_scramble = {
+	.latency = 2,
+	.scramble = 1,
+	.seed = 16,
+};
+
+/** A link with receive checksum offload */
+static struct netem_config netem_test_offload = {
+	.rx_csum = 1,
+	.seed = 8,
+};
+
+/** A lossy link with TCP segmentation offload */
+static struct netem_config netem_test_tso = {
+	.tso = 1,
+	.latency = 2,
+	.loss = 5000,
+	.seed = 12,
+};
+
+/** A jumbo frame link */
+static struct netem_config netem_test_jumbo = {
+	.mtu = 9000,
+	.seed = 6,
+};
+
+/** A jumbo frame link with a path MTU black hole */
+static struct netem_config netem_test_blackhole = {
+	.mtu = 9000,
+	.path_mtu = 1500,
+	.latency = 2,
+	.seed = 7,
+};
+
+/** A dual-stack link */
+static struct netem_config netem_test_dual = {
+	.latency = 2,
+	.seed = 18,
+};
+
+/** A dual-stack link with an IPv6 black hole */
+static struct netem_config netem_test_blackhole6 = {
+	.latency = 2,
+	.blackhole6 = 1,
+	.seed = 19,
+};
+
+/** A dual-stack link with slightly delayed IPv6 name resolution */
+static struct netem_config netem_test_slow_aaaa = {
+	.latency = 2,
+	.aaaa_delay = ( NAMED_RESOLUTION_DELAY / 2 ),
+	.seed = 20,
+};
+
+/** A dual-stack link with greatly delayed IPv6 name resolution */
+static struct netem_config netem_test_late_aaaa = {
+	.latency = 2,
+	.aaaa_delay = ( 2 * NAMED_CONNECTION_DELAY ),
+	.seed = 21,
+};
+
+/**
+ * Perform emulated link self-tests
+ *
+ */
+static void netem_test_exec ( void ) {
+
+	/* HTTP over an ideal link */
+	netem_fetch_ok ( &netem_test_ideal, "http://" NETEM_TEST_PEER "/0", 0 );
+	netem_fetch_ok ( &netem_test_ideal, "http://" NETEM_TEST_PEER "/1", 1 );
+	netem_fetch_ok ( &netem_test_ideal,
+			 "http://" NETEM_TEST_PEER "/1048576", 1048576 );
+
+	/* HTTP over imperfect links */
+	netem_fetch_ok ( &netem_test_poor,
+			 "http://" NETEM_TEST_PEER "/262144", 262144 );
+	netem_fetch_ok ( &netem_test_slow,
+			 "http://" NETEM_TEST_PEER "/262144", 262144 );
+	netem_fetch_ok ( &netem_test_distant,
+			 "http://" NETEM_TEST_PEER "/131072", 131072 );
+	netem_fetch_ok ( &netem_test_jumbo,
+			 "http://" NETEM_TEST_PEER "/1048576", 1048576 );
+	netem_fetch_ok ( &netem_test_offload,
+			 "http://" NETEM_TEST_PEER "/1048576", 1048576 );
+
+	/* TCP uploads over ideal and imperfect links */
+	netem_upload_ok ( &netem_test_ideal, 0 );
+	netem_upload_ok ( &netem_test_ideal, 1 );
+	netem_upload_ok ( &netem_test_ideal, 4194304 );
+	netem_upload_ok ( &netem_test_poor, 1048576 );
+	netem_upload_ok ( &netem_test_lossy, 1048576 );
+	netem_upload_ok ( &netem_test_slow, 1048576 );
+	netem_upload_ok ( &netem_test_distant, 131072 );
+	netem_upload_ok ( &netem_test_distant_ts, 131072 );
+	netem_upload_ok ( &netem_test_jumbo, 1048576 );
+	netem_upload_ok ( &netem_test_offload, 1048576 );
+	netem_upload_ok ( &netem_test_tso, 1048576 );
+	netem_upload_ok ( &netem_test_blackhole, 1048576 );
+
+	/* Acknowledgements over ideal and imperfect links */
+	netem_ack_ok ( &netem_test_ideal,
+		       "http://" NETEM_TEST_PEER "/1048576", 1048576, 0 );
+	netem_ack_ok ( &netem_test_trickle,
+		       "http://" NETEM_TEST_PEER "/8192", 8192, 1 );
+	netem_ack_ok ( &netem_test_reorder,
+		       "http://" NETEM_TEST_PEER "/262144", 262144, 0 );
+
+	/* Receive reassembly of scrambled data */
+	netem_reassemble_ok ( &netem_test_scramble,
+			      "http://" NETEM_TEST_PEER "/1048576", 1048576 );
+
+	/* Receive window tuning over slow and high-latency links */
+	netem_window_ok ( &netem_test_slow,
+			  "http://" NETEM_TEST_PEER "/262144", 262144, 0 );
+	netem_window_ok ( &netem_test_distant,
+			  "http://" NETEM_TEST_PEER "/1048576", 1048576, 1 );
+	netem_window_ok ( &netem_test_distant_pressure,
+			  "http://" NETEM_TEST_PEER "/4194304", 4194304, 1 );
+
+	/* Round-trip time estimation over ideal and high-latency links */
+	netem_rtt_ok ( &netem_test_ideal, 1048576 );
+	netem_rtt_ok ( &netem_test_distant_ts, 131072 );
+
+	/* TFTP over ideal and imperfect links */
+	netem_fetch_ok ( &netem_test_ideal,
+			 "tftp://" NETEM_TEST_PEER "/65536", 65536 );
+	netem_fetch_ok ( &netem_test_ideal,
+			 "tftp://" NETEM_TEST_PEER "/100000", 100000 );
+	netem_fetch_ok ( &netem_test_poor,
+			 "tftp://" NETEM_TEST_PEER "/65536", 65536 );
+
+	/* DNS caching over an ideal link */
+	netem_dns_ok ( &netem_test_ideal );
+
+	/* DNS search lists over ideal and moderate-latency links */
+	netem_dns_search_ok ( &netem_test_ideal );
+	netem_dns_search_ok ( &netem_test_nearby );
+
+	/* Named TCP connections over ideal and high-latency links */
+	netem_fetch_ok ( &netem_test_ideal,
+			 "http://boot.netem.test/65536", 65536 );
+	netem_fetch_ok ( &netem_test_distant,
+			 "http://boot.netem.test/65536", 65536 );
+
+	/* Named TCP connections over dual-stack links */
+	netem_named_ok ( &netem_test_dual, "http://boot.netem.test/1024", 0,
+			 AF_INET6, 0 );
+	netem_named_ok ( &netem_test_dual, "tcp://boot.netem.test:80", 1,
+			 AF_INET6, 0 );
+	netem_named_ok ( &netem_test_blackhole6, "http://boot.netem.test/1024",
+			 0, AF_INET, NAMED_CONNECTION_DELAY );
+	netem_named_ok ( &netem_test_blackhole6, "tcp://boot.netem.test:80", 1,
+			 AF_INET, NAMED_CONNECTION_DELAY );
+	netem_named_ok ( &netem_test_slow_aaaa, "http://boot.netem.test/1024",
+			 0, AF_INET6, netem_test_slow_aaaa.aaaa_delay );
+	netem_named_ok ( &netem_test_late_aaaa, "http://boot.netem.test/1024",
+			 0, AF_INET, NAMED_RESOLUTION_DELAY );
+}
+
+/** Emulated link self-test */
+struct self_test netem_test __self_test = {
+	.name = "netem",
+	.exec = netem_test_exec,
+};
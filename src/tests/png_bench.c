@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2026 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * PNG decoding benchmarks
+ *
+ */
+
+/* Forcibly enable profiling */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <ipxe/image.h>
+#include <ipxe/pixbuf.h>
+#include <ipxe/png.h>
+#include <ipxe/bench.h>
+
+/** Number of iterations for PNG benchmark */
+#define PNG_BENCH_COUNT 16
+
+/** Image data
+ *
+ * This is a 256x256 8-bit RGB gradient image, with each scanline
+ * using the Paeth filter.
+ */
+static const uint8_t png_bench_data[] = {
+	0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00,
+	0x00, 0x0d, 0x49, 0x48, 0x44, 0x52, 0x00, 0x00, 0x01, 0x00,
+	0x00, 0x00, 0x01, 0x00, 0x08, 0x02, 0x00, 0x00, 0x00, 0xd3,
+	0x10, 0x3f, 0x31, 0x00, 0x00, 0x02, 0x05, 0x49, 0x44, 0x41,
+	0x54, 0x78, 0xda, 0xed, 0xd3, 0x01, 0x09, 0x00, 0x30, 0x0c,
+	0xc0, 0xb0, 0x7e, 0xdc, 0xbf, 0xe6, 0x1b, 0xb8, 0x83, 0x05,
+	0xa2, 0xa0, 0xd0, 0x5b, 0x4d, 0x07, 0x76, 0xba, 0xcd, 0x29,
+	0x58, 0xca, 0x00, 0x18, 0x40, 0x08, 0x0c, 0x00, 0x06, 0x00,
+	0x03, 0x80, 0x01, 0xc0, 0x00, 0x60, 0x00, 0x30, 0x00, 0x18,
+	0x00, 0x0c, 0x00, 0x06, 0x00, 0x03, 0x80, 0x01, 0xc0, 0x00,
+	0x60, 0x00, 0x30, 0x00, 0x18, 0x00, 0x0c, 0x00, 0x06, 0x00,
+	0x03, 0x80, 0x01, 0xc0, 0x00, 0x60, 0x00, 0x30, 0x00, 0x18,
+	0x00, 0x0c, 0x00, 0x06, 0x00, 0x03, 0x80, 0x01, 0xc0, 0x00,
+	0x60, 0x00, 0x30, 0x00, 0x18, 0x00, 0x0c, 0x00, 0x06, 0x00,
+	0x03, 0x80, 0x01, 0xc0, 0x00, 0x60, 0x00, 0x30, 0x00, 0x18,
+	0x00, 0x0c, 0x00, 0x06, 0x00, 0x03, 0x80, 0x01, 0xc0, 0x00,
+	0x60, 0x00, 0x30, 0x00, 0x18, 0x00, 0x0c, 0x00, 0x06, 0xc0,
+	0x00, 0x06, 0xc0, 0x00, 0x60, 0x00, 0x30, 0x00, 0x18, 0x00,
+	0x0c, 0x00, 0x06, 0x00, 0x03, 0x80, 0x01, 0xc0, 0x00, 0x60,
+	0x00, 0x30, 0x00, 0x18, 0x00, 0x0c, 0x00, 0x06, 0x00, 0x03,
+	0x80, 0x01, 0xc0, 0x00, 0x60, 0x00, 0x30, 0x00, 0x18, 0x00,
+	0x0c, 0x00, 0x06, 0x00, 0x03, 0x80, 0x01, 0xc0, 0x00, 0x60,
+	0x00, 0x30, 0x00, 0x18, 0x00, 0x0c, 0x00, 0x06, 0x00, 0x03,
+	0x80, 0x01, 0xc0, 0x00, 0x60, 0x00, 0x30, 0x00, 0x18, 0x00,
+	0x0c, 0x00, 0x06, 0x00, 0x03, 0x80, 0x01, 0xc0, 0x00, 0x60,
+	0x00, 0x30, 0x00, 0x18, 0x00, 0x0c, 0x00, 0x06, 0x00, 0x03,
+	0x80, 0x01, 0xc0, 0x00, 0x60, 0x00, 0x30, 0x00, 0x06, 0x50,
+	0x01, 0x03, 0x80, 0x01, 0xc0, 0x00, 0x60, 0x00, 0x30, 0x00,
+	0x18, 0x00, 0x0c, 0x00, 0x06, 0x00, 0x03, 0x80, 0x01, 0xc0,
+	0x00, 0x60, 0x00, 0x30, 0x00, 0x18, 0x00, 0x0c, 0x00, 0x06,
+	0x00, 0x03, 0x80, 0x01, 0xc0, 0x00, 0x60, 0x00, 0x30, 0x00,
+	0x18, 0x00, 0x0c, 0x00, 0x06, 0x00, 0x03, 0x80, 0x01, 0xc0,
+	0x00, 0x60, 0x00, 0x30, 0x00, 0x18, 0x00, 0x0c, 0x00, 0x06,
+	0x00, 0x03, 0x80, 0x01, 0xc0, 0x00, 0x60, 0x00, 0x30, 0x00,
+	0x18, 0x00, 0x0c, 0x00, 0x06, 0x00, 0x03, 0x80, 0x01, 0xc0,
+	0x00, 0x60, 0x00, 0x30, 0x00, 0x18, 0x00, 0x0c, 0x00, 0x06,
+	0x00, 0x03, 0x80, 0x01, 0x30, 0x80, 0x01, 0x30, 0x00, 0x18,
+	0x00, 0x0c, 0x00, 0x06, 0x00, 0x03, 0x80, 0x01, 0xc0, 0x00,
+	0x60, 0x00, 0x30, 0x00, 0x18, 0x00, 0x0c, 0x00, 0x06, 0x00,
+	0x03, 0x80, 0x01, 0xc0, 0x00, 0x60, 0x00, 0x30, 0x00, 0x18,
+	0x00, 0x0c, 0x00, 0x06, 0x00, 0x03, 0x80, 0x01, 0xc0, 0x00,
+	0x60, 0x00, 0x30, 0x00, 0x18, 0x00, 0x0c, 0x00, 0x06, 0x00,
+	0x03, 0x80, 0x01, 0xc0, 0x00, 0x60, 0x00, 0x30, 0x00, 0x18,
+	0x00, 0x0c, 0x00, 0x06, 0x00, 0x03, 0x80, 0x01, 0xc0, 0x00,
+	0x60, 0x00, 0x30, 0x00, 0x18, 0x00, 0x0c, 0x00, 0x06, 0x00,
+	0x03, 0x80, 0x01, 0xc0, 0x00, 0x60, 0x00, 0x30, 0x00, 0x18,
+	0x00, 0x0c, 0x80, 0x01, 0x54, 0xc0, 0x00, 0x60, 0x00, 0x30,
+	0x00, 0x18, 0x00, 0x0c, 0x00, 0x06, 0x00, 0x03, 0x80, 0x01,
+	0xc0, 0x00, 0x60, 0x00, 0x30, 0x00, 0x18, 0x00, 0x0c, 0x00,
+	0x06, 0x00, 0x03, 0x80, 0x01, 0xc0, 0x00, 0x60, 0x00, 0x30,
+	0x00, 0x18, 0x00, 0x0c, 0x00, 0x06, 0x00, 0x03, 0x80, 0x01,
+	0xc0, 0x00, 0x60, 0x00, 0x30, 0x00, 0x18, 0x00, 0x0c, 0x00,
+	0x06, 0x00, 0x03, 0x80, 0x01, 0xc0, 0x00, 0x60, 0x00, 0x30,
+	0x00, 0x18, 0x00, 0x0c, 0x00, 0x06, 0x00, 0x03, 0x80, 0x01,
+	0xc0, 0x00, 0x60, 0x00, 0x30, 0x00, 0x18, 0x00, 0x0c, 0x00,
+	0x06, 0x80, 0x9f, 0x07, 0x65, 0xc4, 0x08, 0x0b, 0x24, 0xe4,
+	0xa3, 0x95, 0x00, 0x00, 0x00, 0x00, 0x49, 0x45, 0x4e, 0x44,
+	0xae, 0x42, 0x60, 0x82
+};
+
+/** Image */
+static struct image png_bench_image = {
+	.refcnt = REF_INIT ( ref_no_free ),
+	.name = "bench.png",
+	.flags = ( IMAGE_STATIC | IMAGE_STATIC_NAME ),
+	.type = &png_image_type,
+	.data = png_bench_data,
+	.len = sizeof ( png_bench_data ),
+};
+
+/**
+ * Perform PNG decoding benchmarks
+ *
+ */
+static void png_bench_exec ( void ) {
+	struct pixel_buffer *pixbuf;
+	struct profiler profiler;
+	size_t len = 0;
+	unsigned int i;
+	int rc;
+
+	/* Profile conversion to pixel buffer */
+	memset ( &profiler, 0, sizeof ( profiler ) );
+	for ( i = 0 ; i < PNG_BENCH_COUNT ; i++ ) {
+		profile_start ( &profiler );
+		rc = image_pixbuf ( &png_bench_image, &pixbuf );
+		profile_stop ( &profiler );
+		if ( rc != 0 ) {
+			printf ( "png: failed: %s\n", strerror ( rc ) );
+			return;
+		}
+		len = pixbuf->len;
+		pixbuf_put ( pixbuf );
+	}
+
+	bench_report ( "png 256x256", &profiler, len );
+}
+
+/** PNG decoding benchmark */
+struct benchmark png_bench __benchmark = {
+	.name = "png",
+	.exec = png_bench_exec,
+};
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2026 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * Process scheduler tests
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <ipxe/process.h>
+#include <ipxe/test.h>
+
+/** Maximum number of scheduler steps to wait for a process to run */
+#define PROCESS_TEST_MAX_STEPS 64
+
+/** A process test */
+struct process_test {
+	/** Process */
+	struct process process;
+	/** Number of times process has been stepped */
+	unsigned int count;
+};
+
+/**
+ * Single-step test process
+ *
+ * @v test		Process test
+ */
+static void process_test_step ( struct process_test *test ) {
+
+	test->count++;
+}
+
+/** Test process descriptor */
+static struct process_descriptor process_test_desc =
+	PROC_DESC ( struct process_test, process, process_test_step );
+
+/** Test process */
+static struct process_test process_test_proc;
+
+/**
+ * Step scheduler until test process has run (or until limit reached)
+ *
+ * @v test		Process test
+ * @ret ran		Test process has run
+ */
+static int process_test_run ( struct process_test *test ) {
+	unsigned int count = test->count;
+	unsigned int i;
+
+	for ( i = 0 ; i < PROCESS_TEST_MAX_STEPS ; i++ ) {
+		step();
+		if ( test->count != count )
+			return 1;
+	}
+	return 0;
+}
+
+/**
+ * Perform process scheduler self-tests
+ *
+ */
+static void process_test_exec ( void ) {
+	struct process_test *test = &process_test_proc;
+
+	/* Running process should be stepped */
+	process_init ( &test->process, &process_test_desc, NULL );
+	ok ( process_running ( &test->process ) );
+	ok ( process_pending() );
+	ok ( process_test_run ( test ) );
+	ok ( process_test_run ( test ) );
+
+	/* Sleeping process should remain running but not be stepped */
+	process_sleep ( &test->process );
+	ok ( process_running ( &test->process ) );
+	ok ( ! process_test_run ( test ) );
+
+	/* Woken process should be stepped */
+	process_wake ( &test->process );
+	ok ( process_pending() );
+	ok ( process_test_run ( test ) );
+
+	/* Adding a sleeping process should wake it */
+	process_sleep ( &test->process );
+	process_add ( &test->process );
+	ok ( process_test_run ( test ) );
+
+	/* Sleeping process should be removable */
+	process_sleep ( &test->process );
+	process_del ( &test->process );
+	ok ( ! process_running ( &test->process ) );
+	process_wake ( &test->process );
+	ok ( ! process_running ( &test->process ) );
+	ok ( ! process_test_run ( test ) );
+
+	/* Sleeping a stopped process should have no effect */
+	process_sleep ( &test->process );
+	ok ( ! process_running ( &test->process ) );
+}
+
+/** Process scheduler self-test */
+struct self_test process_test __self_test = {
+	.name = "process",
+	.exec = process_test_exec,
+};
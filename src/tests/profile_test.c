@@ -100,13 +100,17 @@ PROFILE_TEST ( large, 93533894UL, 25538UL,
  */
 static void profile_okx ( struct profile_test *test, const char *file,
 			  unsigned int line ) {
+	unsigned int hist[PROFILE_BUCKETS];
 	struct profiler profiler;
 	unsigned long mean;
 	unsigned long stddev;
+	unsigned int total;
 	unsigned int i;
 
 	/* Initialise profiler */
 	memset ( &profiler, 0, sizeof ( profiler ) );
+	memset ( hist, 0, sizeof ( hist ) );
+	profiler.hist = hist;
 
 	/* Record sample values */
 	for ( i = 0 ; i < test->count ; i++ )
@@ -118,9 +122,89 @@ static void profile_okx ( struct profile_test *test, const char *file,
 	DBGC ( test, "PROFILE calculated mean %ld stddev %ld\n", mean, stddev );
 	okx ( mean == test->mean, file, line );
 	okx ( stddev == test->stddev, file, line );
+
+	/* Check that every sample appears in the histogram */
+	for ( total = 0, i = 0 ; i < PROFILE_BUCKETS ; i++ )
+		total += profiler.hist[i];
+	okx ( total == test->count, file, line );
 }
 #define profile_ok( test ) profile_okx ( test, __FILE__, __LINE__ )
 
+/**
+ * Perform histogram self-tests
+ *
+ */
+static void profile_hist_test ( void ) {
+	unsigned int hist[PROFILE_BUCKETS];
+	struct profiler profiler;
+	unsigned int i;
+
+	/* Check that a histogram is optional */
+	memset ( &profiler, 0, sizeof ( profiler ) );
+	profile_update ( &profiler, 100 );
+	ok ( profiler.count == 1 );
+	ok ( profile_quantile ( &profiler, 99 ) == 0 );
+
+	/* Record a long tail of samples */
+	memset ( &profiler, 0, sizeof ( profiler ) );
+	memset ( hist, 0, sizeof ( hist ) );
+	profiler.hist = hist;
+	for ( i = 0 ; i < 98 ; i++ )
+		profile_update ( &profiler, 100 );
+	profile_update ( &profiler, 0 );
+	profile_update ( &profiler, 50000 );
+
+	/* Check histogram buckets */
+	ok ( profiler.hist[0] == 1 );
+	ok ( profiler.hist[7] == 98 );
+	ok ( profiler.hist[16] == 1 );
+
+	/* Check quantiles */
+	ok ( profile_quantile ( &profiler, 0 ) == 0 );
+	ok ( profile_quantile ( &profiler, 50 ) == 127 );
+	ok ( profile_quantile ( &profiler, 99 ) == 127 );
+	ok ( profile_quantile ( &profiler, 100 ) == 65535 );
+
+	/* Check that oversized samples are counted in the final bucket */
+	profile_update ( &profiler, ( ~0UL >> 1 ) );
+	ok ( profiler.hist[ PROFILE_BUCKETS - 1 ] == 1 );
+}
+
+/**
+ * Perform trace ring self-tests
+ *
+ */
+static void profile_trace_test ( void ) {
+	static struct profiler profiler;
+	struct profile_event *event;
+	unsigned long prod;
+	unsigned int i;
+
+	/* Record more events than the ring can hold */
+	memset ( &profiler, 0, sizeof ( profiler ) );
+	profiler.name = "test";
+	prod = profile_trace_prod;
+	for ( i = 0 ; i < ( PROFILE_TRACE_SIZE + 1 ) ; i++ ) {
+		profile_start_at ( &profiler, ( 1000 * i ) );
+		profile_stop_at ( &profiler, ( ( 1000 * i ) + i ) );
+	}
+	ok ( profile_trace_prod == ( prod + PROFILE_TRACE_SIZE + 1 ) );
+	ok ( profiler.count == ( PROFILE_TRACE_SIZE + 1 ) );
+
+	/* Check most recent event */
+	event = &profile_trace_ring[ ( profile_trace_prod - 1 ) %
+				     PROFILE_TRACE_SIZE ];
+	ok ( event->profiler == &profiler );
+	ok ( event->stopped == ( ( 1000 * PROFILE_TRACE_SIZE ) +
+				 PROFILE_TRACE_SIZE ) );
+	ok ( event->elapsed == PROFILE_TRACE_SIZE );
+
+	/* Check oldest surviving event */
+	event = &profile_trace_ring[ profile_trace_prod % PROFILE_TRACE_SIZE ];
+	ok ( event->profiler == &profiler );
+	ok ( event->elapsed == 1 );
+}
+
 /**
  * Perform profiling self-tests
  *
@@ -135,6 +219,10 @@ static void profile_test_exec ( void ) {
 	profile_ok ( &small );
 	profile_ok ( &random );
 	profile_ok ( &large );
+
+	/* Perform histogram and trace tests */
+	profile_hist_test();
+	profile_trace_test();
 }
 
 /** Profiling self-test */
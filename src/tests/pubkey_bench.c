@@ -0,0 +1,204 @@
+/*
+ * Copyright (C) 2026 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * Public-key algorithm benchmarks
+ *
+ */
+
+/* Forcibly enable profiling */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ipxe/crypto.h>
+#include <ipxe/bigint.h>
+#include <ipxe/x25519.h>
+#include <ipxe/p256.h>
+#include <ipxe/p384.h>
+#include <ipxe/ffdhe.h>
+#include <ipxe/bench.h>
+
+/** Number of iterations for each public-key benchmark
+ *
+ * Public-key operations are several orders of magnitude slower than
+ * bulk data operations.
+ */
+#define PUBKEY_BENCH_COUNT 8
+
+/** Key exchange algorithms */
+static struct exchange_algorithm *pubkey_bench_exchanges[] = {
+	&x25519_algorithm,
+	&p256_algorithm,
+	&p384_algorithm,
+	&ffdhe2048_algorithm,
+	&ffdhe3072_algorithm,
+	&ffdhe4096_algorithm,
+};
+
+/**
+ * Benchmark key exchange algorithm
+ *
+ * @v exchange		Key exchange algorithm
+ */
+static void pubkey_bench_exchange ( struct exchange_algorithm *exchange ) {
+	uint8_t private[exchange->privsize];
+	uint8_t public[exchange->pubsize];
+	struct profiler profiler;
+	char name[32];
+	unsigned int i;
+	int rc;
+
+	/* Generate pseudo-random private key (ensuring that it is
+	 * smaller than the group order for all supported algorithms).
+	 */
+	for ( i = 0 ; i < sizeof ( private ) ; i++ )
+		private[i] = rand();
+	private[0] &= 0x7f;
+
+	/* Profile public key calculation */
+	memset ( &profiler, 0, sizeof ( profiler ) );
+	for ( i = 0 ; i < PUBKEY_BENCH_COUNT ; i++ ) {
+		profile_start ( &profiler );
+		rc = exchange_share ( exchange, private, public );
+		profile_stop ( &profiler );
+		if ( rc != 0 ) {
+			printf ( "%s: failed: %s\n",
+				 exchange->name, strerror ( rc ) );
+			return;
+		}
+	}
+
+	snprintf ( name, sizeof ( name ), "%s share", exchange->name );
+	bench_report ( name, &profiler, 0 );
+}
+
+/**
+ * Benchmark RSA modular exponentiation
+ *
+ * @v bits		Modulus length (in bits)
+ * @v public		Use a public (rather than private) exponent
+ */
+static void pubkey_bench_rsa ( unsigned int bits, int public ) {
+	static const uint8_t public_exponent[] = { 0x01, 0x00, 0x01 };
+	size_t len = ( bits / 8 );
+	size_t exponent_len = ( public ? sizeof ( public_exponent ) : len );
+	unsigned int size = bigint_required_size ( len );
+	unsigned int exponent_size = bigint_required_size ( exponent_len );
+	bigint_t ( size ) *modulus;
+	size_t tmp_len = bigint_mod_exp_tmp_len ( modulus );
+	struct {
+		bigint_t ( size ) modulus;
+		bigint_t ( exponent_size ) exponent;
+		bigint_t ( size ) base;
+		bigint_t ( size ) result;
+		uint8_t tmp[tmp_len];
+	} __attribute__ (( packed )) *dynamic;
+	uint8_t raw[len];
+	struct profiler profiler;
+	char name[32];
+	unsigned int i;
+
+	/* Allocate big integers */
+	dynamic = malloc ( sizeof ( *dynamic ) );
+	if ( ! dynamic ) {
+		printf ( "rsa-%d: out of memory\n", bits );
+		return;
+	}
+
+	/* Generate pseudo-random odd modulus with the top bit set */
+	for ( i = 0 ; i < len ; i++ )
+		raw[i] = rand();
+	raw[0] |= 0x80;
+	raw[ len - 1 ] |= 0x01;
+	bigint_init ( &dynamic->modulus, raw, len );
+
+	/* Generate pseudo-random exponent */
+	if ( public ) {
+		bigint_init ( &dynamic->exponent, public_exponent,
+			      sizeof ( public_exponent ) );
+	} else {
+		for ( i = 0 ; i < len ; i++ )
+			raw[i] = rand();
+		bigint_init ( &dynamic->exponent, raw, len );
+	}
+
+	/* Generate pseudo-random base smaller than the modulus */
+	for ( i = 0 ; i < len ; i++ )
+		raw[i] = rand();
+	raw[0] &= 0x7f;
+	bigint_init ( &dynamic->base, raw, len );
+
+	/* Profile modular exponentiation */
+	memset ( &profiler, 0, sizeof ( profiler ) );
+	for ( i = 0 ; i < PUBKEY_BENCH_COUNT ; i++ ) {
+		profile_start ( &profiler );
+		bigint_mod_exp ( &dynamic->base, &dynamic->modulus,
+				 &dynamic->exponent, &dynamic->result,
+				 dynamic->tmp );
+		profile_stop ( &profiler );
+	}
+
+	snprintf ( name, sizeof ( name ), "rsa-%d %s", bits,
+		   ( public ? "public" : "private" ) );
+	bench_report ( name, &profiler, 0 );
+
+	/* Free big integers */
+	free ( dynamic );
+}
+
+/**
+ * Perform public-key algorithm benchmarks
+ *
+ */
+static void pubkey_bench_exec ( void ) {
+	unsigned int i;
+
+	/* Use reproducible pseudo-random data */
+	srand ( 0x7075626b );
+
+	/* Perform key exchange benchmarks */
+	for ( i = 0 ; i < ( sizeof ( pubkey_bench_exchanges ) /
+			    sizeof ( pubkey_bench_exchanges[0] ) ) ; i++ ) {
+		pubkey_bench_exchange ( pubkey_bench_exchanges[i] );
+	}
+
+	/* Perform RSA benchmarks */
+	pubkey_bench_rsa ( 1024, 1 );
+	pubkey_bench_rsa ( 1024, 0 );
+	pubkey_bench_rsa ( 2048, 1 );
+	pubkey_bench_rsa ( 2048, 0 );
+	pubkey_bench_rsa ( 4096, 1 );
+	pubkey_bench_rsa ( 4096, 0 );
+}
+
+/** Public-key algorithm benchmark */
+struct benchmark pubkey_bench __benchmark = {
+	.name = "pubkey",
+	.exec = pubkey_bench_exec,
+};
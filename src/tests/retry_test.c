@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2026 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * Retry timer tests
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <string.h>
+#include <ipxe/timer.h>
+#include <ipxe/retry.h>
+#include <ipxe/test.h>
+
+/** A retry timer test */
+struct retry_test {
+	/** Retry timer */
+	struct retry_timer timer;
+	/** Number of expiries */
+	unsigned int expired;
+	/** Timer to stop on expiry, if any */
+	struct retry_test *stop;
+	/** Number of times to restart on expiry */
+	unsigned int restart;
+};
+
+/**
+ * Handle retry timer test expiry
+ *
+ * @v timer		Retry timer
+ * @v over		Failure indicator
+ */
+static void retry_test_expired ( struct retry_timer *timer, int over __unused ){
+	struct retry_test *test =
+		container_of ( timer, struct retry_test, timer );
+
+	test->expired++;
+	if ( test->stop )
+		stop_timer ( &test->stop->timer );
+	if ( test->restart ) {
+		test->restart--;
+		start_timer_nodelay ( timer );
+	}
+}
+
+/** Retry timer tests */
+static struct retry_test retry_tests[3];
+
+/**
+ * Reset retry timer tests
+ *
+ */
+static void retry_test_reset ( void ) {
+	struct retry_test *test;
+	unsigned int i;
+
+	for ( i = 0 ; i < ( sizeof ( retry_tests ) /
+			    sizeof ( retry_tests[0] ) ) ; i++ ) {
+		test = &retry_tests[i];
+		stop_timer ( &test->timer );
+		memset ( test, 0, sizeof ( *test ) );
+		timer_init ( &test->timer, retry_test_expired, NULL );
+	}
+}
+
+/**
+ * Perform retry timer self-tests
+ *
+ */
+static void retry_test_exec ( void ) {
+	struct retry_test *a = &retry_tests[0];
+	struct retry_test *b = &retry_tests[1];
+	struct retry_test *c = &retry_tests[2];
+	unsigned long timeout;
+	unsigned long remaining;
+
+	/* Multiple expiries should be processed in a single poll */
+	retry_test_reset();
+	start_timer_nodelay ( &a->timer );
+	start_timer_nodelay ( &b->timer );
+	start_timer_nodelay ( &c->timer );
+	ok ( retry_remaining() == 0 );
+	retry_poll();
+	ok ( a->expired == 1 );
+	ok ( b->expired == 1 );
+	ok ( c->expired == 1 );
+	ok ( ! timer_running ( &a->timer ) );
+	ok ( ! timer_running ( &b->timer ) );
+	ok ( ! timer_running ( &c->timer ) );
+
+	/* Expiry handler should be able to stop a pending timer */
+	retry_test_reset();
+	a->stop = b;
+	b->stop = a;
+	start_timer_nodelay ( &a->timer );
+	start_timer_nodelay ( &b->timer );
+	retry_poll();
+	ok ( ( a->expired + b->expired ) == 1 );
+	ok ( ! timer_running ( &a->timer ) );
+	ok ( ! timer_running ( &b->timer ) );
+
+	/* Expiry handler should be able to restart its own timer
+	 * without the restarted timer being deferred
+	 */
+	retry_test_reset();
+	a->restart = 1;
+	start_timer_nodelay ( &a->timer );
+	retry_poll();
+	ok ( a->expired >= 1 );
+	retry_poll();
+	ok ( a->expired == 2 );
+	ok ( ! timer_running ( &a->timer ) );
+
+	/* Timers beyond one revolution of the wheel should not expire
+	 * early, and should be reported as the next deadline.
+	 */
+	retry_test_reset();
+	timeout = ( 10 * TICKS_PER_SEC );
+	start_timer_fixed ( &a->timer, timeout );
+	start_timer_fixed ( &b->timer, ( 2 * timeout ) );
+	retry_poll();
+	ok ( a->expired == 0 );
+	ok ( b->expired == 0 );
+	ok ( timer_running ( &a->timer ) );
+	remaining = retry_remaining();
+	ok ( remaining <= timeout );
+	ok ( remaining >= ( timeout - TICKS_PER_SEC ) );
+
+	/* Restarting a timer should update the next deadline */
+	start_timer_nodelay ( &b->timer );
+	ok ( retry_remaining() == 0 );
+	retry_poll();
+	ok ( b->expired == 1 );
+	ok ( a->expired == 0 );
+
+	/* Clean up */
+	retry_test_reset();
+	ok ( ! timer_running ( &a->timer ) );
+}
+
+/** Retry timer self-test */
+struct self_test retry_test __self_test = {
+	.name = "retry",
+	.exec = retry_test_exec,
+};
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2026 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * TCP/IP checksum benchmarks
+ *
+ */
+
+/* Forcibly enable profiling */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ipxe/tcpip.h>
+#include <ipxe/bench.h>
+
+/** Largest buffer length */
+#define TCPIP_BENCH_MAX_LEN 65536
+
+/** Checksummed data */
+static uint8_t tcpip_bench_data[ TCPIP_BENCH_MAX_LEN + 1 ];
+
+/** Copied data */
+static uint8_t tcpip_bench_copy[ TCPIP_BENCH_MAX_LEN + 1 ];
+
+/**
+ * Benchmark TCP/IP checksum calculation
+ *
+ * @v len		Length
+ * @v offset		Misalignment offset
+ */
+static void tcpip_bench_chksum ( size_t len, unsigned int offset ) {
+	struct profiler profiler;
+	char name[32];
+	unsigned int i;
+
+	/* Profile checksum calculation */
+	memset ( &profiler, 0, sizeof ( profiler ) );
+	for ( i = 0 ; i < BENCH_COUNT ; i++ ) {
+		profile_start ( &profiler );
+		tcpip_chksum ( ( tcpip_bench_data + offset ), len );
+		profile_stop ( &profiler );
+	}
+
+	snprintf ( name, sizeof ( name ), "tcpip_chksum %zd+%d", len, offset );
+	bench_report ( name, &profiler, len );
+}
+
+/**
+ * Benchmark TCP/IP copy and checksum calculation
+ *
+ * @v len		Length
+ * @v offset		Misalignment offset
+ * @v fused		Use combined copy-and-checksum
+ */
+static void tcpip_bench_copy_chksum ( size_t len, unsigned int offset,
+				      int fused ) {
+	struct profiler profiler;
+	void *dest = ( tcpip_bench_copy + offset );
+	void *src = ( tcpip_bench_data + offset );
+	char name[32];
+	unsigned int i;
+
+	/* Profile copy and checksum calculation */
+	memset ( &profiler, 0, sizeof ( profiler ) );
+	for ( i = 0 ; i < BENCH_COUNT ; i++ ) {
+		profile_start ( &profiler );
+		if ( fused ) {
+			tcpip_copy_chksum ( TCPIP_EMPTY_CSUM, dest, src, len );
+		} else {
+			memcpy ( dest, src, len );
+			tcpip_chksum ( dest, len );
+		}
+		profile_stop ( &profiler );
+	}
+
+	snprintf ( name, sizeof ( name ), "%s %zd+%d",
+		   ( fused ? "tcpip_copy_chksum" : "memcpy+chksum" ),
+		   len, offset );
+	bench_report ( name, &profiler, len );
+}
+
+/**
+ * Perform TCP/IP checksum benchmarks
+ *
+ */
+static void tcpip_bench_exec ( void ) {
+	unsigned int i;
+
+	/* Fill buffer with pseudo-random data */
+	srand ( 0x74637069 );
+	for ( i = 0 ; i < sizeof ( tcpip_bench_data ) ; i++ )
+		tcpip_bench_data[i] = rand();
+
+	/* Perform benchmarks */
+	tcpip_bench_chksum ( 20, 0 );
+	tcpip_bench_chksum ( 1460, 0 );
+	tcpip_bench_chksum ( 1460, 1 );
+	tcpip_bench_chksum ( TCPIP_BENCH_MAX_LEN, 0 );
+	tcpip_bench_chksum ( TCPIP_BENCH_MAX_LEN, 1 );
+	tcpip_bench_copy_chksum ( 1460, 0, 0 );
+	tcpip_bench_copy_chksum ( 1460, 0, 1 );
+	tcpip_bench_copy_chksum ( TCPIP_BENCH_MAX_LEN, 0, 0 );
+	tcpip_bench_copy_chksum ( TCPIP_BENCH_MAX_LEN, 0, 1 );
+}
+
+/** TCP/IP checksum benchmark */
+struct benchmark tcpip_bench __benchmark = {
+	.name = "tcpip",
+	.exec = tcpip_bench_exec,
+};
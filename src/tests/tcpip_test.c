@@ -38,6 +38,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <assert.h>
 #include <ipxe/test.h>
 #include <ipxe/profile.h>
+#include <ipxe/iobuf.h>
 #include <ipxe/tcpip.h>
 
 /** Number of sample iterations for profiling */
@@ -85,6 +86,10 @@ struct tcpip_random_test {
 static uint8_t __attribute__ (( aligned ( 16 ) ))
 	tcpip_data[ 4096 + 7 /* offset */ ];
 
+/** Buffer for copy-and-checksum tests */
+static uint8_t __attribute__ (( aligned ( 16 ) ))
+	tcpip_copy[ 4096 + 7 /* offset */ ];
+
 /** Empty data */
 TCPIP_TEST ( empty, DATA() );
 
@@ -108,6 +113,17 @@ TCPIP_TEST ( final_carry_big,
 TCPIP_TEST ( final_carry_little,
 	     DATA ( 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00 ) );
 
+/** Negative zero data spanning several machine words */
+TCPIP_TEST ( negative_zero_long,
+	     DATA ( 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+		    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+		    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+		    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+		    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+		    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+		    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+		    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff ) );
+
 /** Random data (aligned) */
 TCPIP_RANDOM_TEST ( random_aligned, 0x12345678UL, 4096, 0 );
 
@@ -164,6 +180,38 @@ static uint16_t rfc_tcpip_chksum ( const void *data, size_t len ) {
 	return ~sum;
 }
 
+/**
+ * Verify TCP/IP copy-and-checksum results
+ *
+ * @v data		Data to copy and sum
+ * @v len		Length of data
+ * @v offset		Destination alignment offset
+ * @v expected		Expected checksum
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void tcpip_copy_okx ( const void *data, size_t len, size_t offset,
+			     uint16_t expected, const char *file,
+			     unsigned int line ) {
+	uint8_t *copy = ( tcpip_copy + offset );
+	uint16_t sum;
+
+	/* Sanity check */
+	assert ( ( len + offset ) <= sizeof ( tcpip_copy ) );
+
+	/* Verify generic_tcpip_copy_chksum() result */
+	memset ( tcpip_copy, 0, sizeof ( tcpip_copy ) );
+	sum = generic_tcpip_copy_chksum ( TCPIP_EMPTY_CSUM, copy, data, len );
+	okx ( sum == expected, file, line );
+	okx ( memcmp ( copy, data, len ) == 0, file, line );
+
+	/* Verify optimised tcpip_copy_chksum() result */
+	memset ( tcpip_copy, 0, sizeof ( tcpip_copy ) );
+	sum = tcpip_copy_chksum ( TCPIP_EMPTY_CSUM, copy, data, len );
+	okx ( sum == expected, file, line );
+	okx ( memcmp ( copy, data, len ) == 0, file, line );
+}
+
 /**
  * Report TCP/IP fixed-data test result
  *
@@ -186,6 +234,9 @@ static void tcpip_okx ( struct tcpip_test *test, const char *file,
 	/* Verify optimised tcpip_continue_chksum() result */
 	sum = tcpip_continue_chksum ( TCPIP_EMPTY_CSUM, test->data, test->len );
 	okx ( sum == expected, file, line );
+
+	/* Verify copy-and-checksum results */
+	tcpip_copy_okx ( test->data, test->len, 0, expected, file, line );
 }
 #define tcpip_ok( test ) tcpip_okx ( test, __FILE__, __LINE__ )
 
@@ -223,6 +274,13 @@ static void tcpip_random_okx ( struct tcpip_random_test *test,
 	sum = tcpip_continue_chksum ( TCPIP_EMPTY_CSUM, data, test->len );
 	okx ( sum == expected, file, line );
 
+	/* Verify copy-and-checksum results, with both the same and a
+	 * different destination alignment.
+	 */
+	tcpip_copy_okx ( data, test->len, test->offset, expected, file, line );
+	tcpip_copy_okx ( data, test->len, ( 7 - test->offset ), expected,
+			 file, line );
+
 	/* Profile optimised calculation */
 	memset ( &profiler, 0, sizeof ( profiler ) );
 	for ( i = 0 ; i < PROFILE_COUNT ; i++ ) {
@@ -237,6 +295,54 @@ static void tcpip_random_okx ( struct tcpip_random_test *test,
 }
 #define tcpip_random_ok( test ) tcpip_random_okx ( test, __FILE__, __LINE__ )
 
+/**
+ * Report partial checksum completion test result
+ *
+ * @v seed		Random seed
+ * @v len		Length of packet
+ * @v start		Offset at which to start checksumming
+ * @v offset		Offset of checksum field (relative to start)
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void tcpip_complete_okx ( unsigned long seed, size_t len, size_t start,
+				 size_t offset, const char *file,
+				 unsigned int line ) {
+	struct io_buffer *iobuf;
+	uint8_t *data;
+	uint16_t *csum;
+	uint16_t expected;
+	unsigned int i;
+
+	/* Construct packet with random contents, including a random
+	 * pseudo-header sum in the checksum field.
+	 */
+	iobuf = alloc_iob ( len );
+	okx ( iobuf != NULL, file, line );
+	if ( ! iobuf )
+		return;
+	data = iob_put ( iobuf, len );
+	srandom ( seed );
+	for ( i = 0 ; i < len ; i++ )
+		data[i] = random();
+	csum = ( ( ( void * ) data ) + start + offset );
+	expected = rfc_tcpip_chksum ( ( data + start ), ( len - start ) );
+
+	/* Complete checksum and verify result */
+	okx ( tcpip_complete_chksum ( iobuf, start, offset ) == 0, file, line );
+	okx ( *csum == expected, file, line );
+
+	/* Verify that out-of-range offsets are rejected */
+	okx ( tcpip_complete_chksum ( iobuf, ( len + 1 ), 0 ) != 0,
+	      file, line );
+	okx ( tcpip_complete_chksum ( iobuf, start, ( len - start - 1 ) )
+	      != 0, file, line );
+
+	free_iob ( iobuf );
+}
+#define tcpip_complete_ok( seed, len, start, offset ) \
+	tcpip_complete_okx ( seed, len, start, offset, __FILE__, __LINE__ )
+
 /**
  * Perform TCP/IP self-tests
  *
@@ -250,11 +356,14 @@ static void tcpip_test_exec ( void ) {
 	tcpip_ok ( &negative_zero );
 	tcpip_ok ( &final_carry_big );
 	tcpip_ok ( &final_carry_little );
+	tcpip_ok ( &negative_zero_long );
 	tcpip_random_ok ( &random_aligned );
 	tcpip_random_ok ( &random_unaligned_1 );
 	tcpip_random_ok ( &random_unaligned_2 );
 	tcpip_random_ok ( &random_aligned_truncated );
 	tcpip_random_ok ( &partial );
+	tcpip_complete_ok ( 0x8badf00d, 74, 34, 16 );
+	tcpip_complete_ok ( 0xfeedface, 1295, 54, 6 );
 }
 
 /** TCP/IP self-test */
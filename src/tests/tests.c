@@ -95,3 +95,10 @@ REQUIRE_OBJECT ( hkdf_test );
 REQUIRE_OBJECT ( ffdhe_test );
 REQUIRE_OBJECT ( mime_test );
 REQUIRE_OBJECT ( datauri_test );
+REQUIRE_OBJECT ( malloc_test );
+REQUIRE_OBJECT ( xferbuf_test );
+REQUIRE_OBJECT ( retry_test );
+REQUIRE_OBJECT ( process_test );
+REQUIRE_OBJECT ( netem_test );
+REQUIRE_OBJECT ( fragment_test );
+REQUIRE_OBJECT ( udp_test );
@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2026 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * UDP demultiplexing tests
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <byteswap.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/in.h>
+#include <ipxe/ip.h>
+#include <ipxe/ipstat.h>
+#include <ipxe/interface.h>
+#include <ipxe/xfer.h>
+#include <ipxe/udp.h>
+#include <ipxe/test.h>
+
+/** Local port used by bound test connections */
+#define UDP_TEST_PORT 3917
+
+/** A UDP test connection */
+struct udp_test_conn {
+	/** Reference count */
+	struct refcnt refcnt;
+	/** Data transfer interface */
+	struct interface xfer;
+	/** Number of datagrams received */
+	unsigned int count;
+};
+
+/** UDP test statistics */
+static struct ip_statistics udp_test_stats;
+
+/**
+ * Receive datagram
+ *
+ * @v conn		UDP test connection
+ * @v iobuf		I/O buffer
+ * @v meta		Data transfer metadata
+ * @ret rc		Return status code
+ */
+static int udp_test_deliver ( struct udp_test_conn *conn,
+			      struct io_buffer *iobuf,
+			      struct xfer_metadata *meta __unused ) {
+
+	conn->count++;
+	free_iob ( iobuf );
+	return 0;
+}
+
+/** UDP test connection interface operations */
+static struct interface_operation udp_test_xfer_operations[] = {
+	INTF_OP ( xfer_deliver, struct udp_test_conn *, udp_test_deliver ),
+};
+
+/** UDP test connection interface descriptor */
+static struct interface_descriptor udp_test_xfer_desc =
+	INTF_DESC ( struct udp_test_conn, xfer, udp_test_xfer_operations );
+
+/**
+ * Initialise UDP test connection
+ *
+ * @v conn		UDP test connection
+ */
+static void udp_test_init ( struct udp_test_conn *conn ) {
+
+	memset ( conn, 0, sizeof ( *conn ) );
+	ref_init ( &conn->refcnt, NULL );
+	intf_init ( &conn->xfer, &udp_test_xfer_desc, &conn->refcnt );
+}
+
+/**
+ * Open bound UDP test connection
+ *
+ * @v conn		UDP test connection
+ * @v port		Local port
+ * @ret rc		Return status code
+ */
+static int udp_test_open ( struct udp_test_conn *conn, unsigned int port ) {
+	struct sockaddr_in peer;
+	struct sockaddr_in local;
+
+	udp_test_init ( conn );
+	memset ( &peer, 0, sizeof ( peer ) );
+	peer.sin_family = AF_INET;
+	peer.sin_addr.s_addr = htonl ( 0xc0a80001UL );
+	peer.sin_port = htons ( 69 );
+	memset ( &local, 0, sizeof ( local ) );
+	local.sin_port = htons ( port );
+	return udp_open ( &conn->xfer, ( struct sockaddr * ) &peer,
+			  ( struct sockaddr * ) &local );
+}
+
+/**
+ * Open promiscuous UDP test connection
+ *
+ * @v conn		UDP test connection
+ * @ret rc		Return status code
+ */
+static int udp_test_open_promisc ( struct udp_test_conn *conn ) {
+
+	udp_test_init ( conn );
+	return udp_open_promisc ( &conn->xfer );
+}
+
+/**
+ * Receive test datagram
+ *
+ * @v port		Destination port
+ * @ret rc		Return status code
+ */
+static int udp_test_rx ( unsigned int port ) {
+	struct sockaddr_tcpip st_src;
+	struct sockaddr_tcpip st_dest;
+	struct udp_header *udphdr;
+	struct io_buffer *iobuf;
+
+	/* Construct datagram (without checksum) */
+	iobuf = alloc_iob ( sizeof ( *udphdr ) + 4 );
+	assert ( iobuf != NULL );
+	udphdr = iob_put ( iobuf, sizeof ( *udphdr ) );
+	udphdr->src = htons ( 69 );
+	udphdr->dest = htons ( port );
+	udphdr->len = htons ( sizeof ( *udphdr ) + 4 );
+	udphdr->chksum = 0;
+	memset ( iob_put ( iobuf, 4 ), 0x5a, 4 );
+
+	/* Hand off to UDP */
+	memset ( &st_src, 0, sizeof ( st_src ) );
+	st_src.st_family = AF_INET;
+	memset ( &st_dest, 0, sizeof ( st_dest ) );
+	st_dest.st_family = AF_INET;
+	return tcpip_rx ( iobuf, NULL, IP_UDP, &st_src, &st_dest, 0,
+			  &udp_test_stats );
+}
+
+/**
+ * Perform UDP self-tests
+ *
+ */
+static void udp_test_exec ( void ) {
+	struct udp_test_conn bound;
+	struct udp_test_conn other;
+	struct udp_test_conn promisc;
+	struct udp_test_conn dup;
+
+	/* Open a bound connection, followed by a promiscuous
+	 * connection and a second bound connection.  The promiscuous
+	 * connection is opened after the first bound connection, and
+	 * so precedes it in any list of connections ordered by age.
+	 */
+	ok ( udp_test_open ( &bound, UDP_TEST_PORT ) == 0 );
+	ok ( udp_test_open_promisc ( &promisc ) == 0 );
+	ok ( udp_test_open ( &other, ( UDP_TEST_PORT + 1 ) ) == 0 );
+
+	/* A second connection may not bind to the same port */
+	ok ( udp_test_open ( &dup, UDP_TEST_PORT ) != 0 );
+
+	/* Bound connections should take precedence */
+	ok ( udp_test_rx ( UDP_TEST_PORT ) == 0 );
+	ok ( bound.count == 1 );
+	ok ( other.count == 0 );
+	ok ( promisc.count == 0 );
+	ok ( udp_test_rx ( UDP_TEST_PORT + 1 ) == 0 );
+	ok ( bound.count == 1 );
+	ok ( other.count == 1 );
+	ok ( promisc.count == 0 );
+
+	/* Unbound ports should be handled by the promiscuous connection */
+	ok ( udp_test_rx ( UDP_TEST_PORT + 2 ) == 0 );
+	ok ( bound.count == 1 );
+	ok ( other.count == 1 );
+	ok ( promisc.count == 1 );
+
+	/* Closing the promiscuous connection should leave unbound
+	 * ports with no connection
+	 */
+	intf_shutdown ( &promisc.xfer, 0 );
+	ok ( udp_test_rx ( UDP_TEST_PORT + 2 ) != 0 );
+	ok ( promisc.count == 1 );
+
+	/* Closing a bound connection should leave its port unbound */
+	intf_shutdown ( &bound.xfer, 0 );
+	ok ( udp_test_rx ( UDP_TEST_PORT ) != 0 );
+	ok ( bound.count == 1 );
+	ok ( udp_test_rx ( UDP_TEST_PORT + 1 ) == 0 );
+	ok ( other.count == 2 );
+	intf_shutdown ( &other.xfer, 0 );
+}
+
+/** UDP self-test */
+struct self_test udp_test __self_test = {
+	.name = "udp",
+	.exec = udp_test_exec,
+};
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2026 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * Data transfer buffer benchmarks
+ *
+ */
+
+/* Forcibly enable profiling */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/xfer.h>
+#include <ipxe/xferbuf.h>
+#include <ipxe/image.h>
+#include <ipxe/bench.h>
+
+/** Length of each packet in streamed download */
+#define XFERBUF_BENCH_PACKET_LEN 1460
+
+/** Total length of streamed download */
+#define XFERBUF_BENCH_STREAM_LEN ( 256 * 1024 * 1024 )
+
+/**
+ * Benchmark streamed download
+ *
+ * @v name		Benchmark name
+ * @v xferbuf		Data transfer buffer
+ *
+ * Deliver a long stream of packets of unknown total length, as would
+ * happen for a chunked HTTP response or a TFTP transfer without a
+ * "tsize" option.
+ */
+static void xferbuf_bench_stream ( const char *name,
+				   struct xfer_buffer *xferbuf ) {
+	struct xfer_metadata meta;
+	struct io_buffer *iobuf;
+	struct profiler profiler;
+	size_t offset;
+	size_t len;
+	int rc;
+
+	/* Profile delivery of each packet */
+	memset ( &meta, 0, sizeof ( meta ) );
+	memset ( &profiler, 0, sizeof ( profiler ) );
+	for ( offset = 0 ; offset < XFERBUF_BENCH_STREAM_LEN ;
+	      offset += len ) {
+		len = ( XFERBUF_BENCH_STREAM_LEN - offset );
+		if ( len > XFERBUF_BENCH_PACKET_LEN )
+			len = XFERBUF_BENCH_PACKET_LEN;
+		iobuf = alloc_iob ( len );
+		if ( ! iobuf )
+			break;
+		memset ( iob_put ( iobuf, len ), offset, len );
+		profile_start ( &profiler );
+		rc = xferbuf_deliver ( xferbuf, iobuf, &meta );
+		profile_stop ( &profiler );
+		if ( rc != 0 )
+			break;
+	}
+	if ( offset < XFERBUF_BENCH_STREAM_LEN ) {
+		printf ( "%s: failed after %zd bytes\n", name, offset );
+		return;
+	}
+
+	bench_report ( name, &profiler, XFERBUF_BENCH_PACKET_LEN );
+}
+
+/**
+ * Perform data transfer buffer benchmarks
+ *
+ */
+static void xferbuf_bench_exec ( void ) {
+	struct xfer_buffer xferbuf;
+	struct image *image;
+
+	/* Stream into umalloc()-based buffer */
+	memset ( &xferbuf, 0, sizeof ( xferbuf ) );
+	xferbuf_umalloc_init ( &xferbuf );
+	xferbuf_bench_stream ( "xferbuf umalloc stream", &xferbuf );
+	xferbuf_free ( &xferbuf );
+
+	/* Stream into image-based buffer */
+	image = alloc_image ( NULL );
+	if ( ! image )
+		return;
+	memset ( &xferbuf, 0, sizeof ( xferbuf ) );
+	xferbuf_image_init ( &xferbuf, image );
+	xferbuf_bench_stream ( "xferbuf image stream", &xferbuf );
+	xferbuf_free ( &xferbuf );
+	image_put ( image );
+}
+
+/** Data transfer buffer benchmark */
+struct benchmark xferbuf_bench __benchmark = {
+	.name = "xferbuf",
+	.exec = xferbuf_bench_exec,
+};
@@ -0,0 +1,272 @@
+/*
+ * Copyright (C) 2026 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * Data transfer buffer tests
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <string.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/xfer.h>
+#include <ipxe/xferbuf.h>
+#include <ipxe/image.h>
+#include <ipxe/test.h>
+
+/** Length of each packet in streamed download */
+#define XFERBUF_TEST_PACKET_LEN 1460
+
+/** Total length of streamed download */
+#define XFERBUF_TEST_STREAM_LEN ( 1024 * 1024 )
+
+/** Maximum number of reallocations permitted for streamed download */
+#define XFERBUF_TEST_MAX_REALLOCS 32
+
+/** Number of reallocations performed */
+static unsigned int xferbuf_test_reallocs;
+
+/**
+ * Reallocate counted umalloc()-based data transfer buffer
+ *
+ * @v xferbuf		Data transfer buffer
+ * @v len		New length (or zero to free buffer)
+ * @ret rc		Return status code
+ */
+static int xferbuf_test_realloc ( struct xfer_buffer *xferbuf, size_t len ) {
+
+	xferbuf_test_reallocs++;
+	return xferbuf_umalloc_operations.realloc ( xferbuf, len );
+}
+
+/**
+ * Access counted umalloc()-based data transfer buffer
+ *
+ * @v xferbuf		Data transfer buffer
+ * @ret raw		Raw data pointer
+ */
+static void * xferbuf_test_access ( struct xfer_buffer *xferbuf ) {
+
+	return xferbuf_umalloc_operations.access ( xferbuf );
+}
+
+/** Counted umalloc()-based data buffer operations */
+static struct xfer_buffer_operations xferbuf_test_operations = {
+	.realloc = xferbuf_test_realloc,
+	.access = xferbuf_test_access,
+};
+
+/**
+ * Perform malloc()-based data transfer buffer tests
+ *
+ */
+static void xferbuf_test_malloc ( void ) {
+	static const char hello[] = "hello";
+	static const char world[] = "world";
+	struct xfer_buffer xferbuf;
+	char buf[ sizeof ( hello ) ];
+
+	/* Write data, leaving a gap */
+	memset ( &xferbuf, 0, sizeof ( xferbuf ) );
+	xferbuf_malloc_init ( &xferbuf );
+	ok ( xferbuf_write ( &xferbuf, 0, hello, sizeof ( hello ) ) == 0 );
+	ok ( xferbuf.len == sizeof ( hello ) );
+	ok ( xferbuf.size == sizeof ( hello ) );
+	ok ( xferbuf_write ( &xferbuf, 100, world, sizeof ( world ) ) == 0 );
+	ok ( xferbuf.len == ( 100 + sizeof ( world ) ) );
+	ok ( xferbuf.size >= xferbuf.len );
+
+	/* Read back data */
+	ok ( xferbuf_read ( &xferbuf, 0, buf, sizeof ( buf ) ) == 0 );
+	ok ( memcmp ( buf, hello, sizeof ( hello ) ) == 0 );
+	ok ( xferbuf_read ( &xferbuf, 100, buf, sizeof ( buf ) ) == 0 );
+	ok ( memcmp ( buf, world, sizeof ( world ) ) == 0 );
+
+	/* Reads beyond the end of the data must fail, even if within
+	 * the allocated storage.
+	 */
+	ok ( xferbuf_read ( &xferbuf, 101, buf, sizeof ( buf ) ) != 0 );
+
+	/* Shrink to fit and read back data */
+	ok ( xferbuf_shrink ( &xferbuf ) == 0 );
+	ok ( xferbuf.size == xferbuf.len );
+	ok ( xferbuf_read ( &xferbuf, 100, buf, sizeof ( buf ) ) == 0 );
+	ok ( memcmp ( buf, world, sizeof ( world ) ) == 0 );
+
+	/* Free buffer */
+	xferbuf_free ( &xferbuf );
+	ok ( xferbuf.len == 0 );
+	ok ( xferbuf.size == 0 );
+}
+
+/**
+ * Perform fixed-size data transfer buffer tests
+ *
+ */
+static void xferbuf_test_fixed ( void ) {
+	struct xfer_buffer xferbuf;
+	uint8_t data[16];
+	uint8_t buf[ sizeof ( data ) + 1 ];
+
+	/* Writes within the buffer must succeed */
+	memset ( &xferbuf, 0, sizeof ( xferbuf ) );
+	memset ( buf, 0x5a, sizeof ( buf ) );
+	xferbuf_fixed_init ( &xferbuf, data, sizeof ( data ) );
+	ok ( xferbuf_write ( &xferbuf, 0, buf, sizeof ( data ) ) == 0 );
+	ok ( data[ sizeof ( data ) - 1 ] == 0x5a );
+
+	/* Writes beyond the buffer must fail */
+	ok ( xferbuf_write ( &xferbuf, 0, buf, sizeof ( buf ) ) != 0 );
+	ok ( xferbuf.len == sizeof ( data ) );
+	ok ( xferbuf.size == sizeof ( data ) );
+	ok ( xferbuf.max == sizeof ( buf ) );
+	ok ( xferbuf_shrink ( &xferbuf ) == 0 );
+}
+
+/**
+ * Perform image-based data transfer buffer tests
+ *
+ */
+static void xferbuf_test_image ( void ) {
+	static const char hello[] = "hello";
+	struct xfer_buffer xferbuf;
+	struct image *image;
+	unsigned int i;
+	size_t len;
+	int grown = 0;
+
+	/* Allocate image */
+	image = alloc_image ( NULL );
+	ok ( image != NULL );
+	if ( ! image )
+		return;
+	memset ( &xferbuf, 0, sizeof ( xferbuf ) );
+	xferbuf_image_init ( &xferbuf, image );
+
+	/* Image length must track the data written, not the
+	 * allocated storage.
+	 */
+	for ( i = 0 ; i < 16 ; i++ ) {
+		len = ( ( i + 1 ) * strlen ( hello ) );
+		ok ( xferbuf_write ( &xferbuf, ( i * strlen ( hello ) ), hello,
+				     strlen ( hello ) ) == 0 );
+		ok ( xferbuf.len == len );
+		ok ( image->len == len );
+		ok ( image->text[len] == '\0' );
+		if ( xferbuf.size > xferbuf.len )
+			grown = 1;
+	}
+	ok ( grown );
+	ok ( memcmp ( image->data, "hellohello", 10 ) == 0 );
+
+	/* Shrink to fit */
+	ok ( xferbuf_shrink ( &xferbuf ) == 0 );
+	ok ( xferbuf.size == xferbuf.len );
+	ok ( image->len == xferbuf.len );
+	ok ( image->text[image->len] == '\0' );
+
+	/* Free buffer */
+	xferbuf_free ( &xferbuf );
+	ok ( image->len == 0 );
+	image_put ( image );
+}
+
+/**
+ * Perform streamed download test
+ *
+ * Deliver a stream of packets of unknown total length into a
+ * umalloc()-based data transfer buffer, as would happen for a chunked
+ * HTTP response or a TFTP transfer without a "tsize" option.
+ */
+static void xferbuf_test_stream ( void ) {
+	struct xfer_buffer xferbuf;
+	struct xfer_metadata meta;
+	struct io_buffer *iobuf;
+	unsigned int corrupt = 0;
+	unsigned int count = 0;
+	uint8_t *data;
+	size_t offset;
+	size_t len;
+	int rc;
+
+	/* Deliver stream */
+	memset ( &xferbuf, 0, sizeof ( xferbuf ) );
+	memset ( &meta, 0, sizeof ( meta ) );
+	xferbuf.op = &xferbuf_test_operations;
+	xferbuf_test_reallocs = 0;
+	for ( offset = 0 ; offset < XFERBUF_TEST_STREAM_LEN ; offset += len ) {
+		len = ( XFERBUF_TEST_STREAM_LEN - offset );
+		if ( len > XFERBUF_TEST_PACKET_LEN )
+			len = XFERBUF_TEST_PACKET_LEN;
+		iobuf = alloc_iob ( len );
+		if ( ! iobuf )
+			break;
+		data = iob_put ( iobuf, len );
+		memset ( data, count, len );
+		rc = xferbuf_deliver ( &xferbuf, iobuf, &meta );
+		if ( rc != 0 )
+			break;
+		count++;
+	}
+	ok ( offset == XFERBUF_TEST_STREAM_LEN );
+	ok ( xferbuf.len == XFERBUF_TEST_STREAM_LEN );
+	ok ( xferbuf_test_reallocs <= XFERBUF_TEST_MAX_REALLOCS );
+
+	/* Shrink to fit and verify data */
+	ok ( xferbuf_shrink ( &xferbuf ) == 0 );
+	ok ( xferbuf.size == xferbuf.len );
+	data = xferbuf.data;
+	for ( offset = 0, count = 0 ; offset < xferbuf.len ;
+	      offset += XFERBUF_TEST_PACKET_LEN, count++ ) {
+		if ( data[offset] != ( ( uint8_t ) count ) )
+			corrupt++;
+	}
+	ok ( corrupt == 0 );
+
+	/* Free buffer */
+	xferbuf_free ( &xferbuf );
+}
+
+/**
+ * Perform data transfer buffer self-tests
+ *
+ */
+static void xferbuf_test_exec ( void ) {
+
+	xferbuf_test_malloc();
+	xferbuf_test_fixed();
+	xferbuf_test_image();
+	xferbuf_test_stream();
+}
+
+/** Data transfer buffer self-test */
+struct self_test xferbuf_test __self_test = {
+	.name = "xferbuf",
+	.exec = xferbuf_test_exec,
+};
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2026 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+FILE_SECBOOT ( PERMITTED );
+
+#include <stdio.h>
+#include <ipxe/malloc.h>
+#include <usr/heapstat.h>
+#include <config/general.h>
+
+/** @file
+ *
+ * Heap statistics
+ *
+ */
+
+/**
+ * Print heap statistics
+ *
+ * @v heap		Heap
+ */
+static void heapstat_heap ( struct heap *heap ) {
+#ifdef HEAP_SITES
+	struct heap_site *site;
+#endif
+	size_t largest;
+	unsigned int fragmented;
+	unsigned int i;
+
+	/* Print usage summary */
+	largest = heap_largest ( heap );
+	fragmented = ( heap->freemem ?
+		       ( ( heap->freemem - largest ) /
+			 ( ( heap->freemem + 99 ) / 100 ) ) : 0 );
+	printf ( "Heap: %zdkB used (peak %zdkB), %zdkB free in %d blocks "
+		 "(largest %zdkB, %d%% fragmented), %ld failures\n",
+		 ( heap->usedmem >> 10 ), ( heap->maxusedmem >> 10 ),
+		 ( heap->freemem >> 10 ), ( ( int ) heap->freeblocks ),
+		 ( largest >> 10 ), fragmented, heap->failures );
+
+	/* Print allocation size histogram */
+	for ( i = 0 ; i < HEAP_CLASSES ; i++ ) {
+		if ( ! heap->allocs[i] )
+			continue;
+		printf ( "Heap: %#zx-%#zx: %ld allocated, %ld in use\n",
+			 ( ( ( size_t ) 1 ) << i ),
+			 ( ( ( ( size_t ) 2 ) << i ) - 1 ),
+			 heap->allocs[i], heap->inuse[i] );
+	}
+
+#ifdef HEAP_SITES
+	/* Print allocation sites */
+	for ( i = 0 ; i < heap_num_sites ; i++ ) {
+		site = &heap_sites[i];
+		if ( ! site->caller )
+			continue;
+		printf ( "Heap: %p: %ld allocated (%ldkB), %ld failures\n",
+			 site->caller, site->allocs, ( site->size >> 10 ),
+			 site->failures );
+	}
+#endif
+}
+
+/**
+ * Print heap statistics
+ *
+ */
+void heapstat ( void ) {
+
+	heapstat_heap ( malloc_heap );
+}
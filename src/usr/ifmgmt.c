@@ -123,6 +123,13 @@ void ifstat ( struct net_device *netdev ) {
 		printf ( "  [Link status: %s]\n",
 			 strerror ( netdev->link_rc ) );
 	}
+	if ( netdev->state & ( NETDEV_RX_CSUM | NETDEV_TX_TSO ) ) {
+		printf ( "  [Offload:%s%s]\n",
+			 ( ( netdev->state & NETDEV_RX_CSUM ) ?
+			   " RX checksum" : "" ),
+			 ( ( netdev->state & NETDEV_TX_TSO ) ?
+			   " TX segmentation" : "" ) );
+	}
 	ifstat_errors ( &netdev->tx_stats, "TXE" );
 	ifstat_errors ( &netdev->rx_stats, "RXE" );
 }
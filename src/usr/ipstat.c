@@ -24,7 +24,11 @@
 FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 FILE_SECBOOT ( PERMITTED );
 
+#include <stdint.h>
 #include <stdio.h>
+#include <byteswap.h>
+#include <ipxe/socket.h>
+#include <ipxe/timer.h>
 #include <ipxe/tcp.h>
 #include <ipxe/ipstat.h>
 #include <usr/ipstat.h>
@@ -75,3 +79,49 @@ void ipstat ( void ) {
 	printf ( "  InDiscards:%ld InOutOfOrder:%ld\n",
 		 tcp_stats.in_discards, tcp_stats.in_out_of_order );
 }
+
+/**
+ * Calculate average throughput
+ *
+ * @v octets		Number of octets transferred
+ * @v ticks		Elapsed time (in ticks)
+ * @ret rate		Average throughput (in kB/s)
+ */
+static unsigned long tcpstat_rate ( unsigned long octets,
+				    unsigned long ticks ) {
+
+	if ( ! ticks )
+		return 0;
+	return ( ( ( ( uint64_t ) octets ) * TICKS_PER_SEC ) /
+		 ( ( ( uint64_t ) ticks ) * 1024 ) );
+}
+
+/**
+ * Print TCP connection statistics
+ *
+ */
+void tcpstat ( void ) {
+	struct tcp_info info;
+	unsigned int i;
+
+	/* Print per-connection statistics */
+	for ( i = 0 ; tcp_info ( i, &info ) == 0 ; i++ ) {
+		printf ( "TCP %d -> %s:%d %s\n", info.local_port,
+			 sock_ntoa ( ( struct sockaddr * ) &info.peer ),
+			 ntohs ( info.peer.st_port ), info.state );
+		printf ( "  SndWnd:%d SndScale:%d Cwnd:%d MSS:%zd%s%s\n",
+			 info.snd_win, info.snd_win_scale, info.cwnd,
+			 info.snd_mss, ( info.sack ? " SACK" : "" ),
+			 ( info.ts ? " TS" : "" ) );
+		printf ( "  RcvWnd:%d RcvScale:%d\n",
+			 info.rcv_win, info.rcv_win_scale );
+		printf ( "  SRTT:%ldms RTO:%ldms Retransmits:%ld "
+			 "OutOfOrder:%d\n", info.srtt, info.rto,
+			 info.retransmits, info.rx_queued );
+		printf ( "  InOctets:%ld (%ldkB/s) OutOctets:%ld (%ldkB/s)\n",
+			 info.in_octets,
+			 tcpstat_rate ( info.in_octets, info.age ),
+			 info.out_octets,
+			 tcpstat_rate ( info.out_octets, info.age ) );
+	}
+}
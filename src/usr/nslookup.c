@@ -28,6 +28,7 @@ FILE_SECBOOT ( PERMITTED );
 #include <ipxe/tcpip.h>
 #include <ipxe/monojob.h>
 #include <ipxe/settings.h>
+#include <ipxe/dns.h>
 #include <usr/nslookup.h>
 
 /** @file
@@ -202,3 +203,17 @@ int nslookup ( const char *name, const char *setting_name ) {
 
 	return 0;
 }
+
+/**
+ * Print DNS cache
+ *
+ */
+void dnscache ( void ) {
+	static struct dns_cache_info info;
+	unsigned int i;
+
+	for ( i = 0 ; dns_cache_info ( i, &info ) == 0 ; i++ ) {
+		printf ( "%s %s %s (TTL %lds)\n", info.name, info.type,
+			 info.value, info.ttl );
+	}
+}
@@ -26,6 +26,7 @@ FILE_SECBOOT ( PERMITTED );
 
 #include <stdio.h>
 #include <ipxe/profile.h>
+#include <usr/heapstat.h>
 #include <usr/profstat.h>
 
 /** @file
@@ -42,8 +43,59 @@ void profstat ( void ) {
 	struct profiler *profiler;
 
 	for_each_table_entry ( profiler, PROFILERS ) {
-		printf ( "%s: %ld +/- %ld ticks (%d samples)\n",
+		printf ( "%s: %ld +/- %ld ticks (%d samples",
 			 profiler->name, profile_mean ( profiler ),
 			 profile_stddev ( profiler ), profiler->count );
+		if ( profiler->hist ) {
+			printf ( ", 99%% < %ld",
+				 profile_quantile ( profiler, 99 ) );
+		}
+		printf ( ")\n" );
+	}
+
+	/* Include heap statistics */
+	heapstat();
+}
+
+/**
+ * Dump profiling histograms and trace
+ *
+ * The output is intended to be machine-readable.  Each profiler is
+ * described by a line of the form
+ *
+ *   profiler <name> <count> <mean> <stddev> <bucket0> ... <bucketN>
+ *
+ * where bucket N counts the samples for which flsl(sample)==N.  The
+ * buckets are omitted for a profiler that does not maintain a
+ * histogram.  This
+ * is followed by the contents of the trace ring (oldest first), with
+ * each event described by a line of the form
+ *
+ *   event <stop timestamp> <name> <elapsed>
+ */
+void profdump ( void ) {
+	struct profiler *profiler;
+	struct profile_event *event;
+	unsigned long prod = profile_trace_prod;
+	unsigned long cons;
+	unsigned int i;
+
+	/* Dump histograms */
+	for_each_table_entry ( profiler, PROFILERS ) {
+		printf ( "profiler %s %d %ld %ld", profiler->name,
+			 profiler->count, profile_mean ( profiler ),
+			 profile_stddev ( profiler ) );
+		for ( i = 0 ; profiler->hist && ( i < PROFILE_BUCKETS ) ; i++ )
+			printf ( " %d", profiler->hist[i] );
+		printf ( "\n" );
+	}
+
+	/* Dump trace ring */
+	cons = ( ( prod > PROFILE_TRACE_SIZE ) ?
+		 ( prod - PROFILE_TRACE_SIZE ) : 0 );
+	for ( ; cons != prod ; cons++ ) {
+		event = &profile_trace_ring[ cons % PROFILE_TRACE_SIZE ];
+		printf ( "event %ld %s %ld\n", event->stopped,
+			 event->profiler->name, event->elapsed );
 	}
 }